@@ -19,6 +19,8 @@ namespace EigenApi
         virtual void breath(const char* dev, unsigned long long t, unsigned val) {};
         virtual void strip(const char* dev, unsigned long long t, unsigned strip, unsigned val) {};
         virtual void pedal(const char* dev, unsigned long long t, unsigned pedal, unsigned val) {};
+        // end of a poll, all key events from this scan have been sent (only called if there were keys)
+        virtual void frame(const char* dev, unsigned long long t) {};
     };
     
     class Eigenharp
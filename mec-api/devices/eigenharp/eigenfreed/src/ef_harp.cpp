@@ -40,7 +40,7 @@ namespace EigenApi
 {
 
 EF_Harp::EF_Harp(EigenFreeD& efd, const char* fw) 
-	: pDevice_(NULL),fwDir_(fw),efd_(efd), stopping_(false)
+	: pDevice_(NULL),fwDir_(fw),efd_(efd), stopping_(false), keysInFrame_(false)
 {
 	;
 }
@@ -128,8 +128,16 @@ bool EF_Harp::poll(long long t)
 
 void EF_Harp::fireKeyEvent(unsigned long long t, unsigned course, unsigned key, bool a, unsigned p, int r, int y)
 {
+	keysInFrame_ = true;
 	efd_.fireKeyEvent(pDevice_->name(), t, course, key, a, p, r, y);
 }
+
+void EF_Harp::fireFrameEvent(unsigned long long t)
+{
+    if(!keysInFrame_) return;
+    keysInFrame_ = false;
+    efd_.fireFrameEvent(pDevice_->name(), t);
+}
     
 void EF_Harp::fireBreathEvent(unsigned long long t, unsigned val)
 {
@@ -152,6 +152,7 @@ bool EigenFreeD::poll(long uSleepTime,long minPollTime)
 		{    
 			EF_Harp *pDevice = *iter;
 			ret &= pDevice->poll(uSleepTime);
+			pDevice->fireFrameEvent(t);
 		}	
         return ret;
     }
@@ -209,6 +210,16 @@ void EigenFreeD::firePedalEvent(const char* dev, unsigned long long t, unsigned
     }
 }
     
+void EigenFreeD::fireFrameEvent(const char* dev, unsigned long long t)
+{
+    std::vector<EigenApi::Callback*>::iterator iter;
+    for(iter=callbacks_.begin();iter!=callbacks_.end();iter++)
+    {
+        EigenApi::Callback *cb=*iter;
+        cb->frame(dev, t);
+    }
+}
+    
 void EigenFreeD::setLED(const char* dev, unsigned int keynum,unsigned int colour)
 {
     std::vector<EF_Harp*>::iterator iter;
@@ -35,6 +35,7 @@ namespace EigenApi
         virtual void fireBreathEvent(const char* dev, unsigned long long t, unsigned val);
         virtual void fireStripEvent(const char* dev, unsigned long long t, unsigned strip, unsigned val);
         virtual void firePedalEvent(const char* dev, unsigned long long t, unsigned pedal, unsigned val);
+        virtual void fireFrameEvent(const char* dev, unsigned long long t);
 
     private:
         const char* fwDir_;
@@ -63,6 +64,7 @@ namespace EigenApi
         virtual void fireBreathEvent(unsigned long long t, unsigned val);
         virtual void fireStripEvent(unsigned long long t, unsigned strip, unsigned val);
         virtual void firePedalEvent(unsigned long long t, unsigned pedal, unsigned val);
+        virtual void fireFrameEvent(unsigned long long t);
         
         virtual void restartKeyboard() = 0;
         virtual void setLED(unsigned int keynum,unsigned int colour) = 0;
@@ -106,6 +108,7 @@ private:
         unsigned lastStrip_[2];
         unsigned lastPedal_[4];
         bool stopping_;
+        bool keysInFrame_;
     };
     
     
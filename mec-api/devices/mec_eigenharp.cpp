@@ -1,29 +1,58 @@
 #include "mec_eigenharp.h"
 
 #include "mec_log.h"
+#include "../mec_recorder.h"
 #include "../mec_surfacemapper.h"
 #include "../mec_voice.h"
 
 
-#include <set>
 
 namespace mec {
 
+// recorded input, see EventRecorder
+enum EigenharpRecord {
+    ER_DEVICE,
+    ER_KEY,
+    ER_BREATH,
+    ER_STRIP,
+    ER_PEDAL,
+    ER_FRAME
+};
+
+struct EigenharpDeviceRec {
+    int32_t type_, rows_, cols_, ribbons_, pedals_;
+};
+
+struct EigenharpKeyRec {
+    uint64_t t_;
+    uint32_t course_, key_;
+    int32_t a_, p_, r_, y_;
+};
+
+struct EigenharpValueRec { // breath, strip, pedal, frame
+    uint64_t t_;
+    uint32_t id_, val_;
+};
+
 ////////////////////////////////////////////////
 class EigenharpHandler : public EigenApi::Callback {
 public:
-    EigenharpHandler(Preferences &p, ICallback &cb)
+    EigenharpHandler(Preferences &p, ICallback &cb, LatencyStats &stats, EventRecorder *recorder)
             : prefs_(p),
               callback_(cb),
-              valid_(true),
+              stats_(stats),
+              recorder_(recorder),
               voices_(static_cast<unsigned>(p.getInt("voices", 15)),
                       static_cast<unsigned>(p.getInt("velocity count", 5))),
+              valid_(true),
               pitchbendRange_((float) p.getDouble("pitchbend range", 2.0)),
               stealVoices_(p.getBool("steal voices", true)),
               throttle_(p.getInt("throttle", 0) == 0
                         ? 0 : 1000000ULL /
                               p.getInt("throttle",
-                                       0)) {
+                                       0)),
+              frameCallback_(nullptr) {
+        voices_.stealPolicy(Voices::stealPolicy(p.getString("steal policy", "oldest")));
         if (valid_) {
             LOG_0("EigenharpHandler enabling for mecapi");
         }
@@ -32,6 +61,7 @@ public:
     bool isValid() { return valid_; }
 
     virtual void device(const char *dev, DeviceType dt, int rows, int cols, int ribbons, int pedals) {
+        if (recorder_) recorder_->record(ER_DEVICE, EigenharpDeviceRec{dt, rows, cols, ribbons, pedals});
         const char *dk;
         switch (dt) {
             case EigenApi::Callback::PICO:
@@ -63,6 +93,103 @@ public:
 
     virtual void key(const char *dev, unsigned long long t, unsigned course, unsigned key, bool a, unsigned p, int r,
                      int y) {
+        // no queue, callbacks are called directly (on process thread), so only delivery/total latency
+        MecTime arrival = mecTimeNow();
+        if (recorder_) recorder_->record(ER_KEY, EigenharpKeyRec{t, course, key, a, (int32_t) p, r, y});
+        callback_.eventTime(arrival);
+        processKey(dev, t, course, key, a, p, r, y);
+        MecTime delivered = mecTimeNow();
+        stats_.record(LatencyStats::DELIVERY, arrival, delivered);
+        stats_.record(LatencyStats::TOTAL, arrival, delivered);
+    }
+
+    virtual void breath(const char *dev, unsigned long long t, unsigned val) {
+        if (recorder_) recorder_->record(ER_BREATH, EigenharpValueRec{t, 0, val});
+        callback_.control(0, unipolar(val));
+    }
+
+    virtual void strip(const char *dev, unsigned long long t, unsigned strip, unsigned val) {
+        if (recorder_) recorder_->record(ER_STRIP, EigenharpValueRec{t, strip, val});
+        callback_.control(0x10 + strip, unipolar(val));
+    }
+
+    virtual void pedal(const char *dev, unsigned long long t, unsigned pedal, unsigned val) {
+        if (recorder_) recorder_->record(ER_PEDAL, EigenharpValueRec{t, pedal, val});
+        callback_.control(0x20 + pedal, unipolar(val));
+    }
+
+    virtual void frame(const char *dev, unsigned long long t) {
+        if (recorder_ && dev != nullptr) recorder_->record(ER_FRAME, EigenharpValueRec{t, 0, 0});
+        if (frameCallback_ && frame_.size_ > 0) frameCallback_->frame(frame_);
+        frame_.clear();
+    }
+
+    void setFrameCallback(IFrameCallback *cb) {
+        frameCallback_ = cb;
+        frame_.clear();
+    }
+
+    void replay(const EventRecord &r) {
+        static const char *dev = "replay";
+        switch (r.type_) {
+            case ER_DEVICE: {
+                const EigenharpDeviceRec *d = r.as<EigenharpDeviceRec>();
+                if (d) device(dev, (DeviceType) d->type_, d->rows_, d->cols_, d->ribbons_, d->pedals_);
+                break;
+            }
+            case ER_KEY: {
+                const EigenharpKeyRec *k = r.as<EigenharpKeyRec>();
+                if (k) key(dev, k->t_, k->course_, k->key_, k->a_ != 0, (unsigned) k->p_, k->r_, k->y_);
+                break;
+            }
+            case ER_BREATH: {
+                const EigenharpValueRec *v = r.as<EigenharpValueRec>();
+                if (v) breath(dev, v->t_, v->val_);
+                break;
+            }
+            case ER_STRIP: {
+                const EigenharpValueRec *v = r.as<EigenharpValueRec>();
+                if (v) strip(dev, v->t_, v->id_, v->val_);
+                break;
+            }
+            case ER_PEDAL: {
+                const EigenharpValueRec *v = r.as<EigenharpValueRec>();
+                if (v) pedal(dev, v->t_, v->id_, v->val_);
+                break;
+            }
+            case ER_FRAME: {
+                const EigenharpValueRec *v = r.as<EigenharpValueRec>();
+                if (v) frame(dev, v->t_);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+private:
+    // deliver to callback, and collect for frame
+    void touch(TouchFrame::State s, int id, float note, float x, float y, float z) {
+        switch (s) {
+            case TouchFrame::T_ON:
+                callback_.touchOn(id, note, x, y, z);
+                break;
+            case TouchFrame::T_CONTINUE:
+                callback_.touchContinue(id, note, x, y, z);
+                break;
+            case TouchFrame::T_OFF:
+                callback_.touchOff(id, note, x, y, z);
+                break;
+        }
+        if (frameCallback_) {
+            if (frame_.isFull()) frame(nullptr, 0);
+            if (frame_.size_ == 0) frame_.t_ = mecTimeNow();
+            frame_.add(s, id, note, x, y, z);
+        }
+    }
+
+    void processKey(const char *dev, unsigned long long t, unsigned course, unsigned key, bool a, unsigned p, int r,
+                    int y) {
         Voices::Voice *voice = voices_.voiceId(key);
         float mx = bipolar(r);
         float my = bipolar(y);
@@ -76,7 +203,7 @@ public:
             LOG_3(" mn: " << mn << " mx: " << mx << " my: " << my << " mz: " << mz);
 
             if (!voice) {
-                if (stolenKeys_.find(key) != stolenKeys_.end()) {
+                if (voices_.isStolen(key)) {
                     // this key has been stolen, must be released to reactivate it
                     return;
                 }
@@ -86,9 +213,9 @@ public:
                 if (!voice && stealVoices_) {
                     LOG_2("voice steal required for " << key);
                     // no available voices, steal?
-                    Voices::Voice *stolen = voices_.oldestActiveVoice();
-                    callback_.touchOff(stolen->i_, stolen->note_, stolen->x_, stolen->y_, 0.0f);
-                    stolenKeys_.insert((unsigned) stolen->id_);
+                    Voices::Voice *stolen = voices_.voiceToSteal(mn);
+                    touch(TouchFrame::T_OFF, stolen->i_, stolen->note_, stolen->x_, stolen->y_, 0.0f);
+                    voices_.markStolen((unsigned) stolen->id_);
                     voices_.stopVoice(stolen);
                     voice = voices_.startVoice(key);
                     // if(voice) { LOG_1("voice steal found for " << key  "stolen from " << stolen->id_)); }
@@ -100,14 +227,14 @@ public:
                     voices_.addPressure(voice, mz);
                     if (voice->state_ == Voices::Voice::ACTIVE) {
                         LOG_2("start voice for " << key << " ch " << voice->i_);
-                        callback_.touchOn(voice->i_, mn, mx, my, voice->v_); //v_ = calculated velocity
+                        touch(TouchFrame::T_ON, voice->i_, mn, mx, my, voice->v_); //v_ = calculated velocity
                         voice->t_ = t;
                     }
                     // dont send to callbacks until we have the minimum pressures for velocity
                 } else {
                     if (throttle_ == 0 || (t - voice->t_) >= throttle_) {
                         LOG_2("continue voice for " << key << " ch " << voice->i_);
-                        callback_.touchContinue(voice->i_, mn, mx, my, mz);
+                        touch(TouchFrame::T_CONTINUE, voice->i_, mn, mx, my, mz);
                         voice->t_ = t;
                     }
                 }
@@ -123,26 +250,13 @@ public:
 
             if (voice) {
                 LOG_2("stop voice for " << key << " ch " << voice->i_);
-                callback_.touchOff(voice->i_, mn, mx, my, mz);
+                touch(TouchFrame::T_OFF, voice->i_, mn, mx, my, mz);
                 voices_.stopVoice(voice);
             }
-            stolenKeys_.erase(key);
+            voices_.clearStolen(key);
         }
     }
 
-    virtual void breath(const char *dev, unsigned long long t, unsigned val) {
-        callback_.control(0, unipolar(val));
-    }
-
-    virtual void strip(const char *dev, unsigned long long t, unsigned strip, unsigned val) {
-        callback_.control(0x10 + strip, unipolar(val));
-    }
-
-    virtual void pedal(const char *dev, unsigned long long t, unsigned pedal, unsigned val) {
-        callback_.control(0x20 + pedal, unipolar(val));
-    }
-
-private:
     inline float clamp(float v, float mn, float mx) { return (std::max(std::min(v, mx), mn)); }
 
     float unipolar(int val) { return std::min(float(val) / 4096.0f, 1.0f); }
@@ -156,19 +270,22 @@ private:
 
     Preferences prefs_;
     ICallback &callback_;
+    LatencyStats &stats_;
+    EventRecorder *recorder_; // nullptr, if not recording
     SurfaceMapper mapper_;
     Voices voices_;
     bool valid_;
     float pitchbendRange_;
     bool stealVoices_;
     unsigned long long throttle_;
-    std::set<unsigned> stolenKeys_;
+    IFrameCallback *frameCallback_;
+    TouchFrame frame_;
 };
 
 
 ////////////////////////////////////////////////
 Eigenharp::Eigenharp(ICallback &cb) :
-        active_(false), callback_(cb), minPollTime_(100) {
+        active_(false), callback_(cb), minPollTime_(100), frameCallback_(nullptr) {
 }
 
 Eigenharp::~Eigenharp() {
@@ -186,8 +303,12 @@ bool Eigenharp::init(void *arg) {
     std::string fwDir = prefs.getString("firmware dir", "./resources/");
     minPollTime_ = prefs.getInt("min poll time", 100);
     eigenD_.reset(new EigenApi::Eigenharp(fwDir.c_str()));
-    EigenharpHandler *pCb = new EigenharpHandler(prefs, callback_);
+    std::string recordFile = prefs.getString("record", "");
+    if (!recordFile.empty()) recorder_.open(recordFile, "eigenharp");
+    EigenharpHandler *pCb = new EigenharpHandler(prefs, callback_, stats_, recorder_.isOpen() ? &recorder_ : nullptr);
     if (pCb->isValid()) {
+        handler_.reset(pCb);
+        handler_->setFrameCallback(frameCallback_);
         eigenD_->addCallback(pCb);
         if (eigenD_->create()) {
             if (eigenD_->start()) {
@@ -208,14 +329,30 @@ bool Eigenharp::init(void *arg) {
 
 bool Eigenharp::process() {
     const int sleepTime = 0;
-    if (active_) eigenD_->poll(sleepTime, minPollTime_);
+    if (active_ && eigenD_) eigenD_->poll(sleepTime, minPollTime_);
     return true;
 }
 
+bool Eigenharp::initReplay(void *arg) {
+    Preferences prefs(arg);
+    deinit();
+    handler_.reset(new EigenharpHandler(prefs, callback_, stats_, nullptr));
+    handler_->setFrameCallback(frameCallback_);
+    active_ = handler_->isValid();
+    return active_;
+}
+
+void Eigenharp::replay(const EventRecord &r) {
+    if (handler_) handler_->replay(r);
+}
+
 void Eigenharp::deinit() {
-    if (!eigenD_) return;
-    eigenD_->destroy();
-    eigenD_.reset();
+    if (eigenD_) {
+        eigenD_->destroy();
+        eigenD_.reset();
+    }
+    handler_.reset();
+    recorder_.close();
     active_ = false;
 }
 
@@ -223,6 +360,16 @@ bool Eigenharp::isActive() {
     return active_;
 }
 
+LatencyStats *Eigenharp::latencyStats() {
+    return &stats_;
+}
+
+bool Eigenharp::setFrameCallback(IFrameCallback *cb) {
+    frameCallback_ = cb;
+    if (handler_) handler_->setFrameCallback(cb);
+    return true;
+}
+
 }
 
 
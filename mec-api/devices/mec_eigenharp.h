@@ -3,11 +3,15 @@
 
 #include "../mec_api.h"
 #include "../mec_device.h"
+#include "../mec_recorder.h"
 
 #include <eigenfreed/eigenfreed.h>
 #include <memory>
 
 namespace mec {
+
+class EigenharpHandler;
+
 class Eigenharp : public Device {
 
 public:
@@ -17,12 +21,20 @@ public:
     virtual bool process();
     virtual void deinit();
     virtual bool isActive();
+    virtual LatencyStats *latencyStats();
+    virtual bool setFrameCallback(IFrameCallback *);
+    virtual bool initReplay(void *);
+    virtual void replay(const EventRecord &);
 
 private:
     ICallback &callback_;
     std::unique_ptr<EigenApi::Eigenharp> eigenD_;
     bool active_;
     long minPollTime_;
+    LatencyStats stats_;
+    std::unique_ptr<EigenharpHandler> handler_; // callback registered with eigenD_
+    IFrameCallback *frameCallback_;
+    EventRecorder recorder_;
 };
 
 }
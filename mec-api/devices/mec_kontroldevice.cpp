@@ -65,12 +65,19 @@ bool KontrolDevice::init(void *arg) {
     active_ = false;
 
     model_->addCallback("clienthandler", std::make_shared<KontrolDeviceClientHandler>(*this));
+    clients_ = std::make_shared<Kontrol::OSCBroadcaster>(Kontrol::CS_LOCAL, 0, true);
+    unsigned coalesce = static_cast<unsigned>(prefs.getInt("coalesce", 0));
+    clients_->setCoalesce(coalesce);
+    if (coalesce > 0) LOG_0("kontrol device : parameter changes coalesced, every " << coalesce << "ms");
+    model_->addCallback("client.osc", clients_);
 
     listenPort_ = static_cast<unsigned>(prefs.getInt("listen port", 4000));
 
     if (listenPort_ > 0) {
         auto p = std::make_shared<Kontrol::OSCReceiver>(model_);
-        if (p->listen(listenPort_)) {
+        if (p->listen(listenPort_,
+                      static_cast<unsigned>(prefs.getInt("batch", mec::UdpReceiver::DEFAULT_BATCH)),
+                      static_cast<unsigned>(prefs.getInt("busy poll", 0)))) {
             osc_receiver_ = p;
             LOG_0("kontrol device : listening on " << listenPort_);
         }
@@ -89,21 +96,11 @@ void KontrolDevice::newClient(
         unsigned port,
         unsigned keepalive) {
 
-    for (auto client : clients_) {
-        if (client->isThisHost(host, port)) {
-            return;
-        }
-    }
+    if (!clients_ || clients_->isThisHost(host, port)) return;
 
-    std::string id = "client.osc:" + host + ":" + std::to_string(port);
-
-    auto client = std::make_shared<Kontrol::OSCBroadcaster>(src, keepalive, true);
-    if (client->connect(host, port)) {
-        LOG_0("KontrolDevice::new client " << client->host() << " : " << client->port() << " KA = " << keepalive);
-//        client->sendPing(listenPort_);
-        client->ping(src, host, port, keepalive);
-        clients_.push_back((client));
-        model_->addCallback(id, client);
+    if (clients_->addClient(src, host, port, keepalive)) {
+        LOG_0("KontrolDevice::new client " << host << " : " << port << " KA = " << keepalive);
+        clients_->ping(src, host, port, keepalive);
     }
 }
 
@@ -118,32 +115,9 @@ void KontrolDevice::processorRun() {
             auto dur = std::chrono::duration_cast<std::chrono::seconds>(now - lastPing_);
             if (dur >= pingFrequency) {
                 lastPing_ = now;
-                bool inactive = false;
-                for (auto client : clients_) {
-                    if (!client->isActive()) {
-                        // not received a ping from this client
-                        inactive = true;
-                    } else {
-                        client->sendPing(osc_receiver_->port());
-                    }
-                }
-
-                // search for inactive clients and remove
-                while (inactive) {
-                    inactive = false;
-                    for (auto it = clients_.begin(); !inactive && it != clients_.end();) {
-                        auto client = *it;
-                        if (!client->isActive()) {
-                            LOG_0("KontrolDevice::Process... remove inactive client " << client->host() << " : "
-                                                                                      << client->port());
-                            client->stop();
-                            clients_.erase(it);
-                            inactive = true;
-                        } else {
-                            it++;
-                        }
-                    }
-                }
+                // remove clients we have not received a ping from
+                clients_->removeInactive();
+                clients_->sendPing(osc_receiver_->port());
             }
         }
         std::this_thread::sleep_for(std::chrono::milliseconds(OSC_POLL_MS));
@@ -158,22 +132,28 @@ bool KontrolDevice::process() {
 
 void KontrolDevice::deinit() {
     LOG_0("KontrolDevice::deinit");
-    for (auto client : clients_) {
-        client->stop();
-    }
-    clients_.clear();
     if (osc_receiver_) osc_receiver_->stop();
 
     active_ = false;
     if (processor_.joinable()) {
         processor_.join();
     }
+    // after the processor, so no new clients
+    if (clients_) {
+        if (clients_->coalesced() > 0) LOG_0("kontrol device : " << clients_->coalesced() << " changes coalesced");
+        clients_->stop();
+    }
 }
 
 bool KontrolDevice::isActive() {
     return active_;
 }
 
+bool KontrolDevice::setWakeup(MsgWakeup *) {
+    // nothing delivered via process(), all done on processor thread
+    return true;
+}
+
 }
 
 
@@ -23,6 +23,7 @@ public:
     virtual bool process();
     virtual void deinit();
     virtual bool isActive();
+    virtual bool setWakeup(MsgWakeup *);
 
     void newClient(Kontrol::ChangeSource src, const std::string &host, unsigned port, unsigned keepalive);
     void processorRun();
@@ -36,7 +37,7 @@ private:
     std::shared_ptr<Kontrol::KontrolModel> model_;
     std::shared_ptr<Kontrol::OSCReceiver> osc_receiver_;
     std::chrono::steady_clock::time_point lastPing_;
-    std::vector<std::shared_ptr<Kontrol::OSCBroadcaster> > clients_;
+    std::shared_ptr<Kontrol::OSCBroadcaster> clients_; // all clients, one writer thread
     std::thread processor_;
 };
 
@@ -0,0 +1,133 @@
+#include "mec_midi_decoder.h"
+
+#include <cstring>
+
+namespace mec {
+
+MidiDecoder::MidiDecoder(MsgQueue &queue) :
+        queue_(queue),
+        mpe_(true),
+        pitchbendRange_(48.0f),
+        time_(0) {
+    reset();
+}
+
+void MidiDecoder::reset() {
+    memset(&ch_, 0, sizeof(ch_));
+    active_ = 0;
+}
+
+void MidiDecoder::touch(MecMsg::type t, unsigned ch) {
+    MecMsg *msg = queue_.reserve();
+    if (msg == nullptr) return; // full, counted by queue
+    msg->type_ = t;
+    msg->data_.touch_.touchId_ = ch;
+    msg->data_.touch_.note_ = ch_.note_[ch];
+    msg->data_.touch_.x_ = ch_.x_[ch];
+    msg->data_.touch_.y_ = ch_.y_[ch];
+    msg->data_.touch_.z_ = ch_.z_[ch];
+    msg->deviceTime_ = time_;
+    queue_.commit(msg);
+}
+
+void MidiDecoder::control(int id, float v) {
+    MecMsg *msg = queue_.reserve();
+    if (msg == nullptr) return;
+    msg->type_ = MecMsg::CONTROL;
+    msg->data_.control_.controlId_ = id;
+    msg->data_.control_.value_ = v;
+    msg->deviceTime_ = time_;
+    queue_.commit(msg);
+}
+
+void MidiDecoder::noteOn(unsigned ch, unsigned note, unsigned vel) {
+    unsigned bit = 1U << ch;
+    if (mpe_ && ((active_ & bit) || vel == 0)) {
+        // a channel is a touch, so retrigger (or note on, velocity 0) ends it
+        ch_.y_[ch] = 0.0f;
+        ch_.z_[ch] = 0.0f;
+        active_ &= ~bit;
+        // assumption: callback handler wants note to be touch finish position
+        touch(MecMsg::TOUCH_OFF, ch);
+        ch_.startNote_[ch] = 0.0f;
+        if (vel == 0) return;
+    }
+
+    // (not mpe, just sent thru, so can be multiple notes on 1 channel)
+    ch_.startNote_[ch] = (float) note;
+    ch_.note_[ch] = (float) note;
+    ch_.x_[ch] = 0.0f;
+    ch_.y_[ch] = 0.0f;
+    ch_.z_[ch] = float(vel) / 127.0f;
+    active_ |= bit;
+    touch(MecMsg::TOUCH_ON, ch);
+}
+
+void MidiDecoder::noteOff(unsigned ch, unsigned note, unsigned vel) {
+    if (mpe_) {
+        // touch note is where it finished, not the note off note
+        ch_.y_[ch] = 0.0f;
+    } else {
+        ch_.note_[ch] = (float) note;
+        ch_.x_[ch] = 0.0f;
+        ch_.y_[ch] = 0.0f;
+    }
+    ch_.z_[ch] = float(vel) / 127.0f;
+    active_ &= ~(1U << ch);
+    touch(MecMsg::TOUCH_OFF, ch);
+    ch_.startNote_[ch] = 0.0f;
+}
+
+void MidiDecoder::message(unsigned char status, unsigned char d1, unsigned char d2) {
+    unsigned ch = status & 0x0F;
+    unsigned type = status & 0xF0;
+    bool active = (active_ & (1U << ch)) != 0;
+    switch (type) {
+        case 0x90:
+            noteOn(ch, d1, d2);
+            break;
+        case 0x80:
+            noteOff(ch, d1, d2);
+            break;
+        case 0xB0: {
+            float v = float(d2) / 127.0f;
+            if (mpe_ && d1 == 74) {
+                if (!active) break;
+                ch_.y_[ch] = v;
+                touch(MecMsg::TOUCH_CONTINUE, ch);
+            } else {
+                control(d1, v);
+            }
+            break;
+        }
+        case 0xD0: {
+            float v = float(d1) / 127.0f;
+            if (mpe_) {
+                if (!active) break;
+                ch_.z_[ch] = v;
+                touch(MecMsg::TOUCH_CONTINUE, ch);
+            } else {
+                control(type, v);
+            }
+            break;
+        }
+        case 0xE0: {
+            float pb = (float) ((d2 << 7) + d1);
+            float v = (pb / 8192.0f) - 1.0f;  // -1.0 to 1.0
+            if (mpe_) {
+                if (!active) break;
+                ch_.note_[ch] = ch_.startNote_[ch] + (v * pitchbendRange_);
+                ch_.x_[ch] = v;
+                touch(MecMsg::TOUCH_CONTINUE, ch);
+            } else {
+                control(type, v);
+            }
+            break;
+        }
+        default:
+            // everything else, ignored
+            break;
+    }
+}
+
+}
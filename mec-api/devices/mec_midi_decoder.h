@@ -0,0 +1,51 @@
+#ifndef MEC_MIDI_DECODER_H
+#define MEC_MIDI_DECODER_H
+
+#include "../mec_msg_queue.h"
+#include "../processors/mec_midi_parser.h"
+
+namespace mec {
+
+// decodes midi input (from a MidiParser) into touches and controls, built in place in a device queue
+// mpe : a touch per channel, pitchbend/cc74/channel pressure are x/y/z
+// otherwise : notes are passed thru as touches on their channel, other messages as controls
+// channel state is a compact table (structure of arrays), only touched for the message's channel
+class MidiDecoder : public MidiParser::Handler {
+public:
+    MidiDecoder(MsgQueue &queue);
+
+    void setMpe(bool mpe) { mpe_ = mpe; }
+    void setPitchbendRange(float pbr) { pitchbendRange_ = pbr; }
+    void reset(); // all touches off (without sending)
+
+    // device time of following messages, i.e. when the buffer being parsed arrived
+    void setTime(MecTime t) { time_ = t; }
+
+    void message(unsigned char status, unsigned char d1, unsigned char d2) override;
+
+private:
+    static const unsigned N_CH = 16;
+
+    void noteOn(unsigned ch, unsigned note, unsigned vel);
+    void noteOff(unsigned ch, unsigned note, unsigned vel);
+    void touch(MecMsg::type t, unsigned ch);
+    void control(int id, float v);
+
+    MsgQueue &queue_;
+    bool mpe_;
+    float pitchbendRange_;
+    MecTime time_;
+
+    struct Channels {
+        float startNote_[N_CH];
+        float note_[N_CH];
+        float x_[N_CH];
+        float y_[N_CH];
+        float z_[N_CH];
+    } ch_;
+    unsigned active_; // bit per channel
+};
+
+}
+
+#endif //MEC_MIDI_DECODER_H
@@ -0,0 +1,132 @@
+#include "mec_midi_merger.h"
+
+namespace mec {
+
+MidiMerger::MidiMerger(MsgQueue &out, unsigned inputs, unsigned voices, bool steal, bool mpe) :
+        out_(out),
+        inputs_(inputs, nullptr),
+        voices_(voices, 5, inputs * N_CH * (mpe ? 1 : N_NOTES)),
+        steal_(steal),
+        mpe_(mpe),
+        dropped_(0) {
+}
+
+unsigned MidiMerger::merge() {
+    unsigned n = 0;
+    // a touch on may also need a stolen touch off, so keep space for 2
+    while (out_.available() >= 2) {
+        // oldest message at the front of an input, inputs are few, so a linear scan
+        int next = -1;
+        const MecMsg *nextMsg = nullptr;
+        for (unsigned i = 0; i < inputs_.size(); i++) {
+            if (inputs_[i] == nullptr) continue;
+            const MecMsg *msg = inputs_[i]->front();
+            if (msg != nullptr && (nextMsg == nullptr || msg->deviceTime_ < nextMsg->deviceTime_)) {
+                next = i;
+                nextMsg = msg;
+            }
+        }
+        if (next < 0) break;
+
+        switch (nextMsg->type_) {
+            case MecMsg::TOUCH_ON:
+            case MecMsg::TOUCH_CONTINUE:
+            case MecMsg::TOUCH_OFF:
+                touch((unsigned) next, *nextMsg);
+                break;
+            default: {
+                MecMsg msg = *nextMsg;
+                add(msg);
+                break;
+            }
+        }
+        inputs_[next]->popFront();
+        n++;
+    }
+    return n;
+}
+
+bool MidiMerger::add(MecMsg &msg) {
+    if (out_.addToQueue(msg)) return true;
+    dropped_++;
+    return false;
+}
+
+unsigned MidiMerger::key(unsigned input, const MecMsg &msg) const {
+    unsigned ch = input * N_CH + ((unsigned) msg.data_.touch_.touchId_ % N_CH);
+    if (mpe_) return ch;
+    // not mpe, touches are only on/off, and note is the midi note
+    return ch * N_NOTES + ((unsigned) msg.data_.touch_.note_ % N_NOTES);
+}
+
+void MidiMerger::touch(unsigned input, const MecMsg &in) {
+    unsigned key = this->key(input, in);
+    Voices::Voice *voice = voices_.voiceId(key);
+    MecMsg msg = in;
+
+    if (in.type_ == MecMsg::TOUCH_OFF) {
+        if (voice) {
+            msg.data_.touch_.touchId_ = voice->i_;
+            add(msg);
+            voices_.stopVoice(voice);
+        }
+        voices_.clearStolen(key);
+        return;
+    }
+
+    if (in.type_ == MecMsg::TOUCH_CONTINUE) {
+        if (!voice) {
+            // stolen (or never started), wait for its release
+            dropped_++;
+            return;
+        }
+    } else {
+        if (voice) {
+            // retrigger without an off, end the previous one
+            MecMsg off = in;
+            off.type_ = MecMsg::TOUCH_OFF;
+            off.data_.touch_.touchId_ = voice->i_;
+            off.data_.touch_.note_ = voice->note_;
+            off.data_.touch_.z_ = 0.0f;
+            add(off);
+            voices_.stopVoice(voice);
+        } else if (voices_.isStolen(key)) {
+            // this key has been stolen, must be released to reactivate it
+            dropped_++;
+            return;
+        }
+
+        voice = voices_.startVoice(key);
+        if (!voice && steal_) {
+            Voices::Voice *stolen = voices_.voiceToSteal(in.data_.touch_.note_);
+
+            MecMsg stolenMsg;
+            stolenMsg.deviceTime_ = in.deviceTime_;
+            stolenMsg.type_ = MecMsg::TOUCH_OFF;
+            stolenMsg.data_.touch_.touchId_ = stolen->i_;
+            stolenMsg.data_.touch_.note_ = stolen->note_;
+            stolenMsg.data_.touch_.x_ = stolen->x_;
+            stolenMsg.data_.touch_.y_ = stolen->y_;
+            stolenMsg.data_.touch_.z_ = 0.0f;
+            voices_.markStolen((unsigned) stolen->id_);
+            add(stolenMsg);
+            voices_.stopVoice(stolen);
+
+            voice = voices_.startVoice(key);
+        }
+        if (!voice) {
+            dropped_++;
+            return;
+        }
+    }
+
+    msg.data_.touch_.touchId_ = voice->i_;
+    voice->note_ = in.data_.touch_.note_;
+    voice->x_ = in.data_.touch_.x_;
+    voice->y_ = in.data_.touch_.y_;
+    voice->z_ = in.data_.touch_.z_;
+    voice->t_ = in.deviceTime_;
+    add(msg);
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef MEC_MIDI_MERGER_H
+#define MEC_MIDI_MERGER_H
+
+#include "../mec_msg_queue.h"
+#include "../mec_voice.h"
+
+#include <vector>
+
+namespace mec {
+
+// merges the queues of several midi inputs (each filled by its own MidiDecoder, on its own thread)
+// into one device queue, in device time order, on the consumer thread
+// touch ids from an input are its channels, so are remapped to voices from one allocator,
+// keyed by input * 16 + channel, giving one touch id space over all inputs
+// without mpe, a channel can have several notes, so keyed by input, channel and note
+// note: only what is queued is merged, an input that is late delivering can be slightly out of order
+class MidiMerger {
+public:
+    static const unsigned N_CH = 16;
+    static const unsigned N_NOTES = 128;
+
+    MidiMerger(MsgQueue &out, unsigned inputs, unsigned voices, bool steal = true, bool mpe = true);
+
+    void stealPolicy(Voices::StealPolicy p) { voices_.stealPolicy(p); }
+    void setInput(unsigned idx, MsgQueue *queue) { if (idx < inputs_.size()) inputs_[idx] = queue; }
+
+    // move queued input messages to out, returns number of input messages consumed
+    unsigned merge();
+
+    unsigned long dropped() const { return dropped_; } // touches without a voice (or out queue full)
+
+private:
+    unsigned key(unsigned input, const MecMsg &msg) const;
+    void touch(unsigned input, const MecMsg &msg);
+    bool add(MecMsg &msg);
+
+    MsgQueue &out_;
+    std::vector<MsgQueue *> inputs_;
+    Voices voices_;
+    bool steal_;
+    bool mpe_;
+    unsigned long dropped_;
+};
+
+}
+
+#endif //MEC_MIDI_MERGER_H
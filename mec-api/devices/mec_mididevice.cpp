@@ -7,7 +7,7 @@ namespace mec {
 
 ////////////////////////////////////////////////
 MidiDevice::MidiDevice(ICallback &cb) :
-        active_(false), callback_(cb) {
+        active_(false), callback_(cb), virtualOpen_(false), decoder_(queue_), wakeup_(nullptr) {
 }
 
 MidiDevice::~MidiDevice() {
@@ -25,56 +25,113 @@ RtMidiIn::RtMidiCallback MidiDevice::getMidiCallback() {
     return MidiDeviceInCallback;
 }
 
+void MidiDevice::inputCallback(double, std::vector<unsigned char> *message, void *userData) {
+    MidiInput *in = static_cast<MidiInput *>(userData);
+    unsigned n = message->size();
+    if (n == 0) return;
+    EventRecorder &recorder = in->device_.recorder_;
+    if (recorder.isOpen()) {
+        std::lock_guard<std::mutex> lock(in->device_.recordMutex_);
+        recorder.record(in->index_, message->data(), n);
+    }
+    in->input(message->data(), n);
+}
 
-bool MidiDevice::init(void *arg) {
-    Preferences prefs(arg);
+// "input devices" : [ ... ], or a single "input device"
+std::vector<std::string> MidiDevice::inputDevices(Preferences &prefs) {
+    std::vector<std::string> names;
+    if (prefs.exists("input devices")) {
+        Preferences::Array array(prefs.getArray("input devices"));
+        unsigned size = static_cast<unsigned>(array.getSize());
+        for (unsigned i = 0; i < size; i++) names.push_back(array.getString(i));
+    } else {
+        std::string input_device = prefs.getString("input device");
+        if (!input_device.empty()) names.push_back(input_device);
+    }
+    return names;
+}
 
-    if (active_) {
-        deinit();
+std::unique_ptr<RtMidiIn> MidiDevice::openInput(const std::string &input_device) {
+    std::unique_ptr<RtMidiIn> in;
+    try {
+        in.reset(new RtMidiIn(RtMidi::Api::UNSPECIFIED, "MEC MIDI IN DEVICE"));
+    } catch (RtMidiError &error) {
+        LOG_0("MidiDevice RtMidiIn ctor error:" << error.what());
+        return nullptr;
     }
-    active_ = false;
 
     bool found = false;
-
-    std::string input_device = prefs.getString("input device");
-    if (!input_device.empty()) {
-
-        try {
-            midiInDevice_.reset(new RtMidiIn(RtMidi::Api::UNSPECIFIED,"MEC MIDI IN DEVICE"));
-        } catch (RtMidiError &error) {
-            midiInDevice_.reset();
-            LOG_0("MidiDevice RtMidiIn ctor error:" << error.what());
-            return false;
-        }
-
-        mpeMode_ = prefs.getBool("mpe", true);
-        pitchbendRange_ = (float) prefs.getDouble("pitchbend range", 48.0);
-
-        for (unsigned i = 0; i < midiInDevice_->getPortCount() && !found; i++) {
-            if (input_device.compare(midiInDevice_->getPortName(i)) == 0) {
-                try {
-                    midiInDevice_->openPort(i,"MIDI IN");
-                    found = true;
-                    LOG_1("Midi input opened :" << input_device);
-                } catch (RtMidiError &error) {
-                    LOG_0("Midi input open error:" << error.what());
-                    midiInDevice_.reset();
-                    return false;
-                }
+    for (unsigned i = 0; i < in->getPortCount() && !found; i++) {
+        if (input_device.compare(in->getPortName(i)) == 0) {
+            try {
+                in->openPort(i, "MIDI IN");
+                found = true;
+                LOG_1("Midi input opened :" << input_device);
+            } catch (RtMidiError &error) {
+                LOG_0("Midi input open error:" << error.what());
+                return nullptr;
             }
         }
-        if (!found) {
-            LOG_0("Input device not found : [" << input_device << "]");
-            LOG_0("available devices:");
-            for (unsigned i = 0; i < midiInDevice_->getPortCount(); i++) {
-                LOG_0("[" << midiInDevice_->getPortName(i) << "]");
-            }
-            midiInDevice_.reset();
-            return false;
+    }
+    if (!found) {
+        LOG_0("Input device not found : [" << input_device << "]");
+        LOG_0("available devices:");
+        for (unsigned i = 0; i < in->getPortCount(); i++) {
+            LOG_0("[" << in->getPortName(i) << "]");
         }
+        return nullptr;
+    }
 
+    in->ignoreTypes(true, true, true);
+    return in;
+}
+
+void MidiDevice::initInputs(Preferences &prefs, unsigned n) {
+    unsigned capacity = static_cast<unsigned>(prefs.getInt("queue size", MsgQueue::DEFAULT_QUEUE_SIZE));
+    merger_.reset(new MidiMerger(queue_, n,
+                                 static_cast<unsigned>(prefs.getInt("voices", n * MidiMerger::N_CH)),
+                                 prefs.getBool("steal voices", true),
+                                 prefs.getBool("mpe", true)));
+    merger_->stealPolicy(Voices::stealPolicy(prefs.getString("steal policy", "oldest")));
+    for (unsigned i = 0; i < n; i++) {
+        inputs_.emplace_back(new MidiInput(*this, i));
+        MidiInput &in = *inputs_.back();
+        in.queue_.setCapacity(capacity);
+        in.queue_.setWakeup(wakeup_);
+        merger_->setInput(i, &in.queue_);
+    }
+}
+
+
+bool MidiDevice::init(void *arg) {
+    Preferences prefs(arg);
 
-        midiInDevice_->ignoreTypes(true, true, true);
+    if (active_) {
+        deinit();
+    }
+    active_ = false;
+    queue_.setCapacity(static_cast<unsigned>(prefs.getInt("queue size", MsgQueue::DEFAULT_QUEUE_SIZE)));
+
+    std::string recordFile = prefs.getString("record", "");
+    if (!recordFile.empty()) recorder_.open(recordFile, "midi");
+
+    std::vector<std::string> inputs = inputDevices(prefs);
+    if (inputs.size() > 1) {
+        initInputs(prefs, inputs.size());
+        initDecoder(prefs);
+        for (unsigned i = 0; i < inputs.size(); i++) {
+            MidiInput &in = *inputs_[i];
+            in.in_ = openInput(inputs[i]);
+            if (!in.in_) {
+                deinit();
+                return false;
+            }
+            in.in_->setCallback(inputCallback, &in);
+        }
+    } else if (!inputs.empty()) {
+        midiInDevice_ = openInput(inputs[0]);
+        if (!midiInDevice_) return false;
+        initDecoder(prefs);
         midiInDevice_->setCallback(getMidiCallback(), this);
     } //midi input
 
@@ -100,7 +157,7 @@ bool MidiDevice::init(void *arg) {
                 return false;
             }
         } else {
-            found = false;
+            bool found = false;
             for (unsigned i = 0; i < midiOutDevice_->getPortCount() && !found; i++) {
                 if (output_device.compare(midiOutDevice_->getPortName(i)) == 0) {
                     try {
@@ -127,19 +184,60 @@ bool MidiDevice::init(void *arg) {
     } // midi output
 
 
-    active_ = midiInDevice_ || midiOutDevice_;
+    active_ = midiInDevice_ || !inputs_.empty() || midiOutDevice_;
     LOG_0("MidiDevice::init - complete");
     return active_;
 }
 
+void MidiDevice::initDecoder(Preferences &prefs) {
+    decoder_.setMpe(prefs.getBool("mpe", true));
+    decoder_.setPitchbendRange((float) prefs.getDouble("pitchbend range", 48.0));
+    decoder_.reset();
+    parser_.reset();
+    for (auto &in : inputs_) {
+        in->decoder_.setMpe(prefs.getBool("mpe", true));
+        in->decoder_.setPitchbendRange((float) prefs.getDouble("pitchbend range", 48.0));
+        in->decoder_.reset();
+        in->parser_.reset();
+    }
+}
+
 bool MidiDevice::process() {
+    if (merger_) merger_->merge();
     return queue_.process(callback_);
 }
 
+bool MidiDevice::initReplay(void *arg) {
+    Preferences prefs(arg);
+    deinit();
+    queue_.setCapacity(static_cast<unsigned>(prefs.getInt("queue size", MsgQueue::DEFAULT_QUEUE_SIZE)));
+    unsigned inputs = inputDevices(prefs).size();
+    if (inputs > 1) initInputs(prefs, inputs);
+    initDecoder(prefs);
+    active_ = true;
+    return active_;
+}
+
+void MidiDevice::replay(const EventRecord &r) {
+    if (r.len_ == 0) return;
+    const unsigned char *data = static_cast<const unsigned char *>(r.data());
+    if (!inputs_.empty()) {
+        if (r.type_ < inputs_.size()) inputs_[r.type_]->input(data, r.len_);
+    } else if (r.type_ == 0) {
+        input(data, r.len_);
+    }
+}
+
 void MidiDevice::deinit() {
     LOG_0("MidiDevice::deinit");
     if (midiInDevice_) midiInDevice_->cancelCallback();
     midiInDevice_.reset();
+    for (auto &in : inputs_) {
+        if (in->in_) in->in_->cancelCallback();
+    }
+    merger_.reset();
+    inputs_.clear();
+    recorder_.close();
     active_ = false;
 }
 
@@ -147,205 +245,57 @@ bool MidiDevice::isActive() {
     return active_;
 }
 
-bool MidiDevice::midiCallback(double, std::vector<unsigned char> *message) {
-    int status = 0, data1 = 0, data2 = 0; //data3 = 0;
-    unsigned int n = message->size();
-    if (n > 3) LOG_0("midiCallback unexpect midi size" << n);
-
-    status = (int) message->at(0);
-    if (n > 1) data1 = (int) message->at(1);
-    if (n > 2) data2 = (int) message->at(2);
-//    if (n > 3) data3 = (int) message->at(3);
-
-
-    int ch = status & 0x0F;
-    int type = status & 0xF0;
-    VoiceData &touch = touches_[ch];
-    MecMsg msg;
-    switch (type) {
-        case 0x90: {
-            // note on (+note off if vel =0)
-            if (mpeMode_) {
-                if (touch.active_ || data2 == 0) {
-                    // touch.x_ = 0.0f;
-                    touch.y_ = 0.0f;
-                    touch.z_ = 0.0f;
-                    touch.active_ = false;
-                    // assumption: callback handler wants note to be touch finish position
-                    msg.type_ = MecMsg::TOUCH_OFF;
-                    msg.data_.touch_.touchId_ = ch;
-                    msg.data_.touch_.note_ = touch.note_;
-                    msg.data_.touch_.x_ = touch.x_;
-                    msg.data_.touch_.y_ = touch.y_;
-                    msg.data_.touch_.z_ = touch.z_;
-                    queue_.addToQueue(msg);
-
-                    touch.startNote_ = 0.0f;
-                }
-                if (data2 > 0) {
-                    touch.startNote_ = (float) data1;
-                    touch.note_ = (float) data1;
-                    touch.x_ = 0.0f;
-                    touch.y_ = 0.0f;
-                    touch.z_ = float(data2) / 127.0f;
-                    touch.active_ = true;
-
-                    msg.type_ = MecMsg::TOUCH_ON;
-                    msg.data_.touch_.touchId_ = ch;
-                    msg.data_.touch_.note_ = touch.note_;
-                    msg.data_.touch_.x_ = touch.x_;
-                    msg.data_.touch_.y_ = touch.y_;
-                    msg.data_.touch_.z_ = touch.z_;
-                    queue_.addToQueue(msg);
-                }
-            } else {
-                // not mpe mode, just send thru, allow multi notes on 1 channel
-                touch.startNote_ = (float) data1;
-                touch.note_ = (float) data1;
-                touch.x_ = 0.0f;
-                touch.y_ = 0.0f;
-                touch.z_ = float(data2) / 127.0f;
-                touch.active_ = true;
-
-                msg.type_ = MecMsg::TOUCH_ON;
-                msg.data_.touch_.touchId_ = ch;
-                msg.data_.touch_.note_ = touch.note_;
-                msg.data_.touch_.x_ = touch.x_;
-                msg.data_.touch_.y_ = touch.y_;
-                msg.data_.touch_.z_ = touch.z_;
-                queue_.addToQueue(msg);
-            }
-            break;
-        }
+bool MidiDevice::setWakeup(MsgWakeup *wakeup) {
+    wakeup_ = wakeup;
+    queue_.setWakeup(wakeup);
+    for (auto &in : inputs_) in->queue_.setWakeup(wakeup);
+    return true;
+}
 
-        case 0x80: {
-            // note off
-            if (mpeMode_) {
-                // touch.note_ == data1 !!
-                // touch.x_ = 0.0f;
-                touch.y_ = 0.0f;
-                touch.z_ = float(data2) / 127.0f;
-                touch.active_ = false;
-                // assumption: callback handler wants note to be touch finish position
-                msg.type_ = MecMsg::TOUCH_OFF;
-                msg.data_.touch_.touchId_ = ch;
-                msg.data_.touch_.note_ = touch.note_;
-                msg.data_.touch_.x_ = touch.x_;
-                msg.data_.touch_.y_ = touch.y_;
-                msg.data_.touch_.z_ = touch.z_;
-                queue_.addToQueue(msg);
-
-                touch.startNote_ = 0.0f;
-            } else {
-                touch.note_ = (float) data1;
-                touch.x_ = 0.0f;
-                touch.y_ = 0.0f;
-                touch.z_ = float(data2) / 127.0f;
-                touch.active_ = true;
-
-                msg.type_ = MecMsg::TOUCH_OFF;
-                msg.data_.touch_.touchId_ = ch;
-                msg.data_.touch_.note_ = touch.note_;
-                msg.data_.touch_.x_ = touch.x_;
-                msg.data_.touch_.y_ = touch.y_;
-                msg.data_.touch_.z_ = touch.z_;
-                queue_.addToQueue(msg);
-
-                touch.startNote_ = 0.0f;
-            }
-            break;
-        }
-        case 0xB0: {
-            // CC
-            float v = float(data2) / 127.0f;
-            if (mpeMode_ && data1 == 74) {
-                if (touch.active_) {
-                    touch.y_ = v;
-
-                    msg.type_ = MecMsg::TOUCH_CONTINUE;
-                    msg.data_.touch_.touchId_ = ch;
-                    msg.data_.touch_.note_ = touch.note_;
-                    msg.data_.touch_.x_ = touch.x_;
-                    msg.data_.touch_.y_ = touch.y_;
-                    msg.data_.touch_.z_ = touch.z_;
-                    queue_.addToQueue(msg);
-                }
-            } else {
-                msg.type_ = MecMsg::CONTROL;
-                msg.data_.control_.controlId_ = data1;
-                msg.data_.control_.value_ = v;
-                queue_.addToQueue(msg);
-            }
-            break;
-        }
-        case 0xD0: {
-            // channel pressure
-            float v = float(data1) / 127.0f;
-            if (mpeMode_) {
-                if (touch.active_) {
-                    touch.z_ = v;
-
-                    msg.type_ = MecMsg::TOUCH_CONTINUE;
-                    msg.data_.touch_.touchId_ = ch;
-                    msg.data_.touch_.note_ = touch.note_;
-                    msg.data_.touch_.x_ = touch.x_;
-                    msg.data_.touch_.y_ = touch.y_;
-                    msg.data_.touch_.z_ = touch.z_;
-                    queue_.addToQueue(msg);
-                }
-            } else {
-                msg.type_ = MecMsg::CONTROL;
-                msg.data_.control_.controlId_ = type;
-                msg.data_.control_.value_ = v;
-                queue_.addToQueue(msg);
-            }
-            break;
-        }
-        case 0xE0: {
-            // PB
-            float pb = (float) ((data2 << 7) + data1);
-            float v = (pb / 8192.0f) - 1.0f;  // -1.0 to 1.0
-            if (mpeMode_) {
-                if (touch.active_) {
-                    touch.note_ = touch.startNote_ + (v * pitchbendRange_);
-                    touch.x_ = v;
-
-                    msg.type_ = MecMsg::TOUCH_CONTINUE;
-                    msg.data_.touch_.touchId_ = ch;
-                    msg.data_.touch_.note_ = touch.note_;
-                    msg.data_.touch_.x_ = touch.x_;
-                    msg.data_.touch_.y_ = touch.y_;
-                    msg.data_.touch_.z_ = touch.z_;
-                    queue_.addToQueue(msg);
-                }
-            } else {
-                msg.type_ = MecMsg::CONTROL;
-                msg.data_.control_.controlId_ = type;
-                msg.data_.control_.value_ = v;
-                queue_.addToQueue(msg);
-            }
-            break;
-        }
-        default: {
-            // everything else;
-            //ignore
-            break;
-        }
-    } //switch
+LatencyStats *MidiDevice::latencyStats() {
+    return &queue_.latencyStats();
+}
 
+bool MidiDevice::midiCallback(double, std::vector<unsigned char> *message) {
+    unsigned n = message->size();
+    if (n == 0) return false;
+    if (recorder_.isOpen()) recorder_.record(0, message->data(), n);
+    input(message->data(), n);
     return true;
 }
 
+void MidiDevice::input(const unsigned char *data, unsigned size) {
+    decoder_.setTime(mecTimeNow());
+    parser_.parse(data, size, decoder_);
+}
+
 bool MidiDevice::send(const MidiMsg &m) {
     if (midiOutDevice_ == nullptr || !isOutputOpen()) return false;
-    std::vector<unsigned char> msg;
 
-    for (int i = 0; i < m.size; i++) {
-        msg.push_back(m.data[i]);
+    try {
+        midiOutDevice_->sendMessage(m.data, m.size);
+    } catch (RtMidiError &error) {
+        LOG_0("MidiDevice output write error:" << error.what());
+        return false;
     }
+    return true;
+}
 
+bool MidiDevice::send(const unsigned char *data, unsigned size) {
+    if (midiOutDevice_ == nullptr || !isOutputOpen()) return false;
+
+    // rtmidi takes a message at a time
     try {
-        midiOutDevice_->sendMessage(&msg);
+        unsigned pos = 0;
+        while (pos < size) {
+            unsigned n = MidiBuffer::messageLength(data + pos, size - pos);
+            if (n == 0) {
+                LOG_0("MidiDevice output invalid message, at " << pos);
+                return false;
+            }
+            midiOutDevice_->sendMessage(data + pos, n);
+            pos += n;
+        }
     } catch (RtMidiError &error) {
         LOG_0("MidiDevice output write error:" << error.what());
         return false;
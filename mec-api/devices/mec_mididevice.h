@@ -4,15 +4,22 @@
 #include "../mec_api.h"
 #include "../mec_device.h"
 #include "../mec_msg_queue.h"
+#include "../mec_recorder.h"
+#include "../processors/mec_midi_buffer.h"
+#include "../processors/mec_midi_parser.h"
+#include "mec_midi_decoder.h"
+#include "mec_midi_merger.h"
 
 #include <RtMidi.h>
 
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 namespace mec {
 
-class MidiDevice : public Device {
+class MidiDevice : public Device, public IMidiSink {
 
 public:
     MidiDevice(ICallback &);
@@ -21,8 +28,14 @@ public:
     virtual bool process();
     virtual void deinit();
     virtual bool isActive();
+    virtual bool setWakeup(MsgWakeup *);
+    virtual LatencyStats *latencyStats();
+    virtual bool initReplay(void *);
+    virtual void replay(const EventRecord &); // raw midi bytes, as recorded by midiCallback, type is input
 
     virtual bool midiCallback(double deltatime, std::vector<unsigned char> *message);
+    // raw midi input, any number of (possibly partial) messages, decoded straight into the queue
+    void input(const unsigned char *data, unsigned size);
 
     bool sendCC(unsigned ch, unsigned cc, unsigned v) { return send(MidiMsg(0xB0 + ch, cc, v)); }
 
@@ -32,6 +45,9 @@ public:
 
     void addTouchMsg(MecMsg& msg) { queue_.addToQueue(msg);}
 
+    // IMidiSink, e.g. for a Midi_Processor to output to this device
+    bool send(const unsigned char *data, unsigned size) override;
+
 protected:
     virtual RtMidiIn::RtMidiCallback getMidiCallback();
 
@@ -65,6 +81,31 @@ protected:
 
     bool send(const MidiMsg &msg);
 
+    void initDecoder(Preferences &prefs);
+
+    // "input devices", several inputs each parsed on their own (rtmidi) thread into their own queue
+    // process() merges them into queue_ (see MidiMerger)
+    struct MidiInput {
+        MidiInput(MidiDevice &device, unsigned index) : device_(device), index_(index), decoder_(queue_) { ; }
+
+        void input(const unsigned char *data, unsigned size) {
+            decoder_.setTime(mecTimeNow());
+            parser_.parse(data, size, decoder_);
+        }
+
+        MidiDevice &device_;
+        unsigned index_;
+        MsgQueue queue_;
+        MidiParser parser_;
+        MidiDecoder decoder_;
+        std::unique_ptr<RtMidiIn> in_; // last, so callbacks stop before the rest goes
+    };
+
+    static void inputCallback(double deltatime, std::vector<unsigned char> *message, void *userData);
+    static std::vector<std::string> inputDevices(Preferences &prefs);
+    std::unique_ptr<RtMidiIn> openInput(const std::string &name);
+    void initInputs(Preferences &prefs, unsigned n);
+
     bool active_;
 
     ICallback &callback_;
@@ -73,19 +114,15 @@ protected:
     bool virtualOpen_;
 
     MsgQueue queue_;
+    MidiParser parser_;
+    MidiDecoder decoder_;
 
-    struct VoiceData {
-        float startNote_;
-        float note_;
-        float x_;
-        float y_;
-        float z_;
-        bool active_;
-    };
-    VoiceData touches_[16];
+    std::vector<std::unique_ptr<MidiInput>> inputs_;
+    std::unique_ptr<MidiMerger> merger_;
+    MsgWakeup *wakeup_;
 
-    float pitchbendRange_;
-    bool mpeMode_;
+    EventRecorder recorder_;
+    std::mutex recordMutex_; // inputs record from their own threads
 };
 
 
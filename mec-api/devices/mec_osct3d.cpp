@@ -4,10 +4,16 @@
 #include <osc/OscOutboundPacketStream.h>
 #include <osc/OscReceivedElements.h>
 #include <osc/OscPacketListener.h>
-#include <ip/UdpSocket.h>
+#include <ip/IpEndpointName.h>
 
 
+#include <atomic>
+#include <cstring>
+
 #include "mec_log.h"
+#include "mec_udp_receiver.h"
+#include "../mec_jitter_buffer.h"
+#include "../mec_recorder.h"
 #include "../mec_voice.h"
 
 ////////////////////////////////////////////////
@@ -18,11 +24,15 @@ namespace mec {
 
 class OscT3DHandler : public osc::OscPacketListener {
 public:
-    OscT3DHandler(Preferences &p, MsgQueue &q)
+    OscT3DHandler(Preferences &p, MsgQueue &q, EventRecorder *recorder)
         : prefs_(p),
           queue_(q),
+          recorder_(recorder),
           valid_(true),
-          socket_(nullptr) {
+          arrival_(0),
+          inFrame_(false),
+          touchesInFrame_(false),
+          frames_(q, static_cast<unsigned>(p.getInt("jitter buffer", 0))) {
         if (valid_) {
             LOG_0("OscT3DHandler enabling for mecapi");
         }
@@ -30,41 +40,73 @@ public:
             activeTouches_[i] = false;
         }
         stealVoices_ = false;
+        counters_.packets_.store(0);
+        counters_.messages_.store(0);
+        counters_.unknown_.store(0);
+        counters_.badArgs_.store(0);
+        counters_.malformed_.store(0);
+        initAddresses();
+        voices_.stealPolicy(Voices::stealPolicy(p.getString("steal policy", "oldest")));
     }
 
     bool isValid() { return valid_; }
 
-    void setSocket(UdpListeningReceiveSocket *pS) {
-        socket_ = pS;
+    // t3d sends a bundle per frame, starting with /t3d/frm, followed by the touches
+    // so the frame is complete at the end of the packet
+    // if frames are not bundled, a frame is the touches from one frm to the next
+    // touches of a frame are queued together (see JitterBuffer), or after a delay with a "jitter buffer"
+    // packets are recorded whole (type 0), replay feeds them back in here
+    virtual void ProcessPacket(const char *data, int size, const IpEndpointName &remoteEndpoint) {
+        if (recorder_) recorder_->record(0, data, static_cast<unsigned>(size));
+        arrival_ = mecTimeNow();
+        inFrame_ = false;
+        inc(counters_.packets_);
+        try {
+            osc::OscPacketListener::ProcessPacket(data, size, remoteEndpoint);
+        } catch (osc::Exception &e) {
+            // only malformed packets/bundles get here, counted rather than logged, as they can be at packet rate
+            inc(counters_.malformed_);
+        }
+        if (inFrame_ && touchesInFrame_) frames_.endFrame();
+        frames_.release(arrival_);
     }
 
     virtual void ProcessMessage(const osc::ReceivedMessage &m,
                                 const IpEndpointName &remoteEndpoint) {
         (void) remoteEndpoint; // suppress unused parameter warning
+        inc(counters_.messages_);
+
+        // no exceptions or allocation on this path, argument types are checked up front
+        unsigned index = 0;
+        const Address *a = match(m.AddressPattern(), index);
+        if (a == nullptr) {
+            inc(counters_.unknown_);
+            return;
+        }
+        if (!checkArgs(m, a->types_)) {
+            inc(counters_.badArgs_);
+            return;
+        }
 
-        try {
-            // example of parsing single messages. osc::OsckPacketListener
-            // handles the bundle traversal.
-            static const std::string A_COMMAND = "/t3d/command";
-            static const std::string A_TOUCH = "/t3d/tch";
-            static const std::string A_FRM = "/t3d/frm";
-
-
-            osc::ReceivedMessageArgumentStream args = m.ArgumentStream();
-            std::string addr = m.AddressPattern();
-            if (addr.length() > 8 && addr.find(A_TOUCH) == 0) {
-                std::string touch = addr.substr(8);
-                unsigned tId = static_cast<unsigned>(std::stoi(touch));
-                float x = 0.0f, y = 0.0f, z = 0.0f, note = 0.0f;
-                args >> x >> y >> z >> note >> osc::EndMessage;
-                queue_touch(tId, note, x, (y * 2.0f) - 1.0f, z);
-            } else if (addr == A_FRM) {
-                osc::int32 d1, d2;
-                args >> d1 >> d2 >> osc::EndMessage;
-            } else if (addr == A_COMMAND) {
-                const char *cmd;
-                args >> cmd >> osc::EndMessage;
-
+        osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+        switch (a->type_) {
+            case A_TOUCH : {
+                float x = (arg++)->AsFloatUnchecked();
+                float y = (arg++)->AsFloatUnchecked();
+                float z = (arg++)->AsFloatUnchecked();
+                float note = (arg++)->AsFloatUnchecked();
+                queue_touch(index, note, x, (y * 2.0f) - 1.0f, z);
+                break;
+            }
+            case A_FRAME : {
+                // frame id, sender timestamp (unused, as sender clock is not ours)
+                frames_.beginFrame(static_cast<unsigned>(arg->AsInt32Unchecked()), arrival_);
+                touchesInFrame_ = false;
+                inFrame_ = true;
+                break;
+            }
+            case A_COMMAND : {
+                const char *cmd = arg->AsStringUnchecked();
                 LOG_1("received /t3d/command message with argument: " << cmd);
                 if (strcmp(cmd, "shutdown") == 0) {
                     LOG_1("T3D shutdown request");
@@ -73,15 +115,33 @@ public:
                     msg.data_.mec_control_.cmd_ = MecMsg::SHUTDOWN;
                     queue_.addToQueue(msg);
                 }
+                break;
             }
-        } catch (osc::Exception &e) {
-            // any parsing errors such as unexpected argument types, or
-            // missing arguments get thrown as exceptions.
-            LOG_0("error while parsing message: " << m.AddressPattern() << ": " << e.what());
         }
     }
 
+    OscT3D::Stats stats() const {
+        OscT3D::Stats s;
+        s.packets_ = counters_.packets_.load(std::memory_order_relaxed);
+        s.messages_ = counters_.messages_.load(std::memory_order_relaxed);
+        s.unknown_ = counters_.unknown_.load(std::memory_order_relaxed);
+        s.badArgs_ = counters_.badArgs_.load(std::memory_order_relaxed);
+        s.malformed_ = counters_.malformed_.load(std::memory_order_relaxed);
+        return s;
+    }
+    const JitterBuffer &frames() const { return frames_; }
+
+    // jitter buffer, frames due by now are released, returns when next is due (0 none)
+    MecTime release(MecTime now) { return frames_.release(now); }
+
+    // touches within a frame are held until it is complete
+    void post(MecMsg &msg) {
+        if (frames_.inFrame()) frames_.add(msg);
+        else queue_.addToQueue(msg);
+    }
+
     virtual void queue_touch(unsigned tId, float mn, float mx, float my, float mz) {
+        touchesInFrame_ = true;
         Voices::Voice *voice = voices_.voiceId(tId);
         if (mz > 0.0) {
             if (!voice) {
@@ -90,15 +150,16 @@ public:
 
                 if (!voice && stealVoices_) {
                     // no available voices, steal?
-                    Voices::Voice *stolen = voices_.oldestActiveVoice();
+                    Voices::Voice *stolen = voices_.voiceToSteal(mn);
                     MecMsg msg;
+                    msg.deviceTime_ = arrival_;
                     msg.data_.touch_.touchId_ = stolen->i_;
                     msg.data_.touch_.note_ = stolen->note_;
                     msg.data_.touch_.x_ = stolen->x_;
                     msg.data_.touch_.y_ = stolen->y_;
                     msg.data_.touch_.z_ = 0.0f;
                     msg.type_ = MecMsg::TOUCH_OFF;
-                    queue_.addToQueue(msg);
+                    post(msg);
                     voices_.stopVoice(stolen);
                     voice = voices_.startVoice(tId);
                 }
@@ -110,24 +171,26 @@ public:
                     voices_.addPressure(voice, mz);
                     if (voice->state_ == Voices::Voice::ACTIVE) {
                         MecMsg msg;
+                        msg.deviceTime_ = arrival_;
                         msg.data_.touch_.touchId_ = voice->i_;
                         msg.data_.touch_.note_ = mn;
                         msg.data_.touch_.x_ = mx;
                         msg.data_.touch_.y_ = my;
                         msg.data_.touch_.z_ = voice->v_;
                         msg.type_ = MecMsg::TOUCH_ON;
-                        queue_.addToQueue(msg);
+                        post(msg);
                     }
                     // dont send to callbacks until we have the minimum pressures for velocity
                 } else {
                     MecMsg msg;
+                    msg.deviceTime_ = arrival_;
                     msg.data_.touch_.touchId_ = voice->i_;
                     msg.data_.touch_.note_ = mn;
                     msg.data_.touch_.x_ = mx;
                     msg.data_.touch_.y_ = my;
                     msg.data_.touch_.z_ = mz;
                     msg.type_ = MecMsg::TOUCH_CONTINUE;
-                    queue_.addToQueue(msg);
+                    post(msg);
                 }
                 voice->note_ = mn;
                 voice->x_ = mx;
@@ -142,37 +205,115 @@ public:
             if (voice) {
                 // LOG_1("stop voice for " << tId << " ch " << voice->i_);
                 MecMsg msg;
+                msg.deviceTime_ = arrival_;
                 msg.data_.touch_.touchId_ = voice->i_;
                 msg.data_.touch_.note_ = mn;
                 msg.data_.touch_.x_ = mx;
                 msg.data_.touch_.y_ = my;
                 msg.data_.touch_.z_ = mz;
                 msg.type_ = MecMsg::TOUCH_OFF;
-                queue_.addToQueue(msg);
+                post(msg);
                 voices_.stopVoice(voice);
             }
         }
     }
 
 private:
+    enum AddressType {
+        A_TOUCH,
+        A_FRAME,
+        A_COMMAND
+    };
+
+    // dispatch table, addresses below the root, indexed addresses are followed by a decimal index
+    struct Address {
+        const char *name_;
+        unsigned len_;
+        bool indexed_;
+        const char *types_; // expected type tags
+        AddressType type_;
+    };
+
+    static const char *root() { return "/t3d/"; }
+
+    static void inc(std::atomic<unsigned long long> &v) {
+        v.store(v.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void initAddresses() {
+        static const Address addresses[] = {
+                {"tch",     3, true,  "ffff", A_TOUCH},
+                {"frm",     3, false, "ii",   A_FRAME},
+                {"command", 7, false, "s",    A_COMMAND}
+        };
+        rootLen_ = static_cast<unsigned>(strlen(root()));
+        for (unsigned i = 0; i < N_ADDRESSES; i++) addresses_[i] = addresses[i];
+    }
+
+    const Address *match(const char *addr, unsigned &index) const {
+        if (strncmp(addr, root(), rootLen_) != 0) return nullptr;
+        const char *p = addr + rootLen_;
+        for (unsigned i = 0; i < N_ADDRESSES; i++) {
+            const Address &a = addresses_[i];
+            if (strncmp(p, a.name_, a.len_) != 0) continue;
+            const char *suffix = p + a.len_;
+            if (!a.indexed_) return *suffix == 0 ? &a : nullptr;
+            return parseIndex(suffix, index) ? &a : nullptr;
+        }
+        return nullptr;
+    }
+
+    // decimal digits to end of string, at most 9 of them, so no overflow
+    static bool parseIndex(const char *p, unsigned &index) {
+        unsigned v = 0;
+        unsigned n = 0;
+        for (; *p >= '0' && *p <= '9'; p++, n++) {
+            if (n == 9) return false;
+            v = v * 10 + unsigned(*p - '0');
+        }
+        if (n == 0 || *p != 0) return false;
+        index = v;
+        return true;
+    }
+
+    static bool checkArgs(const osc::ReceivedMessage &m, const char *types) {
+        if (m.ArgumentCount() != strlen(types)) return false;
+        return strncmp(m.TypeTags(), types, m.ArgumentCount()) == 0;
+    }
+
     inline float clamp(float v, float mn, float mx) { return (std::max(std::min(v, mx), mn)); }
 
     float note(float n) { return n; }
 
     Preferences prefs_;
     MsgQueue &queue_;
+    EventRecorder *recorder_; // nullptr, if not recording
     bool valid_;
     bool activeTouches_[16];
-    UdpListeningReceiveSocket *socket_;
     bool stealVoices_;
     Voices voices_;
-
+    MecTime arrival_; // of packet being processed
+    bool inFrame_; // packet contained a /t3d/frm
+    bool touchesInFrame_;
+
+    static const unsigned N_ADDRESSES = 3;
+    Address addresses_[N_ADDRESSES];
+    unsigned rootLen_;
+    // single writer (listen thread), read from any thread, so relaxed load/store (see LatencyHistogram)
+    struct Counters {
+        std::atomic<unsigned long long> packets_;
+        std::atomic<unsigned long long> messages_;
+        std::atomic<unsigned long long> unknown_;
+        std::atomic<unsigned long long> badArgs_;
+        std::atomic<unsigned long long> malformed_;
+    } counters_;
+    JitterBuffer frames_;
 };
 
 
 ////////////////////////////////////////////////
 OscT3D::OscT3D(ICallback &cb) :
-    active_(false), callback_(cb) {
+    active_(false), callback_(cb), listening_(false) {
 }
 
 OscT3D::~OscT3D() {
@@ -186,7 +327,21 @@ void OscT3DListen(OscT3D *self) {
 
 void OscT3D::listenProc() {
     LOG_1("T3D socket listening on : " << port_);
-    socket_->Run();
+    if (handler_->frames().depth() == 0 || !UdpReceiver::timedReceive()) {
+        socket_->run();
+        return;
+    }
+
+    // jitter buffer, wake for packets, or when the next frame is due
+    while (listening_) {
+        MecTime next = handler_->release(mecTimeNow());
+        int timeoutUs = -1;
+        if (next != 0) {
+            MecTime now = mecTimeNow();
+            timeoutUs = next > now ? static_cast<int>((next - now + 999) / 1000) : 0;
+        }
+        socket_->receive(timeoutUs);
+    }
 }
 
 bool OscT3D::init(void *arg) {
@@ -196,51 +351,113 @@ bool OscT3D::init(void *arg) {
         deinit();
     }
     active_ = false;
-    OscT3DHandler *pCb = new OscT3DHandler(prefs, queue_);
+    queue_.setCapacity(static_cast<unsigned>(prefs.getInt("queue size", MsgQueue::DEFAULT_QUEUE_SIZE)));
+
+    std::string recordFile = prefs.getString("record", "");
+    if (!recordFile.empty()) recorder_.open(recordFile, "osct3d");
+    handler_.reset(new OscT3DHandler(prefs, queue_, recorder_.isOpen() ? &recorder_ : nullptr));
 
     port_ = (unsigned) prefs.getInt("port", 9000);
 
-    if (pCb->isValid()) {
-        active_ = true;
-    } else {
-        delete pCb;
+    if (!handler_->isValid()) {
+        handler_.reset();
+        recorder_.close();
+        return false;
     }
 
     LOG_1("T3D socket on port : " << port_);
 
-    socket_.reset(
-        new UdpListeningReceiveSocket(
-            IpEndpointName(IpEndpointName::ANY_ADDRESS, port_),
-            pCb)
-    );
+    // "batch" packets per receive call, "busy poll" (us) trades a core for latency, see UdpReceiver
+    socket_.reset(new UdpReceiver(handler_.get(),
+                                  static_cast<unsigned>(prefs.getInt("batch", UdpReceiver::DEFAULT_BATCH))));
+    if (!socket_->open(port_, static_cast<unsigned>(prefs.getInt("busy poll", 0)))) {
+        socket_.reset();
+        handler_.reset();
+        recorder_.close();
+        return false;
+    }
 
-    pCb->setSocket(socket_.get());
+    if (handler_->frames().depth() > 0) {
+        if (UdpReceiver::timedReceive()) LOG_1("T3D jitter buffer : " << handler_->frames().depth() << " frames");
+        else LOG_0("T3D jitter buffer not supported on this platform, frames are released as they arrive");
+    }
 
+    listening_ = true;
     listenThread_ = std::thread(OscT3DListen, this);
 
+    active_ = true;
+    return active_;
+}
 
+bool OscT3D::initReplay(void *arg) {
+    Preferences prefs(arg);
+    deinit();
+    queue_.setCapacity(static_cast<unsigned>(prefs.getInt("queue size", MsgQueue::DEFAULT_QUEUE_SIZE)));
+    handler_.reset(new OscT3DHandler(prefs, queue_, nullptr));
+    active_ = handler_->isValid();
     return active_;
 }
 
+void OscT3D::replay(const EventRecord &r) {
+    if (!handler_ || r.type_ != 0) return;
+    handler_->ProcessPacket(static_cast<const char *>(r.data()), r.len_, IpEndpointName());
+}
+
 bool OscT3D::process() {
     return queue_.process(callback_);
 }
 
 void OscT3D::deinit() {
     LOG_0("OscT3D::deinit");
-    if (active_) {
-        socket_->AsynchronousBreak();
+    if (socket_) {
+        listening_ = false;
+        socket_->asynchronousBreak();
         listenThread_.join();
+        const UdpReceiver::Stats &rs = socket_->stats();
+        LOG_0("OscT3D received " << rs.packets_ << " packets in " << rs.calls_ << " calls, truncated " << rs.truncated_);
         socket_.reset();
         LOG_0("OscT3D::deinit done");
     }
+    if (handler_) {
+        Stats s = handler_->stats();
+        LOG_0("OscT3D packets " << s.packets_ << " messages " << s.messages_
+                                << " unknown " << s.unknown_ << " bad args " << s.badArgs_
+                                << " malformed " << s.malformed_);
+        const JitterBuffer::Stats &f = handler_->frames().stats();
+        LOG_0("OscT3D frames " << f.frames_ << " lost " << f.lost_ << " late " << f.late_
+                               << " underruns " << f.underruns_ << " overruns " << f.overruns_
+                               << " dropped " << f.dropped_ << " truncated " << f.truncated_);
+    }
+    handler_.reset();
+    recorder_.close();
     active_ = false;
 }
 
+OscT3D::Stats OscT3D::stats() const {
+    Stats s;
+    if (handler_) s = handler_->stats();
+    else memset(&s, 0, sizeof(s));
+    return s;
+}
+
 bool OscT3D::isActive() {
     return active_;
 }
 
+bool OscT3D::setWakeup(MsgWakeup *wakeup) {
+    queue_.setWakeup(wakeup);
+    return true;
+}
+
+LatencyStats *OscT3D::latencyStats() {
+    return &queue_.latencyStats();
+}
+
+bool OscT3D::setFrameCallback(IFrameCallback *cb) {
+    queue_.setFrameCallback(cb);
+    return true;
+}
+
 
 }
 
@@ -4,33 +4,57 @@
 #include "../mec_api.h"
 #include "../mec_device.h"
 #include "../mec_msg_queue.h"
+#include "../mec_recorder.h"
 
 
+#include <atomic>
 #include <memory>
 #include <thread>
 
-class UdpListeningReceiveSocket;
-
 namespace mec {
 
+class OscT3DHandler;
+class UdpReceiver;
+
 class OscT3D : public Device {
 
 public:
+    // counted on the listen thread, not logged per packet, logged at deinit
+    struct Stats {
+        unsigned long long packets_;
+        unsigned long long messages_;
+        unsigned long long unknown_;   // address not in dispatch table
+        unsigned long long badArgs_;   // wrong argument count/types
+        unsigned long long malformed_; // packet could not be parsed
+    };
+
     OscT3D(ICallback &);
     virtual ~OscT3D();
     virtual bool init(void *);
     virtual bool process();
     virtual void deinit();
     virtual bool isActive();
+    virtual bool setWakeup(MsgWakeup *);
+    virtual LatencyStats *latencyStats();
+    virtual bool setFrameCallback(IFrameCallback *);
+    virtual bool initReplay(void *);
+    virtual void replay(const EventRecord &); // raw osc packet
+    // "jitter buffer" : frames (default 0), touches are always delivered a frame at a time
+    // with a depth, frames are delayed by depth frames, and released at the sender's frame rate
 
     void listenProc();
 
+    Stats stats() const; // zero if not initialised
+
 private:
     ICallback &callback_;
     bool active_;
     MsgQueue queue_;
-    std::unique_ptr<UdpListeningReceiveSocket> socket_;
+    EventRecorder recorder_;
+    std::unique_ptr<OscT3DHandler> handler_; // must outlive socket_
+    std::unique_ptr<UdpReceiver> socket_;
     std::thread listenThread_;
+    std::atomic<bool> listening_;
 
     unsigned int port_;
 };
@@ -16,8 +16,8 @@ static const unsigned OSC_POLL_MS = 50;
 
 
 Push2::Push2(ICallback &cb) :
-        MidiDevice(cb) {
-    PaUtil_InitializeRingBuffer(&midiQueue_, sizeof(MidiMsg), MAX_N_MIDI_MSGS, msgData_);
+        MidiDevice(cb),
+        midiQueue_(MAX_N_MIDI_MSGS) {
 }
 
 Push2::~Push2() {
@@ -62,9 +62,11 @@ void *push2_processor_func(void *pDevice) {
 
 
 bool Push2::init(void *arg) {
-    if (MidiDevice::init(arg)) {
+    Preferences prefs(arg);
+    // must be sized before midi input is started
+    midiQueue_.setCapacity(static_cast<unsigned>(prefs.getInt("midi queue size", MAX_N_MIDI_MSGS)));
 
-        Preferences prefs(arg);
+    if (MidiDevice::init(arg)) {
 
         // push2 api setup
         push2Api_.reset(new Push2API::Push2());
@@ -98,9 +100,8 @@ void Push2::processorRun() {
     while (active_) {
         push2Api_->render();
 
-        while (PaUtil_GetRingBufferReadAvailable(&midiQueue_)) {
-            MidiMsg msg;
-            PaUtil_ReadRingBuffer(&midiQueue_, &msg, 1);
+        MidiMsg msg;
+        while (midiQueue_.pop(msg)) {
             processMidi(msg);
         }
         std::this_thread::sleep_for(std::chrono::milliseconds(OSC_POLL_MS));
@@ -136,7 +137,7 @@ bool Push2::midiCallback(double, std::vector<unsigned char> *message) {
     if (n > 2) m.data[2] = message->at(2);
 
     // LOG_0("midi: s " << std::hex << m.status_ << " "<< m.data[1] << " " << m.data[2]);
-    PaUtil_WriteRingBuffer(&midiQueue_, (void *) &m, 1);
+    midiQueue_.push(m);
     return true;
 }
 
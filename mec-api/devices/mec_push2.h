@@ -3,6 +3,7 @@
 #include "../mec_api.h"
 #include "../mec_device.h"
 #include "../mec_msg_queue.h"
+#include "../mec_spsc_queue.h"
 #include "mec_mididevice.h"
 #include <KontrolModel.h>
 #include <RtMidi.h>
@@ -10,7 +11,6 @@
 #include <vector>
 #include <map>
 #include <push2lib/push2lib.h>
-#include <pa_ringbuffer.h>
 #include <thread>
 
 namespace mec {
@@ -170,9 +170,8 @@ private:
     // kontrol interface
     std::shared_ptr<Kontrol::KontrolModel> model_;
 
-    static const unsigned int MAX_N_MIDI_MSGS = 16;
-    PaUtilRingBuffer midiQueue_; // draw midi from P2
-    char msgData_[sizeof(MidiMsg) * MAX_N_MIDI_MSGS];
+    static const unsigned int MAX_N_MIDI_MSGS = 64;
+    SpscQueue<MidiMsg> midiQueue_; // draw midi from P2
     std::thread processor_;
 };
 
@@ -0,0 +1,146 @@
+#include "mec_replaydevice.h"
+
+#include "mec_log.h"
+
+#ifndef WIN32
+#include "mec_eigenharp.h"
+#include "mec_soundplane.h"
+#endif
+
+#include "mec_mididevice.h"
+#include "mec_osct3d.h"
+
+namespace mec {
+
+////////////////////////////////////////////////
+ReplayDevice::ReplayDevice(ICallback &cb) :
+        callback_(cb), active_(false), frameCallback_(nullptr),
+        speed_(1.0), loop_(false), batch_(64), shutdown_(false),
+        start_(0), pending_(nullptr), count_(0), done_(false) {
+}
+
+ReplayDevice::~ReplayDevice() {
+    deinit();
+}
+
+std::shared_ptr<Device> ReplayDevice::createDevice(const std::string &name) {
+#ifndef WIN32
+    if (name == "eigenharp") return std::make_shared<Eigenharp>(callback_);
+    if (name == "soundplane") return std::make_shared<Soundplane>(callback_);
+#endif
+    if (name == "midi") return std::make_shared<MidiDevice>(callback_);
+    if (name == "osct3d") return std::make_shared<OscT3D>(callback_);
+    return nullptr;
+}
+
+bool ReplayDevice::init(void *arg) {
+    Preferences prefs(arg);
+
+    if (active_) {
+        deinit();
+    }
+    active_ = false;
+
+    std::string file = prefs.getString("file");
+    if (file.empty()) {
+        LOG_0("ReplayDevice: no file specified");
+        return false;
+    }
+    if (!reader_.open(file)) return false;
+
+    device_ = createDevice(reader_.device());
+    if (!device_) {
+        LOG_0("ReplayDevice: cannot replay device : " << reader_.device());
+        reader_.close();
+        return false;
+    }
+
+    if (!device_->initReplay(prefs.getSubTree("device"))) {
+        LOG_0("ReplayDevice: " << reader_.device() << " failed to initialise for replay");
+        device_.reset();
+        reader_.close();
+        return false;
+    }
+    if (frameCallback_) device_->setFrameCallback(frameCallback_);
+
+    speed_ = prefs.getDouble("speed", 1.0);
+    if (speed_ < 0.0) speed_ = 0.0;
+    loop_ = prefs.getBool("loop", false);
+    batch_ = static_cast<unsigned>(prefs.getInt("batch", 64));
+    if (batch_ == 0) batch_ = 1;
+    shutdown_ = prefs.getBool("shutdown", false);
+
+    start_ = 0; // started on first process
+    pending_ = nullptr;
+    count_ = 0;
+    done_ = false;
+
+    LOG_0("ReplayDevice: replaying " << reader_.device() << " from " << file << " speed " << speed_);
+    active_ = true;
+    return active_;
+}
+
+bool ReplayDevice::process() {
+    if (!active_) return false;
+
+    if (!done_) {
+        MecTime now = mecTimeNow();
+        if (start_ == 0) start_ = now;
+        unsigned n = 0;
+        while (n < batch_) {
+            const EventRecord *r = pending_ ? pending_ : reader_.next();
+            pending_ = nullptr;
+            if (r == nullptr) {
+                if (loop_ && count_ > 0) {
+                    reader_.rewind();
+                    start_ = now;
+                    continue;
+                }
+                finished();
+                break;
+            }
+            if (speed_ > 0.0 && double(r->time_) > double(now - start_) * speed_) {
+                pending_ = r; // not due yet
+                break;
+            }
+            device_->replay(*r);
+            count_++;
+            n++;
+        }
+    }
+    return device_->process();
+}
+
+void ReplayDevice::finished() {
+    done_ = true;
+    double secs = double(mecTimeNow() - start_) / 1e9;
+    LOG_0("ReplayDevice: replayed " << count_ << " events in " << secs << " secs");
+    if (shutdown_) callback_.mec_control(ICallback::SHUTDOWN, nullptr);
+}
+
+void ReplayDevice::deinit() {
+    if (device_) {
+        LOG_0("ReplayDevice::deinit");
+        device_->deinit();
+        device_.reset();
+    }
+    reader_.close();
+    pending_ = nullptr;
+    active_ = false;
+}
+
+bool ReplayDevice::isActive() {
+    return active_;
+}
+
+LatencyStats *ReplayDevice::latencyStats() {
+    return device_ ? device_->latencyStats() : nullptr;
+}
+
+bool ReplayDevice::setFrameCallback(IFrameCallback *cb) {
+    frameCallback_ = cb;
+    // frames if the replayed device has them
+    return device_ != nullptr && device_->setFrameCallback(cb);
+}
+
+}
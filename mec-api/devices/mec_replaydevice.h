@@ -0,0 +1,50 @@
+#ifndef MecReplayDevice_H
+#define MecReplayDevice_H
+
+#include "../mec_api.h"
+#include "../mec_device.h"
+#include "../mec_recorder.h"
+
+#include <memory>
+
+namespace mec {
+
+// replays a recording (see EventRecorder) through the recorded device's own handler,
+// so everything downstream (voices, surfaces, callbacks) sees the same input as when recorded.
+// the device is created from the name in the recording, and initialised with initReplay
+class ReplayDevice : public Device {
+
+public:
+    ReplayDevice(ICallback &);
+    virtual ~ReplayDevice();
+    virtual bool init(void *);
+    virtual bool process();
+    virtual void deinit();
+    virtual bool isActive();
+    virtual LatencyStats *latencyStats();
+    virtual bool setFrameCallback(IFrameCallback *);
+
+private:
+    std::shared_ptr<Device> createDevice(const std::string &name);
+    void finished();
+
+    ICallback &callback_;
+    bool active_;
+    EventReader reader_;
+    std::shared_ptr<Device> device_;
+    IFrameCallback *frameCallback_;
+
+    double speed_; // 1.0 = realtime, 0 = as fast as possible
+    bool loop_;
+    unsigned batch_;
+    bool shutdown_;
+
+    MecTime start_;
+    const EventRecord *pending_; // next record, not yet due
+    unsigned long long count_;
+    bool done_;
+};
+
+}
+
+#endif // MecReplayDevice_H
@@ -5,11 +5,31 @@
 
 
 #include "mec_log.h"
+#include "../mec_recorder.h"
 #include "../mec_voice.h"
 
 
 namespace mec {
 
+// recorded input, see EventRecorder
+enum SoundplaneRecord {
+    SR_TOUCH,
+    SR_CONTROL,
+    SR_FRAME
+};
+
+struct SoundplaneTouchRec {
+    uint64_t t_;
+    int32_t a_, touch_;
+    float n_, x_, y_, z_;
+};
+
+struct SoundplaneControlRec {
+    uint64_t t_;
+    int32_t id_;
+    float val_;
+};
+
 
 ////////////////////////////////////////////////
 // TODO
@@ -17,12 +37,15 @@ namespace mec {
 ////////////////////////////////////////////////
 class SoundplaneHandler : public SoundplaneMECCallback {
 public:
-    SoundplaneHandler(Preferences &p, MsgQueue &q)
+    SoundplaneHandler(Preferences &p, MsgQueue &q, EventRecorder *recorder)
             : prefs_(p),
               queue_(q),
+              recorder_(recorder),
               valid_(true),
               voices_(static_cast<unsigned>(p.getInt("voices", 15))),
-              stealVoices_(p.getBool("steal voices", true)) {
+              stealVoices_(p.getBool("steal voices", true)),
+              touchesInFrame_(false) {
+        voices_.stealPolicy(Voices::stealPolicy(p.getString("steal policy", "oldest")));
         if (valid_) {
             LOG_0("SoundplaneHandler enabling for mecapi");
         }
@@ -37,6 +60,9 @@ public:
 
     virtual void touch(const char *dev, unsigned long long t, bool a, int itouch, float n, float x, float y, float z) {
         static const unsigned int NOTE_CH_OFFSET = 1;
+        MecTime now = mecTimeNow();
+        if (recorder_) recorder_->record(SR_TOUCH, SoundplaneTouchRec{t, a, itouch, n, x, y, z});
+        touchesInFrame_ = true;
 
         unsigned touch = (unsigned) itouch;
         Voices::Voice *voice = voices_.voiceId(touch);
@@ -47,6 +73,7 @@ public:
         float mz = clamp(z, 0.0f, 1.0f);
 
         MecMsg msg;
+        msg.deviceTime_ = now;
         msg.type_ = MecMsg::TOUCH_OFF;
         msg.data_.touch_.touchId_ = -1;
         msg.data_.touch_.note_ = mn;
@@ -60,7 +87,7 @@ public:
             // LOG_1(" x: " << x      << " y: "   << y    << " z: "   << z);
             // LOG_1(" mx: " << mx    << " my: "  << my   << " mz: "  << mz);
             if (!voice) {
-                if (stolenTouches_.find(touch) != stolenTouches_.end()) {
+                if (voices_.isStolen(touch)) {
                     // this key has been stolen, must be released to reactivate it
                     return;
                 }
@@ -70,16 +97,17 @@ public:
 
                 if (!voice && stealVoices_) {
                     // no available voices, steal?
-                    Voices::Voice *stolen = voices_.oldestActiveVoice();
+                    Voices::Voice *stolen = voices_.voiceToSteal(mn);
 
                     MecMsg stolenMsg;
+                    stolenMsg.deviceTime_ = now;
                     stolenMsg.type_ = MecMsg::TOUCH_OFF;
                     stolenMsg.data_.touch_.touchId_ = stolen->i_;
                     stolenMsg.data_.touch_.note_ = stolen->note_;
                     stolenMsg.data_.touch_.x_ = stolen->x_;
                     stolenMsg.data_.touch_.y_ = stolen->y_;
                     stolenMsg.data_.touch_.z_ = 0.0f;
-                    stolenTouches_.insert((unsigned) stolen->id_);
+                    voices_.markStolen((unsigned) stolen->id_);
                     queue_.addToQueue(stolenMsg);
                     voices_.stopVoice(stolen);
 
@@ -116,11 +144,12 @@ public:
                 queue_.addToQueue(msg);
                 voices_.stopVoice(voice);
             }
-            stolenTouches_.erase(touch);
+            voices_.clearStolen(touch);
         }
     }
 
     virtual void control(const char *dev, unsigned long long t, int id, float val) {
+        if (recorder_) recorder_->record(SR_CONTROL, SoundplaneControlRec{t, id, val});
         MecMsg msg;
         msg.type_ = MecMsg::CONTROL;
         msg.data_.control_.controlId_ = id;
@@ -128,6 +157,38 @@ public:
         queue_.addToQueue(msg);
     }
 
+    virtual void frame(const char *dev, unsigned long long t) {
+        if (recorder_) recorder_->record(SR_FRAME, t);
+        if (!touchesInFrame_) return;
+        touchesInFrame_ = false;
+        MecMsg msg;
+        msg.type_ = MecMsg::FRAME;
+        queue_.addToQueue(msg);
+    }
+
+    void replay(const EventRecord &r) {
+        static const char *dev = "replay";
+        switch (r.type_) {
+            case SR_TOUCH: {
+                const SoundplaneTouchRec *tr = r.as<SoundplaneTouchRec>();
+                if (tr) touch(dev, tr->t_, tr->a_ != 0, tr->touch_, tr->n_, tr->x_, tr->y_, tr->z_);
+                break;
+            }
+            case SR_CONTROL: {
+                const SoundplaneControlRec *c = r.as<SoundplaneControlRec>();
+                if (c) control(dev, c->t_, c->id_, c->val_);
+                break;
+            }
+            case SR_FRAME: {
+                const uint64_t *t = r.as<uint64_t>();
+                if (t) frame(dev, *t);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
 private:
     inline float clamp(float v, float mn, float mx) { return (std::max(std::min(v, mx), mn)); }
 
@@ -135,10 +196,11 @@ private:
 
     Preferences prefs_;
     MsgQueue &queue_;
+    EventRecorder *recorder_; // nullptr, if not recording
     Voices voices_;
     bool valid_;
     bool stealVoices_;
-    std::set<unsigned> stolenTouches_;
+    bool touchesInFrame_; // only mark frames which have touches
 };
 
 
@@ -158,6 +220,7 @@ bool Soundplane::init(void *arg) {
         deinit();
     }
     active_ = false;
+    queue_.setCapacity(static_cast<unsigned>(prefs.getInt("queue size", MsgQueue::DEFAULT_QUEUE_SIZE)));
     model_.reset(new SoundplaneModel());
     std::string appDir = prefs.getString("app state dir", ".");
 
@@ -171,8 +234,11 @@ bool Soundplane::init(void *arg) {
     model_->setPropertyImmediate("mec_active", 1.0f);
     model_->setPropertyImmediate("data_freq_mec", 500.0f);
 
-    SoundplaneHandler *pCb = new SoundplaneHandler(prefs, queue_);
+    std::string recordFile = prefs.getString("record", "");
+    if (!recordFile.empty()) recorder_.open(recordFile, "soundplane");
+    SoundplaneHandler *pCb = new SoundplaneHandler(prefs, queue_, recorder_.isOpen() ? &recorder_ : nullptr);
     if (pCb->isValid()) {
+        handler_.reset(pCb);
         model_->mecOutput().connect(pCb);
         LOG_0("Soundplane::init - model init");
         model_->initialize();
@@ -190,11 +256,27 @@ bool Soundplane::process() {
     return queue_.process(callback_);
 }
 
+bool Soundplane::initReplay(void *arg) {
+    Preferences prefs(arg);
+    deinit();
+    queue_.setCapacity(static_cast<unsigned>(prefs.getInt("queue size", MsgQueue::DEFAULT_QUEUE_SIZE)));
+    handler_.reset(new SoundplaneHandler(prefs, queue_, nullptr));
+    active_ = handler_->isValid();
+    return active_;
+}
+
+void Soundplane::replay(const EventRecord &r) {
+    if (handler_) handler_->replay(r);
+}
+
 void Soundplane::deinit() {
     LOG_0("Soundplane::deinit");
-    if (!model_) return;
-    LOG_0("Soundplane::reset model");
-    model_.reset();
+    if (model_) {
+        LOG_0("Soundplane::reset model");
+        model_.reset();
+    }
+    handler_.reset();
+    recorder_.close();
     active_ = false;
 }
 
@@ -202,6 +284,20 @@ bool Soundplane::isActive() {
     return active_;
 }
 
+bool Soundplane::setWakeup(MsgWakeup *wakeup) {
+    queue_.setWakeup(wakeup);
+    return true;
+}
+
+LatencyStats *Soundplane::latencyStats() {
+    return &queue_.latencyStats();
+}
+
+bool Soundplane::setFrameCallback(IFrameCallback *cb) {
+    queue_.setFrameCallback(cb);
+    return true;
+}
+
 
 }
 
@@ -4,11 +4,16 @@
 #include "../mec_api.h"
 #include "../mec_device.h"
 #include "../mec_msg_queue.h"
+#include "../mec_recorder.h"
 
 class SoundplaneModel;
 
 class MLAppState;
 
+namespace mec {
+class SoundplaneHandler;
+}
+
 #include <memory>
 
 namespace mec {
@@ -23,6 +28,11 @@ public:
     virtual bool process();
     virtual void deinit();
     virtual bool isActive();
+    virtual bool setWakeup(MsgWakeup *);
+    virtual LatencyStats *latencyStats();
+    virtual bool setFrameCallback(IFrameCallback *);
+    virtual bool initReplay(void *);
+    virtual void replay(const EventRecord &);
 
 private:
     ICallback &callback_;
@@ -30,6 +40,8 @@ private:
     std::unique_ptr<MLAppState> modelState_;
     bool active_;
     MsgQueue queue_;
+    std::unique_ptr<SoundplaneHandler> handler_;
+    EventRecorder recorder_;
 };
 
 }
@@ -18,6 +18,7 @@ public:
     virtual void device(const char* dev, int rows, int cols) = 0;
     virtual void touch(const char* dev, unsigned long long t, bool a, int touch, float note, float x, float y, float z) = 0;
     virtual void control(const char* dev, unsigned long long t, int id, float val) = 0;
+    virtual void frame(const char* dev, unsigned long long t) {}; // all touches for this frame have been sent
 };
 
 class SoundplaneMECOutput_Impl;
@@ -208,9 +208,9 @@ void SoundplaneMECOutput_Impl::processSoundplaneMessage(const SoundplaneDataMess
         {
             callback_->control(mSerialNumber.c_str(), mCurrFrameStartTime, zoneID, x > 0.5 ? 1 : 0);
         }
-        else if(type == endFrameSym) 
-        {
-            //nop
-        }
+    }
+    else if (type == endFrameSym)
+    {
+        callback_->frame(mSerialNumber.c_str(), mCurrFrameStartTime);
     }
 }
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include "mec_prefs.h"
 #include "mec_device.h"
 #include "mec_log.h"
+#include "mec_msg_queue.h"
+#include "mec_surface.h"
+#include "mec_scaler.h"
 
 #ifndef WIN32
 #include "devices/mec_eigenharp.h"
@@ -14,11 +17,41 @@
 #include "devices/mec_mididevice.h"
 #include "devices/mec_osct3d.h"
 #include "devices/mec_kontroldevice.h"
+#include "devices/mec_replaydevice.h"
+
+#include <algorithm>
 
 namespace mec {
 
+class MecApi_Impl;
+
+// callback for a device, forwards to MecApi_Impl,
+// and routes touches into the surface graph, at the device's surface
+// touches from a device with frames are mapped and delivered a frame at a time
+class SurfaceInput : public ICallback, public IFrameCallback {
+public:
+    static const unsigned MAX_TOUCH_ID = 1024;
+
+    SurfaceInput(MecApi_Impl &api, const std::string &device, int surface);
+
+    virtual void touchOn(int touchId, float note, float x, float y, float z) override;
+    virtual void touchContinue(int touchId, float note, float x, float y, float z) override;
+    virtual void touchOff(int touchId, float note, float x, float y, float z) override;
+    virtual void control(int ctrlId, float v) override;
+    virtual void mec_control(int cmd, void *other) override;
+    virtual void eventTime(MecTime t) override { time_ = t; }
+    virtual void frame(const TouchFrame &) override;
+
+    MecApi_Impl &api_;
+    std::string device_;
+    int surface_;
+    bool framed_; // device delivers frames
+    MecTime time_; // arrival of current touch at device handler, 0 = unknown
+    std::vector<int> active_; // output surface of touch id, -1 = none
+};
+
 /////////////////////////////////////////////////////////
-class MecApi_Impl : public ICallback, public ISurfaceCallback, public IMusicalCallback {
+class MecApi_Impl : public ICallback, public ISurfaceCallback, public IMusicalCallback, public IFrameCallback {
 public:
     MecApi_Impl(void *prefs);
     MecApi_Impl(const std::string &configFile);
@@ -26,6 +59,10 @@ public:
 
     void init();
     void process();  // periodically call to process messages
+    bool waitForEvents(unsigned timeoutMs);
+
+    std::vector<DeviceStats> stats();
+    void resetStats();
 
     void subscribe(ICallback *);
     void unsubscribe(ICallback *);
@@ -37,6 +74,10 @@ public:
     void subscribe(IMusicalCallback *);
     void unsubscribe(IMusicalCallback *);
 
+    void subscribe(IFrameCallback *);
+    void unsubscribe(IFrameCallback *);
+
+    void subscribe(ICallback *, IFrameCallback *);
 
     //callbacks...
     virtual void touchOn(int touchId, float note, float x, float y, float z);
@@ -53,15 +94,49 @@ public:
     virtual void touchContinue(const MusicalTouch &);
     virtual void touchOff(const MusicalTouch &);
 
+    virtual void frame(const TouchFrame &);
+
+    void deviceTouch(const SurfaceInput &in, TouchFrame::State s, MecTime t, int touchId, float note,
+                     float x, float y, float z);
+    void routeTouch(SurfaceInput &in, TouchFrame::State s, MecTime t, int touchId, float note,
+                    float x, float y, float z);
+    void flushRouted();
+
 private:
+    void initSurfaces();
     void initDevices();
+    ICallback &deviceCallback(const std::string &name);
+    void addDevice(const std::string &name, std::shared_ptr<Device> device);
+    void queueTouch(int surface, TouchFrame::State s, MecTime t, int touchId, float note, const float *v);
 
+    SurfaceManager surfaceManager_;
+    std::vector<std::unique_ptr<SurfaceInput>> inputs_;
     std::vector<std::shared_ptr<Device>> devices_;
+    std::vector<std::string> deviceNames_;
     std::unique_ptr<Preferences> fileprefs_; // top level prefs on file
     std::unique_ptr<Preferences> prefs_;     // api prefs
     std::vector<ICallback *> callbacks_;
     std::vector<ISurfaceCallback *> surfaces_;
     std::vector<IMusicalCallback *> musicalsurfaces_;
+    std::vector<IFrameCallback *> frameCallbacks_;
+    // subscribed for frames instead of touches from frame devices
+    struct FramedCallback {
+        ICallback *touches_;
+        IFrameCallback *frames_;
+    };
+    std::vector<FramedCallback> framedCallbacks_;
+    MsgWakeup wakeup_;
+    unsigned pollingDevices_; // devices which cannot signal wakeup_
+
+    // routed touches, waiting to be mapped by their scaler as a batch (see flushRouted)
+    // a touch moving across a split is routed as two
+    static const unsigned MAX_ROUTED = TouchFrame::MAX_TOUCHES * 2;
+    unsigned routed_;
+    int routedSurface_[MAX_ROUTED];
+    unsigned char routedState_[MAX_ROUTED];
+    float routedNote_[MAX_ROUTED]; // device note, for surfaces without a scaler
+    Touch routedTouch_[MAX_ROUTED];
+    MusicalTouch routedOut_[MAX_ROUTED];
 };
 
 
@@ -90,6 +165,18 @@ void MecApi::process() {
     impl_->process();
 }
 
+bool MecApi::waitForEvents(unsigned timeoutMs) {
+    return impl_->waitForEvents(timeoutMs);
+}
+
+std::vector<DeviceStats> MecApi::stats() {
+    return impl_->stats();
+}
+
+void MecApi::resetStats() {
+    impl_->resetStats();
+}
+
 void MecApi::subscribe(ICallback *p) {
     impl_->subscribe(p);
 
@@ -117,15 +204,27 @@ void MecApi::unsubscribe(IMusicalCallback *p) {
     impl_->unsubscribe(p);
 }
 
+void MecApi::subscribe(IFrameCallback *p) {
+    impl_->subscribe(p);
+}
+
+void MecApi::unsubscribe(IFrameCallback *p) {
+    impl_->unsubscribe(p);
+}
+
+void MecApi::subscribe(ICallback *touches, IFrameCallback *frames) {
+    impl_->subscribe(touches, frames);
+}
+
 
 /////////////////////////////////////////////////////////
 //MecApi_Impl
-MecApi_Impl::MecApi_Impl(void *prefs) {
+MecApi_Impl::MecApi_Impl(void *prefs) : pollingDevices_(0), routed_(0) {
     fileprefs_.reset(new Preferences(prefs));
     prefs_.reset(new Preferences(fileprefs_->getSubTree("mec")));
 }
 
-MecApi_Impl::MecApi_Impl(const std::string &configFile) {
+MecApi_Impl::MecApi_Impl(const std::string &configFile) : pollingDevices_(0), routed_(0) {
     fileprefs_.reset(new Preferences(configFile));
     prefs_.reset(new Preferences(fileprefs_->getSubTree("mec")));
 }
@@ -137,6 +236,7 @@ MecApi_Impl::~MecApi_Impl() {
         (*it)->deinit();
     }
     devices_.clear();
+    deviceNames_.clear();
     LOG_1("devices cleared");
     prefs_.reset();
     fileprefs_.reset();
@@ -144,6 +244,7 @@ MecApi_Impl::~MecApi_Impl() {
 
 void MecApi_Impl::init() {
     LOG_1("MecApi_Impl::init");
+    initSurfaces();
     initDevices();
 }
 
@@ -151,6 +252,41 @@ void MecApi_Impl::process() {
     for (std::vector<std::shared_ptr<Device>>::iterator it = devices_.begin(); it != devices_.end(); ++it) {
         (*it)->process();
     }
+    flushRouted();
+    // nothing is being mapped, so replaced scale tables can be freed
+    surfaceManager_.quiescent();
+}
+
+bool MecApi_Impl::waitForEvents(unsigned timeoutMs) {
+    static const unsigned POLLING_WAIT_MS = 1;
+    if (pollingDevices_ > 0) {
+        // cannot be woken by polling devices, so they always need processing
+        wakeup_.wait(std::min(timeoutMs, POLLING_WAIT_MS));
+        return true;
+    }
+    return wakeup_.wait(timeoutMs);
+}
+
+std::vector<DeviceStats> MecApi_Impl::stats() {
+    std::vector<DeviceStats> ret;
+    for (unsigned i = 0; i < devices_.size(); i++) {
+        LatencyStats *lstats = devices_[i]->latencyStats();
+        if (lstats == nullptr) continue;
+        DeviceStats dstats;
+        dstats.device_ = deviceNames_[i];
+        for (unsigned s = 0; s < LatencyStats::N_STAGES; s++) {
+            lstats->stage((LatencyStats::Stage) s).snapshot(dstats.stages_[s]);
+        }
+        ret.push_back(dstats);
+    }
+    return ret;
+}
+
+void MecApi_Impl::resetStats() {
+    for (auto device : devices_) {
+        LatencyStats *lstats = device->latencyStats();
+        if (lstats != nullptr) lstats->reset();
+    }
 }
 
 void MecApi_Impl::subscribe(ICallback *p) {
@@ -164,6 +300,12 @@ void MecApi_Impl::unsubscribe(ICallback *p) {
             return;
         }
     }
+    for (std::vector<FramedCallback>::iterator it = framedCallbacks_.begin(); it != framedCallbacks_.end(); ++it) {
+        if (p == it->touches_) {
+            framedCallbacks_.erase(it);
+            return;
+        }
+    }
 }
 
 void MecApi_Impl::subscribe(ISurfaceCallback *p) {
@@ -192,35 +334,67 @@ void MecApi_Impl::unsubscribe(IMusicalCallback *p) {
     }
 }
 
+void MecApi_Impl::subscribe(IFrameCallback *p) {
+    frameCallbacks_.push_back(p);
+}
+
+void MecApi_Impl::unsubscribe(IFrameCallback *p) {
+    for (std::vector<IFrameCallback *>::iterator it = frameCallbacks_.begin(); it != frameCallbacks_.end(); ++it) {
+        if (p == (*it)) {
+            frameCallbacks_.erase(it);
+            return;
+        }
+    }
+}
+
+void MecApi_Impl::subscribe(ICallback *touches, IFrameCallback *frames) {
+    framedCallbacks_.push_back(FramedCallback{touches, frames});
+}
+
 
 void MecApi_Impl::touchOn(int touchId, float note, float x, float y, float z) {
     for (std::vector<ICallback *>::iterator it = callbacks_.begin(); it != callbacks_.end(); ++it) {
         (*it)->touchOn(touchId, note, x, y, z);
     }
+    for (std::vector<FramedCallback>::iterator it = framedCallbacks_.begin(); it != framedCallbacks_.end(); ++it) {
+        it->touches_->touchOn(touchId, note, x, y, z);
+    }
 }
 
 void MecApi_Impl::touchContinue(int touchId, float note, float x, float y, float z) {
     for (std::vector<ICallback *>::iterator it = callbacks_.begin(); it != callbacks_.end(); ++it) {
         (*it)->touchContinue(touchId, note, x, y, z);
     }
+    for (std::vector<FramedCallback>::iterator it = framedCallbacks_.begin(); it != framedCallbacks_.end(); ++it) {
+        it->touches_->touchContinue(touchId, note, x, y, z);
+    }
 }
 
 void MecApi_Impl::touchOff(int touchId, float note, float x, float y, float z) {
     for (std::vector<ICallback *>::iterator it = callbacks_.begin(); it != callbacks_.end(); ++it) {
         (*it)->touchOff(touchId, note, x, y, z);
     }
+    for (std::vector<FramedCallback>::iterator it = framedCallbacks_.begin(); it != framedCallbacks_.end(); ++it) {
+        it->touches_->touchOff(touchId, note, x, y, z);
+    }
 }
 
 void MecApi_Impl::control(int ctrlId, float v) {
     for (std::vector<ICallback *>::iterator it = callbacks_.begin(); it != callbacks_.end(); ++it) {
         (*it)->control(ctrlId, v);
     }
+    for (std::vector<FramedCallback>::iterator it = framedCallbacks_.begin(); it != framedCallbacks_.end(); ++it) {
+        it->touches_->control(ctrlId, v);
+    }
 }
 
 void MecApi_Impl::mec_control(int cmd, void *other) {
     for (std::vector<ICallback *>::iterator it = callbacks_.begin(); it != callbacks_.end(); ++it) {
         (*it)->mec_control(cmd, other);
     }
+    for (std::vector<FramedCallback>::iterator it = framedCallbacks_.begin(); it != framedCallbacks_.end(); ++it) {
+        it->touches_->mec_control(cmd, other);
+    }
 }
 
 
@@ -260,12 +434,219 @@ void MecApi_Impl::touchOff(const MusicalTouch &t) {
     }
 }
 
+void MecApi_Impl::frame(const TouchFrame &f) {
+    for (std::vector<IFrameCallback *>::iterator it = frameCallbacks_.begin(); it != frameCallbacks_.end(); ++it) {
+        (*it)->frame(f);
+    }
+    for (std::vector<FramedCallback>::iterator it = framedCallbacks_.begin(); it != framedCallbacks_.end(); ++it) {
+        it->frames_->frame(f);
+    }
+}
+
+// a touch from a device, framed callbacks get touches from frame devices via frame() instead
+void MecApi_Impl::deviceTouch(const SurfaceInput &in, TouchFrame::State s, MecTime t, int touchId, float note,
+                              float x, float y, float z) {
+    for (std::vector<ICallback *>::iterator it = callbacks_.begin(); it != callbacks_.end(); ++it) {
+        (*it)->eventTime(t);
+    }
+    if (!in.framed_) {
+        for (std::vector<FramedCallback>::iterator it = framedCallbacks_.begin(); it != framedCallbacks_.end(); ++it) {
+            it->touches_->eventTime(t);
+        }
+        switch (s) {
+            case TouchFrame::T_ON:
+                touchOn(touchId, note, x, y, z);
+                break;
+            case TouchFrame::T_CONTINUE:
+                touchContinue(touchId, note, x, y, z);
+                break;
+            case TouchFrame::T_OFF:
+                touchOff(touchId, note, x, y, z);
+                break;
+        }
+        return;
+    }
+    for (std::vector<ICallback *>::iterator it = callbacks_.begin(); it != callbacks_.end(); ++it) {
+        switch (s) {
+            case TouchFrame::T_ON:
+                (*it)->touchOn(touchId, note, x, y, z);
+                break;
+            case TouchFrame::T_CONTINUE:
+                (*it)->touchContinue(touchId, note, x, y, z);
+                break;
+            case TouchFrame::T_OFF:
+                (*it)->touchOff(touchId, note, x, y, z);
+                break;
+        }
+    }
+}
+
+void MecApi_Impl::routeTouch(SurfaceInput &in, TouchFrame::State s, MecTime t, int touchId, float note,
+                             float x, float y, float z) {
+    if (in.surface_ < 0 || (surfaces_.empty() && musicalsurfaces_.empty())) return;
 
+    // device touches have no row, column is the device note
+    float v[SurfaceNode::N_AXES] = {x, y, z, 0.0f, note};
+    int out = surfaceManager_.route(in.surface_, v);
+
+    int *active = (touchId >= 0 && touchId < (int) in.active_.size()) ? &in.active_[touchId] : nullptr;
+    if (active != nullptr) {
+        if (s != TouchFrame::T_ON && *active >= 0 && *active != out) {
+            // touch has moved across a split, so finish it on the surface it started on
+            queueTouch(*active, TouchFrame::T_OFF, t, touchId, note, v);
+            if (s == TouchFrame::T_OFF) {
+                *active = -1;
+                if (!in.framed_) flushRouted();
+                return;
+            }
+            s = TouchFrame::T_ON;
+        }
+        *active = s == TouchFrame::T_OFF ? -1 : out;
+    }
+    queueTouch(out, s, t, touchId, note, v);
+
+    // frame devices are flushed at end of frame, see SurfaceInput::frame
+    if (!in.framed_) flushRouted();
+}
+
+void MecApi_Impl::queueTouch(int surface, TouchFrame::State s, MecTime time, int touchId, float note,
+                             const float *v) {
+    if (routed_ == MAX_ROUTED) flushRouted();
+    unsigned i = routed_++;
+    routedSurface_[i] = surface;
+    routedState_[i] = static_cast<unsigned char>(s);
+    routedNote_[i] = note;
+    Touch &t = routedTouch_[i];
+    t.id_ = touchId;
+    t.surface_ = surfaceManager_.id(surface);
+    t.x_ = v[Surface::C_X];
+    t.y_ = v[Surface::C_Y];
+    t.z_ = v[Surface::C_Z];
+    t.r_ = v[Surface::C_R];
+    t.c_ = v[Surface::C_C];
+    t.t_ = time;
+}
+
+// map each run of touches on the same surface as a batch, then deliver in the order routed
+void MecApi_Impl::flushRouted() {
+    for (unsigned start = 0; start < routed_;) {
+        int surface = routedSurface_[start];
+        unsigned end = start + 1;
+        while (end < routed_ && routedSurface_[end] == surface) end++;
+
+        const Scaler *scaler = surfaceManager_.scaler(surface);
+        if (scaler != nullptr) {
+            scaler->mapBatch(routedTouch_ + start, routedOut_ + start, end - start);
+        } else {
+            for (unsigned i = start; i < end; i++) routedOut_[i] = MusicalTouch(routedTouch_[i], routedNote_[i]);
+        }
+        start = end;
+    }
+
+    for (unsigned i = 0; i < routed_; i++) {
+        const MusicalTouch &t = routedOut_[i];
+        const Touch &st = t;
+        switch (routedState_[i]) {
+            case TouchFrame::T_ON:
+                touchOn(st);
+                touchOn(t);
+                break;
+            case TouchFrame::T_CONTINUE:
+                touchContinue(st);
+                touchContinue(t);
+                break;
+            case TouchFrame::T_OFF:
+                touchOff(st);
+                touchOff(t);
+                break;
+        }
+    }
+    routed_ = 0;
+}
 
 
 /////////////////////////////////////////////////////////
+//SurfaceInput
+SurfaceInput::SurfaceInput(MecApi_Impl &api, const std::string &device, int surface) :
+        api_(api), device_(device), surface_(surface), framed_(false), time_(0), active_(MAX_TOUCH_ID, -1) {
+}
+
+void SurfaceInput::touchOn(int touchId, float note, float x, float y, float z) {
+    api_.deviceTouch(*this, TouchFrame::T_ON, time_, touchId, note, x, y, z);
+    api_.routeTouch(*this, TouchFrame::T_ON, time_, touchId, note, x, y, z);
+}
+
+void SurfaceInput::touchContinue(int touchId, float note, float x, float y, float z) {
+    api_.deviceTouch(*this, TouchFrame::T_CONTINUE, time_, touchId, note, x, y, z);
+    api_.routeTouch(*this, TouchFrame::T_CONTINUE, time_, touchId, note, x, y, z);
+}
+
+void SurfaceInput::touchOff(int touchId, float note, float x, float y, float z) {
+    api_.deviceTouch(*this, TouchFrame::T_OFF, time_, touchId, note, x, y, z);
+    api_.routeTouch(*this, TouchFrame::T_OFF, time_, touchId, note, x, y, z);
+}
 
+void SurfaceInput::control(int ctrlId, float v) {
+    api_.control(ctrlId, v);
+}
 
+void SurfaceInput::mec_control(int cmd, void *other) {
+    api_.mec_control(cmd, other);
+}
+
+void SurfaceInput::frame(const TouchFrame &f) {
+    api_.flushRouted();
+    api_.frame(f);
+}
+
+
+/////////////////////////////////////////////////////////
+
+// touch devices and their default surface, a device can use another with "surface" in its prefs
+static const char *touchDevices[] = {"eigenharp", "soundplane", "push2", "midi", "osct3d", "replay"};
+
+void MecApi_Impl::initSurfaces() {
+    if (prefs_ == nullptr) return;
+
+    if (prefs_->exists("scales")) {
+        Scales::init(Preferences(prefs_->getSubTree("scales")));
+    }
+
+    std::vector<SurfaceID> inputs;
+    for (const char *device : touchDevices) {
+        if (prefs_->exists(device)) {
+            Preferences dp(prefs_->getSubTree(device));
+            inputs.push_back(SurfaceRegistry::intern(dp.getString("surface", device)));
+        }
+    }
+
+    surfaceManager_.init(Preferences(prefs_->getSubTree("surfaces")), inputs);
+}
+
+ICallback &MecApi_Impl::deviceCallback(const std::string &name) {
+    int surface = -1;
+    if (prefs_->exists(name)) {
+        Preferences dp(prefs_->getSubTree(name));
+        surface = surfaceManager_.index(SurfaceRegistry::intern(dp.getString("surface", name)));
+    }
+    inputs_.push_back(std::unique_ptr<SurfaceInput>(new SurfaceInput(*this, name, surface)));
+    return *inputs_.back();
+}
+
+void MecApi_Impl::addDevice(const std::string &name, std::shared_ptr<Device> device) {
+    devices_.push_back(device);
+    deviceNames_.push_back(name);
+    if (!device->setWakeup(&wakeup_)) pollingDevices_++;
+    SurfaceInput *input = nullptr;
+    for (auto &i : inputs_) {
+        if (i->device_ == name) input = i.get();
+    }
+    if (input != nullptr) {
+        input->framed_ = device->setFrameCallback(input);
+    } else {
+        device->setFrameCallback(this);
+    }
+}
 
 void MecApi_Impl::initDevices() {
     if (fileprefs_ == nullptr || prefs_ == nullptr) {
@@ -276,10 +657,10 @@ void MecApi_Impl::initDevices() {
 #ifndef WIN32
     if (prefs_->exists("eigenharp")) {
         LOG_1("eigenharp initialise ");
-        std::shared_ptr<Device> device = std::make_shared<Eigenharp>(*this);
+        std::shared_ptr<Device> device = std::make_shared<Eigenharp>(deviceCallback("eigenharp"));
         if (device->init(prefs_->getSubTree("eigenharp"))) {
             if (device->isActive()) {
-                devices_.push_back(device);
+                addDevice("eigenharp", device);
             } else {
                 LOG_1("eigenharp init inactive ");
                 device->deinit();
@@ -292,10 +673,10 @@ void MecApi_Impl::initDevices() {
 
     if (prefs_->exists("soundplane")) {
         LOG_1("soundplane initialise");
-        std::shared_ptr<Device> device = std::make_shared<Soundplane>(*this);
+        std::shared_ptr<Device> device = std::make_shared<Soundplane>(deviceCallback("soundplane"));
         if (device->init(prefs_->getSubTree("soundplane"))) {
             if (device->isActive()) {
-                devices_.push_back(device);
+                addDevice("soundplane", device);
                 LOG_1("soundplane init active ");
             } else {
                 LOG_1("soundplane init inactive ");
@@ -309,11 +690,11 @@ void MecApi_Impl::initDevices() {
 
     if (prefs_->exists("push2")) {
         LOG_1("push2 initialise ");
-        std::shared_ptr<Push2> device = std::make_shared<Push2>(*this);
+        std::shared_ptr<Push2> device = std::make_shared<Push2>(deviceCallback("push2"));
         Kontrol::KontrolModel::model()->addCallback("push2", device);
         if (device->init(prefs_->getSubTree("push2"))) {
             if (device->isActive()) {
-                devices_.push_back(device);
+                addDevice("push2", device);
             } else {
                 LOG_1("push2 init inactive ");
                 device->deinit();
@@ -327,10 +708,10 @@ void MecApi_Impl::initDevices() {
 
     if (prefs_->exists("midi")) {
         LOG_1("midi initialise ");
-        std::shared_ptr<Device> device = std::make_shared<MidiDevice>(*this);
+        std::shared_ptr<Device> device = std::make_shared<MidiDevice>(deviceCallback("midi"));
         if (device->init(prefs_->getSubTree("midi"))) {
             if (device->isActive()) {
-                devices_.push_back(device);
+                addDevice("midi", device);
             } else {
                 LOG_1("midi init inactive ");
                 device->deinit();
@@ -344,10 +725,10 @@ void MecApi_Impl::initDevices() {
 
     if (prefs_->exists("osct3d")) {
         LOG_1("osct3d initialise ");
-        std::shared_ptr<Device> device = std::make_shared<OscT3D>(*this);
+        std::shared_ptr<Device> device = std::make_shared<OscT3D>(deviceCallback("osct3d"));
         if (device->init(prefs_->getSubTree("osct3d"))) {
             if (device->isActive()) {
-                devices_.push_back(device);
+                addDevice("osct3d", device);
             } else {
                 LOG_1("osct3d init inactive ");
                 device->deinit();
@@ -358,12 +739,28 @@ void MecApi_Impl::initDevices() {
         }
     }
 
+    if (prefs_->exists("replay")) {
+        LOG_1("replay initialise ");
+        std::shared_ptr<Device> device = std::make_shared<ReplayDevice>(deviceCallback("replay"));
+        if (device->init(prefs_->getSubTree("replay"))) {
+            if (device->isActive()) {
+                addDevice("replay", device);
+            } else {
+                LOG_1("replay init inactive ");
+                device->deinit();
+            }
+        } else {
+            LOG_1("replay init failed ");
+            device->deinit();
+        }
+    }
+
     if (prefs_->exists("kontrol")) {
         LOG_1("KontrolDevice initialise ");
         std::shared_ptr<Device> device = std::make_shared<KontrolDevice>(*this);
         if (device->init(prefs_->getSubTree("Kontrol"))) {
             if (device->isActive()) {
-                devices_.push_back(device);
+                addDevice("kontrol", device);
             } else {
                 LOG_1("KontrolDevice init inactive ");
                 device->deinit();
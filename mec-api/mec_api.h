@@ -2,6 +2,9 @@
 #define MEC_API_H
 
 #include <string>
+#include <vector>
+
+#include "mec_stats.h"
 
 
 namespace mec {
@@ -20,6 +23,8 @@ public:
     virtual void touchOff(int touchId, float note, float x, float y, float z) = 0;
     virtual void control(int ctrlId, float v) = 0;
     virtual void mec_control(int cmd, void* other) = 0;
+    // arrival at the device handler of the touches that follow, for callbacks that carry it on (see Touch::t_)
+    virtual void eventTime(MecTime) { ; }
 };
 
 class Callback : public ICallback {
@@ -32,13 +37,80 @@ public:
     virtual void mec_control(int cmd, void* other) override  {};
 };
 
+// all touches from one device scan (sensor frame), as a structure of arrays
+// so a consumer can process a frame in a single pass, rather than a virtual call per touch
+// touches are in the order the device reported them, r/c are 0 if the device does not provide them
+struct TouchFrame {
+    static const unsigned MAX_TOUCHES = 64;
+
+    enum State {
+        T_ON,
+        T_CONTINUE,
+        T_OFF
+    };
+
+    TouchFrame() : size_(0), t_(0) {
+        ;
+    }
+
+    void clear() { size_ = 0; }
+
+    bool isFull() const { return size_ >= MAX_TOUCHES; }
+
+    bool add(State s, int id, float note, float x, float y, float z, float r = 0.0f, float c = 0.0f) {
+        if (isFull()) return false;
+        unsigned i = size_++;
+        state_[i] = static_cast<unsigned char>(s);
+        id_[i] = id;
+        note_[i] = note;
+        x_[i] = x;
+        y_[i] = y;
+        z_[i] = z;
+        r_[i] = r;
+        c_[i] = c;
+        return true;
+    }
+
+    unsigned size_;
+    MecTime t_; // arrival of first touch in frame
+
+    unsigned char state_[MAX_TOUCHES];
+    int   id_[MAX_TOUCHES];
+    float note_[MAX_TOUCHES];
+    float x_[MAX_TOUCHES];
+    float y_[MAX_TOUCHES];
+    float z_[MAX_TOUCHES];
+    float r_[MAX_TOUCHES];
+    float c_[MAX_TOUCHES];
+};
+
+// alternative to ICallback touch methods, called once per device frame (soundplane, eigenharp, t3d)
+// devices that do not have frames (e.g. midi) only deliver via ICallback
+// a frame larger than MAX_TOUCHES is delivered in parts
+// see MecApi::subscribe(ICallback*, IFrameCallback*), to get frames instead of per touch calls
+class IFrameCallback {
+public:
+    virtual void frame(const TouchFrame&) = 0;
+    virtual ~IFrameCallback() {};
+};
+
+
 //////////////////////////////////////////
 // new experimental surface api
 //////////////////////////////////////////
 
 
 
-typedef std::string SurfaceID;
+// surfaces are named in config, the name is interned to a SurfaceID, so touches carry a plain integer
+typedef unsigned SurfaceID;
+
+// surface names <-> ids, ids are never reused
+// intern at config load, name lookup is for logging/display, both are thread safe (but lock)
+class SurfaceRegistry {
+public:
+    static SurfaceID intern(const std::string &name); // returns existing id, if already interned
+    static const std::string &name(SurfaceID id); // empty if unknown
+};
 
 
 // represents a single touch on a surface
@@ -51,14 +123,16 @@ typedef std::string SurfaceID;
 // touches originate from a device, and then are passed thru surfaces to allow there coordinates to be translated.
 // a simple exampe is a device surfaces may be 'split' into 2 halfs, a 'split surface' will take the device touches and translate into touches for that
 // split... to the application these touches will be the same as if they came from different devices
+// trivially copyable (and fits in a cache line), so can be passed by value, and thru lock free queues
 struct Touch {
-    Touch() {
+    Touch() : t_(0) {
         ;
     }
-    Touch(int id, SurfaceID surface, float x, float y, float z, float r, float c) :
+    Touch(int id, SurfaceID surface, float x, float y, float z, float r, float c, MecTime t = 0) :
         id_(id), surface_(surface),
         x_(x), y_(y), z_(z),
-        r_(r), c_(c) {
+        r_(r), c_(c),
+        t_(t) {
 
     }
 
@@ -72,6 +146,7 @@ struct Touch {
     float r_; // string, sames axis as y.. but often used for pitch offsets (e.g 4ths), then Y is within this axis
     float c_; // pitch along string, usually proportional to x.
 
+    MecTime t_; // arrival at device handler (monotonic), carried thru surfaces so latency can be measured
 };
 
 class ISurfaceCallback {
@@ -90,7 +165,7 @@ struct MusicalTouch : public Touch {
     }
 
     MusicalTouch(const Touch& t, float note) :
-        Touch(t.id_, t.surface_, t.x_, t.y_, t.z_, t.r_, t.c_),
+        Touch(t.id_, t.surface_, t.x_, t.y_, t.z_, t.r_, t.c_, t.t_),
         note_(note)  {
         ;
     }
@@ -107,6 +182,13 @@ public:
 };
 
 
+// latency of events thru mec for a device, see LatencyStats for stages
+struct DeviceStats {
+    std::string device_;
+    LatencySnapshot stages_[LatencyStats::N_STAGES];
+};
+
+
 class MecApi {
 public:
     MecApi(const std::string& configFile = "./mec.json");
@@ -114,6 +196,12 @@ public:
     ~MecApi();
     void init();
     void process();  // periodically call to process messages
+    // block until a device has messages for process(), or timeout
+    // returns false on timeout. if devices need polling (e.g. eigenharp) it will not block for long, and returns true
+    bool waitForEvents(unsigned timeoutMs);
+
+    std::vector<DeviceStats> stats(); // per active device
+    void resetStats();
 
     void subscribe(ICallback*);
     void unsubscribe(ICallback*);
@@ -124,6 +212,14 @@ public:
     void subscribe(IMusicalCallback*);
     void unsubscribe(IMusicalCallback*);
 
+    void subscribe(IFrameCallback*);
+    void unsubscribe(IFrameCallback*);
+
+    // touches from devices with frames go to frames, instead of per touch to touches
+    // touches from other devices, control and mec_control still go to touches
+    // unsubscribe(ICallback*) removes both
+    void subscribe(ICallback* touches, IFrameCallback* frames);
+
 private:
     MecApi_Impl* impl_;
 };
@@ -2,9 +2,14 @@
 #define MEC_DEVICE_H
 
 #include "mec_prefs.h"
+#include "mec_stats.h"
 
 namespace mec {
 
+class MsgWakeup;
+class IFrameCallback;
+struct EventRecord;
+
 class Device {
 public:
     virtual ~Device() {};
@@ -12,6 +17,17 @@ public:
     virtual bool process() = 0 ;
     virtual void deinit() = 0;
     virtual bool isActive() = 0;
+    // devices delivering via a MsgQueue attach it, so MecApi::waitForEvents can sleep until they have data
+    // return false, if device needs process() to be called regularly (i.e. it polls)
+    virtual bool setWakeup(MsgWakeup*) { return false; }
+    // latency of events from this device, nullptr if not measured
+    virtual LatencyStats* latencyStats() { return nullptr; }
+    // devices that scan in frames, deliver each frame to this (in process()), as well as to ICallback
+    // returns true if the device delivers frames, so frame subscribers can skip its per touch calls
+    virtual bool setFrameCallback(IFrameCallback*) { return false; }
+    // replay of recorded input (see ReplayDevice), initialise without hardware, then replay() each record
+    virtual bool initReplay(void*) { return false; }
+    virtual void replay(const EventRecord&) { ; }
 };
 
 }
@@ -0,0 +1,176 @@
+#include "mec_jitter_buffer.h"
+
+#include <cstring>
+
+namespace mec {
+
+static const MecTime HOLD_RETRY = 1000000; // ns, when on/off are held but no frame is due
+
+JitterBuffer::JitterBuffer(MsgQueue &queue, unsigned depth) : queue_(queue) {
+    memset(&stats_, 0, sizeof(stats_));
+    held_.reserve(2 * MAX_FRAME_MSGS);
+    setDepth(depth);
+}
+
+void JitterBuffer::setDepth(unsigned depth) {
+    depth_ = depth;
+    // up to 2 * depth buffered (see release), + one building, + one so beginFrame need not release
+    frames_.resize(2 * depth + 2);
+    reset();
+}
+
+void JitterBuffer::reset() {
+    head_ = 0;
+    count_ = 0;
+    building_ = false;
+    started_ = false;
+    lastId_ = 0;
+    lastArrival_ = 0;
+    period_ = 0;
+    playing_ = false;
+    next_ = 0;
+}
+
+void JitterBuffer::openFrame(unsigned id, MecTime arrival, bool continued) {
+    if (count_ + 1 >= frames_.size()) {
+        // release not called often enough to keep up
+        stats_.overruns_++;
+        releaseOne();
+    }
+
+    Frame &f = slot(head_ + count_);
+    f.id_ = id;
+    f.arrival_ = arrival;
+    f.size_ = 0;
+    f.continued_ = continued;
+    building_ = true;
+}
+
+void JitterBuffer::beginFrame(unsigned id, MecTime arrival) {
+    if (building_) endFrame();
+    openFrame(id, arrival, false);
+    stats_.frames_++;
+
+    int delta = started_ ? int(id - lastId_) : 1;
+    if (delta <= 0) {
+        stats_.late_++;
+        return;
+    }
+    if (started_) {
+        if (delta > 1) stats_.lost_ += delta - 1;
+        if (arrival > lastArrival_) {
+            // per frame, so lost frames dont distort it, smoothed so bursts average out
+            long long sample = (long long) (arrival - lastArrival_) / delta;
+            long long period = (long long) period_;
+            period_ = period_ == 0 ? (MecTime) sample : (MecTime) (period + (sample - period) / 16);
+        }
+    }
+    started_ = true;
+    lastId_ = id;
+    lastArrival_ = arrival;
+}
+
+bool JitterBuffer::add(const MecMsg &msg) {
+    if (!building_) return false;
+    Frame *f = &slot(head_ + count_);
+    if (f->size_ >= MAX_FRAME_MSGS) {
+        if (msg.type_ != MecMsg::TOUCH_ON && msg.type_ != MecMsg::TOUCH_OFF) {
+            stats_.truncated_++;
+            return false;
+        }
+        unsigned id = f->id_;
+        MecTime arrival = f->arrival_;
+        endFrame();
+        openFrame(id, arrival, true);
+        f = &slot(head_ + count_);
+    }
+    f->msgs_[f->size_++] = msg;
+    return true;
+}
+
+void JitterBuffer::endFrame() {
+    if (!building_) return;
+    Frame &f = slot(head_ + count_);
+    if (f.size_ > 0) {
+        MecMsg &msg = f.msgs_[f.size_++];
+        msg.type_ = MecMsg::FRAME;
+        msg.deviceTime_ = f.arrival_;
+    }
+    // empty frames are kept, so playout keeps the senders cadence
+    building_ = false;
+    count_++;
+}
+
+MecTime JitterBuffer::release(MecTime now) {
+    releaseHeld();
+    MecTime next = releaseFrames(now);
+    // held on/off are retried, even if no more frames arrive
+    if (next == 0 && !held_.empty()) next = now + (period_ > 0 ? period_ : HOLD_RETRY);
+    return next;
+}
+
+MecTime JitterBuffer::releaseFrames(MecTime now) {
+    if (depth_ == 0 || period_ == 0) {
+        while (count_ > 0) releaseOne();
+        playing_ = false;
+        return 0;
+    }
+
+    if (!playing_) {
+        if (count_ < depth_) return 0;
+        playing_ = true;
+        next_ = now;
+    }
+
+    // sender faster than estimate, or a burst beyond depth, catch up
+    while (count_ > 2 * depth_) {
+        stats_.overruns_++;
+        releaseOne();
+    }
+
+    // we stalled, dont burst out everything that was due
+    if (now > next_ + depth_ * period_) next_ = now;
+
+    while (count_ > 0 && now >= next_) {
+        releaseOne();
+        next_ += period_;
+    }
+
+    if (count_ == 0 && now >= next_) {
+        stats_.underruns_++;
+        playing_ = false;
+        return 0;
+    }
+    return next_;
+}
+
+void JitterBuffer::releaseOne() {
+    do {
+        queueFrame(slot(head_));
+        head_ = (head_ + 1) % frames_.size();
+        count_--;
+    } while (count_ > 0 && slot(head_).continued_);
+}
+
+void JitterBuffer::queueFrame(const Frame &f) {
+    // held on/off go first, so order is kept
+    if (releaseHeld() && queue_.addFrame(f.msgs_, f.size_)) {
+        stats_.released_++;
+        return;
+    }
+    stats_.dropped_++;
+    for (unsigned i = 0; i < f.size_; i++) {
+        const MecMsg &msg = f.msgs_[i];
+        if (msg.type_ == MecMsg::TOUCH_ON || msg.type_ == MecMsg::TOUCH_OFF) held_.push_back(msg);
+    }
+    releaseHeld();
+}
+
+bool JitterBuffer::releaseHeld() {
+    unsigned n = 0;
+    while (n < held_.size() && !queue_.isFull() && queue_.addToQueue(held_[n])) n++;
+    held_.erase(held_.begin(), held_.begin() + n);
+    return held_.empty();
+}
+
+}
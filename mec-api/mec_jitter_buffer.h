@@ -0,0 +1,95 @@
+#ifndef MEC_JITTER_BUFFER_H
+#define MEC_JITTER_BUFFER_H
+
+#include <vector>
+
+#include "mec_api.h"
+#include "mec_msg_queue.h"
+
+namespace mec {
+
+// groups device messages into frames, and releases whole frames to a device queue
+// (see MsgQueue::addFrame), so a frame is never split over process() calls
+//
+// with a depth, it is also a playout buffer, for frames arriving over a network with jitter :
+// release starts once depth frames are buffered, then it is one frame per frame period,
+// the period being estimated from arrivals (so follows the sender, no clock sync needed)
+// if the buffer runs dry, it rebuffers, if it gets more than twice depth behind, it catches up
+// depth 0, frames are released as soon as they are complete
+// touch on/off are never dropped (a lost off is a stuck note) : a full frame continues in another
+// with the same id, released with it, and if the queue is full they are held until there is room
+//
+// single threaded, the device's producer thread
+class JitterBuffer {
+public:
+    static const unsigned MAX_FRAME_MSGS = TouchFrame::MAX_TOUCHES; // more continues are dropped (counted)
+
+    struct Stats {
+        unsigned long long frames_;
+        unsigned long long released_;
+        unsigned long long lost_;       // gaps in frame ids
+        unsigned long long late_;       // frame id not after previous (released anyway, as voices depend on it)
+        unsigned long long underruns_;  // nothing to release when due, so rebuffered
+        unsigned long long overruns_;   // released early, as too far behind
+        unsigned long long truncated_;  // continues dropped, frame full
+        unsigned long long dropped_;    // frames dropped, queue full (but not their on/off)
+    };
+
+    JitterBuffer(MsgQueue &queue, unsigned depth = 0);
+
+    void setDepth(unsigned depth); // not while frames are buffered
+    unsigned depth() const { return depth_; }
+    void reset();
+
+    // build a frame, messages added between begin and end
+    void beginFrame(unsigned id, MecTime arrival);
+    bool inFrame() const { return building_; }
+    bool add(const MecMsg &msg);
+    void endFrame(); // frame is complete, a FRAME message is appended
+
+    // release frames due at now to the queue, returns when the next is due, or 0 if waiting for a frame
+    // (or when to retry, if on/off are held)
+    MecTime release(MecTime now);
+
+    MecTime period() const { return period_; } // estimated frame period, 0 if not known
+    unsigned buffered() const { return count_; } // complete frames waiting
+    unsigned held() const { return static_cast<unsigned>(held_.size()); } // on/off waiting for queue space
+    const Stats &stats() const { return stats_; }
+
+private:
+    struct Frame {
+        unsigned id_;
+        MecTime arrival_;
+        unsigned size_;
+        bool continued_; // rest of the previous frame, released with it
+        MecMsg msgs_[MAX_FRAME_MSGS + 1]; // + FRAME
+    };
+
+    Frame &slot(unsigned i) { return frames_[i % frames_.size()]; }
+    void openFrame(unsigned id, MecTime arrival, bool continued);
+    MecTime releaseFrames(MecTime now);
+    void releaseOne();
+    void queueFrame(const Frame &f);
+    bool releaseHeld();
+
+    MsgQueue &queue_;
+    unsigned depth_;
+    std::vector<Frame> frames_; // ring, oldest complete frame at head_, building at head_ + count_
+    unsigned head_;
+    unsigned count_;
+    bool building_;
+
+    bool started_;          // a frame has been seen, so lastId_/lastArrival_ valid
+    unsigned lastId_;
+    MecTime lastArrival_;
+    MecTime period_;
+    bool playing_;
+    MecTime next_;          // next release due
+    std::vector<MecMsg> held_; // on/off of dropped frames, in order
+
+    Stats stats_;
+};
+
+}
+
+#endif //MEC_JITTER_BUFFER_H
@@ -2,122 +2,316 @@
 
 #include "mec_api.h"
 #include "mec_log.h"
+#include "mec_spsc_queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstdint>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
 
 namespace mec {
 
-const int RING_BUFFER_SIZE = 30;
+class MsgQueue_impl {
+public:
+    MsgQueue_impl(unsigned capacity) : queue_(capacity), wakeup_(nullptr), frameCallback_(nullptr) { ; }
+
+    void addToFrame(TouchFrame::State s, const MecMsg &msg) {
+        if (frame_.isFull()) deliverFrame();
+        if (frame_.size_ == 0) frame_.t_ = msg.deviceTime_;
+        frame_.add(s,
+                   msg.data_.touch_.touchId_,
+                   msg.data_.touch_.note_,
+                   msg.data_.touch_.x_,
+                   msg.data_.touch_.y_,
+                   msg.data_.touch_.z_);
+    }
 
+    void deliverFrame() {
+        if (frame_.size_ > 0) frameCallback_->frame(frame_);
+        frame_.clear();
+    }
 
-class MsgQueue_impl {
+    SpscQueue<MecMsg> queue_;
+    std::atomic<MsgWakeup *> wakeup_; // read by producer on each push
+    LatencyStats stats_;
+    IFrameCallback *frameCallback_;
+    TouchFrame frame_; // touches since last FRAME
+};
+
+class MsgWakeup_impl {
 public:
-    MsgQueue_impl();
-    ~MsgQueue_impl();
-
-    bool addToQueue(MecMsg &);
-    bool nextMsg(MecMsg &);
-    bool isEmpty();
-    bool isFull();
-    int available();
-    int pending();
-
-private:
-    MecMsg queue_[RING_BUFFER_SIZE];
-    // unsigned readPtr_;
-    // unsigned writePtr_;
-    volatile unsigned readPtr_;
-    volatile unsigned writePtr_;
+    std::vector<MsgQueue *> queues_;
+#ifdef __linux__
+    int fd_;
+#else
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    bool signalled_;
+#endif
 };
 
 
-/////////// Public Interface
-MsgQueue::MsgQueue() {
-    impl_.reset(new MsgQueue_impl());
+/////////// MsgWakeup
+MsgWakeup::MsgWakeup() {
+    impl_.reset(new MsgWakeup_impl());
+#ifdef __linux__
+    impl_->fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (impl_->fd_ < 0) {
+        LOG_0("MsgWakeup : unable to create eventfd, will poll");
+    }
+#else
+    impl_->signalled_ = false;
+#endif
 }
 
-MsgQueue::~MsgQueue() {
+MsgWakeup::~MsgWakeup() {
+    // queues may outlive us (devices are shared), so make sure they dont signal us
+    for (auto q : impl_->queues_) {
+        q->impl_->wakeup_.store(nullptr);
+    }
+#ifdef __linux__
+    if (impl_->fd_ >= 0) close(impl_->fd_);
+#endif
 }
 
-bool MsgQueue::addToQueue(MecMsg &msg) {
-    return impl_->addToQueue(msg);
+void MsgWakeup::signal() {
+#ifdef __linux__
+    if (impl_->fd_ >= 0) {
+        uint64_t v = 1;
+        // counter only saturates if nobody ever waits, in which case, nothing to do
+        ssize_t r = write(impl_->fd_, &v, sizeof(v));
+        (void) r;
+    }
+#else
+    {
+        std::lock_guard<std::mutex> lock(impl_->mtx_);
+        impl_->signalled_ = true;
+    }
+    impl_->cond_.notify_one();
+#endif
 }
 
-bool MsgQueue::nextMsg(MecMsg &msg) {
-    return impl_->nextMsg(msg);
+bool MsgWakeup::wait(unsigned timeoutMs) {
+    // pairs with fence in SpscQueue::push, see there
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (auto q : impl_->queues_) {
+        if (!q->isEmpty()) return true;
+    }
+    if (timeoutMs == 0) return false;
+
+#ifdef __linux__
+    if (impl_->fd_ < 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(timeoutMs, 1u)));
+        return true;
+    }
+    struct pollfd pfd;
+    pfd.fd = impl_->fd_;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int rc = poll(&pfd, 1, static_cast<int>(timeoutMs));
+    if (rc > 0) {
+        uint64_t v;
+        ssize_t r = read(impl_->fd_, &v, sizeof(v)); // reset counter
+        (void) r;
+        return true;
+    }
+    return false; // timeout or interrupted
+#else
+    std::unique_lock<std::mutex> lock(impl_->mtx_);
+    impl_->cond_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return impl_->signalled_; });
+    bool signalled = impl_->signalled_;
+    impl_->signalled_ = false;
+    return signalled;
+#endif
 }
 
-bool MsgQueue::isEmpty() {
-    return impl_->isEmpty();
+int MsgWakeup::fd() {
+#ifdef __linux__
+    return impl_->fd_;
+#else
+    return -1;
+#endif
 }
 
-bool MsgQueue::isFull() {
-    return impl_->isFull();
+void MsgWakeup::attach(MsgQueue *q) {
+    if (std::find(impl_->queues_.begin(), impl_->queues_.end(), q) == impl_->queues_.end()) {
+        impl_->queues_.push_back(q);
+    }
 }
 
-int MsgQueue::available() {
-    return impl_->available();
+void MsgWakeup::detach(MsgQueue *q) {
+    impl_->queues_.erase(std::remove(impl_->queues_.begin(), impl_->queues_.end(), q), impl_->queues_.end());
 }
 
-int MsgQueue::pending() {
-    return impl_->pending();
+
+/////////// Public Interface
+MsgQueue::MsgQueue(unsigned capacity) {
+    impl_.reset(new MsgQueue_impl(capacity));
 }
 
+MsgQueue::~MsgQueue() {
+    setWakeup(nullptr);
+}
 
-/////////// Implementation
-MsgQueue_impl::MsgQueue_impl() {
-    writePtr_ = readPtr_ = 0;
+void MsgQueue::setCapacity(unsigned capacity) {
+    impl_->queue_.setCapacity(capacity);
 }
 
-MsgQueue_impl::~MsgQueue_impl() {
+unsigned MsgQueue::capacity() {
+    return impl_->queue_.capacity();
+}
 
+bool MsgQueue::addToQueue(MecMsg &msg) {
+    // note: no logging on overflow, this is called on device thread, see overflows()
+    msg.enqueueTime_ = mecTimeNow();
+    if (msg.deviceTime_ == 0) msg.deviceTime_ = msg.enqueueTime_;
+
+    bool ret;
+    MsgWakeup *wakeup = impl_->wakeup_.load(std::memory_order_relaxed);
+    if (wakeup == nullptr) {
+        ret = impl_->queue_.push(msg);
+    } else {
+        bool wasEmpty;
+        ret = impl_->queue_.push(msg, wasEmpty);
+        if (wasEmpty) wakeup->signal();
+    }
+    if (ret) impl_->stats_.record(LatencyStats::DEVICE, msg.deviceTime_, msg.enqueueTime_);
+    return ret;
 }
 
-bool MsgQueue_impl::addToQueue(MecMsg &msg) {
-    unsigned next = (writePtr_ + 1) % RING_BUFFER_SIZE;
+MecMsg *MsgQueue::reserve() {
+    return impl_->queue_.back();
+}
 
-    if (next == readPtr_) {
-        LOG_0("MsgQueue_impl : ring buffer overflow");
-        return false;
+void MsgQueue::commit(MecMsg *msg) {
+    MecTime now = mecTimeNow();
+    msg->enqueueTime_ = now;
+    if (msg->deviceTime_ == 0) msg->deviceTime_ = now;
+    MecTime deviceTime = msg->deviceTime_; // msg belongs to consumer once published
+
+    MsgWakeup *wakeup = impl_->wakeup_.load(std::memory_order_relaxed);
+    if (wakeup == nullptr) {
+        impl_->queue_.publish();
+    } else {
+        bool wasEmpty;
+        impl_->queue_.publish(wasEmpty);
+        if (wasEmpty) wakeup->signal();
     }
-    queue_[writePtr_] = msg;
-    writePtr_ = next;
-    return true;
+    impl_->stats_.record(LatencyStats::DEVICE, deviceTime, now);
 }
 
-bool MsgQueue_impl::nextMsg(MecMsg &msg) {
-    if (readPtr_ != writePtr_) {
-        msg = queue_[readPtr_];
-        readPtr_ = (readPtr_ + 1) % RING_BUFFER_SIZE;
-        return true;
+bool MsgQueue::addFrame(const MecMsg *msgs, unsigned n) {
+    if (n == 0) return true;
+    SpscQueue<MecMsg> &queue = impl_->queue_;
+    if (!queue.reserve(n)) return false;
+
+    MecTime now = mecTimeNow();
+    for (unsigned i = 0; i < n; i++) {
+        MecMsg *msg = queue.slot(i);
+        *msg = msgs[i];
+        msg->enqueueTime_ = now;
+        if (msg->deviceTime_ == 0) msg->deviceTime_ = now;
+        impl_->stats_.record(LatencyStats::DEVICE, msg->deviceTime_, now);
     }
-    return false;
+
+    MsgWakeup *wakeup = impl_->wakeup_.load(std::memory_order_relaxed);
+    if (wakeup == nullptr) {
+        queue.publish(n);
+    } else {
+        bool wasEmpty;
+        queue.publish(n, wasEmpty);
+        if (wasEmpty) wakeup->signal();
+    }
+    return true;
 }
 
-bool MsgQueue_impl::isEmpty() {
-    return readPtr_ == writePtr_;
+bool MsgQueue::nextMsg(MecMsg &msg) {
+    return impl_->queue_.pop(msg);
 }
 
-bool MsgQueue_impl::isFull() {
-    return available() == 0;
+const MecMsg *MsgQueue::front() {
+    return impl_->queue_.front();
 }
 
-int MsgQueue_impl::available() {
-    return RING_BUFFER_SIZE - pending();
+void MsgQueue::popFront() {
+    impl_->queue_.popFront();
+}
 
+bool MsgQueue::isEmpty() {
+    return impl_->queue_.isEmpty();
 }
 
-int MsgQueue_impl::pending() {
-    if (writePtr_ >= readPtr_) {
-        return writePtr_ - readPtr_;
-    }
+bool MsgQueue::isFull() {
+    return impl_->queue_.isFull();
+}
+
+int MsgQueue::available() {
+    return impl_->queue_.available();
+}
+
+int MsgQueue::pending() {
+    return impl_->queue_.pending();
+}
 
-    return writePtr_ + RING_BUFFER_SIZE - readPtr_;
+unsigned long MsgQueue::overflows() {
+    return impl_->queue_.overflows();
 }
 
+void MsgQueue::resetOverflows() {
+    impl_->queue_.resetOverflows();
+}
+
+LatencyStats &MsgQueue::latencyStats() {
+    return impl_->stats_;
+}
+
+void MsgQueue::setFrameCallback(IFrameCallback *cb) {
+    impl_->frameCallback_ = cb;
+    impl_->frame_.clear();
+}
+
+void MsgQueue::setWakeup(MsgWakeup *wakeup) {
+    MsgWakeup *old = impl_->wakeup_.load();
+    if (old == wakeup) return;
+    if (old != nullptr) old->detach(this);
+    if (wakeup != nullptr) wakeup->attach(this);
+    impl_->wakeup_.store(wakeup);
+}
+
+
 bool MsgQueue::process(ICallback &c) {
-    MecMsg msg;
-    while (nextMsg(msg)) {
+    drain(c, impl_->queue_.capacity());
+    return true;
+}
+
+unsigned MsgQueue::drain(ICallback &c, unsigned maxN) {
+    // only drain what is available now, so a busy producer cannot hold us here
+    unsigned n = 0;
+    const MecMsg *pMsg;
+    LatencyStats &stats = impl_->stats_;
+    bool frameCallback = impl_->frameCallback_ != nullptr;
+    // delivery of one message, is dequeue of the next, so only one clock read per message
+    MecTime now = mecTimeNow();
+    while (n < maxN && (pMsg = impl_->queue_.front()) != nullptr) {
+        const MecMsg &msg = *pMsg;
+        MecTime dequeued = now;
+        // frame markers are not events, so not part of the latency stats
+        bool counted = msg.type_ != MecMsg::FRAME;
+        if (counted) stats.record(LatencyStats::QUEUE, msg.enqueueTime_, dequeued);
         switch (msg.type_) {
             case MecMsg::TOUCH_ON:
+                if (frameCallback) impl_->addToFrame(TouchFrame::T_ON, msg);
+                c.eventTime(msg.deviceTime_);
                 c.touchOn(
                         msg.data_.touch_.touchId_,
                         msg.data_.touch_.note_,
@@ -126,6 +320,8 @@ bool MsgQueue::process(ICallback &c) {
                         msg.data_.touch_.z_);
                 break;
             case MecMsg::TOUCH_CONTINUE:
+                if (frameCallback) impl_->addToFrame(TouchFrame::T_CONTINUE, msg);
+                c.eventTime(msg.deviceTime_);
                 c.touchContinue(
                         msg.data_.touch_.touchId_,
                         msg.data_.touch_.note_,
@@ -134,6 +330,8 @@ bool MsgQueue::process(ICallback &c) {
                         msg.data_.touch_.z_);
                 break;
             case MecMsg::TOUCH_OFF:
+                if (frameCallback) impl_->addToFrame(TouchFrame::T_OFF, msg);
+                c.eventTime(msg.deviceTime_);
                 c.touchOff(
                         msg.data_.touch_.touchId_,
                         msg.data_.touch_.note_,
@@ -152,11 +350,25 @@ bool MsgQueue::process(ICallback &c) {
                     LOG_1("posting shutdown request");
                     c.mec_control(ICallback::SHUTDOWN, nullptr);
                 }
+                break;
+            case MecMsg::FRAME :
+                if (frameCallback) impl_->deliverFrame();
+                break;
             default:
                 LOG_0("MsgQueue::process unhandled message type");
         }
+        now = mecTimeNow();
+        if (counted) {
+            stats.record(LatencyStats::DELIVERY, dequeued, now);
+            stats.record(LatencyStats::TOTAL, msg.deviceTime_, now);
+        }
+        impl_->queue_.popFront();
+        n++;
     }
-    return true;
+    // frame subscribers may not get these touches any other way, so a frame is not held over
+    // (e.g. t3d without /t3d/frm), this may split a frame still being queued
+    if (frameCallback) impl_->deliverFrame();
+    return n;
 }
 
 
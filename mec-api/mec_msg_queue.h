@@ -3,9 +3,12 @@
 
 #include <memory>
 
+#include "mec_stats.h"
+
 namespace mec {
 
 class ICallback;
+class IFrameCallback;
 
 struct MecMsg {
     enum type {
@@ -13,7 +16,8 @@ struct MecMsg {
         TOUCH_CONTINUE,
         TOUCH_OFF,
         CONTROL,
-        MEC_CONTROL
+        MEC_CONTROL,
+        FRAME       // end of a device frame, touches since last FRAME are delivered to IFrameCallback
     } type_;
 
     enum mec_cmd {
@@ -34,23 +38,70 @@ struct MecMsg {
             mec_cmd cmd_;
         } mec_control_;
     } data_;
+
+    MecTime deviceTime_ = 0;  // arrival at device handler, if 0, set on enqueue
+    MecTime enqueueTime_ = 0; // set by addToQueue
 };
 
 class MsgQueue_impl;
+class MsgQueue;
+class MsgWakeup_impl;
 
+// lets the consumer (MecApi) sleep until one of its queues has data
+// queues signal it when they go from empty to non empty
+// linux uses an eventfd (so can also be used with poll/select), other platforms a condition variable
+class MsgWakeup {
+public:
+    MsgWakeup();
+    ~MsgWakeup();
+    void signal(); // producer side, safe from any thread
+    bool wait(unsigned timeoutMs); // consumer side, true if there may be messages to process
+    int  fd(); // eventfd, or -1 if not available
+
+private:
+    friend class MsgQueue;
+    void attach(MsgQueue *);
+    void detach(MsgQueue *);
+
+    std::unique_ptr<MsgWakeup_impl> impl_;
+};
+
+// single producer (device thread) , single consumer (MecApi::process) queue
+// capacity is rounded up to a power of 2, and can be set per device with "queue size" in mec.json
 class MsgQueue {
 public:
-    MsgQueue();
+    static const unsigned DEFAULT_QUEUE_SIZE = 512;
+
+    MsgQueue(unsigned capacity = DEFAULT_QUEUE_SIZE);
     ~MsgQueue();
+    void setCapacity(unsigned capacity); // call before device starts producing
+    unsigned capacity();
     bool addToQueue(MecMsg&);
+    // producer, build a message in place, instead of a copy with addToQueue
+    // reserve returns nullptr if full, otherwise fill it in and commit it (before any other add)
+    MecMsg* reserve();
+    void commit(MecMsg*);
+    // producer, n messages (e.g. a device frame) published together, so process() never splits them
+    // all or nothing, false (and n overflows) if there is not space for all of them
+    bool addFrame(const MecMsg *msgs, unsigned n);
     bool nextMsg(MecMsg&);
+    // consumer, next message in place (nullptr if empty), release it with popFront
+    const MecMsg* front();
+    void popFront();
     bool isEmpty();
     bool isFull();
     int  available();
     int  pending();
+    unsigned long overflows(); // messages dropped, as queue full
+    void resetOverflows();
     bool process(ICallback&);
+    unsigned drain(ICallback&, unsigned maxN); // returns number of messages processed
+    void setWakeup(MsgWakeup*); // consumer thread, nullptr to detach
+    LatencyStats& latencyStats();
+    void setFrameCallback(IFrameCallback*); // consumer thread
 
 private:
+    friend class MsgWakeup;
     std::unique_ptr<MsgQueue_impl> impl_;
 };
 
@@ -0,0 +1,368 @@
+#include "mec_recorder.h"
+
+#include <cstring>
+#include <vector>
+
+#ifndef WIN32
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#else
+#include <cstdio>
+#endif
+
+#include "mec_log.h"
+
+namespace mec {
+
+static const char RECORD_MAGIC[4] = {'M', 'E', 'C', 'R'};
+static const uint32_t RECORD_VERSION = 1;
+
+struct RecordFileHeader {
+    char magic_[4];
+    uint32_t version_;
+    char device_[32];
+    uint64_t reserved_;
+};
+
+static inline unsigned recordSize(unsigned len) {
+    return (sizeof(EventRecord) + len + 7) & ~7U;
+}
+
+
+////////////////////////////// EventRecorder ////////////////////////////////////////
+
+// all public, private to EventRecorder
+class EventRecorder_impl {
+public:
+    EventRecorder_impl(const std::string &file, unsigned chunkSize) :
+            file_(file),
+            chunkSize_(chunkSize < 4096 ? 4096 : chunkSize),
+            start_(mecTimeNow()),
+            pos_(0),
+            count_(0),
+#ifndef WIN32
+            fd_(-1),
+            base_(nullptr),
+            size_(0)
+#else
+            fp_(nullptr)
+#endif
+    {
+        ;
+    }
+
+    ~EventRecorder_impl() {
+        close();
+    }
+
+#ifndef WIN32
+
+    bool open() {
+        fd_ = ::open(file_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            LOG_0("EventRecorder: unable to open " << file_);
+            return false;
+        }
+        return map(chunkSize_);
+    }
+
+    void close() {
+        if (fd_ < 0) return;
+        unmap();
+        if (::ftruncate(fd_, pos_) != 0) {
+            LOG_0("EventRecorder: unable to truncate " << file_);
+        }
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    bool isOpen() const { return fd_ >= 0 && base_ != nullptr; }
+
+    // space for n bytes at pos_, grows file if needed
+    unsigned char *reserve(unsigned n) {
+        if (base_ == nullptr) return nullptr;
+        if (pos_ + n > size_) {
+            size_t sz = size_ + (n > chunkSize_ ? n : chunkSize_);
+            unmap();
+            if (!map(sz)) {
+                close();
+                return nullptr;
+            }
+        }
+        return base_ + pos_;
+    }
+
+    bool map(size_t sz) {
+        if (::ftruncate(fd_, sz) != 0) {
+            LOG_0("EventRecorder: unable to size " << file_);
+            return false;
+        }
+        void *p = ::mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED) {
+            LOG_0("EventRecorder: unable to map " << file_);
+            return false;
+        }
+        base_ = static_cast<unsigned char *>(p);
+        size_ = sz;
+        return true;
+    }
+
+    void unmap() {
+        if (base_ == nullptr) return;
+        ::munmap(base_, size_);
+        base_ = nullptr;
+        size_ = 0;
+    }
+
+#else
+
+    bool open() {
+        fp_ = fopen(file_.c_str(), "wb");
+        if (fp_ == nullptr) {
+            LOG_0("EventRecorder: unable to open " << file_);
+            return false;
+        }
+        buf_.resize(chunkSize_);
+        return true;
+    }
+
+    void close() {
+        if (fp_ == nullptr) return;
+        flush();
+        fclose(fp_);
+        fp_ = nullptr;
+    }
+
+    bool isOpen() const { return fp_ != nullptr; }
+
+    // no mmap, so buffer and write a chunk at a time
+    // pos_ is position in file, buffered_ of it still in buf_
+    unsigned char *reserve(unsigned n) {
+        if (fp_ == nullptr) return nullptr;
+        if (buffered_ + n > buf_.size()) {
+            flush();
+            if (n > buf_.size()) buf_.resize(n);
+        }
+        return buf_.data() + buffered_;
+    }
+
+    void flush() {
+        if (buffered_ > 0) fwrite(buf_.data(), 1, buffered_, fp_);
+        buffered_ = 0;
+    }
+
+#endif
+
+    // commit n bytes written to reserved space
+    void commit(unsigned n) {
+        pos_ += n;
+#ifdef WIN32
+        buffered_ += n;
+#endif
+    }
+
+    std::string file_;
+    unsigned chunkSize_;
+    MecTime start_;
+    size_t pos_;
+    unsigned long long count_;
+#ifndef WIN32
+    int fd_;
+    unsigned char *base_;
+    size_t size_;
+#else
+    FILE *fp_;
+    std::vector<unsigned char> buf_;
+    size_t buffered_ = 0;
+#endif
+};
+
+
+EventRecorder::EventRecorder() {
+    ;
+}
+
+EventRecorder::~EventRecorder() {
+    close();
+}
+
+bool EventRecorder::open(const std::string &file, const std::string &device, unsigned chunkSize) {
+    close();
+    impl_.reset(new EventRecorder_impl(file, chunkSize));
+    if (!impl_->open()) {
+        impl_.reset();
+        return false;
+    }
+
+    RecordFileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic_, RECORD_MAGIC, sizeof(hdr.magic_));
+    hdr.version_ = RECORD_VERSION;
+    strncpy(hdr.device_, device.c_str(), sizeof(hdr.device_) - 1);
+    unsigned char *p = impl_->reserve(sizeof(hdr));
+    if (p == nullptr) {
+        impl_.reset();
+        return false;
+    }
+    memcpy(p, &hdr, sizeof(hdr));
+    impl_->commit(sizeof(hdr));
+    LOG_0("EventRecorder: recording " << device << " to " << file);
+    return true;
+}
+
+void EventRecorder::close() {
+    if (!impl_) return;
+    LOG_0("EventRecorder: recorded " << impl_->count_ << " events to " << impl_->file_);
+    impl_.reset();
+}
+
+bool EventRecorder::isOpen() const {
+    return impl_ && impl_->isOpen();
+}
+
+bool EventRecorder::record(unsigned type, const void *data, unsigned len) {
+    if (!impl_ || len > 0xFFFF) return false;
+    unsigned sz = recordSize(len);
+    unsigned char *p = impl_->reserve(sz);
+    if (p == nullptr) return false;
+    EventRecord *r = reinterpret_cast<EventRecord *>(p);
+    r->size_ = sz;
+    r->type_ = static_cast<uint16_t>(type);
+    r->len_ = static_cast<uint16_t>(len);
+    r->time_ = mecTimeNow() - impl_->start_;
+    memcpy(p + sizeof(EventRecord), data, len);
+    impl_->commit(sz);
+    impl_->count_++;
+    return true;
+}
+
+unsigned long long EventRecorder::count() const {
+    return impl_ ? impl_->count_ : 0;
+}
+
+
+////////////////////////////// EventReader ////////////////////////////////////////
+
+class EventReader_impl {
+public:
+    EventReader_impl() :
+            base_(nullptr), size_(0), pos_(0)
+#ifndef WIN32
+            , mapped_(false)
+#endif
+    {
+        ;
+    }
+
+    ~EventReader_impl() {
+#ifndef WIN32
+        if (mapped_) ::munmap(const_cast<unsigned char *>(base_), size_);
+#endif
+    }
+
+    bool load(const std::string &file) {
+#ifndef WIN32
+        int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(RecordFileHeader)) {
+            ::close(fd);
+            return false;
+        }
+        void *p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        base_ = static_cast<const unsigned char *>(p);
+        size_ = st.st_size;
+        mapped_ = true;
+#else
+        FILE *fp = fopen(file.c_str(), "rb");
+        if (fp == nullptr) return false;
+        unsigned char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) data_.insert(data_.end(), buf, buf + n);
+        fclose(fp);
+        if (data_.size() < sizeof(RecordFileHeader)) return false;
+        base_ = data_.data();
+        size_ = data_.size();
+#endif
+        return true;
+    }
+
+    const unsigned char *base_;
+    size_t size_;
+    size_t pos_;
+    std::string device_;
+#ifndef WIN32
+    bool mapped_;
+#else
+    std::vector<unsigned char> data_;
+#endif
+};
+
+EventReader::EventReader() {
+    ;
+}
+
+EventReader::~EventReader() {
+    close();
+}
+
+bool EventReader::open(const std::string &file) {
+    close();
+    impl_.reset(new EventReader_impl());
+    if (!impl_->load(file)) {
+        LOG_0("EventReader: unable to open " << file);
+        impl_.reset();
+        return false;
+    }
+
+    RecordFileHeader hdr;
+    memcpy(&hdr, impl_->base_, sizeof(hdr));
+    if (memcmp(hdr.magic_, RECORD_MAGIC, sizeof(hdr.magic_)) != 0 || hdr.version_ != RECORD_VERSION) {
+        LOG_0("EventReader: not a mec recording (or wrong version) " << file);
+        impl_.reset();
+        return false;
+    }
+    hdr.device_[sizeof(hdr.device_) - 1] = 0;
+    impl_->device_ = hdr.device_;
+    rewind();
+    return true;
+}
+
+void EventReader::close() {
+    impl_.reset();
+}
+
+bool EventReader::isOpen() const {
+    return impl_ != nullptr;
+}
+
+const std::string &EventReader::device() const {
+    static const std::string none;
+    return impl_ ? impl_->device_ : none;
+}
+
+const EventRecord *EventReader::next() {
+    if (!impl_) return nullptr;
+    size_t remain = impl_->size_ - impl_->pos_;
+    if (remain < sizeof(EventRecord)) return nullptr;
+    const EventRecord *r = reinterpret_cast<const EventRecord *>(impl_->base_ + impl_->pos_);
+    if (r->size_ > remain || r->size_ < recordSize(r->len_)) {
+        LOG_0("EventReader: corrupt record, at " << impl_->pos_);
+        impl_->pos_ = impl_->size_;
+        return nullptr;
+    }
+    impl_->pos_ += r->size_;
+    return r;
+}
+
+void EventReader::rewind() {
+    if (impl_) impl_->pos_ = sizeof(RecordFileHeader);
+}
+
+}
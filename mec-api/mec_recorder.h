@@ -0,0 +1,74 @@
+#ifndef MEC_RECORDER_H
+#define MEC_RECORDER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "mec_stats.h"
+
+namespace mec {
+
+// binary recording of raw device input, so it can be replayed without the device (see ReplayDevice)
+// enabled per device with "record" : "file" in mec.json
+//
+// file : header (inc. device name), followed by records, each 8 byte aligned
+// the file is memory mapped and grown in chunks, so recording an event is a memcpy, not a system call
+// each device has its own recorder, and records only on its input thread, so there is no locking
+// note: files are in native byte order
+
+struct EventRecord {
+    uint32_t size_;  // of whole record, inc. header and padding
+    uint16_t type_;  // device specific
+    uint16_t len_;   // of data
+    uint64_t time_;  // ns since recording started
+
+    const void *data() const { return this + 1; }
+
+    // data as device specific struct, nullptr if record is too short
+    template<typename T>
+    const T *as() const { return len_ >= sizeof(T) ? static_cast<const T *>(data()) : nullptr; }
+};
+
+class EventRecorder_impl;
+
+class EventRecorder {
+public:
+    static const unsigned DEFAULT_CHUNK_SIZE = 4 * 1024 * 1024;
+
+    EventRecorder();
+    ~EventRecorder();
+    bool open(const std::string &file, const std::string &device, unsigned chunkSize = DEFAULT_CHUNK_SIZE);
+    void close(); // file is truncated to what was recorded
+    bool isOpen() const;
+    bool record(unsigned type, const void *data, unsigned len); // timestamped now
+
+    template<typename T>
+    bool record(unsigned type, const T &data) { return record(type, &data, sizeof(T)); }
+
+    unsigned long long count() const; // events recorded
+
+private:
+    std::unique_ptr<EventRecorder_impl> impl_;
+};
+
+class EventReader_impl;
+
+class EventReader {
+public:
+    EventReader();
+    ~EventReader();
+    bool open(const std::string &file);
+    void close();
+    bool isOpen() const;
+    const std::string &device() const; // device that was recorded
+    const EventRecord *next(); // nullptr at end (or at a corrupt record)
+    void rewind();
+
+private:
+    std::unique_ptr<EventReader_impl> impl_;
+};
+
+}
+
+#endif //MEC_RECORDER_H
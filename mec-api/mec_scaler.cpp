@@ -1,5 +1,10 @@
 #include "mec_scaler.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "mec_log.h"
+
 namespace mec {
 
 
@@ -39,15 +44,68 @@ bool Scales::init(const Preferences &p) {
 }
 
 const ScaleArray &Scales::getScale(const std::string &name) {
-    return scaleManager.scales_[name];
+    static const ScaleArray none;
+    auto it = scaleManager.scales_.find(name);
+    return it != scaleManager.scales_.end() ? it->second : none;
 }
 
 
-Scaler::Scaler() :
-        scale_(Scales::getScale("chromatic")),
-        tonic_(0.0f),
-        rowOffset_(0.0f), columnOffset_(0.0f) {
-    ;
+////////////////////////////// ScaleTable ////////////////////////////////////////
+
+// note at start of column ix (excluding offsets), and slope to next column
+// see notes in header, important 12 note scale has 13 entries!
+static void scaleColumn(const ScaleArray &scale, int ix, float &note, float &slope) {
+    int sz = (int) scale.size() - 1;
+    if (sz < 1) {
+        // no scale, treat as chromatic
+        note = (float) ix;
+        slope = 1.0f;
+        return;
+    }
+    int n = ix % sz;
+    int octave = ix / sz;
+    if (n < 0) {
+        n += sz;
+        octave--;
+    }
+    note = (octave * scale[sz]) + scale[n];
+    slope = scale[n + 1] - scale[n];
+}
+
+ScaleTable::ScaleTable(const ScaleArray &scale, float tonic, float rowOffset, float columnOffset) :
+        scale_(scale),
+        tonic_(tonic),
+        rowOffset_(rowOffset),
+        columnOffset_(columnOffset) {
+    for (unsigned ix = 0; ix < N_COLUMNS; ix++) {
+        float note;
+        scaleColumn(scale_, ix, note, slope_[ix]);
+        base_[ix] = columnOffset_ + tonic_ + note;
+    }
+}
+
+void ScaleTable::column(int ix, float &base, float &slope) const {
+    if (ix >= 0 && ix < (int) N_COLUMNS) {
+        base = base_[ix];
+        slope = slope_[ix];
+        return;
+    }
+    float note;
+    scaleColumn(scale_, ix, note, slope);
+    base = columnOffset_ + tonic_ + note;
+}
+
+static inline int columnIndex(float c) {
+    // truncation is floor for +ve, which is all the table covers
+    return c >= 0.0f ? (int) c : (int) std::floor(c);
+}
+
+
+////////////////////////////// Scaler ////////////////////////////////////////
+
+Scaler::Scaler() : epoch_(0) {
+    current_.reset(new ScaleTable(Scales::getScale("chromatic"), 0.0f, 0.0f, 0.0f));
+    table_.store(current_.get(), std::memory_order_release);
 }
 
 Scaler::~Scaler() {
@@ -57,72 +115,137 @@ Scaler::~Scaler() {
 bool Scaler::load(const Preferences &prefs) {
     if (!prefs.valid()) return false;
 
-    scale_ = Scales::getScale(prefs.getString("scale", "major"));
-    tonic_ = (float) prefs.getDouble("tonic", 0.0f);
-    rowOffset_ = (float) prefs.getDouble("row offset", 0.0f);
-    columnOffset_ = (float) prefs.getDouble("column offset", 0.0f);
+    std::string name = prefs.getString("scale", "major");
+    const ScaleArray &scale = Scales::getScale(name);
+    if (scale.size() < 2) {
+        LOG_0("Scaler: unknown scale " << name);
+        return false;
+    }
 
+    set(scale,
+        (float) prefs.getDouble("tonic", 0.0f),
+        (float) prefs.getDouble("row offset", 0.0f),
+        (float) prefs.getDouble("column offset", 0.0f));
     return true;
 }
 
 MusicalTouch Scaler::map(const Touch &t) const {
-    // see notes above, important 12 note scale has 13 entries!
-    // think , row = string , column = fret
-    int ix = (int) t.c_;
-    int sz = (int) scale_.size() - 1;
-    int n = ix % sz;
-
-    float fx = t.c_ - ix;
-
-    float sn0 = scale_[n];
-    float sn1 = scale_[n + 1];
-
-    float sn = sn0 + ((sn1 - sn0) * fx);
-
-    float note = ((ix / sz) * scale_[sz]) + sn;
-
-    note = columnOffset_ + (t.r_ * rowOffset_) + tonic_ + note;
-
-    return MusicalTouch(t, note);
+    return MusicalTouch(t, note(t.r_, t.c_));
+}
+
+float Scaler::note(float r, float c) const {
+    const ScaleTable *t = table();
+    int ix = columnIndex(c);
+    float base, slope;
+    t->column(ix, base, slope);
+    return base + (slope * (c - ix)) + (r * t->rowOffset_);
+}
+
+void Scaler::mapBatch(const Touch *in, MusicalTouch *out, unsigned n) const {
+    // same table for whole batch, so a concurrent change applies to all or none of it
+    const ScaleTable *t = table();
+    const float rowOffset = t->rowOffset_;
+
+    // table lookups are gathers, so are done first, then interpolation is a straight loop over arrays
+    // which the compiler can vectorise (sse/neon)
+    static const unsigned CHUNK = 16;
+    float base[CHUNK], slope[CHUNK], fx[CHUNK], r[CHUNK], note[CHUNK];
+    for (unsigned i = 0; i < n; i += CHUNK) {
+        unsigned cn = std::min(CHUNK, n - i);
+        const Touch *src = in + i;
+        for (unsigned j = 0; j < cn; j++) {
+            int ix = columnIndex(src[j].c_);
+            t->column(ix, base[j], slope[j]);
+            fx[j] = src[j].c_ - ix;
+            r[j] = src[j].r_;
+        }
+        for (unsigned j = 0; j < cn; j++) {
+            note[j] = base[j] + (slope[j] * fx[j]) + (r[j] * rowOffset);
+        }
+        MusicalTouch *dest = out + i;
+        for (unsigned j = 0; j < cn; j++) {
+            static_cast<Touch &>(dest[j]) = src[j];
+            dest[j].note_ = note[j];
+        }
+    }
 }
 
+// getters lock, as a table is only safe to read from the mapping thread, or with writeLock_
 float Scaler::getTonic() const {
-    return tonic_;
+    std::lock_guard<std::mutex> lock(writeLock_);
+    return current_->tonic_;
 }
 
 float Scaler::getRowOffset() const {
-    return rowOffset_;
+    std::lock_guard<std::mutex> lock(writeLock_);
+    return current_->rowOffset_;
 }
 
 float Scaler::getColumnOffset() const {
-    return columnOffset_;
+    std::lock_guard<std::mutex> lock(writeLock_);
+    return current_->columnOffset_;
 }
 
-const ScaleArray &Scaler::getScale() const {
-    return scale_;
+ScaleArray Scaler::getScale() const {
+    std::lock_guard<std::mutex> lock(writeLock_);
+    return current_->scale_;
 }
 
-void Scaler::setTonic(float f) {
-    tonic_ = f;
+unsigned Scaler::retired() const {
+    std::lock_guard<std::mutex> lock(writeLock_);
+    return retired_.size();
 }
 
+void Scaler::setTonic(float f) {
+    std::lock_guard<std::mutex> lock(writeLock_);
+    const ScaleTable *t = current_.get();
+    publish(new ScaleTable(t->scale_, f, t->rowOffset_, t->columnOffset_));
+}
 
 void Scaler::setRowOffset(float f) {
-    rowOffset_ = f;
+    std::lock_guard<std::mutex> lock(writeLock_);
+    const ScaleTable *t = current_.get();
+    publish(new ScaleTable(t->scale_, t->tonic_, f, t->columnOffset_));
 }
 
-
 void Scaler::setColumnOffset(float f) {
-    columnOffset_ = f;
+    std::lock_guard<std::mutex> lock(writeLock_);
+    const ScaleTable *t = current_.get();
+    publish(new ScaleTable(t->scale_, t->tonic_, t->rowOffset_, f));
 }
 
-
 void Scaler::setScale(const ScaleArray &scale) {
-    scale_ = scale;
+    std::lock_guard<std::mutex> lock(writeLock_);
+    const ScaleTable *t = current_.get();
+    publish(new ScaleTable(scale, t->tonic_, t->rowOffset_, t->columnOffset_));
 }
 
 void Scaler::setScale(const std::string &name) {
-    scale_ = Scales::getScale(name);
+    const ScaleArray &scale = Scales::getScale(name);
+    if (scale.size() < 2) {
+        LOG_0("Scaler: unknown scale " << name);
+        return;
+    }
+    setScale(scale);
+}
+
+void Scaler::set(const ScaleArray &scale, float tonic, float rowOffset, float columnOffset) {
+    std::lock_guard<std::mutex> lock(writeLock_);
+    publish(new ScaleTable(scale, tonic, rowOffset, columnOffset));
+}
+
+// writeLock_ must be held
+void Scaler::publish(ScaleTable *table) {
+    std::unique_ptr<ScaleTable> old(current_.release());
+    current_.reset(table);
+    table_.store(table);
+
+    // the mapping thread may have loaded the old table, until its next quiescent()
+    unsigned long long epoch = epoch_.load();
+    retired_.push_back(Retired{std::move(old), epoch});
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                  [epoch](const Retired &r) { return r.epoch_ < epoch; }),
+                   retired_.end());
 }
 
 
@@ -4,18 +4,20 @@
 #include "mec_prefs.h"
 #include "mec_api.h"
 
-#include <vector>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
-// NOT USED YET INTERFACE EXPERIMENT ONLY
-// 
 // Scaler is used to map a surface to a musical output .. notes
+// used by output surfaces (see mec_surface.h), with a 'scaler' definition
 // e.g. r/c  to note
 
 // row/column
 // consider ROW as a guitar string (so string N is offset N* rowOffset)
 // consider columns as a positon (like a fret) on that string. (its fretless, i.e. fractional position)
-// note: presently linear interp between scale positions
+// note: presently linear interp between scale positions, precomputed per column (see ScaleTable)
 
 // scale can be chromatic or not, intervales are determined in float
 // e.g.
@@ -40,7 +42,7 @@ public:
     bool load(const Preferences &prefs);
 
     // static/singleton interface
-    static const ScaleArray &getScale(const std::string &name);
+    static const ScaleArray &getScale(const std::string &name); // empty if unknown
     static bool init(const Preferences &);
 
 private:
@@ -48,18 +50,52 @@ private:
 };
 
 
+// scaler settings, with the note at each column precomputed
+// immutable once published, see Scaler
+struct ScaleTable {
+    static const unsigned N_COLUMNS = 128; // columns outside this are calculated
+
+    ScaleTable(const ScaleArray &scale, float tonic, float rowOffset, float columnOffset);
+
+    // note (inc. tonic and column offset) at start of column ix, and slope to next
+    void column(int ix, float &base, float &slope) const;
+
+    ScaleArray scale_;
+    float tonic_;
+    float rowOffset_;
+    float columnOffset_;
+
+    float base_[N_COLUMNS];
+    float slope_[N_COLUMNS];
+};
+
+
+// settings can be changed at any time (e.g. key change from kontrol) from any thread,
+// a new table is built and swapped in atomically, so map()/mapBatch() never lock
+// a replaced table may still be in use by a mapping, so it is only freed (on a later change)
+// once the mapping thread has called quiescent(), i.e. it holds no table
+// map()/note()/mapBatch() are for a single mapping thread (e.g. MecApi::process)
 class Scaler {
 public:
     Scaler();
     virtual ~Scaler();
+    Scaler(const Scaler &) = delete;
+    Scaler &operator=(const Scaler &) = delete;
+
     bool load(const Preferences &prefs);
 
     virtual MusicalTouch map(const Touch &t) const;
+    float note(float r, float c) const; // as map, without constructing a touch
+    void mapBatch(const Touch *in, MusicalTouch *out, unsigned n) const;
+
+    // mapping thread, between mappings, allows replaced tables to be freed
+    void quiescent() const { epoch_.fetch_add(1); }
+    unsigned retired() const; // replaced tables not yet freed
 
     float getTonic() const;
     float getRowOffset() const;
     float getColumnOffset() const;
-    const ScaleArray &getScale() const;
+    ScaleArray getScale() const;
 
     void setTonic(float);
     void setRowOffset(float);
@@ -68,14 +104,26 @@ public:
     void setScale(const ScaleArray &scale);
     void setScale(const std::string &name);
 
-private:
-    float tonic_;
-    float rowOffset_;
-    float columnOffset_;
+    // change everything at once, e.g. key change
+    void set(const ScaleArray &scale, float tonic, float rowOffset, float columnOffset);
 
-    ScaleArray scale_;
+private:
+    const ScaleTable *table() const { return table_.load(std::memory_order_acquire); }
+    void publish(ScaleTable *);
+
+    // replaced table, and the mapping epoch when it was replaced
+    struct Retired {
+        std::unique_ptr<ScaleTable> table_;
+        unsigned long long epoch_;
+    };
+
+    std::atomic<const ScaleTable *> table_;
+    mutable std::atomic<unsigned long long> epoch_; // quiescent count of the mapping thread
+    mutable std::mutex writeLock_; // setters and getters
+    std::unique_ptr<ScaleTable> current_;
+    std::vector<Retired> retired_;
 };
 
 }
 
-#endif //MEC_SCALER_H
\ No newline at end of file
+#endif //MEC_SCALER_H
@@ -0,0 +1,175 @@
+#ifndef MEC_SPSC_QUEUE_H
+#define MEC_SPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+
+namespace mec {
+
+// single producer / single consumer lock free queue
+// - one thread (e.g. device/usb thread) calls push
+// - one thread (e.g. MecApi::process) calls pop
+// capacity is rounded up to a power of 2, so indexes can be masked
+// read/write indexes are free running, and live on separate cache lines
+// so producer and consumer dont fight over the same line
+// on overflow, the item is dropped and counted (no logging, as that would stall producer)
+
+static const unsigned MEC_CACHE_LINE_SIZE = 64;
+
+template<typename T>
+class SpscQueue {
+public:
+    static const unsigned DEFAULT_CAPACITY = 512;
+
+    SpscQueue(unsigned capacity = DEFAULT_CAPACITY) : overflows_(0) {
+        writePtr_.store(0);
+        readPtr_.store(0);
+        setCapacity(capacity);
+    }
+
+    // not thread safe, call before producer/consumer are started
+    void setCapacity(unsigned capacity) {
+        unsigned sz = 2;
+        while (sz < capacity) sz <<= 1;
+        queue_.resize(sz);
+        mask_ = sz - 1;
+        writePtr_.store(0);
+        readPtr_.store(0);
+    }
+
+    unsigned capacity() const { return mask_ + 1; }
+
+    // producer
+    bool push(const T &v) {
+        unsigned wp = writePtr_.load(std::memory_order_relaxed);
+        if (wp - readPtr_.load(std::memory_order_acquire) > mask_) {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        queue_[wp & mask_] = v;
+        writePtr_.store(wp + 1, std::memory_order_release);
+        return true;
+    }
+
+    // producer, as above, but also reports if the consumer had caught up (i.e. queue was empty)
+    // so a sleeping consumer can be woken. the fence pairs with a seq_cst fence on the consumer side
+    // before it checks isEmpty() and sleeps, so either it sees this item, or we see it caught up
+    bool push(const T &v, bool &wasEmpty) {
+        wasEmpty = false;
+        unsigned wp = writePtr_.load(std::memory_order_relaxed);
+        if (wp - readPtr_.load(std::memory_order_acquire) > mask_) {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        queue_[wp & mask_] = v;
+        writePtr_.store(wp + 1, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wasEmpty = readPtr_.load(std::memory_order_relaxed) == wp;
+        return true;
+    }
+
+    // producer, fill the next item in place (rather than copying it in), then publish() it
+    // nullptr if full, counted as an overflow
+    T *back() {
+        unsigned wp = writePtr_.load(std::memory_order_relaxed);
+        if (wp - readPtr_.load(std::memory_order_acquire) > mask_) {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &queue_[wp & mask_];
+    }
+
+    // producer, wasEmpty as for push
+    void publish(bool &wasEmpty) {
+        unsigned wp = writePtr_.load(std::memory_order_relaxed);
+        writePtr_.store(wp + 1, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wasEmpty = readPtr_.load(std::memory_order_relaxed) == wp;
+    }
+
+    void publish() {
+        writePtr_.store(writePtr_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // producer, n items at once, so the consumer sees all of them or none
+    // reserve(n), fill slot(0) .. slot(n-1), then publish(n)
+    // reserve is false if there is not space for all n, counted as n overflows
+    bool reserve(unsigned n) {
+        unsigned wp = writePtr_.load(std::memory_order_relaxed);
+        if (wp - readPtr_.load(std::memory_order_acquire) + n > mask_ + 1) {
+            overflows_.fetch_add(n, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    T *slot(unsigned i) {
+        return &queue_[(writePtr_.load(std::memory_order_relaxed) + i) & mask_];
+    }
+
+    void publish(unsigned n, bool &wasEmpty) {
+        unsigned wp = writePtr_.load(std::memory_order_relaxed);
+        writePtr_.store(wp + n, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wasEmpty = readPtr_.load(std::memory_order_relaxed) == wp;
+    }
+
+    void publish(unsigned n) {
+        writePtr_.store(writePtr_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    // consumer
+    bool pop(T &v) {
+        unsigned rp = readPtr_.load(std::memory_order_relaxed);
+        if (rp == writePtr_.load(std::memory_order_acquire)) return false;
+        v = queue_[rp & mask_];
+        readPtr_.store(rp + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer, access next item in place, release it with popFront()
+    const T *front() const {
+        unsigned rp = readPtr_.load(std::memory_order_relaxed);
+        if (rp == writePtr_.load(std::memory_order_acquire)) return nullptr;
+        return &queue_[rp & mask_];
+    }
+
+    void popFront() {
+        readPtr_.store(readPtr_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // consumer, discard everything queued
+    void flush() {
+        readPtr_.store(writePtr_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    unsigned pending() const {
+        return writePtr_.load(std::memory_order_acquire) - readPtr_.load(std::memory_order_acquire);
+    }
+
+    unsigned available() const { return capacity() - pending(); }
+
+    bool isEmpty() const { return pending() == 0; }
+
+    bool isFull() const { return available() == 0; }
+
+    unsigned long overflows() const { return overflows_.load(std::memory_order_relaxed); }
+
+    void resetOverflows() { overflows_.store(0, std::memory_order_relaxed); }
+
+private:
+    // producer owned
+    std::atomic<unsigned> writePtr_;
+    std::atomic<unsigned long> overflows_;
+    char pad1_[MEC_CACHE_LINE_SIZE];
+    // consumer owned
+    std::atomic<unsigned> readPtr_;
+    char pad2_[MEC_CACHE_LINE_SIZE];
+    // shared, read only once running
+    unsigned mask_;
+    std::vector<T> queue_;
+};
+
+}
+
+#endif //MEC_SPSC_QUEUE_H
@@ -0,0 +1,134 @@
+#ifndef MEC_STATS_H
+#define MEC_STATS_H
+
+#include <atomic>
+#include <chrono>
+
+namespace mec {
+
+// monotonic time in nanoseconds, used to timestamp events as they pass thru mec
+// note: device hardware timestamps use their own clocks (and epochs), so are not comparable with this
+typedef unsigned long long MecTime;
+
+inline MecTime mecTimeNow() {
+    return static_cast<MecTime>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+
+// copy of a histogram, safe to inspect at leisure
+// bucket 0 : < 1us , bucket i : [2^(i-1), 2^i) us, last bucket also holds anything larger
+struct LatencySnapshot {
+    static const unsigned N_BUCKETS = 24;
+
+    unsigned long long count_;
+    unsigned long long totalUs_;
+    unsigned long long maxUs_;
+    unsigned long long buckets_[N_BUCKETS];
+
+    double meanUs() const { return count_ > 0 ? double(totalUs_) / double(count_) : 0.0; }
+
+    // upper bound (in us) of bucket containing the p'th percentile (0..1)
+    unsigned long long percentileUs(double p) const {
+        if (count_ == 0) return 0;
+        unsigned long long target = static_cast<unsigned long long>(p * double(count_));
+        unsigned long long n = 0;
+        for (unsigned i = 0; i < N_BUCKETS; i++) {
+            n += buckets_[i];
+            if (n > target) return (1ULL << i);
+        }
+        return maxUs_;
+    }
+};
+
+
+// log2 histogram of latencies (in us)
+// lock free, and single writer : each stage is only ever recorded by one thread (device or process thread)
+// so counters are updated with relaxed load/store, rather than (more expensive) atomic read-modify-write
+// readers (e.g. MecApi::stats) may be on any thread
+class LatencyHistogram {
+public:
+    static const unsigned N_BUCKETS = LatencySnapshot::N_BUCKETS;
+
+    LatencyHistogram() { reset(); }
+
+    void record(MecTime from, MecTime to) {
+        unsigned long long us = to > from ? (to - from) / 1000 : 0;
+        inc(buckets_[bucket(us)], 1);
+        inc(count_, 1);
+        inc(totalUs_, us);
+        if (us > maxUs_.load(std::memory_order_relaxed)) maxUs_.store(us, std::memory_order_relaxed);
+    }
+
+    void snapshot(LatencySnapshot &s) const {
+        s.count_ = count_.load(std::memory_order_relaxed);
+        s.totalUs_ = totalUs_.load(std::memory_order_relaxed);
+        s.maxUs_ = maxUs_.load(std::memory_order_relaxed);
+        for (unsigned i = 0; i < N_BUCKETS; i++) s.buckets_[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+
+    // note: a concurrent record() may be partially lost
+    void reset() {
+        count_.store(0);
+        totalUs_.store(0);
+        maxUs_.store(0);
+        for (unsigned i = 0; i < N_BUCKETS; i++) buckets_[i].store(0);
+    }
+
+    static unsigned bucket(unsigned long long us) {
+        unsigned b = 0;
+        while (us > 0 && b < N_BUCKETS - 1) {
+            us >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+private:
+    static void inc(std::atomic<unsigned long long> &v, unsigned long long n) {
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<unsigned long long> count_;
+    std::atomic<unsigned long long> totalUs_;
+    std::atomic<unsigned long long> maxUs_;
+    std::atomic<unsigned long long> buckets_[N_BUCKETS];
+};
+
+
+// latency stages of an event from a device
+// DEVICE   : arrival at device handler -> enqueued (device processing e.g. voice allocation), device thread
+// QUEUE    : enqueued -> dequeued by MecApi::process
+// DELIVERY : dequeued -> all callbacks returned (e.g. midi sent)
+// TOTAL    : arrival at device handler -> all callbacks returned
+class LatencyStats {
+public:
+    enum Stage {
+        DEVICE,
+        QUEUE,
+        DELIVERY,
+        TOTAL,
+        N_STAGES
+    };
+
+    static const char *stageName(Stage s) {
+        static const char *names[N_STAGES] = {"device", "queue", "delivery", "total"};
+        return s < N_STAGES ? names[s] : "unknown";
+    }
+
+    void record(Stage s, MecTime from, MecTime to) { stages_[s].record(from, to); }
+
+    const LatencyHistogram &stage(Stage s) const { return stages_[s]; }
+
+    void reset() {
+        for (unsigned i = 0; i < N_STAGES; i++) stages_[i].reset();
+    }
+
+private:
+    LatencyHistogram stages_[N_STAGES];
+};
+
+}
+
+#endif //MEC_STATS_H
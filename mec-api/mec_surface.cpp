@@ -1,16 +1,74 @@
 #include "mec_surface.h"
 
 
-// NOT USED YET INTERFACE EXPERIMENT ONLY
 //
 // mapping between surfaces
 //
 
 #include "mec_log.h"
 
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
 
 namespace mec {
 
+////////////////////////////// SurfaceRegistry ////////////////////////////////////////
+
+static std::mutex registryMutex;
+static std::unordered_map<std::string, SurfaceID> registryIds;
+static std::deque<std::string> registryNames; // deque, so references stay valid
+
+SurfaceID SurfaceRegistry::intern(const std::string &name) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto it = registryIds.find(name);
+    if (it != registryIds.end()) return it->second;
+    SurfaceID id = registryNames.size();
+    registryNames.push_back(name);
+    registryIds[name] = id;
+    return id;
+}
+
+const std::string &SurfaceRegistry::name(SurfaceID id) {
+    static const std::string unknown;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return id < registryNames.size() ? registryNames[id] : unknown;
+}
+
+
+static const char *axisNames[SurfaceNode::N_AXES] = {"x", "y", "z", "r", "c"};
+
+static float &axisValue(Touch &t, unsigned axis) {
+    switch (axis) {
+        case Surface::C_Y :
+            return t.y_;
+        case Surface::C_Z :
+            return t.z_;
+        case Surface::C_R :
+            return t.r_;
+        case Surface::C_C :
+            return t.c_;
+        case Surface::C_X :
+        default:
+            return t.x_;
+    }
+}
+
+////////////////////////////// SurfaceNode ////////////////////////////////////////
+
+SurfaceNode::SurfaceNode() :
+        type_(S_PLAIN),
+        transform_(false),
+        splitAxis_(Surface::C_X), splitPoint_(1.0f),
+        join_(-1), joinAxis_(Surface::C_X), joinOffset_(0.0f),
+        scaler_(nullptr) {
+    for (unsigned a = 0; a < N_AXES; a++) {
+        scale_[a] = 1.0f;
+        offset_[a] = 0.0f;
+    }
+}
+
 
 ////////////////////////////// SurfaceManager ////////////////////////////////////////
 
@@ -24,46 +82,177 @@ SurfaceManager::~SurfaceManager() {
 }
 
 bool SurfaceManager::init(const Preferences &prefs) {
-    if (!prefs.valid()) return false;
+    return init(prefs, std::vector<SurfaceID>());
+}
 
-    std::vector<std::string> keys = prefs.getKeys();
-    for (std::string k : keys) {
-        Preferences p(prefs.getSubTree(k));
-        if (p.valid()) {
-            std::shared_ptr<Surface> pS;
-            std::string type = p.getString("type", "");
-            if (type.size() == 0) { // plain
-                pS.reset(new Surface(k));
-            } else if (type == "join") {
-                pS.reset(new JoinedSurface(k));
-            } else if (type == "split") {
-                pS.reset(new SplitSurface(k));
-            } else {
-                pS.reset();
-                LOG_0("SurfaceManager: surface def missing type");
-            }
-            if (pS) {
-                if (pS->load(p)) {
-                    surfaces_[k] = pS;
+bool SurfaceManager::init(const Preferences &prefs, const std::vector<SurfaceID> &inputs) {
+    surfaces_.clear();
+    nodes_.clear();
+    index_.clear();
+
+    if (prefs.valid()) {
+        std::vector<std::string> keys = prefs.getKeys();
+        for (std::string k : keys) {
+            Preferences p(prefs.getSubTree(k));
+            if (p.valid()) {
+                std::shared_ptr<Surface> pS;
+                std::string type = p.getString("type", "");
+                SurfaceID id = SurfaceRegistry::intern(k);
+                if (type.size() == 0) { // plain
+                    pS.reset(new Surface(id));
+                } else if (type == "join") {
+                    pS.reset(new JoinedSurface(id));
+                } else if (type == "split") {
+                    pS.reset(new SplitSurface(id));
                 } else {
                     pS.reset();
+                    LOG_0("SurfaceManager: surface def missing type");
+                }
+                if (pS) {
+                    if (pS->load(p)) {
+                        add(pS);
+                    } else {
+                        LOG_0("SurfaceManager: invalid surface def " << k);
+                        pS.reset();
+                    }
                 }
             }
         }
     }
-    return true;
+
+    // surfaces referred to, but not defined, are plain surfaces
+    std::vector<std::pair<SurfaceID, SurfaceID>> edges;
+    for (unsigned i = 0; i < surfaces_.size(); i++) {
+        surfaces_[i]->edges(edges);
+    }
+    for (auto e : edges) {
+        if (index(e.first) < 0) add(std::make_shared<Surface>(e.first));
+        if (index(e.second) < 0) add(std::make_shared<Surface>(e.second));
+    }
+    for (auto i : inputs) {
+        if (index(i) < 0) add(std::make_shared<Surface>(i));
+    }
+
+    order();
+    compile();
+    return prefs.valid();
 }
 
 std::shared_ptr<Surface> SurfaceManager::getSurface(SurfaceID id) {
-    return surfaces_[id];
+    int idx = index(id);
+    return idx < 0 ? nullptr : surfaces_[idx];
+}
+
+SurfaceID SurfaceManager::id(int idx) const {
+    return surfaces_[idx]->id();
+}
+
+void SurfaceManager::quiescent() const {
+    for (const SurfaceNode &n : nodes_) {
+        if (n.scaler_ != nullptr) n.scaler_->quiescent();
+    }
+}
+
+int SurfaceManager::route(int idx, float *v) const {
+    for (;;) {
+        const SurfaceNode &n = nodes_[idx];
+        if (n.transform_) {
+            for (unsigned a = 0; a < SurfaceNode::N_AXES; a++) {
+                v[a] = (v[a] * n.scale_[a]) + n.offset_[a];
+            }
+        }
+        if (n.type_ == SurfaceNode::S_SPLIT) {
+            float f = v[n.splitAxis_] / n.splitPoint_;
+            unsigned last = n.split_.size() - 1;
+            unsigned s = f <= 0.0f ? 0 : (f >= float(last) ? last : static_cast<unsigned>(f));
+            v[n.splitAxis_] -= n.splitPoint_ * s;
+            idx = n.split_[s];
+        } else if (n.join_ >= 0) {
+            v[n.joinAxis_] += n.joinOffset_;
+            idx = n.join_;
+        } else {
+            return idx;
+        }
+    }
+}
+
+int SurfaceManager::add(std::shared_ptr<Surface> surface) {
+    int idx = surfaces_.size();
+    surfaces_.push_back(surface);
+    if (surface->id() >= index_.size()) index_.resize(surface->id() + 1, -1);
+    index_[surface->id()] = idx;
+    return idx;
+}
+
+// topological sort, so surfaces only route to surfaces with a higher index
+void SurfaceManager::order() {
+    unsigned sz = surfaces_.size();
+    std::vector<std::pair<SurfaceID, SurfaceID>> edges;
+    for (unsigned i = 0; i < sz; i++) {
+        surfaces_[i]->edges(edges);
+    }
+
+    std::vector<std::vector<int>> out(sz);
+    std::vector<unsigned> in(sz, 0);
+    for (auto e : edges) {
+        int from = index(e.first);
+        int to = index(e.second);
+        if (from < 0 || to < 0 || from == to) continue;
+        out[from].push_back(to);
+        in[to]++;
+    }
+
+    std::vector<int> ordered;
+    for (unsigned i = 0; i < sz; i++) {
+        if (in[i] == 0) ordered.push_back(i);
+    }
+    for (unsigned k = 0; k < ordered.size(); k++) {
+        for (int to : out[ordered[k]]) {
+            if (--in[to] == 0) ordered.push_back(to);
+        }
+    }
+    for (unsigned i = 0; i < sz; i++) {
+        if (in[i] > 0) {
+            // compile will ignore routes that go backwards
+            LOG_0("SurfaceManager: surface " << SurfaceRegistry::name(surfaces_[i]->id()) << " is part of a cycle");
+            ordered.push_back(i);
+        }
+    }
+
+    std::vector<std::shared_ptr<Surface>> surfaces;
+    surfaces.swap(surfaces_);
+    index_.assign(index_.size(), -1);
+    for (int i : ordered) {
+        add(surfaces[i]);
+    }
+}
+
+void SurfaceManager::compile() {
+    nodes_.assign(surfaces_.size(), SurfaceNode());
+    for (unsigned i = 0; i < surfaces_.size(); i++) {
+        surfaces_[i]->compile(*this, nodes_, i);
+    }
+
+    // only output surfaces are scaled
+    for (unsigned i = 0; i < nodes_.size(); i++) {
+        SurfaceNode &n = nodes_[i];
+        if (n.scaler_ != nullptr && (n.type_ == SurfaceNode::S_SPLIT || n.join_ >= 0)) {
+            LOG_0("SurfaceManager: scaler ignored, " << SurfaceRegistry::name(surfaces_[i]->id()) << " is not an output surface");
+            n.scaler_ = nullptr;
+        }
+    }
 }
 
 ////////////////////////////// Surface ////////////////////////////////////////
 
 
 Surface::Surface(SurfaceID surfaceId) :
-        surfaceId_(surfaceId) {
-    ;
+        surfaceId_(surfaceId),
+        transform_(false) {
+    for (unsigned a = 0; a < SurfaceNode::N_AXES; a++) {
+        scale_[a] = 1.0f;
+        offset_[a] = 0.0f;
+    }
 }
 
 Surface::~Surface() {
@@ -71,21 +260,68 @@ Surface::~Surface() {
 }
 
 bool Surface::load(const Preferences &prefs) {
-    return prefs.valid();
+    if (!prefs.valid()) return false;
+
+    if (prefs.exists("transform")) {
+        // e.g. "transform" : { "c scale" : 2.0, "c offset" : 60.0 }
+        Preferences t(prefs.getSubTree("transform"));
+        if (t.valid()) {
+            transform_ = true;
+            for (unsigned a = 0; a < SurfaceNode::N_AXES; a++) {
+                std::string n = axisNames[a];
+                scale_[a] = (float) t.getDouble(n + " scale", 1.0);
+                offset_[a] = (float) t.getDouble(n + " offset", 0.0);
+            }
+        }
+    }
+
+    if (prefs.exists("scaler")) {
+        std::shared_ptr<Scaler> scaler = std::make_shared<Scaler>();
+        if (scaler->load(Preferences(prefs.getSubTree("scaler"))) && scaler->getScale().size() > 1) {
+            scaler_ = scaler;
+        } else {
+            LOG_0("Surface: invalid scaler for " << SurfaceRegistry::name(surfaceId_));
+        }
+    }
+    return true;
 }
 
 Touch Surface::map(const Touch &t) const {
-    return t;
+    return transform(t);
+}
+
+Touch Surface::transform(const Touch &t) const {
+    Touch out = t;
+    if (transform_) {
+        for (unsigned a = 0; a < SurfaceNode::N_AXES; a++) {
+            float &v = axisValue(out, a);
+            v = (v * scale_[a]) + offset_[a];
+        }
+    }
+    return out;
+}
+
+void Surface::compile(const SurfaceManager &, std::vector<SurfaceNode> &nodes, int idx) const {
+    SurfaceNode &n = nodes[idx];
+    n.transform_ = transform_;
+    for (unsigned a = 0; a < SurfaceNode::N_AXES; a++) {
+        n.scale_[a] = scale_[a];
+        n.offset_[a] = offset_[a];
+    }
+    n.scaler_ = scaler_.get();
 }
 
 SurfaceID Surface::getId() {
     return surfaceId_;
 }
 
+Surface::Axis Surface::axis(const std::string &name) {
+    for (unsigned a = 0; a < SurfaceNode::N_AXES; a++) {
+        if (name == axisNames[a]) return static_cast<Axis>(a);
+    }
+    return C_X;
+}
 
-//const float UNDEFINED_SPLIT = -1.0f;
-//const float MIN_SPLIT = 0.0f;
-//const float MAX_SPLIT = 16384.0f;
 
 ////////////////////////////// SplitSurface ////////////////////////////////////////
 
@@ -101,30 +337,23 @@ SplitSurface::~SplitSurface() {
 
 bool SplitSurface::load(const Preferences &prefs) {
 
-    if (!prefs.valid()) return false;
+    if (!Surface::load(prefs)) return false;
 
     splitPoint_ = (float) prefs.getDouble("split point", 0.5);
+    if (splitPoint_ <= 0.0f) {
+        LOG_0("SplitSurface : split point must be > 0");
+        return false;
+    }
 
     Preferences::Array array(prefs.getArray("surfaces"));
     for (unsigned i = 0; i < array.getSize(); i++) {
-        SurfaceID n = array.getString(i);
+        std::string n = array.getString(i);
         if (n.size() > 0) {
-            surfaces_.push_back(n);
+            surfaces_.push_back(SurfaceRegistry::intern(n));
         }
     }
 
-    std::string axis = prefs.getString("axis", "");
-    if (axis.size() > 0) {
-        if (axis == "x") axis_ = C_X;
-        else if (axis == "y") axis_ = C_Y;
-        else if (axis == "z") axis_ = C_Z;
-        else if (axis == "r") axis_ = C_R;
-        else if (axis == "c") axis_ = C_C;
-        else axis_ = C_X;
-    } else {
-        axis_ = C_X;
-    }
-
+    axis_ = axis(prefs.getString("axis", "x"));
 
     return surfaces_.size() > 0;
 }
@@ -133,48 +362,39 @@ Touch SplitSurface::map(const Touch &t) const {
     // TODO
     // relationship between X-C , Y - R
     // touch id, needs to be voiced on surface
-    Touch out = t;
-    unsigned n = 0;
-
-    switch (axis_) {
-        case C_X: {
-            n = static_cast<unsigned>(t.x_ / splitPoint_);
-            n = std::min<unsigned>(n, surfaces_.size() - 1);
-            out.x_ = t.x_ - (splitPoint_ * n);
-            break;
-        }
-        case C_Y: {
-            n = static_cast<unsigned>(static_cast<int>(t.y_ / splitPoint_));
-            n = std::min<unsigned>(n, surfaces_.size() - 1);
-            out.y_ = t.y_ - (splitPoint_ * n);
-            break;
-        }
-        case C_Z: {
-            n = static_cast<unsigned>(t.z_ / splitPoint_);
-            n = std::min<unsigned>(n, surfaces_.size() - 1);
-            out.z_ = t.z_ - (splitPoint_ * n);
-            break;
-        }
-        case C_R: {
-            n = static_cast<unsigned>(t.r_ / splitPoint_);
-            n = std::min<unsigned>(n, surfaces_.size() - 1);
-            out.r_ = t.r_ - (splitPoint_ * n);
-            break;
-        }
-        case C_C: {
-            n = static_cast<unsigned>(t.c_ / splitPoint_);
-            n = std::min<unsigned>(n, surfaces_.size() - 1);
-            out.c_ = t.c_ - (splitPoint_ * n);
-            break;
-        }
-        default:
-            LOG_0("SplitSurface : invalid axis");
-            break;
-    }
+    Touch out = transform(t);
+    float &v = axisValue(out, axis_);
+    float f = v / splitPoint_;
+    unsigned last = surfaces_.size() - 1;
+    unsigned n = f <= 0.0f ? 0 : (f >= float(last) ? last : static_cast<unsigned>(f));
+    v = v - (splitPoint_ * n);
     out.surface_ = surfaces_[n];
     return out;
 }
 
+void SplitSurface::edges(std::vector<std::pair<SurfaceID, SurfaceID>> &e) const {
+    for (SurfaceID s : surfaces_) {
+        e.push_back(std::make_pair(surfaceId_, s));
+    }
+}
+
+void SplitSurface::compile(const SurfaceManager &mgr, std::vector<SurfaceNode> &nodes, int idx) const {
+    Surface::compile(mgr, nodes, idx);
+    SurfaceNode &n = nodes[idx];
+    for (SurfaceID s : surfaces_) {
+        int target = mgr.index(s);
+        if (target <= idx) {
+            LOG_0("SplitSurface : " << SurfaceRegistry::name(surfaceId_) << " cannot route to " << SurfaceRegistry::name(s) << ", ignoring split");
+            n.split_.clear();
+            return;
+        }
+        n.split_.push_back(target);
+    }
+    n.type_ = SurfaceNode::S_SPLIT;
+    n.splitAxis_ = axis_;
+    n.splitPoint_ = splitPoint_;
+}
+
 
 ////////////////////////////// JoinedSurface ////////////////////////////////////////
 
@@ -189,31 +409,20 @@ JoinedSurface::~JoinedSurface() {
 }
 
 bool JoinedSurface::load(const Preferences &prefs) {
-    if (!prefs.valid()) return false;
+    if (!Surface::load(prefs)) return false;
 
     // temp, this will come from the source surface
     surfaceSize_ = (float) prefs.getDouble("surface size", 1.0);
 
     Preferences::Array array(prefs.getArray("surfaces"));
     for (unsigned i = 0; i < array.getSize(); i++) {
-        SurfaceID n = array.getString(i);
+        std::string n = array.getString(i);
         if (n.size() > 0) {
-            surfaces_.push_back(n);
+            surfaces_.push_back(SurfaceRegistry::intern(n));
         }
     }
 
-    std::string axis = prefs.getString("axis", "");
-    if (axis.size() > 0) {
-        if (axis == "x") axis_ = C_X;
-        else if (axis == "y") axis_ = C_Y;
-        else if (axis == "z") axis_ = C_Z;
-        else if (axis == "r") axis_ = C_R;
-        else if (axis == "c") axis_ = C_C;
-        else axis_ = C_X;
-    } else {
-        axis_ = C_X;
-    }
-
+    axis_ = axis(prefs.getString("axis", "x"));
 
     return surfaces_.size() > 0;
 }
@@ -223,42 +432,42 @@ Touch JoinedSurface::map(const Touch &t) const {
     // use source surface for dimension,
     // relationship between X-C , Y - R
     // touch id, needs to be voiced on surface
-    Touch out = t;
     int idx = 0;
     for (SurfaceID n : surfaces_) {
         if (t.surface_ == n) {
-            switch (axis_) {
-                case C_X: {
-                    out.x_ = t.x_ + (surfaceSize_ * idx);
-                    break;
-                }
-                case C_Y: {
-                    out.y_ = t.y_ + (surfaceSize_ * idx);
-                    break;
-                }
-                case C_Z: {
-                    out.z_ = t.z_ + (surfaceSize_ * idx);
-                    break;
-                }
-                case C_R: {
-                    out.r_ = t.r_ + (surfaceSize_ * idx);
-                    break;
-                }
-                case C_C: {
-                    out.c_ = t.c_ + (surfaceSize_ * idx);
-                    break;
-                }
-                default:
-                    LOG_0("JoinedSurface : invalid axis");
-                    break;
-            }
-
+            Touch out = t;
+            axisValue(out, axis_) += surfaceSize_ * idx;
             out.surface_ = surfaceId_;
-            return out;
+            return transform(out);
         }
         idx++;
     }
-    return out;
+    return t;
+}
+
+void JoinedSurface::edges(std::vector<std::pair<SurfaceID, SurfaceID>> &e) const {
+    for (SurfaceID s : surfaces_) {
+        e.push_back(std::make_pair(s, surfaceId_));
+    }
+}
+
+void JoinedSurface::compile(const SurfaceManager &mgr, std::vector<SurfaceNode> &nodes, int idx) const {
+    Surface::compile(mgr, nodes, idx);
+    for (unsigned i = 0; i < surfaces_.size(); i++) {
+        int member = mgr.index(surfaces_[i]);
+        if (member < 0 || member >= idx) {
+            LOG_0("JoinedSurface : " << SurfaceRegistry::name(surfaces_[i]) << " cannot route to " << SurfaceRegistry::name(surfaceId_));
+            continue;
+        }
+        SurfaceNode &m = nodes[member];
+        if (m.join_ >= 0) {
+            LOG_0("JoinedSurface : " << SurfaceRegistry::name(surfaces_[i]) << " already joined, ignoring join to " << SurfaceRegistry::name(surfaceId_));
+            continue;
+        }
+        m.join_ = idx;
+        m.joinAxis_ = axis_;
+        m.joinOffset_ = surfaceSize_ * i;
+    }
 }
 
 } // namespace
@@ -3,45 +3,127 @@
 
 #include "mec_api.h"
 #include "mec_prefs.h"
+#include "mec_scaler.h"
 
 
-// NOT USED YET INTERFACE EXPERIMENT ONLY
 //
 // mapping between surfaces
 //
+// the surfaces section of mec.json is loaded into Surface objects, which are then compiled
+// into a flat table of SurfaceNode's, indexed by a dense surface index.
+// touches from a device enter at the device's surface, and are routed (SurfaceManager::route)
+// thru splits/joins/transforms until they reach an output surface, which may have a scaler.
+// the Surface::map functions are the (string based) reference implementation, used for testing
 
 
-#include <map>
 #include <memory>
+#include <vector>
 
 namespace mec {
 
 
 class Surface;
 
+// compiled form of a surface
+// a surface only ever routes to a surface with a higher index (surfaces are topologically ordered)
+// so route() is a single forward pass
+struct SurfaceNode {
+    static const unsigned N_AXES = 5; // x,y,z,r,c , see Surface::Axis
+
+    SurfaceNode();
+
+    enum {
+        S_PLAIN,
+        S_SPLIT
+    } type_;
+
+    // transform on entry : v = (v * scale) + offset
+    bool transform_;
+    float scale_[N_AXES];
+    float offset_[N_AXES];
+
+    // split
+    unsigned splitAxis_;
+    float splitPoint_;
+    std::vector<int> split_;
+
+    // join this surface feeds into, -1 = none
+    int join_;
+    unsigned joinAxis_;
+    float joinOffset_;
+
+    // output surfaces only, nullptr = none (note from device is used)
+    const Scaler *scaler_;
+};
+
+
 class SurfaceManager {
 public:
     SurfaceManager();
     virtual ~SurfaceManager();
     bool init(const Preferences &prefs);
+    // inputs : surfaces touches enter at (i.e. device surfaces), added as plain surfaces if not defined
+    bool init(const Preferences &prefs, const std::vector<SurfaceID> &inputs);
 
     std::shared_ptr<Surface> getSurface(SurfaceID id);
+
+    // compiled graph
+    int index(SurfaceID id) const { return id < index_.size() ? index_[id] : -1; } // -1 if unknown
+    unsigned size() const { return surfaces_.size(); }
+    SurfaceID id(int idx) const;
+    const Scaler *scaler(int idx) const { return nodes_[idx].scaler_; }
+
+    // route touch values (x,y,z,r,c) entering at surface idx, transforming in place
+    // returns output surface index
+    int route(int idx, float *v) const;
+
+    // routing thread holds no scale tables, see Scaler::quiescent
+    void quiescent() const;
+
 private:
-    std::map<SurfaceID, std::shared_ptr<Surface>> surfaces_;
+    int add(std::shared_ptr<Surface> surface);
+    void order();
+    void compile();
+
+    std::vector<std::shared_ptr<Surface>> surfaces_;
+    std::vector<SurfaceNode> nodes_;
+    std::vector<int> index_; // by SurfaceID
 };
 
 
 class Surface {
 public:
+    enum Axis {
+        C_X,
+        C_Y,
+        C_Z,
+        C_R,
+        C_C
+    };
+
     Surface(SurfaceID surfaceId);
     virtual ~Surface();
 
     SurfaceID getId();
+    SurfaceID id() const { return surfaceId_; }
     virtual bool load(const Preferences &prefs);
     virtual Touch map(const Touch &) const;
 
+    // graph edges (from, to), used to order surfaces
+    virtual void edges(std::vector<std::pair<SurfaceID, SurfaceID>> &) const { ; }
+    // fill node idx, other nodes may also be updated (e.g. join members)
+    virtual void compile(const SurfaceManager &mgr, std::vector<SurfaceNode> &nodes, int idx) const;
+
+    static Axis axis(const std::string &name);
+
 protected:
+    Touch transform(const Touch &) const;
+
     SurfaceID surfaceId_;
+    bool transform_;
+    float scale_[SurfaceNode::N_AXES];
+    float offset_[SurfaceNode::N_AXES];
+    std::shared_ptr<Scaler> scaler_;
 };
 
 // simple split with even split division
@@ -52,15 +134,11 @@ public:
 
     virtual bool load(const Preferences &prefs) override;
     virtual Touch map(const Touch &) const override;
+    virtual void edges(std::vector<std::pair<SurfaceID, SurfaceID>> &) const override;
+    virtual void compile(const SurfaceManager &mgr, std::vector<SurfaceNode> &nodes, int idx) const override;
 
 private:
-    enum {
-        C_X,
-        C_Y,
-        C_Z,
-        C_R,
-        C_C
-    } axis_;
+    Axis axis_;
     std::vector<SurfaceID> surfaces_;
     float splitPoint_;
 };
@@ -75,19 +153,15 @@ public:
 
     virtual bool load(const Preferences &prefs) override;
     virtual Touch map(const Touch &) const override;
+    virtual void edges(std::vector<std::pair<SurfaceID, SurfaceID>> &) const override;
+    virtual void compile(const SurfaceManager &mgr, std::vector<SurfaceNode> &nodes, int idx) const override;
 
 private:
-    enum {
-        C_X,
-        C_Y,
-        C_Z,
-        C_R,
-        C_C
-    } axis_;
+    Axis axis_;
     std::vector<SurfaceID> surfaces_;
     float surfaceSize_;
 };
 
 }
 
-#endif //MEC_SURFACE_H
\ No newline at end of file
+#endif //MEC_SURFACE_H
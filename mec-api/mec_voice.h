@@ -2,32 +2,57 @@
 #define MEC_VOICES_H_
 
 #include <math.h>
+#include <string>
 #include <vector>
-#include <list>
 
 #include "mec_log.h"
 
 namespace mec {
 
+// fixed capacity voice allocator, no heap allocation after construction
+// - free voices are a FIFO (so released voices are reused last), active voices are in start order (oldest first)
+//   both are intrusive linked lists, so start/stop are O(1)
+// - ids (keys/touches) below maxId are directly indexed, so voiceId() is O(1), larger ids are searched
+// - stolen ids are tracked in a bitset, so a stolen key must be released before it can restart
 class Voices {
 public:
     const float V_SCALE_AMT = 4.0f;
     const float V_CURVE_AMT = 1.0f;
 
-    Voices(unsigned voiceCount = 15, unsigned velocityCount = 5)
-            : maxVoices_(voiceCount), velocityCount_(velocityCount) {
+    static const unsigned DEFAULT_MAX_ID = 1024;
+
+    enum StealPolicy {
+        STEAL_OLDEST,
+        STEAL_QUIETEST,
+        STEAL_NEAREST   // nearest in pitch
+    };
+
+    Voices(unsigned voiceCount = 15, unsigned velocityCount = 5, unsigned maxId = DEFAULT_MAX_ID)
+            : maxVoices_(voiceCount), velocityCount_(velocityCount), maxId_(maxId),
+              freeHead_(nullptr), freeTail_(nullptr), usedHead_(nullptr), usedTail_(nullptr),
+              stealPolicy_(STEAL_OLDEST) {
         voices_.resize(maxVoices_);
+        idTable_.assign(maxId_, -1);
+        stolen_.assign((maxId_ + 63) / 64, 0);
         for (int i = 0; i < maxVoices_; i++) {
-            voices_[i].i_ = i;
-            voices_[i].state_ = Voice::INACTIVE;
-            voices_[i].id_ = -1;
-            freeVoices_.push_back(&voices_[i]);
+            Voice &voice = voices_[i];
+            voice.i_ = i;
+            voice.state_ = Voice::INACTIVE;
+            voice.id_ = -1;
+            voice.note_ = voice.x_ = voice.y_ = voice.z_ = voice.v_ = 0.0f;
+            voice.t_ = 0;
+            voice.prev_ = voice.next_ = nullptr;
+            pushFree(&voice);
         }
 
     };
 
     virtual ~Voices() {};
 
+    // lists point into voices_
+    Voices(const Voices &) = delete;
+    Voices &operator=(const Voices &) = delete;
+
 
     struct Voice {
         int i_;
@@ -51,29 +76,44 @@ public:
             float scale_, curve_; // comes from config
             float raw_;
         } vel_;
+
+        // intrusive list, free or used
+        Voice *prev_;
+        Voice *next_;
     };
 
+    static StealPolicy stealPolicy(const std::string &name) {
+        if (name == "quietest") return STEAL_QUIETEST;
+        if (name == "nearest") return STEAL_NEAREST;
+        return STEAL_OLDEST;
+    }
+
+    void stealPolicy(StealPolicy p) { stealPolicy_ = p; }
+
+    StealPolicy stealPolicy() const { return stealPolicy_; }
+
     Voice *voiceId(unsigned id) {
-        for (int i = 0; i < maxVoices_; i++) {
-            if (voices_[i].id_ == id)
-                return &voices_[i];
+        if (id < maxId_) {
+            int i = idTable_[id];
+            return i < 0 ? nullptr : &voices_[i];
         }
-        return NULL;
+        for (Voice *voice = usedHead_; voice != nullptr; voice = voice->next_) {
+            if (voice->id_ == (int) id) return voice;
+        }
+        return nullptr;
     }
 
     Voice *startVoice(unsigned id) {
-        Voice *voice;
-        if (freeVoices_.size() > 0) {
-            voice = freeVoices_.front();
-            freeVoices_.pop_front();
-        } else {
-            // all voices used, use oldestActiveVoice
-            // if you wish to steal it
-            return NULL;
+        Voice *voice = popFree();
+        if (voice == nullptr) {
+            // all voices used, use voiceToSteal() / oldestActiveVoice()
+            // if you wish to steal one
+            return nullptr;
         }
         voice->id_ = id;
         voice->state_ = Voice::PENDING;
         voice->v_ = 0;
+        if (id < maxId_) idTable_[id] = voice->i_;
 
         voice->vel_.scale_ = V_SCALE_AMT;
         voice->vel_.curve_ = V_CURVE_AMT;
@@ -90,7 +130,7 @@ public:
         voice->vel_.x_++;
 
 
-        usedVoices_.push_back(voice);
+        pushUsed(voice);
         return voice;
     }
 
@@ -130,8 +170,9 @@ public:
     }
 
     void stopVoice(Voice *voice) {
-        if (!voice) return;
-        usedVoices_.remove(voice);
+        if (!voice || voice->state_ == Voice::INACTIVE) return;
+        removeUsed(voice);
+        if (voice->id_ >= 0 && (unsigned) voice->id_ < maxId_) idTable_[voice->id_] = -1;
         voice->id_ = -1;
         voice->note_ = 0;
         voice->x_ = 0;
@@ -139,20 +180,86 @@ public:
         voice->z_ = 0;
         voice->t_ = 0;
         voice->state_ = Voice::INACTIVE;
-        freeVoices_.push_back(voice);
+        pushFree(voice);
     }
 
     Voice *oldestActiveVoice() {
-        return usedVoices_.front();
+        return usedHead_;
+    }
+
+    // voice to steal, according to steal policy, note is pitch of new voice
+    Voice *voiceToSteal(float note) {
+        if (stealPolicy_ == STEAL_OLDEST) return usedHead_;
+
+        Voice *best = usedHead_;
+        float bestDist = 0.0f;
+        for (Voice *voice = usedHead_; voice != nullptr; voice = voice->next_) {
+            float dist = stealPolicy_ == STEAL_QUIETEST ? voice->z_ : fabsf(voice->note_ - note);
+            if (voice == usedHead_ || dist < bestDist) {
+                best = voice;
+                bestDist = dist;
+            }
+        }
+        return best;
+    }
+
+    // stolen ids, ids >= maxId are not tracked
+    void markStolen(unsigned id) {
+        if (id < maxId_) stolen_[id >> 6] |= (1ULL << (id & 63));
+    }
+
+    void clearStolen(unsigned id) {
+        if (id < maxId_) stolen_[id >> 6] &= ~(1ULL << (id & 63));
+    }
+
+    bool isStolen(unsigned id) const {
+        return id < maxId_ && (stolen_[id >> 6] & (1ULL << (id & 63))) != 0;
     }
 
 
 private:
+    void pushFree(Voice *voice) {
+        voice->prev_ = nullptr;
+        voice->next_ = nullptr;
+        if (freeTail_) freeTail_->next_ = voice;
+        else freeHead_ = voice;
+        freeTail_ = voice;
+    }
+
+    Voice *popFree() {
+        Voice *voice = freeHead_;
+        if (voice == nullptr) return nullptr;
+        freeHead_ = voice->next_;
+        if (freeHead_ == nullptr) freeTail_ = nullptr;
+        voice->next_ = nullptr;
+        return voice;
+    }
+
+    void pushUsed(Voice *voice) {
+        voice->prev_ = usedTail_;
+        voice->next_ = nullptr;
+        if (usedTail_) usedTail_->next_ = voice;
+        else usedHead_ = voice;
+        usedTail_ = voice;
+    }
+
+    void removeUsed(Voice *voice) {
+        if (voice->prev_) voice->prev_->next_ = voice->next_;
+        else usedHead_ = voice->next_;
+        if (voice->next_) voice->next_->prev_ = voice->prev_;
+        else usedTail_ = voice->prev_;
+        voice->prev_ = voice->next_ = nullptr;
+    }
+
     std::vector<Voice> voices_;
-    std::list<Voice *> freeVoices_;
-    std::list<Voice *> usedVoices_;
     unsigned maxVoices_;
     unsigned velocityCount_;
+    unsigned maxId_;
+    std::vector<int> idTable_;                  // id -> voice index, -1 if none
+    std::vector<unsigned long long> stolen_;    // bitset of stolen ids
+    Voice *freeHead_, *freeTail_;
+    Voice *usedHead_, *usedTail_;
+    StealPolicy stealPolicy_;
 };
 }
 
@@ -0,0 +1,89 @@
+#ifndef MEC_MIDI_BUFFER_H
+#define MEC_MIDI_BUFFER_H
+
+namespace mec {
+
+// bulk midi output, data is one or more complete midi messages (no running status)
+// e.g. everything a processor generated during one MecApi::process()
+class IMidiSink {
+public:
+    virtual ~IMidiSink() {};
+    virtual bool send(const unsigned char *data, unsigned size) = 0;
+};
+
+// fixed size buffer of complete midi messages, never allocates
+class MidiBuffer {
+public:
+    static const unsigned CAPACITY = 1024;
+
+    MidiBuffer() : size_(0) { ; }
+
+    // false if no room, message is not added
+    bool add(const unsigned char *msg, unsigned n) {
+        if (size_ + n > CAPACITY) return false;
+        for (unsigned i = 0; i < n; i++) data_[size_ + i] = msg[i];
+        size_ += n;
+        return true;
+    }
+
+    void clear() { size_ = 0; }
+
+    bool isEmpty() const { return size_ == 0; }
+
+    unsigned available() const { return CAPACITY - size_; }
+
+    const unsigned char *data() const { return data_; }
+
+    unsigned size() const { return size_; }
+
+    // length of the message at the start of data, 0 if not a complete message
+    // sysex runs to (and includes) 0xF7, realtime is 1 byte
+    static unsigned messageLength(const unsigned char *data, unsigned size) {
+        if (size == 0 || data[0] < 0x80) return 0;
+        unsigned n;
+        switch (data[0] & 0xF0) {
+            case 0xC0:
+            case 0xD0:
+                n = 2;
+                break;
+            case 0xF0:
+                switch (data[0]) {
+                    case 0xF0: {
+                        for (n = 1; n < size; n++) {
+                            if (data[n] == 0xF7) return n + 1;
+                        }
+                        return 0;
+                    }
+                    case 0xF1:
+                    case 0xF3:
+                        n = 2;
+                        break;
+                    case 0xF2:
+                        n = 3;
+                        break;
+                    default:
+                        n = 1;
+                        break;
+                }
+                break;
+            default:
+                n = 3;
+                break;
+        }
+        return n <= size ? n : 0;
+    }
+
+    // data entry and (n)rpn, where the same value can mean something different each time
+    // and channel mode messages (all notes off etc), so must not be dropped or reordered
+    static bool isSequenceCC(unsigned cc) {
+        return cc == 6 || cc == 38 || (cc >= 96 && cc <= 101) || cc >= 120;
+    }
+
+private:
+    unsigned char data_[CAPACITY];
+    unsigned size_;
+};
+
+}
+
+#endif //MEC_MIDI_BUFFER_H
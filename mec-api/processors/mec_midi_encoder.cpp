@@ -0,0 +1,169 @@
+#include "mec_midi_encoder.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace mec {
+
+MidiEncoder::MidiEncoder(IMidiSink *output) :
+        output_(output),
+        runningStatus_(false),
+        suppress_(true),
+        pitchbendResolution_(1),
+        resolution_(1),
+        lastStatus_(0),
+        ok_(true) {
+    reset();
+    resetStats();
+}
+
+MidiEncoder::~MidiEncoder() {
+    ;
+}
+
+bool MidiEncoder::load(const Preferences &prefs) {
+    if (!prefs.valid()) return false;
+    setRunningStatus(prefs.getBool("running status", false));
+    setSuppressRedundant(prefs.getBool("suppress redundant", true));
+    setResolution((unsigned) prefs.getInt("pitchbend resolution", 1), (unsigned) prefs.getInt("resolution", 1));
+    return true;
+}
+
+void MidiEncoder::setResolution(unsigned pitchbend, unsigned sevenBit) {
+    pitchbendResolution_ = pitchbend > 0 ? pitchbend : 1;
+    resolution_ = sevenBit > 0 ? sevenBit : 1;
+}
+
+void MidiEncoder::reset() {
+    for (unsigned ch = 0; ch < 16; ch++) {
+        pitchbend_[ch] = UNKNOWN;
+        pressure_[ch] = UNKNOWN;
+    }
+    memset(cc_, UNKNOWN, sizeof(cc_));
+    lastStatus_ = 0;
+}
+
+void MidiEncoder::resetStats() {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+bool MidiEncoder::send(const unsigned char *data, unsigned size) {
+    ok_ = true;
+    stats_.bytesIn_ += size;
+    unsigned pos = 0;
+    while (pos < size) {
+        unsigned n = MidiBuffer::messageLength(data + pos, size - pos);
+        if (n == 0) {
+            // not a complete message, nothing more can be parsed
+            ok_ = false;
+            break;
+        }
+        stats_.messagesIn_++;
+        encode(data + pos, n);
+        pos += n;
+    }
+    return flushOutput() && ok_;
+}
+
+// does value v need to be sent, given last value sent
+bool MidiEncoder::keep(int last, int v, unsigned resolution, int centre, int max) const {
+    if (last == UNKNOWN) return true;
+    if (v == last) return false;
+    if (resolution <= 1 || v == 0 || v == centre || v == max) return true;
+    return (unsigned) std::abs(v - last) >= resolution;
+}
+
+void MidiEncoder::encode(const unsigned char *msg, unsigned n) {
+    unsigned char status = msg[0];
+    if (status >= 0xF8) {
+        // realtime, does not affect running status
+        put(msg, n);
+        return;
+    }
+    if (status >= 0xF0) {
+        // system common/sysex, cancels running status
+        lastStatus_ = 0;
+        put(msg, n);
+        return;
+    }
+
+    unsigned ch = status & 0x0F;
+    unsigned type = status & 0xF0;
+    if (suppress_) {
+        switch (type) {
+            case 0xE0: {
+                int v = msg[1] | (msg[2] << 7);
+                if (!keep(pitchbend_[ch], v, pitchbendResolution_, 0x2000, 0x3FFF)) {
+                    stats_.messagesDropped_++;
+                    return;
+                }
+                pitchbend_[ch] = v;
+                break;
+            }
+            case 0xD0: {
+                int v = msg[1];
+                if (!keep(pressure_[ch], v, resolution_, 0, 127)) {
+                    stats_.messagesDropped_++;
+                    return;
+                }
+                pressure_[ch] = v;
+                break;
+            }
+            case 0xB0: {
+                unsigned cc = msg[1] & 0x7F;
+                int v = msg[2];
+                if (!MidiBuffer::isSequenceCC(cc)) {
+                    if (!keep(cc_[ch][cc], v, resolution_, 64, 127)) {
+                        stats_.messagesDropped_++;
+                        return;
+                    }
+                    cc_[ch][cc] = (signed char) v;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    if (!runningStatus_) {
+        put(msg, n);
+        return;
+    }
+
+    unsigned char outStatus = status;
+    if (type == 0x80 && msg[2] == 0) outStatus = (unsigned char) (0x90 | ch); // note on, zero velocity
+    if (outStatus == lastStatus_) {
+        put(msg + 1, n - 1);
+    } else {
+        lastStatus_ = outStatus;
+        unsigned char out[3] = {outStatus, msg[1], n > 2 ? msg[2] : (unsigned char) 0};
+        put(out, n);
+    }
+}
+
+void MidiEncoder::put(const unsigned char *msg, unsigned n) {
+    stats_.bytesOut_ += n;
+    if (out_.add(msg, n)) return;
+    flushOutput();
+    if (out_.add(msg, n)) return;
+    // larger than buffer (long sysex), send as is
+    if (output_ == nullptr || !output_->send(msg, n)) {
+        lastStatus_ = 0;
+        ok_ = false;
+    }
+}
+
+bool MidiEncoder::flushOutput() {
+    if (out_.isEmpty()) return true;
+    bool ret = output_ != nullptr && output_->send(out_.data(), out_.size());
+    out_.clear();
+    if (!ret) {
+        // receiver may not have seen the status, so resend it next time
+        lastStatus_ = 0;
+        ok_ = false;
+    }
+    return ret;
+}
+
+}
@@ -0,0 +1,77 @@
+#ifndef MEC_MIDI_ENCODER_H
+#define MEC_MIDI_ENCODER_H
+
+//////////////
+// encoder stage between a Midi_Processor and the output, to save bandwidth (e.g. DIN midi at 31.25kbit/s)
+// - suppresses channel messages that would not change the receivers state (same value as last sent)
+// - optionally drops continuous changes (pitchbend, cc, pressure) smaller than a resolution,
+//   extremes and centre are always sent, so controls can always return to rest
+// - optionally uses running status, only for byte stream transports (e.g. a uart),
+//   rtmidi needs complete messages, so must not use it.
+//   with running status, note off with zero velocity is sent as note on (zero velocity), so it can run too
+
+#include "mec_prefs.h"
+#include "mec_midi_buffer.h"
+
+namespace mec {
+
+class MidiEncoder : public IMidiSink {
+public:
+    struct Stats {
+        unsigned long long bytesIn_;
+        unsigned long long bytesOut_;
+        unsigned long long messagesIn_;
+        unsigned long long messagesDropped_;
+
+        long long bytesSaved() const { return (long long) bytesIn_ - (long long) bytesOut_; }
+    };
+
+    MidiEncoder(IMidiSink *output = nullptr);
+    virtual ~MidiEncoder();
+
+    // "running status" (false), "suppress redundant" (true),
+    // "pitchbend resolution" (1, in 14 bit steps), "resolution" (1, in 7 bit steps, cc and pressure)
+    bool load(const Preferences &prefs);
+
+    void setOutput(IMidiSink *output) { output_ = output; }
+    void setRunningStatus(bool b) { runningStatus_ = b; lastStatus_ = 0; }
+    void setSuppressRedundant(bool b) { suppress_ = b; }
+    void setResolution(unsigned pitchbend, unsigned sevenBit);
+
+    // encode and send to output, data is complete messages (see IMidiSink)
+    bool send(const unsigned char *data, unsigned size) override;
+
+    // forget what the receiver has (e.g. reconnected), so everything is sent again
+    void reset();
+
+    const Stats &stats() const { return stats_; }
+    void resetStats();
+
+private:
+    static const int UNKNOWN = -1;
+
+    bool keep(int last, int v, unsigned resolution, int centre, int max) const;
+    void encode(const unsigned char *msg, unsigned n);
+    void put(const unsigned char *msg, unsigned n);
+    bool flushOutput();
+
+    IMidiSink *output_;
+    bool runningStatus_;
+    bool suppress_;
+    unsigned pitchbendResolution_;
+    unsigned resolution_;
+
+    // last value sent per channel, UNKNOWN until sent
+    int pitchbend_[16];
+    int pressure_[16];
+    signed char cc_[16][128];
+
+    unsigned char lastStatus_; // running status, 0 = none
+    MidiBuffer out_;
+    bool ok_;
+    Stats stats_;
+};
+
+}
+
+#endif //MEC_MIDI_ENCODER_H
@@ -0,0 +1,104 @@
+#include "mec_midi_parser.h"
+
+namespace mec {
+
+MidiParser::MidiParser() : dropped_(0) {
+    reset();
+}
+
+void MidiParser::reset() {
+    status_ = 0;
+    data_[0] = data_[1] = 0;
+    count_ = 0;
+    expected_ = 0;
+    sysex_ = false;
+}
+
+unsigned MidiParser::dataLength(unsigned char status) {
+    switch (status & 0xF0) {
+        case 0xC0:
+        case 0xD0:
+            return 1;
+        case 0xF0:
+            switch (status) {
+                case 0xF1:
+                case 0xF3:
+                    return 1;
+                case 0xF2:
+                    return 2;
+                default:
+                    return 0;
+            }
+        default:
+            return 2;
+    }
+}
+
+void MidiParser::parse(const unsigned char *data, unsigned size, Handler &handler) {
+    // start of the sysex piece in this buffer
+    unsigned sysexStart = 0;
+
+    for (unsigned i = 0; i < size; i++) {
+        unsigned char b = data[i];
+
+        if (b < 0x80) {
+            if (sysex_) continue; // part of the piece
+            if (status_ == 0) {
+                dropped_++;
+                continue;
+            }
+            data_[count_++] = b;
+            if (count_ == expected_) {
+                handler.message(status_, data_[0], expected_ > 1 ? data_[1] : (unsigned char) 0);
+                count_ = 0;
+                // system common does not set running status
+                if (status_ >= 0xF0) status_ = 0;
+            }
+            continue;
+        }
+
+        if (b >= 0xF8) {
+            // realtime, does not affect anything else
+            if (sysex_ && i > sysexStart) handler.sysex(data + sysexStart, i - sysexStart, false);
+            handler.realtime(b);
+            sysexStart = i + 1;
+            continue;
+        }
+
+        if (sysex_) {
+            // any status ends sysex, normally 0xF7
+            sysex_ = false;
+            if (b == 0xF7) {
+                handler.sysex(data + sysexStart, i + 1 - sysexStart, true);
+                continue;
+            }
+            handler.sysex(data + sysexStart, i - sysexStart, true);
+        }
+
+        count_ = 0;
+        switch (b) {
+            case 0xF0:
+                sysex_ = true;
+                sysexStart = i;
+                status_ = 0;
+                break;
+            case 0xF7:
+                // end of sysex we did not see start of
+                status_ = 0;
+                break;
+            default:
+                status_ = b;
+                expected_ = dataLength(b);
+                if (expected_ == 0) {
+                    // e.g. tune request
+                    handler.message(b, 0, 0);
+                    status_ = 0;
+                }
+                break;
+        }
+    }
+
+    if (sysex_ && size > sysexStart) handler.sysex(data + sysexStart, size - sysexStart, false);
+}
+
+}
@@ -0,0 +1,49 @@
+#ifndef MEC_MIDI_PARSER_H
+#define MEC_MIDI_PARSER_H
+
+//////////////
+// streaming midi input parser, works directly on the input buffer (no copying)
+// a message may be split over buffers, and a buffer may hold many messages
+// - running status (and note on, velocity 0 as sent with it, is left to the handler)
+// - realtime bytes, anywhere in the stream, including inside other messages and sysex
+// - sysex, passed on in pieces as it arrives, so it can be any length
+
+namespace mec {
+
+class MidiParser {
+public:
+    class Handler {
+    public:
+        virtual ~Handler() { ; }
+
+        // channel and system common messages, d1/d2 are 0 if not used by the message
+        virtual void message(unsigned char status, unsigned char d1, unsigned char d2) = 0;
+
+        virtual void realtime(unsigned char) { ; }
+
+        // sysex pieces, pointing into the parsed buffer
+        // first starts with 0xF0, last ends with 0xF7 (unless the sysex was cut short by another status)
+        virtual void sysex(const unsigned char *, unsigned, bool /*last*/) { ; }
+    };
+
+    MidiParser();
+
+    void parse(const unsigned char *data, unsigned size, Handler &handler);
+    void reset();
+
+    unsigned long long dropped() const { return dropped_; } // data bytes without a status
+
+private:
+    static unsigned dataLength(unsigned char status);
+
+    unsigned char status_;     // current message status, 0 = none
+    unsigned char data_[2];
+    unsigned count_;           // data bytes received
+    unsigned expected_;        // data bytes for status_
+    bool sysex_;
+    unsigned long long dropped_;
+};
+
+}
+
+#endif //MEC_MIDI_PARSER_H
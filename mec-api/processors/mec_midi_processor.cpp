@@ -5,8 +5,8 @@
 
 namespace mec {
 
-Midi_Processor::Midi_Processor(float pbr) : pitchbendRange_ (pbr) {
-    ;
+Midi_Processor::Midi_Processor(float pbr) : pitchbendRange_ (pbr), port_(0) {
+    for (unsigned i = 0; i < MAX_PORTS; i++) sinks_[i] = nullptr;
 }
 
 Midi_Processor::~Midi_Processor() {
@@ -17,6 +17,29 @@ void Midi_Processor::setPitchbendRange(float v) {
     pitchbendRange_ = v;
 }
 
+void Midi_Processor::process(MidiMsg& msg) {
+    if (sinks_[port_] == nullptr) return;
+    MidiBuffer& buffer = buffers_[port_];
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(msg.data);
+    if (!buffer.add(data, msg.size)) {
+        // buffer full, send what we have, rather than drop
+        sinks_[port_]->send(buffer.data(), buffer.size());
+        buffer.clear();
+        buffer.add(data, msg.size);
+    }
+}
+
+bool Midi_Processor::flush() {
+    bool ret = true;
+    for (unsigned i = 0; i < MAX_PORTS; i++) {
+        MidiBuffer& buffer = buffers_[i];
+        if (buffer.isEmpty()) continue;
+        ret = (sinks_[i] != nullptr && sinks_[i]->send(buffer.data(), buffer.size())) && ret;
+        buffer.clear();
+    }
+    return ret;
+}
+
 /////////////////////////
 // ICallback interface
 void Midi_Processor::touchOn(int id, float note, float , float , float z) {
@@ -2,9 +2,13 @@
 
 //////////////
 // this class can be used to process incoming callbacks and convert into Midi messages
-// define the process method to determine what to do with the midi message
+// either define the process method to determine what to do with each midi message,
+// or set a sink, messages are then buffered and sent to the sink in one go by flush()
+// (e.g. once per MecApi::process), so the output path does not allocate or call per message
+// there can be a sink per output port, messages go to the current port (see selectPort)
 
 #include "../mec_api.h"
+#include "mec_midi_buffer.h"
 
 #include <list>
 
@@ -26,9 +30,15 @@ public:
     };
 
 
-    virtual void  process(MidiMsg& msg) = 0;
+    static const unsigned MAX_PORTS = 4;
+
+    virtual void  process(MidiMsg& msg); // default, adds to buffer for sink of current port
     void setPitchbendRange(float pbr);
 
+    void setSink(IMidiSink* sink, unsigned port = 0) { if (port < MAX_PORTS) sinks_[port] = sink; }
+    bool flush(); // send buffered messages to sinks, false if a send failed
+    unsigned port() const { return port_; } // of message being processed
+
     // ICallback handling
     virtual void touchOn(int touchId, float note, float x, float y, float z);
     virtual void touchContinue(int touchId, float note, float x, float y, float z);
@@ -51,6 +61,13 @@ protected:
 
     float global_[127];
     float pitchbendRange_;
+
+    // port for following messages
+    void selectPort(unsigned port) { port_ = port < MAX_PORTS ? port : 0; }
+
+    IMidiSink* sinks_[MAX_PORTS];
+    MidiBuffer buffers_[MAX_PORTS];
+    unsigned port_;
 };
 
 }
@@ -0,0 +1,272 @@
+#include "mec_midi_scheduler.h"
+
+#include <cstring>
+
+namespace mec {
+
+MidiScheduler::MidiScheduler(IMidiSink *output) :
+        output_(output),
+        rate_(0),
+        burst_(32),
+        tokens_(0),
+        lastService_(0),
+        priorityHead_(0),
+        priorityCount_(0),
+        pendingChannels_(0),
+        nextChannel_(0),
+        ok_(true) {
+    clear();
+    resetStats();
+}
+
+MidiScheduler::~MidiScheduler() {
+    ;
+}
+
+bool MidiScheduler::load(const Preferences &prefs) {
+    if (!prefs.valid()) return false;
+    setRate((unsigned) prefs.getInt("bytes per second", 0), (unsigned) prefs.getInt("burst", 32));
+    return true;
+}
+
+void MidiScheduler::setRate(unsigned bytesPerSecond, unsigned burst) {
+    rate_ = bytesPerSecond;
+    // must at least fit the largest queued message
+    burst_ = burst >= 3 ? burst : 3;
+    tokens_ = burst_;
+    lastService_ = 0;
+}
+
+void MidiScheduler::clear() {
+    priorityHead_ = 0;
+    priorityCount_ = 0;
+    for (unsigned ch = 0; ch < 16; ch++) {
+        channels_[ch].pending_.reset();
+        channels_[ch].count_ = 0;
+        channels_[ch].next_ = 0;
+    }
+    pendingChannels_ = 0;
+    nextChannel_ = 0;
+    out_.clear();
+}
+
+void MidiScheduler::resetStats() {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+// cc where each value matters, and the order against notes/program changes
+// bank select msb/lsb, sustain, portamento, sostenuto, soft, legato, hold 2
+bool MidiScheduler::isSwitchCC(unsigned cc) {
+    return cc == 0 || cc == 32 || (cc >= 64 && cc <= 69);
+}
+
+bool MidiScheduler::isContinuous(const unsigned char *msg) const {
+    switch (msg[0] & 0xF0) {
+        case 0xA0:
+        case 0xD0:
+        case 0xE0:
+            return true;
+        case 0xB0:
+            return !MidiBuffer::isSequenceCC(msg[1] & 0x7F) && !isSwitchCC(msg[1] & 0x7F);
+        default:
+            return false;
+    }
+}
+
+bool MidiScheduler::send(const unsigned char *data, unsigned size) {
+    ok_ = true;
+    MecTime now = mecTimeNow();
+    unsigned pos = 0;
+    while (pos < size) {
+        unsigned n = MidiBuffer::messageLength(data + pos, size - pos);
+        if (n == 0) {
+            // not a complete message, nothing more can be parsed
+            ok_ = false;
+            break;
+        }
+        stats_.messagesIn_++;
+        const unsigned char *msg = data + pos;
+        if (rate_ == 0) {
+            // unlimited, pass through in order, after anything queued before the rate was cleared
+            if (isPending()) service(now);
+            emit(msg, n);
+        } else if (n > 3 || msg[0] >= 0xF8) {
+            // sysex cannot be queued, and realtime must not be delayed
+            // so these go now, after anything already queued to keep order
+            while (priorityCount_ > 0) {
+                PriorityMsg &p = priority_[priorityHead_];
+                emit(p.data_, p.size_);
+                priorityHead_ = (priorityHead_ + 1) % PRIORITY_CAPACITY;
+                priorityCount_--;
+                stats_.overBudget_++;
+            }
+            emit(msg, n);
+        } else if (isContinuous(msg)) {
+            queueContinuous(msg);
+        } else {
+            if ((msg[0] & 0xF0) == 0x90 && msg[2] > 0) promote(msg[0] & 0x0F, now);
+            queuePriority(msg, n, now);
+        }
+        pos += n;
+    }
+    return flushOutput() && ok_;
+}
+
+void MidiScheduler::queueContinuous(const unsigned char *msg) {
+    unsigned ch = msg[0] & 0x0F;
+    unsigned slot;
+    unsigned short v;
+    switch (msg[0] & 0xF0) {
+        case 0xE0:
+            slot = SLOT_PITCHBEND;
+            v = (unsigned short) (msg[1] | (msg[2] << 7));
+            break;
+        case 0xD0:
+            slot = SLOT_PRESSURE;
+            v = msg[1];
+            break;
+        case 0xB0:
+            slot = SLOT_CC + (msg[1] & 0x7F);
+            v = msg[2];
+            break;
+        default: // 0xA0
+            slot = SLOT_POLY + (msg[1] & 0x7F);
+            v = msg[2];
+            break;
+    }
+
+    Channel &c = channels_[ch];
+    if (c.pending_.test(slot)) {
+        stats_.coalesced_++;
+    } else {
+        c.pending_.set(slot);
+        if (c.count_++ == 0) pendingChannels_++;
+    }
+    c.value_[slot] = v;
+}
+
+void MidiScheduler::queuePriority(const unsigned char *msg, unsigned n, MecTime now) {
+    if (priorityCount_ == PRIORITY_CAPACITY) {
+        // full, oldest goes now regardless of budget, rather than losing a note off
+        PriorityMsg &p = priority_[priorityHead_];
+        emit(p.data_, p.size_);
+        priorityHead_ = (priorityHead_ + 1) % PRIORITY_CAPACITY;
+        priorityCount_--;
+        stats_.overBudget_++;
+    }
+    PriorityMsg &p = priority_[(priorityHead_ + priorityCount_) % PRIORITY_CAPACITY];
+    for (unsigned i = 0; i < n; i++) p.data_[i] = msg[i];
+    p.size_ = (unsigned char) n;
+    p.t_ = now;
+    priorityCount_++;
+}
+
+// note on, move continuous data for the channel ahead of it (e.g. mpe initial pitchbend and timbre)
+// poly pressure is left, as it is for a note, which is not yet on
+void MidiScheduler::promote(unsigned ch, MecTime now) {
+    Channel &c = channels_[ch];
+    if (c.count_ == 0) return;
+    unsigned char msg[3];
+    unsigned n;
+    c.next_ = 0;
+    while (takeContinuous(ch, msg, n)) {
+        if ((msg[0] & 0xF0) == 0xA0) {
+            // put it back, nothing else remains
+            queueContinuous(msg);
+            break;
+        }
+        queuePriority(msg, n, now);
+    }
+}
+
+// next continuous message for channel, round robin over slots
+bool MidiScheduler::takeContinuous(unsigned ch, unsigned char *msg, unsigned &n) {
+    Channel &c = channels_[ch];
+    if (c.count_ == 0) return false;
+
+    unsigned slot = c.next_;
+    while (!c.pending_.test(slot)) slot = (slot + 1) % N_SLOTS;
+
+    unsigned short v = c.value_[slot];
+    if (slot == SLOT_PITCHBEND) {
+        msg[0] = (unsigned char) (0xE0 | ch);
+        msg[1] = (unsigned char) (v & 0x7F);
+        msg[2] = (unsigned char) ((v >> 7) & 0x7F);
+        n = 3;
+    } else if (slot == SLOT_PRESSURE) {
+        msg[0] = (unsigned char) (0xD0 | ch);
+        msg[1] = (unsigned char) v;
+        n = 2;
+    } else if (slot < SLOT_POLY) {
+        msg[0] = (unsigned char) (0xB0 | ch);
+        msg[1] = (unsigned char) (slot - SLOT_CC);
+        msg[2] = (unsigned char) v;
+        n = 3;
+    } else {
+        msg[0] = (unsigned char) (0xA0 | ch);
+        msg[1] = (unsigned char) (slot - SLOT_POLY);
+        msg[2] = (unsigned char) v;
+        n = 3;
+    }
+
+    c.pending_.reset(slot);
+    c.next_ = (slot + 1) % N_SLOTS;
+    if (--c.count_ == 0) pendingChannels_--;
+    return true;
+}
+
+bool MidiScheduler::service(MecTime now) {
+    ok_ = true;
+    if (rate_ > 0) {
+        if (lastService_ != 0 && now > lastService_) {
+            tokens_ += (double) rate_ * (double) (now - lastService_) / 1000000000.0;
+            if (tokens_ > burst_) tokens_ = burst_;
+        }
+        lastService_ = now;
+    }
+
+    // discrete messages first, in order
+    while (priorityCount_ > 0) {
+        PriorityMsg &p = priority_[priorityHead_];
+        if (rate_ > 0 && tokens_ < p.size_) return flushOutput() && ok_;
+        if (now > p.t_ && now - p.t_ > stats_.maxPriorityDelay_) stats_.maxPriorityDelay_ = now - p.t_;
+        emit(p.data_, p.size_);
+        priorityHead_ = (priorityHead_ + 1) % PRIORITY_CAPACITY;
+        priorityCount_--;
+    }
+
+    // then latest continuous values, one per channel in turn
+    while (pendingChannels_ > 0) {
+        unsigned ch = nextChannel_;
+        while (channels_[ch].count_ == 0) ch = (ch + 1) % 16;
+        // worst case size, so a message is never taken then left unsent
+        if (rate_ > 0 && tokens_ < 3) break;
+        unsigned char msg[3];
+        unsigned n;
+        takeContinuous(ch, msg, n);
+        emit(msg, n);
+        nextChannel_ = (ch + 1) % 16;
+    }
+    return flushOutput() && ok_;
+}
+
+void MidiScheduler::emit(const unsigned char *msg, unsigned n) {
+    if (rate_ > 0) tokens_ -= n;
+    stats_.messagesSent_++;
+    stats_.bytesSent_ += n;
+    if (out_.add(msg, n)) return;
+    flushOutput();
+    if (out_.add(msg, n)) return;
+    // larger than buffer (long sysex), send as is
+    if (output_ == nullptr || !output_->send(msg, n)) ok_ = false;
+}
+
+bool MidiScheduler::flushOutput() {
+    if (out_.isEmpty()) return true;
+    bool ret = output_ != nullptr && output_->send(out_.data(), out_.size());
+    out_.clear();
+    if (!ret) ok_ = false;
+    return ret;
+}
+
+}
@@ -0,0 +1,111 @@
+#ifndef MEC_MIDI_SCHEDULER_H
+#define MEC_MIDI_SCHEDULER_H
+
+//////////////
+// bandwidth limited midi output, for slow links (din midi, ble midi bridges)
+// queues messages from a Midi_Processor, service() then sends what the byte rate budget allows
+// without a rate (the default), messages are passed through as they arrive
+// - note on/off (and other discrete messages) are sent first, in order
+// - continuous messages (pitchbend, pressure, poly pressure, cc) are kept as a latest value per
+//   channel/controller, so a stale value is replaced rather than queued behind
+// - cc which select or switch state (bank select, pedals, rpn/nrpn, mode) are discrete, so stay in order
+// - channels with continuous data are served round robin, so one busy voice cannot starve the others
+// - a note on first sends any continuous data pending for its channel, so it starts with the right pitch/timbre
+// place before a MidiEncoder, so running status/suppression apply to what is actually sent
+
+#include <bitset>
+
+#include "mec_prefs.h"
+#include "../mec_stats.h"
+#include "mec_midi_buffer.h"
+
+namespace mec {
+
+class MidiScheduler : public IMidiSink {
+public:
+    static const unsigned PRIORITY_CAPACITY = 256; // discrete messages, when full they are sent regardless of budget
+
+    struct Stats {
+        unsigned long long messagesIn_;
+        unsigned long long messagesSent_;
+        unsigned long long coalesced_;   // continuous values replaced before being sent
+        unsigned long long bytesSent_;
+        unsigned long long overBudget_;  // discrete messages sent over budget, as queue was full
+        MecTime maxPriorityDelay_;       // longest a discrete message (e.g. note off) waited
+    };
+
+    MidiScheduler(IMidiSink *output = nullptr);
+    virtual ~MidiScheduler();
+
+    // "bytes per second" (0 = unlimited, din midi is 3125), "burst" (bytes, default 32)
+    bool load(const Preferences &prefs);
+
+    void setOutput(IMidiSink *output) { output_ = output; }
+    void setRate(unsigned bytesPerSecond, unsigned burst);
+
+    // queue messages, data is complete messages (see IMidiSink)
+    bool send(const unsigned char *data, unsigned size) override;
+
+    // send what the budget allows, false if output failed
+    bool service(MecTime now = mecTimeNow());
+
+    bool isPending() const { return priorityCount_ > 0 || pendingChannels_ > 0; }
+    void clear();
+
+    const Stats &stats() const { return stats_; }
+    void resetStats();
+
+private:
+    // continuous slots per channel
+    enum {
+        SLOT_PITCHBEND = 0,
+        SLOT_PRESSURE = 1,
+        SLOT_CC = 2,
+        SLOT_POLY = SLOT_CC + 128,
+        N_SLOTS = SLOT_POLY + 128
+    };
+
+    struct PriorityMsg {
+        unsigned char data_[3];
+        unsigned char size_;
+        MecTime t_;
+    };
+
+    struct Channel {
+        std::bitset<N_SLOTS> pending_;
+        unsigned short value_[N_SLOTS];
+        unsigned count_;
+        unsigned next_; // slot to look from, so slots are served round robin too
+    };
+
+    static bool isSwitchCC(unsigned cc);
+    bool isContinuous(const unsigned char *msg) const;
+    void queueContinuous(const unsigned char *msg);
+    void queuePriority(const unsigned char *msg, unsigned n, MecTime now);
+    void promote(unsigned ch, MecTime now);
+    bool takeContinuous(unsigned ch, unsigned char *msg, unsigned &n);
+    void emit(const unsigned char *msg, unsigned n);
+    bool flushOutput();
+
+    IMidiSink *output_;
+    unsigned rate_;   // bytes per second, 0 = unlimited
+    unsigned burst_;
+    double tokens_;   // bytes that can be sent now
+    MecTime lastService_;
+
+    PriorityMsg priority_[PRIORITY_CAPACITY];
+    unsigned priorityHead_;
+    unsigned priorityCount_;
+
+    Channel channels_[16];
+    unsigned pendingChannels_;
+    unsigned nextChannel_;
+
+    MidiBuffer out_;
+    bool ok_;
+    Stats stats_;
+};
+
+}
+
+#endif //MEC_MIDI_SCHEDULER_H
@@ -0,0 +1,96 @@
+#include "mec_mpe_allocator.h"
+
+namespace mec {
+
+MpeChannelAllocator::MpeChannelAllocator() :
+        zoneCount_(0),
+        size_(0),
+        freeHead_(-1),
+        freeTail_(-1),
+        next_(0) {
+    ;
+}
+
+bool MpeChannelAllocator::addZone(unsigned port, ZoneType type, unsigned members) {
+    if (zoneCount_ == MAX_ZONES || members == 0 || members > MAX_MEMBERS) return false;
+
+    // lower and upper zone on a port share the 14 channels between the masters
+    for (unsigned i = 0; i < zoneCount_; i++) {
+        const Zone &z = zones_[i];
+        if (z.port_ != port) continue;
+        if (z.type_ == type || z.members_ + members > MAX_MEMBERS - 1) return false;
+    }
+
+    Zone &z = zones_[zoneCount_++];
+    z.port_ = port;
+    z.type_ = type;
+    z.members_ = members;
+    build();
+    return true;
+}
+
+void MpeChannelAllocator::clear() {
+    zoneCount_ = 0;
+    build();
+}
+
+// channel table, interleaving zones
+void MpeChannelAllocator::build() {
+    size_ = 0;
+    for (unsigned m = 0; m < MAX_MEMBERS; m++) {
+        for (unsigned i = 0; i < zoneCount_; i++) {
+            const Zone &z = zones_[i];
+            if (m >= z.members_) continue;
+            Channel &c = channels_[size_++];
+            c.port_ = z.port_;
+            c.ch_ = z.type_ == LOWER ? 1 + m : 14 - m;
+        }
+    }
+    reset();
+}
+
+void MpeChannelAllocator::reset() {
+    freeHead_ = freeTail_ = -1;
+    for (unsigned i = 0; i < size_; i++) {
+        notes_[i] = 0;
+        pushFree(i);
+    }
+    next_ = 0;
+}
+
+void MpeChannelAllocator::pushFree(int idx) {
+    freeNext_[idx] = -1;
+    if (freeTail_ < 0) {
+        freeHead_ = idx;
+    } else {
+        freeNext_[freeTail_] = idx;
+    }
+    freeTail_ = idx;
+}
+
+int MpeChannelAllocator::allocate() {
+    if (size_ == 0) return -1;
+
+    int idx = freeHead_;
+    if (idx >= 0) {
+        freeHead_ = freeNext_[idx];
+        if (freeHead_ < 0) freeTail_ = -1;
+    } else {
+        // all in use, share the least used, starting from where we last shared
+        idx = next_ % size_;
+        for (unsigned i = 1; i < size_; i++) {
+            unsigned c = (next_ + i) % size_;
+            if (notes_[c] < notes_[idx]) idx = c;
+        }
+        next_ = idx + 1;
+    }
+    notes_[idx]++;
+    return idx;
+}
+
+void MpeChannelAllocator::release(int idx) {
+    if (idx < 0 || (unsigned) idx >= size_ || notes_[idx] == 0) return;
+    if (--notes_[idx] == 0) pushFree(idx);
+}
+
+}
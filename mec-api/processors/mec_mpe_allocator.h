@@ -0,0 +1,76 @@
+#ifndef MEC_MPE_ALLOCATOR_H
+#define MEC_MPE_ALLOCATOR_H
+
+//////////////
+// allocates mpe member channels to voices, over one or more zones, each zone is on an output port
+// so polyphony (and midi bandwidth) can go beyond the 15 channels of a single zone
+// - free channels are reused least recently released first, so a release tail is not cut short
+// - zones are interleaved, so consecutive voices go to different ports
+// - if all channels are in use, a channel is shared (as mpe allows), round robin over the least used
+// fixed capacity, so allocation never touches the heap
+
+namespace mec {
+
+class MpeChannelAllocator {
+public:
+    static const unsigned MAX_ZONES = 8;
+    static const unsigned MAX_MEMBERS = 15;
+    static const unsigned MAX_CHANNELS = MAX_ZONES * MAX_MEMBERS;
+
+    enum ZoneType {
+        LOWER,  // master channel 1, members 2 upwards
+        UPPER   // master channel 16, members 15 downwards
+    };
+
+    struct Zone {
+        unsigned port_;
+        ZoneType type_;
+        unsigned members_;
+
+        unsigned master() const { return type_ == LOWER ? 0 : 15; } // 0-15
+    };
+
+    struct Channel {
+        unsigned port_;
+        unsigned ch_; // 0-15
+    };
+
+    MpeChannelAllocator();
+
+    // false if invalid, or overlaps a zone already on the port
+    bool addZone(unsigned port, ZoneType type, unsigned members);
+    void clear(); // remove all zones
+
+    unsigned zoneCount() const { return zoneCount_; }
+    const Zone &zone(unsigned i) const { return zones_[i]; }
+    unsigned size() const { return size_; } // member channels
+
+    int allocate(); // channel index, -1 if there are no channels
+    void release(int idx);
+    void reset(); // release all
+
+    const Channel &channel(int idx) const { return channels_[idx]; }
+    unsigned notes(int idx) const { return notes_[idx]; } // notes allocated to channel
+
+private:
+    void build();
+    void pushFree(int idx);
+
+    Zone zones_[MAX_ZONES];
+    unsigned zoneCount_;
+
+    Channel channels_[MAX_CHANNELS];
+    unsigned notes_[MAX_CHANNELS];
+    unsigned size_;
+
+    // free channels, fifo by release
+    int freeNext_[MAX_CHANNELS];
+    int freeHead_;
+    int freeTail_;
+
+    unsigned next_; // round robin, when sharing
+};
+
+}
+
+#endif //MEC_MPE_ALLOCATOR_H
@@ -1,14 +1,21 @@
 
 #include "mec_mpe_processor.h"
 
+#include <cstring>
+
 //#include "mec_log.h"
 
 namespace mec {
 
 #define TIMBRE_CC 74
 
-MPE_Processor::MPE_Processor(float pbr) : Midi_Processor(pbr) {
-    ;
+MPE_Processor::MPE_Processor(float pbr) : Midi_Processor(pbr),
+    changedVoices_(0),
+    period_(0),
+    nextTick_(0) {
+    memset(&voices_, 0, sizeof(voices_));
+    for (unsigned i = 0; i < MAX_VOICES; i++) voices_.channel_[i] = -1;
+    allocator_.addZone(0, MpeChannelAllocator::LOWER, MpeChannelAllocator::MAX_MEMBERS);
 }
 
 MPE_Processor::~MPE_Processor() {
@@ -18,101 +25,225 @@ MPE_Processor::~MPE_Processor() {
 /////////////////////////
 // ICallback interface
 void MPE_Processor::touchOn(int id, float note, float x, float y, float z) {
+    if (id < 0 || id >= (int) MAX_VOICES) return;
 
-    VoiceData& voice = voices_[id];
-
-    unsigned ch = id + 1; // MPE starts on 2
-    voice.startNote_ = (note + 0.4999999) ; //int
+    // retriggered without an off, keeps its channel
+    if (voices_.channel_[id] < 0) voices_.channel_[id] = allocator_.allocate();
+    if (voices_.channel_[id] < 0) return;
+    unsigned ch = selectChannel(id);
+    unsigned startNote = (note + 0.4999999) ; //int
+    voices_.startNote_[id] = startNote;
 
-    float semis = note - float(voice.startNote_);
+    float semis = note - float(startNote);
     int pb = bipolar14bit(semis / pitchbendRange_);
 
-    unsigned mx = bipolar14bit(x);
     int my = bipolar7bit(y);
     int mz = unipolar7bit(z);
 
     // LOG_1("MPE_Processor::touchOn");
-    // LOG_1("   note : " << note  << " startNote " << voice.startNote_ << " semi :" << semis << " pb: " << pb);
-    // LOG_1("   x :" << x << " mx: " << mx);
+    // LOG_1("   note : " << note  << " startNote " << startNote << " semi :" << semis << " pb: " << pb);
     // LOG_1("   y :" << y << " my: " << my);
     // LOG_1("   z :" << z << " mz: " << mz);
 
     pitchbend(ch, pb);
     cc(ch, TIMBRE_CC,  my);
-    noteOn(ch, voice.startNote_, mz);
+    noteOn(ch, startNote, mz);
 
-    voice.note_ = voice.startNote_;
-    voice.pitchbend_ = pb;
-    voice.timbre_ = my;
+    voices_.pitchbend_[id] = pb;
+    voices_.timbre_[id] = my;
 
     // start with zero z, as we use intial z of velocity
     pressure(ch, 0.0f);
-    voice.pressure_ = 0.0f;
+    voices_.pressure_[id] = 0;
+
+    // everything is sent, so nothing pending from a previous touch
+    voices_.changed_[id] = 0;
+    changedVoices_ &= ~(1ULL << id);
 }
 
 void MPE_Processor::touchContinue(int id, float note, float x, float y, float z) {
+    if (id < 0 || id >= (int) MAX_VOICES || voices_.channel_[id] < 0) return;
 
-    VoiceData& voice = voices_[id];
-    unsigned ch = id + 1; // MPE starts on 2
     // unsigned mx = bipolar14bit(x);
     int my = bipolar7bit(y);
     unsigned mz = unipolar7bit(z);
 
-    float semis = note - float(voice.startNote_);
-    int pb = bipolar14bit(semis / pitchbendRange_);
-
     // LOG_1(std::cout  << "midi output c")
     // LOG_1(           << " note :" << note << " pb: " << pb << " semis: " << semis)
     // LOG_1(           << " y :" << y << " my: " << my)
     // LOG_1(           << " z :" << z << " mz: " << mz)
-    // LOG_1(           << " startnote :" << voice.startNote_ << " pbr: " << pitchbendRange_)
+    // LOG_1(           << " startnote :" << voices_.startNote_[id] << " pbr: " << pitchbendRange_)
     // LOG_1(           )
 
-    voice.note_ = note;
+    unsigned changed = update(id, note, my, mz);
+    if (changed == 0) return;
+
+    if (period_ == 0) {
+        sendChanged(id, changed);
+    } else {
+        mark(id, changed);
+    }
+}
+
+// store latest values of a voice
+unsigned MPE_Processor::update(unsigned id, float note, int my, unsigned mz) {
+    float semis = note - float(voices_.startNote_[id]);
+    int pb = bipolar14bit(semis / pitchbendRange_);
 
-    if (voice.pitchbend_ != pb) {
-        voice.pitchbend_ = pb;
-        pitchbend(ch, pb) ;
+    unsigned changed = 0;
+    if (voices_.pitchbend_[id] != pb) {
+        voices_.pitchbend_[id] = pb;
+        changed |= C_PITCHBEND;
     }
-    if (voice.timbre_ != my) {
-        voice.timbre_ = my;
-        cc(ch, TIMBRE_CC, my);
+    if (voices_.timbre_[id] != my) {
+        voices_.timbre_[id] = my;
+        changed |= C_TIMBRE;
     }
-    if (voice.pressure_ != mz) {
-        voice.pressure_ = mz;
-        pressure(ch, mz);
+    if (voices_.pressure_[id] != mz) {
+        voices_.pressure_[id] = mz;
+        changed |= C_PRESSURE;
     }
+    return changed;
 }
 
-void MPE_Processor::touchOff(int id, float note, float x, float y, float z) {
+// latest values are sent on next tick (or end of frame)
+void MPE_Processor::mark(unsigned id, unsigned changed) {
+    voices_.changed_[id] |= changed;
+    changedVoices_ |= 1ULL << id;
+}
 
-    VoiceData& voice = voices_[id];
+void MPE_Processor::touchOff(int id, float note, float x, float y, float z) {
+    if (id < 0 || id >= (int) MAX_VOICES || voices_.channel_[id] < 0) return;
 
-    unsigned ch = id + 1; // MPE starts on 2
+    unsigned ch = selectChannel(id);
     unsigned vel = 0.0f; // last vel = release velocity
     pressure(ch, 0.0f);
-    noteOff(ch, voice.startNote_ , vel);
-
-    voice.startNote_ = 0;
-    voice.note_ = 0.0f;
-    voice.pitchbend_ = 0.0f;
-    voice.timbre_ = 0.0f;
-    voice.pressure_ = 0.0f;//
+    noteOff(ch, voices_.startNote_[id] , vel);
+
+    voices_.startNote_[id] = 0;
+    voices_.pitchbend_[id] = 0;
+    voices_.timbre_[id] = 0;
+    voices_.pressure_[id] = 0;
+    // pending changes are for a note that has ended
+    voices_.changed_[id] = 0;
+    changedVoices_ &= ~(1ULL << id);
+
+    allocator_.release(voices_.channel_[id]);
+    voices_.channel_[id] = -1;
 }
 
 void MPE_Processor::control(int attr, float v) {
 
     if (global_[attr] != v ) {
         global_[attr] = v;
-        cc(0, attr, unipolar7bit(v));
+        // global, so to master channel of every zone
+        for (unsigned i = 0; i < allocator_.zoneCount(); i++) {
+            const MpeChannelAllocator::Zone& zone = allocator_.zone(i);
+            selectPort(zone.port_);
+            cc(zone.master(), attr, unipolar7bit(v));
+        }
         // cc(ch, attr, isBipolar ? bipolar7bit(v) : unipolar7bit(v));
     }
 }
 
+void MPE_Processor::sendZoneConfig() {
+    for (unsigned i = 0; i < allocator_.zoneCount(); i++) {
+        const MpeChannelAllocator::Zone& zone = allocator_.zone(i);
+        unsigned m = zone.master();
+        selectPort(zone.port_);
+        cc(m, 101, 0);
+        cc(m, 100, 6);
+        cc(m, 6, zone.members_);
+        // rpn null, so later data entry is not taken as mpe config
+        cc(m, 101, 127);
+        cc(m, 100, 127);
+    }
+}
+
 void MPE_Processor::mec_control(int cmd, void* other) {
     // ignored
     ;
 }
 
+/////////////////////////
+// output rate
+void MPE_Processor::setOutputRate(unsigned hz) {
+    period_ = hz > 0 ? 1000000000ULL / hz : 0;
+    nextTick_ = 0;
+    if (period_ == 0) {
+        // immediate, so send anything waiting now
+        tick(0);
+    }
+}
+
+void MPE_Processor::tick(MecTime now) {
+    if (now < nextTick_) return;
+    if (period_ > 0) {
+        // stay on a fixed grid, unless we have fallen behind
+        nextTick_ = (nextTick_ != 0 && now - nextTick_ < period_) ? nextTick_ + period_ : now + period_;
+    }
+    sendPending();
+}
+
+void MPE_Processor::sendPending() {
+    unsigned long long voices = changedVoices_;
+    changedVoices_ = 0;
+    for (unsigned id = 0; voices != 0; id++, voices >>= 1) {
+        if ((voices & 1) == 0) continue;
+        sendChanged(id, voices_.changed_[id]);
+        voices_.changed_[id] = 0;
+    }
+}
+
+unsigned MPE_Processor::selectChannel(unsigned id) {
+    const MpeChannelAllocator::Channel& c = allocator_.channel(voices_.channel_[id]);
+    selectPort(c.port_);
+    return c.ch_;
+}
+
+void MPE_Processor::sendChanged(unsigned id, unsigned changed) {
+    unsigned ch = selectChannel(id);
+    if (changed & C_PITCHBEND) pitchbend(ch, voices_.pitchbend_[id]);
+    if (changed & C_TIMBRE) cc(ch, TIMBRE_CC, voices_.timbre_[id]);
+    if (changed & C_PRESSURE) pressure(ch, voices_.pressure_[id]);
+}
+
+
+/////////////////////////
+// frame handling
+void MPE_Processor::frame(const TouchFrame& f) {
+    // convert continuous data for the whole frame first
+    int my[TouchFrame::MAX_TOUCHES];
+    unsigned mz[TouchFrame::MAX_TOUCHES];
+    for (unsigned i = 0; i < f.size_; i++) {
+        my[i] = bipolar7bit(f.y_[i]);
+        mz[i] = unipolar7bit(f.z_[i]);
+    }
+
+    // on/off are sent in frame order, continuous data is only marked
+    for (unsigned i = 0; i < f.size_; i++) {
+        int id = f.id_[i];
+        switch (f.state_[i]) {
+            case TouchFrame::T_ON:
+                MPE_Processor::touchOn(id, f.note_[i], f.x_[i], f.y_[i], f.z_[i]);
+                break;
+            case TouchFrame::T_CONTINUE: {
+                if (id < 0 || id >= (int) MAX_VOICES || voices_.channel_[id] < 0) break;
+                unsigned changed = update(id, f.note_[i], my[i], mz[i]);
+                if (changed) mark(id, changed);
+                break;
+            }
+            case TouchFrame::T_OFF:
+                MPE_Processor::touchOff(id, f.note_[i], f.x_[i], f.y_[i], f.z_[i]);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // immediate, so each changed voice is sent once per frame
+    if (period_ == 0) sendPending();
+}
+
 
 }
\ No newline at end of file
@@ -1,10 +1,19 @@
 #pragma once
 //////////////
 // this class can be used to process incoming callbacks and convert into Midi messages
-// define the process method to determine what to do with the midi message
+// define the process method to determine what to do with the midi message, or set a sink (see Midi_Processor)
+//
+// continuous data (pitchbend, timbre, pressure) is normally sent as touches arrive, i.e. at the device scan rate
+// with an output rate, changes are only marked, and tick() sends changed values at that fixed rate
+// note on/off are always sent immediately
+//
+// voices are given member channels by an MpeChannelAllocator, by default a single lower zone on port 0
+// more zones (or ports, see Midi_Processor::setSink) can be added, to go beyond 15 voices
 
 #include "../mec_api.h"
+#include "../mec_stats.h"
 #include "mec_midi_processor.h"
+#include "mec_mpe_allocator.h"
 #include <list>
 
 namespace mec {
@@ -14,8 +23,6 @@ public:
     MPE_Processor(float pbr = 48.0);
     virtual ~MPE_Processor();
 
-    virtual void  process(MidiMsg& msg) = 0;
-
     // ICallback handling
     virtual void touchOn(int touchId, float note, float x, float y, float z);
     virtual void touchContinue(int touchId, float note, float x, float y, float z);
@@ -23,17 +30,54 @@ public:
     virtual void control(int ctrlId, float v);
     virtual void mec_control(int cmd, void* other); //ignores
 
+    // process a whole frame in one pass, e.g. from an IFrameCallback
+    // (use instead of subscribing as an ICallback, not as well as, see MecApi::subscribe)
+    // continuous data is converted for the whole frame, then changed voices are sent once at the end
+    void frame(const TouchFrame& f);
+
+    // continuous output rate in hz, 0 = immediate (default)
+    void setOutputRate(unsigned hz);
+    // send changed continuous data, if a tick is due
+    void tick(MecTime now = mecTimeNow());
+    bool isPending() const { return changedVoices_ != 0; } // changes waiting for a tick
+    MecTime nextTick() const { return nextTick_; }
+
+    // zones, configure before use, then send config to the outputs with sendZoneConfig
+    MpeChannelAllocator& channels() { return allocator_; }
+    // mpe configuration message (rpn 6) on master channel of each zone
+    void sendZoneConfig();
+
+    static const unsigned MAX_VOICES = 64; // touch ids beyond this are ignored
+
 private:
 
-    struct VoiceData {
-        unsigned    startNote_;
-        unsigned    note_;      //0
-        int         pitchbend_; //1
-        int         timbre_;    //2
-        unsigned    pressure_;  //3
+    enum {
+        C_PITCHBEND = 1 << 0,
+        C_TIMBRE = 1 << 1,
+        C_PRESSURE = 1 << 2
+    };
+
+    unsigned update(unsigned id, float note, int my, unsigned mz); // returns C_ mask of changes
+    void mark(unsigned id, unsigned changed);
+    void sendPending();
+    void sendChanged(unsigned id, unsigned changed);
+    unsigned selectChannel(unsigned id); // sets port for voice, returns channel
+
+    // voice state, as structure of arrays, by voice (touch id)
+    struct Voices {
+        int         channel_[MAX_VOICES]; // allocator index, -1 = not on
+        unsigned    startNote_[MAX_VOICES];
+        int         pitchbend_[MAX_VOICES];
+        int         timbre_[MAX_VOICES];
+        unsigned    pressure_[MAX_VOICES];
+        unsigned    changed_[MAX_VOICES]; // C_ mask, not yet sent
     };
 
-    VoiceData voices_[16];
+    Voices voices_;
+    unsigned long long changedVoices_; // bit per voice with changed_ set
+    MpeChannelAllocator allocator_;
+    MecTime period_; // ns, 0 = immediate
+    MecTime nextTick_;
 };
 
 }
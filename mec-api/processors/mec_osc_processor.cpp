@@ -0,0 +1,231 @@
+#include "mec_osc_processor.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace mec {
+
+static const char BUNDLE_HEADER[16] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0, 0, 0, 0, 0, 0, 0, 0, 1}; // immediate
+
+static inline void putInt32(char *p, uint32_t v) {
+    p[0] = static_cast<char>(v >> 24);
+    p[1] = static_cast<char>(v >> 16);
+    p[2] = static_cast<char>(v >> 8);
+    p[3] = static_cast<char>(v);
+}
+
+static inline void putFloat(char *p, float f) {
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    putInt32(p, v);
+}
+
+static inline uint32_t getInt32(const char *p) {
+    const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+    return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | uint32_t(u[3]);
+}
+
+// osc strings are null terminated, and padded to 4 bytes
+static inline unsigned padded(unsigned len) {
+    return (len + 4) & ~3u;
+}
+
+
+OSC_Processor::OSC_Processor(IOscSink *sink) :
+    sink_(sink),
+    mtu_(DEFAULT_MTU),
+    frameMessages_(false),
+    frameId_(0),
+    changedVoices_(0),
+    eventsSize_(0),
+    packetSize_(0),
+    packetMsgs_(0),
+    period_(0),
+    nextTick_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+    char address[32];
+    for (unsigned i = 0; i < MAX_VOICES; i++) {
+        snprintf(address, sizeof(address), "/t3d/tch%u", i);
+        encode(voices_[i], address, ",ffff");
+    }
+    encode(control_, "/t3d/control", ",if");
+    encode(frame_, "/t3d/frm", ",ii");
+}
+
+OSC_Processor::~OSC_Processor() {
+    ;
+}
+
+void OSC_Processor::encode(Template &t, const char *address, const char *types) {
+    memset(t.data_, 0, sizeof(t.data_));
+    unsigned alen = static_cast<unsigned>(strlen(address));
+    unsigned tlen = static_cast<unsigned>(strlen(types));
+    memcpy(t.data_, address, alen);
+    memcpy(t.data_ + padded(alen), types, tlen);
+    t.payload_ = padded(alen) + padded(tlen);
+    t.size_ = t.payload_ + 4 * (tlen - 1); // 4 bytes per argument (i and f only)
+}
+
+void OSC_Processor::setMtu(unsigned bytes) {
+    // a bundle must at least hold one message
+    static const unsigned MIN_MTU = sizeof(BUNDLE_HEADER) + 4 + MAX_MSG_SIZE;
+    mtu_ = bytes < MIN_MTU ? MIN_MTU : (bytes > MAX_MTU ? MAX_MTU : bytes);
+}
+
+/////////////////////////
+// output rate
+void OSC_Processor::setOutputRate(unsigned hz) {
+    period_ = hz > 0 ? 1000000000ULL / hz : 0;
+    nextTick_ = 0;
+}
+
+bool OSC_Processor::flush(MecTime now) {
+    if (period_ > 0) {
+        if (now < nextTick_) return true;
+        // stay on a fixed grid, unless we have fallen behind
+        nextTick_ = (nextTick_ != 0 && now - nextTick_ < period_) ? nextTick_ + period_ : now + period_;
+    }
+    if (!isPending()) return true;
+
+    bool ret = true;
+    beginBundle();
+    if (frameMessages_) {
+        putInt32(frame_.data_ + frame_.payload_, frameId_++);
+        putInt32(frame_.data_ + frame_.payload_ + 4, static_cast<uint32_t>(now / 1000000));
+        ret = addToBundle(frame_.data_, frame_.size_) && ret;
+    }
+
+    for (unsigned pos = 0; pos < eventsSize_;) {
+        unsigned size = getInt32(events_ + pos);
+        ret = addToBundle(events_ + pos + 4, size) && ret;
+        pos += 4 + size;
+    }
+    eventsSize_ = 0;
+
+    unsigned long long voices = changedVoices_;
+    changedVoices_ = 0;
+    for (unsigned id = 0; voices != 0; id++, voices >>= 1) {
+        if ((voices & 1) == 0) continue;
+        ret = addToBundle(voices_[id].data_, voices_[id].size_) && ret;
+    }
+    return endBundle() && ret;
+}
+
+/////////////////////////
+// ICallback interface
+void OSC_Processor::touchOn(int id, float note, float x, float y, float z) {
+    if (id < 0 || id >= (int) MAX_VOICES) return;
+    setTouch(id, note, x, y, z);
+    addEvent(voices_[id]);
+    // sent with latest values, so nothing pending from a previous touch
+    changedVoices_ &= ~(1ULL << id);
+}
+
+void OSC_Processor::touchContinue(int id, float note, float x, float y, float z) {
+    if (id < 0 || id >= (int) MAX_VOICES) return;
+    setTouch(id, note, x, y, z);
+    if (period_ == 0) {
+        addEvent(voices_[id]);
+        return;
+    }
+    // latest values are sent on next tick
+    if (changedVoices_ & (1ULL << id)) stats_.coalesced_++;
+    changedVoices_ |= 1ULL << id;
+}
+
+void OSC_Processor::touchOff(int id, float note, float x, float y, float z) {
+    if (id < 0 || id >= (int) MAX_VOICES) return;
+    setTouch(id, note, x, y, 0.0f);
+    addEvent(voices_[id]);
+    // pending changes are for a touch that has ended
+    changedVoices_ &= ~(1ULL << id);
+}
+
+void OSC_Processor::control(int ctrlId, float v) {
+    putInt32(control_.data_ + control_.payload_, static_cast<uint32_t>(ctrlId));
+    putFloat(control_.data_ + control_.payload_ + 4, v);
+    addEvent(control_);
+}
+
+void OSC_Processor::mec_control(int, void *) {
+    // ignored
+    ;
+}
+
+void OSC_Processor::frame(const TouchFrame &f) {
+    for (unsigned i = 0; i < f.size_; i++) {
+        switch (f.state_[i]) {
+            case TouchFrame::T_ON:
+                OSC_Processor::touchOn(f.id_[i], f.note_[i], f.x_[i], f.y_[i], f.z_[i]);
+                break;
+            case TouchFrame::T_CONTINUE:
+                OSC_Processor::touchContinue(f.id_[i], f.note_[i], f.x_[i], f.y_[i], f.z_[i]);
+                break;
+            case TouchFrame::T_OFF:
+                OSC_Processor::touchOff(f.id_[i], f.note_[i], f.x_[i], f.y_[i], f.z_[i]);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/////////////////////////
+// encoding
+void OSC_Processor::setTouch(unsigned id, float note, float x, float y, float z) {
+    char *p = voices_[id].data_ + voices_[id].payload_;
+    putFloat(p, x);
+    putFloat(p + 4, y);
+    putFloat(p + 8, z);
+    putFloat(p + 12, note);
+}
+
+void OSC_Processor::addEvent(const Template &t) {
+    if (eventsSize_ + 4 + t.size_ > EVENTS_CAPACITY) {
+        // buffer full, send what we have (regardless of output rate), rather than drop
+        MecTime next = nextTick_;
+        nextTick_ = 0;
+        flush(mecTimeNow());
+        if (period_ > 0) nextTick_ = next;
+    }
+    putInt32(events_ + eventsSize_, t.size_);
+    memcpy(events_ + eventsSize_ + 4, t.data_, t.size_);
+    eventsSize_ += 4 + t.size_;
+}
+
+void OSC_Processor::beginBundle() {
+    memcpy(packet_, BUNDLE_HEADER, sizeof(BUNDLE_HEADER));
+    packetSize_ = sizeof(BUNDLE_HEADER);
+    packetMsgs_ = 0;
+}
+
+bool OSC_Processor::addToBundle(const char *data, unsigned size) {
+    bool ret = true;
+    if (packetMsgs_ > 0 && packetSize_ + 4 + size > mtu_) {
+        ret = endBundle();
+        beginBundle();
+    }
+    putInt32(packet_ + packetSize_, size);
+    memcpy(packet_ + packetSize_ + 4, data, size);
+    packetSize_ += 4 + size;
+    packetMsgs_++;
+    stats_.messages_++;
+    return ret;
+}
+
+bool OSC_Processor::endBundle() {
+    if (packetMsgs_ == 0) return true;
+    packetMsgs_ = 0;
+    return send(packet_, packetSize_);
+}
+
+bool OSC_Processor::send(const char *data, unsigned size) {
+    stats_.packets_++;
+    stats_.bytes_ += size;
+    if (sink_ != nullptr && sink_->send(data, size)) return true;
+    stats_.sendErrors_++;
+    return false;
+}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+//////////////
+// this class can be used to process incoming callbacks and convert into T3D style osc messages
+// /t3d/tch<id> x y z note, /t3d/control id v, optionally /t3d/frm id ms at the start of each bundle
+//
+// messages are pre-encoded per touch id (address and type tags), so only the float payload is patched
+// everything generated between flushes (e.g. one MecApi::process) is sent as one bundle to the sink
+// split into several bundles if larger than the mtu
+//
+// with an output rate, flush() only sends when a tick is due, so packets are sent at most at that rate
+// touch continues are then coalesced, the latest value per touch is sent, on/off and controls are never dropped
+
+#include "../mec_api.h"
+
+namespace mec {
+
+// bulk osc output, data is one complete osc packet (a bundle)
+class IOscSink {
+public:
+    virtual ~IOscSink() {};
+    virtual bool send(const char *data, unsigned size) = 0;
+};
+
+class OSC_Processor : public ICallback {
+public:
+    static const unsigned MAX_VOICES = 64; // touch ids beyond this are ignored
+    static const unsigned DEFAULT_MTU = 1472; // ethernet, less ip and udp headers
+    static const unsigned MAX_MTU = 8192;
+
+    struct Stats {
+        unsigned long long messages_;
+        unsigned long long packets_;
+        unsigned long long bytes_;
+        unsigned long long coalesced_; // continues replaced by a later value, before being sent
+        unsigned long long sendErrors_;
+    };
+
+    OSC_Processor(IOscSink *sink = nullptr);
+    virtual ~OSC_Processor();
+
+    void setSink(IOscSink *sink) { sink_ = sink; }
+    void setMtu(unsigned bytes); // max packet size
+    void setFrameMessages(bool b) { frameMessages_ = b; }
+
+    // max packets per second in hz, 0 = every flush (default)
+    void setOutputRate(unsigned hz);
+    bool isPending() const { return eventsSize_ > 0 || changedVoices_ != 0; } // waiting for a tick
+    MecTime nextTick() const { return nextTick_; }
+
+    // send buffered messages to sink, if a tick is due, false if a send failed
+    bool flush(MecTime now = mecTimeNow());
+
+    // ICallback handling
+    virtual void touchOn(int touchId, float note, float x, float y, float z);
+    virtual void touchContinue(int touchId, float note, float x, float y, float z);
+    virtual void touchOff(int touchId, float note, float x, float y, float z);
+    virtual void control(int ctrlId, float v);
+    virtual void mec_control(int cmd, void *other); //ignores
+
+    // process a whole frame in one pass, e.g. from an IFrameCallback
+    void frame(const TouchFrame &f);
+
+    const Stats &stats() const { return stats_; }
+
+private:
+    static const unsigned MAX_MSG_SIZE = 64;
+    static const unsigned EVENTS_CAPACITY = 4096;
+
+    // an encoded message, payload_ is the offset of the arguments
+    struct Template {
+        char data_[MAX_MSG_SIZE];
+        unsigned size_;
+        unsigned payload_;
+    };
+
+    static void encode(Template &t, const char *address, const char *types);
+    void setTouch(unsigned id, float note, float x, float y, float z);
+    void addEvent(const Template &t);
+    bool send(const char *data, unsigned size);
+
+    void beginBundle();
+    bool addToBundle(const char *data, unsigned size);
+    bool endBundle();
+
+    IOscSink *sink_;
+    unsigned mtu_;
+    bool frameMessages_;
+    unsigned frameId_;
+
+    Template voices_[MAX_VOICES];
+    unsigned long long changedVoices_; // bit per voice, continue not yet sent (output rate only)
+    Template control_;
+    Template frame_;
+
+    // on/off/control (and continues without an output rate), as bundle elements
+    char events_[EVENTS_CAPACITY];
+    unsigned eventsSize_;
+
+    char packet_[MAX_MTU];
+    unsigned packetSize_;
+    unsigned packetMsgs_;
+
+    MecTime period_; // ns, 0 = every flush
+    MecTime nextTick_;
+    Stats stats_;
+};
+
+}
@@ -0,0 +1,114 @@
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <vector>
+
+#include <mec_voice.h>
+
+// microbenchmark of mec::Voices against the previous std::list based allocator
+// simulates a stream of key events (lookup, start/steal, stop) as a device handler does
+
+// previous implementation (velocity detection omitted, as unchanged)
+class ListVoices {
+public:
+    struct Voice {
+        int i_;
+        int id_;
+    };
+
+    ListVoices(unsigned voiceCount) : maxVoices_(voiceCount) {
+        voices_.resize(maxVoices_);
+        for (unsigned i = 0; i < maxVoices_; i++) {
+            voices_[i].i_ = i;
+            voices_[i].id_ = -1;
+            freeVoices_.push_back(&voices_[i]);
+        }
+    }
+
+    Voice *voiceId(unsigned id) {
+        for (unsigned i = 0; i < maxVoices_; i++) {
+            if (voices_[i].id_ == (int) id) return &voices_[i];
+        }
+        return nullptr;
+    }
+
+    Voice *startVoice(unsigned id) {
+        if (freeVoices_.empty()) return nullptr;
+        Voice *voice = freeVoices_.front();
+        freeVoices_.pop_front();
+        voice->id_ = id;
+        usedVoices_.push_back(voice);
+        return voice;
+    }
+
+    void stopVoice(Voice *voice) {
+        usedVoices_.remove(voice);
+        voice->id_ = -1;
+        freeVoices_.push_back(voice);
+    }
+
+    Voice *oldestActiveVoice() { return usedVoices_.front(); }
+
+private:
+    std::vector<Voice> voices_;
+    std::list<Voice *> freeVoices_;
+    std::list<Voice *> usedVoices_;
+    unsigned maxVoices_;
+};
+
+
+static const unsigned N_KEYS = 132;
+static const unsigned N_EVENTS = 5000000;
+
+struct KeyEvent {
+    unsigned key_;
+    bool on_;
+};
+
+template<typename VOICES>
+static double run(VOICES &voices, const std::vector<KeyEvent> &events, unsigned &checksum) {
+    auto start = std::chrono::steady_clock::now();
+    for (const KeyEvent &e : events) {
+        auto voice = voices.voiceId(e.key_);
+        if (e.on_) {
+            if (!voice) {
+                voice = voices.startVoice(e.key_);
+                if (!voice) {
+                    voices.stopVoice(voices.oldestActiveVoice());
+                    voice = voices.startVoice(e.key_);
+                }
+            }
+            checksum += voice->i_;
+        } else if (voice) {
+            voices.stopVoice(voice);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / events.size();
+}
+
+int main(int argc, char **argv) {
+    // mostly continues on held keys, with some key on/offs
+    std::vector<KeyEvent> events(N_EVENTS);
+    unsigned long long seed = 12345;
+    for (KeyEvent &e : events) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        e.key_ = static_cast<unsigned>((seed >> 33) % N_KEYS);
+        e.on_ = ((seed >> 20) & 7) != 0;
+    }
+
+    for (unsigned voiceCount : {4, 15, 32}) {
+        unsigned c1 = 0, c2 = 0;
+        ListVoices listVoices(voiceCount);
+        mec::Voices voices(voiceCount);
+        double tList = run(listVoices, events, c1);
+        double tVoices = run(voices, events, c2);
+        std::cout << "voices: " << voiceCount
+                  << " list: " << tList << " ns/event"
+                  << " mec::Voices: " << tVoices << " ns/event"
+                  << " speedup: " << tList / tVoices
+                  << (c1 == c2 ? "" : " (allocation differs!)")
+                  << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <cassert>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <mec_byte_ring.h>
+#include <mec_log.h>
+
+// record n has size (n % 700) + 1, filled with n
+static unsigned testSize(unsigned n) { return (n % 700) + 1; }
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    // variable sizes, in place, several records peeked before release
+    {
+        mec::ByteRing ring(1024);
+        assert(ring.capacity() == 1024 && ring.maxSize() == 508 && ring.isEmpty());
+        char big[500];
+        memset(big, 'b', sizeof(big));
+        assert(ring.write("a", 1));
+        assert(ring.write(big, sizeof(big))); // larger than the old fixed 256 byte slots
+        assert(ring.write("cc", 2));
+        assert(ring.pending() == 8 + 504 + 8);
+
+        unsigned pos = ring.begin(), size;
+        const char *a = ring.peek(pos, size);
+        assert(a && size == 1 && a[0] == 'a');
+        const char *b = ring.peek(pos, size);
+        assert(b && size == sizeof(big) && memcmp(b, big, size) == 0);
+        const char *c = ring.peek(pos, size);
+        assert(c && size == 2 && c[1] == 'c');
+        assert(ring.peek(pos, size) == nullptr);
+        assert(!ring.isEmpty());
+        ring.release(pos);
+        assert(ring.isEmpty());
+
+        // too large for this ring
+        assert(ring.reserve(ring.maxSize() + 1) == nullptr);
+    }
+
+    // full, then wraparound with padding
+    {
+        mec::ByteRing ring(256);
+        char data[100];
+        memset(data, 'x', sizeof(data));
+        assert(ring.write(data, 100));
+        assert(ring.write(data, 100));
+        assert(ring.reserve(100) == nullptr); // 208 used, 104 needed
+        assert(!ring.waitForSpace(100, std::chrono::microseconds(100)));
+        ring.drop();
+        assert(ring.dropped() == 1);
+
+        // consume one, next record does not fit before the end, so starts at the beginning
+        unsigned pos = ring.begin(), size;
+        assert(ring.peek(pos, size) && size == 100);
+        ring.release(pos);
+        char *p = ring.reserve(60);
+        assert(p != nullptr);
+        memset(p, 'y', 60);
+        ring.commit();
+        assert(ring.pending() == 104 + 48 + 64); // record, padding, record
+
+        pos = ring.begin();
+        assert(ring.peek(pos, size) && size == 100);
+        const char *y = ring.peek(pos, size);
+        assert(y && size == 60 && y[0] == 'y' && y[59] == 'y');
+        assert(ring.peek(pos, size) == nullptr);
+        ring.release(pos);
+        assert(ring.isEmpty());
+
+        ring.write(data, 10);
+        ring.flush();
+        assert(ring.isEmpty());
+    }
+
+    // a waiting producer is woken by release, not by its timeout
+    {
+        mec::ByteRing ring(256);
+        char data[100];
+        memset(data, 'x', sizeof(data));
+        assert(ring.write(data, 100) && ring.write(data, 100));
+        auto start = std::chrono::steady_clock::now();
+        std::thread consumer([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            ring.flush();
+        });
+        assert(ring.waitForSpace(100, std::chrono::seconds(5)));
+        assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+        consumer.join();
+        assert(ring.write(data, 100));
+    }
+
+    // producer and consumer threads, producer waits for space rather than dropping
+    {
+        static const unsigned N = 100000;
+        mec::ByteRing ring(4096);
+        unsigned received = 0, bad = 0;
+        std::thread consumer([&] {
+            while (received < N) {
+                unsigned pos = ring.begin(), size;
+                while (const char *data = ring.peek(pos, size)) {
+                    if (size != testSize(received) || (unsigned char) data[size - 1] != (received & 0xff)) bad++;
+                    received++;
+                }
+                ring.release(pos);
+                std::this_thread::yield();
+            }
+        });
+        char data[1024];
+        for (unsigned n = 0; n < N; n++) {
+            unsigned size = testSize(n);
+            char *p = ring.reserve(size);
+            while (p == nullptr) {
+                ring.waitForSpace(size, std::chrono::microseconds(1000));
+                p = ring.reserve(size);
+            }
+            memset(data, n & 0xff, size);
+            memcpy(p, data, size);
+            ring.commit();
+        }
+        consumer.join();
+        assert(received == N && bad == 0 && ring.dropped() == 0 && ring.isEmpty());
+    }
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include <mec_api.h>
+
+#include <cassert>
+
+#include <mec_jitter_buffer.h>
+#include <mec_log.h>
+#include <mec_msg_queue.h>
+
+static const mec::MecTime MS = 1000000; // ns
+
+static void frame(mec::JitterBuffer &jb, unsigned id, mec::MecTime t, unsigned touches) {
+    jb.beginFrame(id, t);
+    for (unsigned i = 0; i < touches; i++) {
+        mec::MecMsg msg;
+        msg.type_ = mec::MecMsg::TOUCH_CONTINUE;
+        msg.deviceTime_ = t;
+        msg.data_.touch_.touchId_ = i;
+        msg.data_.touch_.note_ = float(id);
+        jb.add(msg);
+    }
+    jb.endFrame();
+}
+
+// frames in queue, checks each is whole, returns id (note) of last
+static unsigned frames(mec::MsgQueue &q, unsigned &n) {
+    mec::MecMsg m;
+    unsigned id = 0, touches = 0;
+    n = 0;
+    while (q.nextMsg(m)) {
+        if (m.type_ == mec::MecMsg::FRAME) {
+            assert(touches > 0);
+            touches = 0;
+            n++;
+        } else {
+            id = unsigned(m.data_.touch_.note_);
+            touches++;
+        }
+    }
+    assert(touches == 0);
+    return id;
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    // no depth, released when complete, empty frames have nothing to deliver
+    {
+        mec::MsgQueue q;
+        mec::JitterBuffer jb(q);
+        frame(jb, 1, 1 * MS, 3);
+        assert(q.isEmpty());
+        assert(jb.release(1 * MS) == 0);
+        assert(q.pending() == 4);
+        frame(jb, 2, 2 * MS, 0);
+        jb.release(2 * MS);
+        assert(q.pending() == 4);
+
+        // lost and late frames counted
+        frame(jb, 5, 3 * MS, 1);
+        frame(jb, 4, 4 * MS, 1);
+        jb.release(4 * MS);
+        assert(jb.stats().lost_ == 2 && jb.stats().late_ == 1 && jb.stats().released_ == 4);
+    }
+
+    // a frame is queued whole, or not at all
+    {
+        mec::MsgQueue q(4);
+        mec::JitterBuffer jb(q);
+        frame(jb, 1, 1 * MS, 4);
+        jb.release(1 * MS);
+        assert(q.isEmpty() && q.overflows() == 5 && jb.stats().dropped_ == 1);
+        frame(jb, 2, 2 * MS, 3);
+        jb.release(2 * MS);
+        assert(q.pending() == 4);
+    }
+
+    // on/off are never dropped, a full frame continues in another, released with it
+    {
+        mec::MsgQueue q;
+        mec::JitterBuffer jb(q, 2);
+        frame(jb, 1, 1 * MS, 1);
+        jb.beginFrame(2, 2 * MS);
+        mec::MecMsg msg;
+        msg.type_ = mec::MecMsg::TOUCH_CONTINUE;
+        for (unsigned i = 0; i < mec::JitterBuffer::MAX_FRAME_MSGS; i++) assert(jb.add(msg));
+        assert(!jb.add(msg) && jb.stats().truncated_ == 1);
+        msg.type_ = mec::MecMsg::TOUCH_OFF;
+        assert(jb.add(msg));
+        jb.endFrame();
+        assert(jb.buffered() == 3);
+        jb.release(2 * MS);
+        assert(jb.stats().released_ == 1 && jb.buffered() == 2);
+        jb.release(3 * MS);
+        assert(jb.stats().released_ == 3 && jb.buffered() == 0);
+        unsigned offs = 0;
+        while (q.nextMsg(msg)) offs += msg.type_ == mec::MecMsg::TOUCH_OFF;
+        assert(offs == 1);
+    }
+
+    // queue full, on/off of a dropped frame are held until there is room, in order
+    {
+        mec::MsgQueue q(8);
+        mec::JitterBuffer jb(q);
+        frame(jb, 1, 1 * MS, 7);
+        jb.release(1 * MS);
+        jb.beginFrame(2, 2 * MS);
+        mec::MecMsg msg;
+        msg.type_ = mec::MecMsg::TOUCH_CONTINUE;
+        msg.data_.touch_.touchId_ = 0;
+        jb.add(msg);
+        msg.type_ = mec::MecMsg::TOUCH_OFF;
+        for (int i = 0; i < 3; i++) {
+            msg.data_.touch_.touchId_ = i;
+            jb.add(msg);
+        }
+        jb.endFrame();
+        assert(jb.release(2 * MS) != 0); // retry due
+        assert(jb.stats().dropped_ == 1 && q.isFull() && jb.held() == 3);
+
+        while (q.nextMsg(msg)) { ; }
+        frame(jb, 3, 3 * MS, 1);
+        assert(jb.release(3 * MS) == 0 && jb.held() == 0);
+        int next = 0;
+        while (q.nextMsg(msg)) {
+            if (msg.type_ == mec::MecMsg::TOUCH_OFF) assert(msg.data_.touch_.touchId_ == next++);
+            else if (msg.type_ == mec::MecMsg::TOUCH_CONTINUE) assert(next == 3); // after held offs
+        }
+        assert(next == 3);
+    }
+
+    // playout, frames arrive in bursts, released one per period after depth frames
+    {
+        mec::MsgQueue q;
+        mec::JitterBuffer jb(q, 2);
+        unsigned n;
+
+        frame(jb, 1, 10 * MS, 1);
+        jb.release(10 * MS); // no period estimate yet, released
+        assert(frames(q, n) == 1 && n == 1);
+
+        frame(jb, 2, 11 * MS, 1);
+        assert(jb.release(11 * MS) == 0 && q.isEmpty()); // buffering
+        assert(jb.period() == 1 * MS);
+
+        frame(jb, 3, 12 * MS, 1);
+        assert(jb.release(12 * MS) == 13 * MS);
+        assert(frames(q, n) == 2 && n == 1);
+
+        // burst of 3, after a gap
+        frame(jb, 4, 14 * MS, 1);
+        frame(jb, 5, 14 * MS, 1);
+        frame(jb, 6, 14 * MS, 1);
+        mec::MecTime next = jb.release(13 * MS);
+        assert(frames(q, n) == 3 && n == 1);
+        assert(next > 13 * MS && next < 15 * MS);
+        assert(jb.buffered() == 3);
+
+        // steady release, not all at once
+        next = jb.release(next);
+        assert(frames(q, n) == 4 && n == 1);
+        next = jb.release(next);
+        assert(frames(q, n) == 5 && n == 1);
+        next = jb.release(next);
+        assert(frames(q, n) == 6 && n == 1);
+
+        // nothing arrived, underrun, rebuffers
+        assert(jb.release(next) == 0 && jb.stats().underruns_ == 1);
+        frame(jb, 7, 20 * MS, 1);
+        assert(jb.release(20 * MS) == 0 && q.isEmpty());
+
+        // too far behind, catches up to depth
+        for (unsigned i = 8; i < 14; i++) frame(jb, i, 20 * MS, 1);
+        jb.release(20 * MS);
+        assert(jb.stats().overruns_ > 0 && jb.buffered() <= 4);
+    }
+
+    LOG_0("test completed");
+    return 0;
+}
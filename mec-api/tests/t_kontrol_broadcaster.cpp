@@ -0,0 +1,165 @@
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <KontrolModel.h>
+#include <OSCBroadcaster.h>
+#include <mec_log.h>
+#include <mec_udp_receiver.h>
+
+#include <osc/OscReceivedElements.h>
+
+// counts /Kontrol/changed, as a client would receive them
+class TestClient : public PacketListener {
+public:
+    void ProcessPacket(const char *data, int size, const IpEndpointName &) override {
+        osc::ReceivedPacket p(data, size);
+        if (!p.IsBundle()) return;
+        osc::ReceivedBundle b(p);
+        for (auto e = b.ElementsBegin(); e != b.ElementsEnd(); e++) {
+            osc::ReceivedMessage m(*e);
+            if (strcmp(m.AddressPattern(), "/Kontrol/changed") != 0) continue;
+            changed_++;
+            auto arg = m.ArgumentsBegin();
+            arg++;
+            arg++;
+            const char *paramId = (arg++)->AsString();
+            if (strcmp(paramId, "o_level") == 0) {
+                level_ = arg->AsFloat();
+                levels_++;
+            } else if (strcmp(paramId, "r_mix") == 0) {
+                mixes_++;
+            }
+        }
+        packets_++;
+    }
+
+    unsigned changed_ = 0, packets_ = 0, levels_ = 0, mixes_ = 0;
+    float level_ = 0.0f;
+};
+
+static void receive(mec::UdpReceiver &r, TestClient &c, unsigned count) {
+    while (c.changed_ < count && r.receive(500000) > 0);
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    auto model = Kontrol::KontrolModel::model();
+    std::string host = "127.0.0.1";
+    Kontrol::EntityId rackId = Kontrol::Rack::createId(host, 9001);
+    model->createRack(Kontrol::CS_LOCAL, rackId, host, 9001);
+    model->createModule(Kontrol::CS_LOCAL, rackId, "module1", "Poly Synth", "polysynth");
+    model->createParam(Kontrol::CS_LOCAL, rackId, "module1", {"pct", "o_level", "level", 0.0f, 100.0f, 100.0f});
+    model->createParam(Kontrol::CS_LOCAL, rackId, "module1", {"pct", "r_mix", "mix", 0.0f, 100.0f, 50.0f});
+    model->createParam(Kontrol::CS_LOCAL, rackId, "module1", {"int", "r_type", "type", 0.0f, 100.0f, 0.0f});
+
+    TestClient a, b;
+    mec::UdpReceiver ra(&a), rb(&b);
+    assert(ra.open(0) && rb.open(0));
+
+    // both clients share one broadcaster, no keep alive, so always active
+    auto broadcaster = std::make_shared<Kontrol::OSCBroadcaster>(Kontrol::CS_LOCAL, 0, true);
+    Kontrol::ChangeSource srcA(Kontrol::ChangeSource::REMOTE, "a");
+    Kontrol::ChangeSource srcB(Kontrol::ChangeSource::REMOTE, "b");
+    assert(broadcaster->addClient(srcA, host, ra.port(), 0));
+    assert(broadcaster->addClient(srcB, host, rb.port(), 0));
+    assert(!broadcaster->addClient(srcB, host, rb.port(), 0));
+    assert(broadcaster->isThisHost(host, rb.port()) && broadcaster->isActive());
+    model->addCallback("test.osc", broadcaster);
+
+    // local changes to both
+    for (unsigned i = 0; i < 10; i++) {
+        model->changeParam(Kontrol::CS_LOCAL, rackId, "module1", "o_level", Kontrol::ParamValue(float(i)));
+    }
+    receive(ra, a, 10);
+    receive(rb, b, 10);
+    assert(a.changed_ == 10 && b.changed_ == 10);
+
+    // not back to the client it came from
+    model->changeParam(srcB, rackId, "module1", "o_level", Kontrol::ParamValue(50.0f));
+    receive(ra, a, 11);
+    assert(a.changed_ == 11);
+    assert(rb.receive(100000) == 0 && b.changed_ == 10);
+
+    // ping from a new client, meta data only to it, later changes to both again
+    broadcaster->ping(srcB, host, rb.port(), 0);
+    receive(rb, b, 13);
+    assert(b.changed_ == 13 && b.level_ == 50.0f);
+    assert(ra.receive(100000) == 0 && a.changed_ == 11);
+    model->changeParam(Kontrol::CS_LOCAL, rackId, "module1", "o_level", Kontrol::ParamValue(51.0f));
+    receive(ra, a, 12);
+    receive(rb, b, 14);
+    assert(a.changed_ == 12 && b.changed_ == 14);
+
+    model->removeCallback("test.osc");
+    broadcaster->stop();
+    assert(!broadcaster->isActive());
+
+    // changes from two threads at once, each queued whole
+    {
+        TestClient c;
+        mec::UdpReceiver rc(&c);
+        assert(rc.open(0));
+        auto concurrent = std::make_shared<Kontrol::OSCBroadcaster>(Kontrol::CS_LOCAL, 0, true);
+        assert(concurrent->addClient(srcA, host, rc.port(), 0));
+        auto rack = model->getRack(rackId);
+        auto module = model->getModule(rack, "module1");
+        auto level = model->getParam(module, "o_level");
+        auto mix = model->getParam(module, "r_mix");
+
+        // paced, so the client's socket buffer does not overflow
+        const unsigned N = 2000;
+        std::atomic<bool> go(false);
+        auto changes = [&](std::shared_ptr<Kontrol::Parameter> p) {
+            while (!go);
+            for (unsigned i = 0; i < N; i++) {
+                concurrent->changed(Kontrol::CS_LOCAL, *rack, *module, *p);
+                if (i % 20 == 19) std::this_thread::sleep_for(std::chrono::microseconds(500));
+            }
+        };
+        std::thread t1(changes, level), t2(changes, mix);
+        go = true;
+        receive(rc, c, 2 * N);
+        t1.join();
+        t2.join();
+        receive(rc, c, 2 * N);
+        assert(c.changed_ == 2 * N && c.packets_ == 2 * N && concurrent->dropped() == 0);
+        assert(c.levels_ == N && c.mixes_ == N);
+        concurrent->stop();
+    }
+
+    // coalesced, latest value per parameter, in one bundle. discrete parameters not coalesced
+    {
+        TestClient c;
+        mec::UdpReceiver rc(&c);
+        assert(rc.open(0));
+        auto coalescing = std::make_shared<Kontrol::OSCBroadcaster>(Kontrol::CS_LOCAL, 0, true);
+        coalescing->setCoalesce(50);
+        assert(coalescing->addClient(srcA, host, rc.port(), 0));
+        model->addCallback("test.coalesce", coalescing);
+
+        for (unsigned i = 1; i <= 20; i++) {
+            model->changeParam(Kontrol::CS_LOCAL, rackId, "module1", "o_level", Kontrol::ParamValue(float(i)));
+            model->changeParam(Kontrol::CS_LOCAL, rackId, "module1", "r_mix", Kontrol::ParamValue(float(i)));
+        }
+        for (unsigned i = 1; i <= 5; i++) {
+            model->changeParam(Kontrol::CS_LOCAL, rackId, "module1", "r_type", Kontrol::ParamValue(float(i)));
+        }
+        receive(rc, c, 5); // discrete, immediately
+        assert(c.changed_ == 5 && c.packets_ == 5);
+
+        receive(rc, c, 7);
+        assert(c.changed_ == 7 && c.packets_ == 6 && c.level_ == 20.0f);
+        assert(coalescing->coalesced() == 38);
+
+        model->removeCallback("test.coalesce");
+        coalescing->stop();
+    }
+
+    LOG_0("test completed");
+    return 0;
+}
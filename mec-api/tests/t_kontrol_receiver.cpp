@@ -0,0 +1,146 @@
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <KontrolModel.h>
+#include <OSCReceiver.h>
+#include <mec_log.h>
+
+#include <ip/UdpSocket.h>
+#include <osc/OscOutboundPacketStream.h>
+
+// records what the receiver applied to the model
+class TestCallback : public Kontrol::KontrolCallback {
+public:
+    TestCallback() : src_(Kontrol::CS_LOCAL) { ; }
+
+    void rack(Kontrol::ChangeSource, const Kontrol::Rack &) override { racks_++; }
+
+    void module(Kontrol::ChangeSource, const Kontrol::Rack &, const Kontrol::Module &) override { modules_++; }
+
+    void page(Kontrol::ChangeSource, const Kontrol::Rack &, const Kontrol::Module &,
+              const Kontrol::Page &) override { ; }
+
+    void param(Kontrol::ChangeSource, const Kontrol::Rack &, const Kontrol::Module &,
+               const Kontrol::Parameter &) override { params_++; }
+
+    void changed(Kontrol::ChangeSource src, const Kontrol::Rack &, const Kontrol::Module &,
+                 const Kontrol::Parameter &p) override {
+        changed_++;
+        src_ = src;
+        value_ = p.current().floatValue();
+    }
+
+    void resource(Kontrol::ChangeSource, const Kontrol::Rack &, const std::string &,
+                  const std::string &) override { ; }
+
+    void ping(Kontrol::ChangeSource src, const std::string &host, unsigned port, unsigned keepAlive) override {
+        pings_++;
+        pingHost_ = host;
+        pingPort_ = port;
+    }
+
+    unsigned racks_ = 0, modules_ = 0, params_ = 0, changed_ = 0, pings_ = 0;
+    Kontrol::ChangeSource src_;
+    float value_ = 0.0f;
+    std::string pingHost_;
+    unsigned pingPort_ = 0;
+};
+
+static void send(UdpTransmitSocket &socket, osc::OutboundPacketStream &ops) {
+    socket.Send(ops.Data(), ops.Size());
+    ops.Clear();
+}
+
+// poll until count is reached, or timeout
+static void poll(Kontrol::OSCReceiver &receiver, const unsigned &count, unsigned expected) {
+    for (unsigned i = 0; i < 500 && count < expected; i++) {
+        receiver.poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    auto model = Kontrol::KontrolModel::model();
+    auto callback = std::make_shared<TestCallback>();
+    model->addCallback("test", callback);
+
+    Kontrol::OSCReceiver receiver(model);
+    assert(receiver.listen(0));
+    unsigned port = receiver.socket()->port();
+
+    // rack id is derived from host and port
+    Kontrol::EntityId rackId = Kontrol::Rack::createId("127.0.0.1", 9001);
+    const char *rack1 = rackId.c_str();
+
+    UdpTransmitSocket socket(IpEndpointName("127.0.0.1", port));
+    char buffer[1024];
+    osc::OutboundPacketStream ops(buffer, sizeof(buffer));
+
+    // meta data, ids are interned on first use
+    ops << osc::BeginMessage("/Kontrol/rack") << rack1 << "127.0.0.1" << 9001 << osc::EndMessage;
+    send(socket, ops);
+    ops << osc::BeginMessage("/Kontrol/module") << rack1 << "module1" << "Poly Synth" << "polysynth"
+        << osc::EndMessage;
+    send(socket, ops);
+    ops << osc::BeginMessage("/Kontrol/param") << rack1 << "module1"
+        << "pct" << "o_level" << "level" << 0.0f << 100.0f << 100.0f << osc::EndMessage;
+    send(socket, ops);
+    poll(receiver, callback->params_, 1);
+    assert(callback->racks_ == 1 && callback->modules_ == 1 && callback->params_ == 1);
+
+    // unknown, and not quite Kontrol, addresses are ignored
+    ops << osc::BeginMessage("/Kontrol/chang") << rack1 << osc::EndMessage;
+    send(socket, ops);
+    ops << osc::BeginMessage("/Kontrol/changes") << rack1 << "module1" << "o_level" << 1.0f << osc::EndMessage;
+    send(socket, ops);
+    ops << osc::BeginMessage("/x") << osc::EndMessage;
+    send(socket, ops);
+
+    // a storm of changes, all from the same source
+    for (unsigned i = 0; i < 100; i++) {
+        ops << osc::BeginMessage("/Kontrol/changed") << rack1 << "module1" << "o_level" << float(i % 50)
+            << osc::EndMessage;
+        send(socket, ops);
+    }
+    poll(receiver, callback->changed_, 100);
+    assert(callback->changed_ == 100);
+    assert(callback->value_ == 49.0f);
+    assert(callback->src_ != Kontrol::CS_LOCAL);
+
+    // ping, host from the endpoint, and the same source as the changes
+    ops << osc::BeginMessage("/Kontrol/ping") << 9002 << 0 << osc::EndMessage;
+    send(socket, ops);
+    poll(receiver, callback->pings_, 1);
+    assert(callback->pings_ == 1 && callback->pingHost_ == "127.0.0.1" && callback->pingPort_ == 9002);
+
+    // unknown rack, module or param, nothing changes
+    ops << osc::BeginMessage("/Kontrol/changed") << "rack2" << "module1" << "o_level" << 1.0f << osc::EndMessage;
+    send(socket, ops);
+    ops << osc::BeginMessage("/Kontrol/changed") << rack1 << "module1" << "r_mix" << 1.0f << osc::EndMessage;
+    send(socket, ops);
+    ops << osc::BeginMessage("/Kontrol/changed") << rack1 << "module1" << "o_level" << 7.0f << osc::EndMessage;
+    send(socket, ops);
+    poll(receiver, callback->changed_, 101);
+    assert(callback->changed_ == 101 && callback->value_ == 7.0f);
+    assert(model->getRack("rack2") == nullptr);
+    assert(model->getParam(model->getModule(model->getRack(rackId), "module1"), "r_mix") == nullptr);
+
+    // remote sources compare by endpoint
+    Kontrol::ChangeSource a = Kontrol::ChangeSource::createRemoteSource("127.0.0.1", 9001);
+    Kontrol::ChangeSource b = Kontrol::ChangeSource::createRemoteSource("127.0.0.1", 9001);
+    Kontrol::ChangeSource c = a;
+    assert(a == b && a == c && a != Kontrol::ChangeSource::createRemoteSource("127.0.0.1", 9002));
+    assert(a != Kontrol::CS_LOCAL && Kontrol::CS_MIDI == Kontrol::ChangeSource(Kontrol::ChangeSource::MIDI));
+
+    receiver.stop();
+    model->removeCallback("test");
+    assert(receiver.dropped() == 0);
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <vector>
+
+#include <processors/mec_midi_encoder.h>
+#include <processors/mec_mpe_processor.h>
+#include <mec_log.h>
+
+// byte stream, as a uart would see it
+class StreamSink : public mec::IMidiSink {
+public:
+    bool send(const unsigned char *data, unsigned size) override {
+        bytes_.insert(bytes_.end(), data, data + size);
+        return true;
+    }
+
+    std::vector<unsigned char> bytes_;
+};
+
+static bool sendMsg(mec::MidiEncoder &enc, unsigned char s, unsigned char d1, unsigned char d2) {
+    unsigned char m[3] = {s, d1, d2};
+    return enc.send(m, 3);
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    // redundant messages are suppressed, per channel
+    {
+        StreamSink out;
+        mec::MidiEncoder enc(&out);
+        sendMsg(enc, 0xE1, 0x00, 0x40);
+        sendMsg(enc, 0xE1, 0x00, 0x40); // same
+        sendMsg(enc, 0xE2, 0x00, 0x40); // other channel
+        sendMsg(enc, 0xB1, 74, 64);
+        sendMsg(enc, 0xB1, 74, 64);     // same
+        sendMsg(enc, 0xB1, 6, 10);
+        sendMsg(enc, 0xB1, 6, 10);      // data entry, always sent
+        sendMsg(enc, 0x91, 60, 100);
+        sendMsg(enc, 0x91, 60, 100);    // notes are never suppressed
+        assert(out.bytes_.size() == 7 * 3);
+        assert(enc.stats().messagesIn_ == 9);
+        assert(enc.stats().messagesDropped_ == 2);
+        assert(enc.stats().bytesSaved() == 6);
+
+        // receiver reset, everything is sent again
+        enc.reset();
+        sendMsg(enc, 0xE1, 0x00, 0x40);
+        assert(out.bytes_.size() == 8 * 3);
+    }
+
+    // resolution, extremes and centre are always sent
+    {
+        StreamSink out;
+        mec::MidiEncoder enc(&out);
+        enc.setResolution(64, 4);
+        unsigned char pressure[2] = {0xD1, 10};
+        enc.send(pressure, 2);
+        pressure[1] = 12;
+        enc.send(pressure, 2); // < 4, dropped
+        pressure[1] = 14;
+        enc.send(pressure, 2); // 4 from last sent
+        pressure[1] = 0;
+        enc.send(pressure, 2); // rest
+        assert(out.bytes_.size() == 3 * 2);
+        assert(out.bytes_[3] == 14 && out.bytes_[5] == 0);
+
+        sendMsg(enc, 0xE1, 0x00, 0x41); // 0x2080
+        sendMsg(enc, 0xE1, 0x10, 0x41); // +16, dropped
+        sendMsg(enc, 0xE1, 0x00, 0x40); // centre
+        assert(out.bytes_.size() == 3 * 2 + 2 * 3);
+    }
+
+    // running status, including note off as note on
+    {
+        StreamSink out;
+        mec::MidiEncoder enc(&out);
+        enc.setRunningStatus(true);
+        sendMsg(enc, 0x91, 60, 100);
+        sendMsg(enc, 0x91, 64, 100);
+        sendMsg(enc, 0x81, 60, 0);    // as 0x91 60 0
+        unsigned char clock = 0xF8;
+        enc.send(&clock, 1);          // realtime, keeps running status
+        sendMsg(enc, 0x81, 64, 0);
+        sendMsg(enc, 0x81, 64, 10);   // release velocity, needs real note off
+        const unsigned char expect[] = {0x91, 60, 100, 64, 100, 60, 0, 0xF8, 64, 0, 0x81, 64, 10};
+        assert(out.bytes_ == std::vector<unsigned char>(expect, expect + sizeof(expect)));
+        unsigned char sysex[4] = {0xF0, 0x7E, 0x01, 0xF7};
+        enc.send(sysex, 4);           // cancels running status
+        sendMsg(enc, 0x81, 64, 20);
+        assert(out.bytes_.size() == sizeof(expect) + 4 + 3 && out.bytes_.back() == 20);
+        assert(enc.stats().bytesSaved() == 3); // 3 status bytes
+    }
+
+    // mpe stream, 10 voices, as after Midi_Processor
+    {
+        StreamSink plain, encoded;
+        mec::MidiEncoder enc(&encoded);
+        enc.setRunningStatus(true);
+        mec::MPE_Processor p1, p2;
+        p1.setSink(&plain);
+        p2.setSink(&enc);
+        // repeated notes, on, pressure changes, off
+        for (unsigned frame = 0; frame < 100; frame++) {
+            for (int v = 0; v < 10; v++) {
+                float z = 0.5f + (frame % 10) * 0.01f;
+                switch (frame % 10) {
+                    case 0:
+                        p1.touchOn(v, 48.0f + v, 0.0f, 0.0f, z);
+                        p2.touchOn(v, 48.0f + v, 0.0f, 0.0f, z);
+                        break;
+                    case 9:
+                        p1.touchOff(v, 48.0f + v, 0.0f, 0.0f, 0.0f);
+                        p2.touchOff(v, 48.0f + v, 0.0f, 0.0f, 0.0f);
+                        break;
+                    default:
+                        p1.touchContinue(v, 48.0f + v, 0.0f, 0.0f, z);
+                        p2.touchContinue(v, 48.0f + v, 0.0f, 0.0f, z);
+                        break;
+                }
+            }
+            p1.flush();
+            p2.flush();
+        }
+        assert(encoded.bytes_.size() < plain.bytes_.size());
+        assert(enc.stats().bytesIn_ == plain.bytes_.size());
+        assert(enc.stats().bytesSaved() == (long long) (plain.bytes_.size() - encoded.bytes_.size()));
+        LOG_0("mpe 10 voices, plain " << plain.bytes_.size() << " encoded " << encoded.bytes_.size());
+    }
+
+    LOG_0("test completed");
+    return 0;
+}
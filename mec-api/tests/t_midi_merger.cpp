@@ -0,0 +1,122 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <vector>
+
+#include <devices/mec_midi_decoder.h>
+#include <devices/mec_midi_merger.h>
+#include <processors/mec_midi_parser.h>
+#include <mec_log.h>
+
+// an input, as MidiDevice has for each of its "input devices"
+struct TestInput {
+    TestInput() : decoder_(queue_) { ; }
+
+    void input(mec::MecTime t, std::vector<unsigned char> in) {
+        decoder_.setTime(t);
+        parser_.parse(in.data(), in.size(), decoder_);
+    }
+
+    mec::MsgQueue queue_;
+    mec::MidiParser parser_;
+    mec::MidiDecoder decoder_;
+};
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    // merged in time order, same channel on each input is a different touch
+    {
+        mec::MsgQueue out;
+        TestInput a, b;
+        mec::MidiMerger merger(out, 2, 32);
+        merger.setInput(0, &a.queue_);
+        merger.setInput(1, &b.queue_);
+
+        a.input(100, {0x91, 60, 100});
+        a.input(300, {0xD1, 64});
+        b.input(200, {0x91, 62, 100, 0xB0, 7, 127});
+        assert(merger.merge() == 4);
+
+        mec::MecMsg m;
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_ON && m.data_.touch_.touchId_ == 0);
+        assert(m.data_.touch_.note_ == 60.0f && m.deviceTime_ == 100);
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_ON && m.data_.touch_.touchId_ == 1);
+        assert(m.data_.touch_.note_ == 62.0f && m.deviceTime_ == 200);
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::CONTROL && m.deviceTime_ == 200);
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_CONTINUE && m.data_.touch_.touchId_ == 0);
+        assert(m.deviceTime_ == 300 && out.isEmpty());
+
+        // voices are released, and reused oldest released first
+        a.input(400, {0x81, 60, 0});
+        b.input(500, {0x81, 62, 0, 0x92, 65, 100});
+        merger.merge();
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_OFF && m.data_.touch_.touchId_ == 0);
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_OFF && m.data_.touch_.touchId_ == 1);
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_ON && m.data_.touch_.touchId_ == 2);
+    }
+
+    // out of voices, oldest stolen, and stays off until released
+    {
+        mec::MsgQueue out;
+        TestInput a, b;
+        mec::MidiMerger merger(out, 2, 2);
+        merger.setInput(0, &a.queue_);
+        merger.setInput(1, &b.queue_);
+
+        a.input(100, {0x91, 60, 100, 0x92, 61, 100});
+        b.input(200, {0x91, 62, 100});
+        a.input(300, {0xD1, 64});
+        merger.merge();
+
+        mec::MecMsg m;
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_ON && m.data_.touch_.touchId_ == 0);
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_ON && m.data_.touch_.touchId_ == 1);
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_OFF && m.data_.touch_.touchId_ == 0);
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_ON && m.data_.touch_.touchId_ == 0);
+        assert(m.data_.touch_.note_ == 62.0f);
+        assert(out.isEmpty() && merger.dropped() == 1); // continue of stolen touch
+
+        // release of stolen touch is not sent, then it can start again
+        a.input(400, {0x81, 60, 0, 0x82, 61, 0, 0x91, 67, 100});
+        merger.merge();
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_OFF && m.data_.touch_.touchId_ == 1);
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_ON && m.data_.touch_.touchId_ == 1);
+        assert(m.data_.touch_.note_ == 67.0f && out.isEmpty());
+    }
+
+    // not mpe, a chord on one channel is a touch per note
+    {
+        mec::MsgQueue out;
+        TestInput a;
+        a.decoder_.setMpe(false);
+        mec::MidiMerger merger(out, 1, 16, true, false);
+        merger.setInput(0, &a.queue_);
+        a.input(100, {0x90, 60, 100, 0x90, 64, 100, 0x90, 67, 100});
+        a.input(200, {0x80, 64, 0});
+        merger.merge();
+
+        mec::MecMsg m;
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_ON && m.data_.touch_.touchId_ == 0);
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_ON && m.data_.touch_.touchId_ == 1);
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_ON && m.data_.touch_.touchId_ == 2);
+        assert(out.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_OFF && m.data_.touch_.touchId_ == 1);
+        assert(m.data_.touch_.note_ == 64.0f && out.isEmpty() && merger.dropped() == 0);
+    }
+
+    // only merges what fits in out
+    {
+        mec::MsgQueue out(4);
+        TestInput a;
+        mec::MidiMerger merger(out, 1, 16);
+        merger.setInput(0, &a.queue_);
+        a.input(100, {0xB0, 1, 1, 2, 2, 3, 3, 4, 4});
+        assert(merger.merge() == 3 && a.queue_.pending() == 1);
+        mec::MecMsg m;
+        while (out.nextMsg(m));
+        assert(merger.merge() == 1 && a.queue_.isEmpty() && out.overflows() == 0);
+    }
+
+    LOG_0("test completed");
+    return 0;
+}
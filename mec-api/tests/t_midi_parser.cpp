@@ -0,0 +1,115 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <vector>
+
+#include <devices/mec_midi_decoder.h>
+#include <processors/mec_midi_parser.h>
+#include <mec_log.h>
+
+// records everything, messages as 3 bytes
+class TestHandler : public mec::MidiParser::Handler {
+public:
+    void message(unsigned char status, unsigned char d1, unsigned char d2) override {
+        messages_.push_back(std::vector<unsigned char>{status, d1, d2});
+    }
+
+    void realtime(unsigned char b) override { realtime_.push_back(b); }
+
+    void sysex(const unsigned char *data, unsigned size, bool last) override {
+        sysex_.insert(sysex_.end(), data, data + size);
+        if (last) sysexDone_++;
+    }
+
+    std::vector<std::vector<unsigned char>> messages_;
+    std::vector<unsigned char> realtime_;
+    std::vector<unsigned char> sysex_;
+    unsigned sysexDone_ = 0;
+};
+
+static void parse(mec::MidiParser &p, TestHandler &h, std::initializer_list<unsigned char> l) {
+    std::vector<unsigned char> v(l);
+    p.parse(v.data(), v.size(), h);
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    // running status, realtime in a message, message split over buffers
+    {
+        mec::MidiParser p;
+        TestHandler h;
+        parse(p, h, {0x91, 60, 100, 62, 100, 0xF8, 64});
+        parse(p, h, {100, 0xD1, 20, 30, 0xE1});
+        parse(p, h, {0x00, 0xFE, 0x40});
+        assert(h.messages_.size() == 6);
+        assert((h.messages_[1] == std::vector<unsigned char>{0x91, 62, 100}));
+        assert((h.messages_[2] == std::vector<unsigned char>{0x91, 64, 100}));
+        assert((h.messages_[4] == std::vector<unsigned char>{0xD1, 30, 0}));
+        assert((h.messages_[5] == std::vector<unsigned char>{0xE1, 0x00, 0x40}));
+        assert((h.realtime_ == std::vector<unsigned char>{0xF8, 0xFE}));
+    }
+
+    // sysex over buffers, with realtime inside, then cancels running status
+    {
+        mec::MidiParser p;
+        TestHandler h;
+        parse(p, h, {0x90, 60, 100, 0xF0, 0x7E, 0x01});
+        parse(p, h, {0x02, 0xF8, 0x03, 0xF7, 61, 100});
+        assert(h.messages_.size() == 1 && p.dropped() == 2);
+        assert((h.sysex_ == std::vector<unsigned char>{0xF0, 0x7E, 0x01, 0x02, 0x03, 0xF7}));
+        assert(h.sysexDone_ == 1 && h.realtime_.size() == 1);
+
+        // system common, no running status after it
+        parse(p, h, {0xB0, 7, 100, 0xF2, 0x10, 0x20, 8, 9, 0xF6});
+        assert(h.messages_.size() == 4);
+        assert((h.messages_[2] == std::vector<unsigned char>{0xF2, 0x10, 0x20}));
+        assert(h.messages_[3][0] == 0xF6 && p.dropped() == 4);
+
+        // unterminated sysex, ended by status
+        parse(p, h, {0xF0, 0x01, 0x90, 60, 0});
+        assert(h.sysexDone_ == 2 && h.messages_.size() == 5);
+    }
+
+    // decoded into a queue, mpe
+    {
+        mec::MsgQueue queue;
+        mec::MidiDecoder d(queue);
+        d.setPitchbendRange(48.0f);
+        mec::MidiParser p;
+        d.setTime(1000);
+        std::vector<unsigned char> in{0xE1, 0x00, 0x40, 0x91, 60, 127, 0xE1, 0x00, 0x50, 0xB1, 74, 127, 0xD1, 0, 0x81, 60, 0};
+        p.parse(in.data(), in.size(), d);
+        mec::MecMsg m;
+        assert(queue.pending() == 5); // pitchbend before note on is ignored
+        assert(queue.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_ON && m.data_.touch_.touchId_ == 1);
+        assert(m.data_.touch_.note_ == 60.0f && m.data_.touch_.z_ == 1.0f && m.deviceTime_ == 1000);
+        assert(queue.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_CONTINUE && m.data_.touch_.note_ == 72.0f);
+        assert(queue.nextMsg(m) && m.data_.touch_.y_ == 1.0f);
+        assert(queue.nextMsg(m) && m.data_.touch_.z_ == 0.0f);
+        assert(queue.nextMsg(m) && m.type_ == mec::MecMsg::TOUCH_OFF && m.data_.touch_.note_ == 72.0f);
+
+        // not mpe, controls
+        d.setMpe(false);
+        in = {0xB0, 74, 127, 0xD0, 0};
+        p.parse(in.data(), in.size(), d);
+        assert(queue.nextMsg(m) && m.type_ == mec::MecMsg::CONTROL && m.data_.control_.controlId_ == 74);
+        assert(queue.nextMsg(m) && m.type_ == mec::MecMsg::CONTROL && m.data_.control_.controlId_ == 0xD0);
+    }
+
+    // queue full, dropped and counted, not overwritten
+    {
+        mec::MsgQueue queue(4);
+        mec::MidiDecoder d(queue);
+        d.setMpe(false);
+        mec::MidiParser p;
+        std::vector<unsigned char> in{0xB0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6};
+        p.parse(in.data(), in.size(), d);
+        assert(queue.pending() == 4 && queue.overflows() == 2);
+        mec::MecMsg m;
+        assert(queue.nextMsg(m) && m.data_.control_.controlId_ == 1);
+    }
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <vector>
+
+#include <processors/mec_midi_buffer.h>
+#include <processors/mec_mpe_processor.h>
+#include <mec_log.h>
+
+// records what is sent, and each send
+class TestSink : public mec::IMidiSink {
+public:
+    bool send(const unsigned char *data, unsigned size) override {
+        sends_++;
+        unsigned pos = 0;
+        while (pos < size) {
+            unsigned n = mec::MidiBuffer::messageLength(data + pos, size - pos);
+            assert(n > 0);
+            messages_.push_back(std::vector<unsigned char>(data + pos, data + pos + n));
+            pos += n;
+        }
+        return true;
+    }
+
+    unsigned sends_ = 0;
+    std::vector<std::vector<unsigned char>> messages_;
+};
+
+class TestMpeProcessor : public mec::MPE_Processor {
+};
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    // message lengths
+    const unsigned char noteOn[] = {0x91, 60, 100};
+    const unsigned char pressure[] = {0xD1, 64};
+    const unsigned char sysex[] = {0xF0, 0x7E, 0x01, 0xF7};
+    const unsigned char clock[] = {0xF8};
+    assert(mec::MidiBuffer::messageLength(noteOn, 3) == 3);
+    assert(mec::MidiBuffer::messageLength(noteOn, 2) == 0);
+    assert(mec::MidiBuffer::messageLength(pressure, 2) == 2);
+    assert(mec::MidiBuffer::messageLength(sysex, 4) == 4);
+    assert(mec::MidiBuffer::messageLength(sysex, 3) == 0);
+    assert(mec::MidiBuffer::messageLength(clock, 1) == 1);
+    assert(mec::MidiBuffer::messageLength(noteOn + 1, 2) == 0); // data byte, not a status
+
+    // buffer
+    mec::MidiBuffer buf;
+    assert(buf.isEmpty());
+    assert(buf.add(noteOn, 3) && buf.add(pressure, 2));
+    assert(buf.size() == 5 && buf.data()[3] == 0xD1);
+    while (buf.add(noteOn, 3));
+    assert(buf.available() < 3);
+    buf.clear();
+    assert(buf.isEmpty() && buf.available() == mec::MidiBuffer::CAPACITY);
+
+    // nothing is sent until flush
+    TestSink sink;
+    TestMpeProcessor mpe;
+    mpe.setSink(&sink);
+    mpe.touchOn(0, 60.0f, 0.0f, 0.0f, 0.5f);
+    mpe.touchContinue(0, 60.5f, 0.1f, 0.2f, 0.6f);
+    mpe.touchOff(0, 60.5f, 0.1f, 0.2f, 0.0f);
+    assert(sink.sends_ == 0);
+    assert(mpe.flush());
+    assert(sink.sends_ == 1);
+    assert(sink.messages_.size() >= 3);
+    bool sawOn = false, sawOff = false;
+    for (auto &m : sink.messages_) {
+        assert((m[0] & 0x0F) == 1); // mpe, touch 0 is on channel 2
+        if ((m[0] & 0xF0) == 0x90 && m[1] == 60) sawOn = true;
+        if ((m[0] & 0xF0) == 0x80 && m[1] == 60) sawOff = true;
+    }
+    assert(sawOn && sawOff);
+    assert(mpe.flush());
+    assert(sink.sends_ == 1); // empty, nothing sent
+
+    // more than fits in the buffer, is flushed early rather than dropped
+    sink.messages_.clear();
+    sink.sends_ = 0;
+    const unsigned N = mec::MidiBuffer::CAPACITY; // at least N bytes of messages
+    for (unsigned i = 0; i < N; i++) mpe.touchOn(i % 15, float(40 + (i % 40)), 0.0f, 0.0f, 0.5f);
+    mpe.flush();
+    assert(sink.sends_ > 1);
+    unsigned noteOns = 0;
+    for (auto &m : sink.messages_) if ((m[0] & 0xF0) == 0x90) noteOns++;
+    assert(noteOns == N);
+
+    // output rate, continuous data only on ticks, latest values only
+    {
+        const mec::MecTime MS = 1000000;
+        TestSink rsink;
+        TestMpeProcessor rate;
+        rate.setSink(&rsink);
+        rate.setOutputRate(250); // 4ms
+        rate.touchOn(0, 60.0f, 0.0f, 0.0f, 0.5f);
+        rate.touchOn(1, 64.0f, 0.0f, 0.0f, 0.5f);
+        rate.flush();
+        assert(rsink.messages_.size() == 8); // note on is immediate
+        rsink.messages_.clear();
+
+        mec::MecTime t0 = 100 * MS;
+        rate.tick(t0);
+        for (unsigned i = 1; i <= 4; i++) rate.touchContinue(0, 60.0f, 0.0f, 0.0f, 0.5f + i * 0.1f);
+        rate.touchContinue(1, 64.5f, 0.0f, 0.0f, 0.0f); // pitchbend only
+        rate.flush();
+        assert(rsink.messages_.empty() && rate.isPending());
+        rate.tick(t0 + 2 * MS); // not due
+        rate.flush();
+        assert(rsink.messages_.empty());
+        rate.tick(t0 + 4 * MS);
+        rate.flush();
+        assert(!rate.isPending() && rate.nextTick() == t0 + 8 * MS);
+        assert(rsink.messages_.size() == 2);
+        assert(rsink.messages_[0][0] == 0xD1 && rsink.messages_[0][1] == 114); // latest pressure
+        assert(rsink.messages_[1][0] == 0xE2);
+        rsink.messages_.clear();
+
+        // pending changes are dropped on touch off
+        rate.touchContinue(0, 60.0f, 0.0f, 0.0f, 0.2f);
+        rate.touchOff(0, 60.0f, 0.0f, 0.0f, 0.0f);
+        rate.tick(t0 + 8 * MS);
+        rate.flush();
+        assert(rsink.messages_.size() == 2 && (rsink.messages_[1][0] & 0xF0) == 0x80);
+        rsink.messages_.clear();
+
+        // back to immediate, waiting changes are sent
+        rate.touchContinue(1, 65.0f, 0.0f, 0.0f, 0.0f);
+        rate.setOutputRate(0);
+        rate.touchContinue(1, 65.5f, 0.0f, 0.0f, 0.0f);
+        rate.flush();
+        assert(rsink.messages_.size() == 2 && !rate.isPending());
+    }
+
+    // frame, on/off in order, each changed voice sent once at the end
+    {
+        TestSink fsink;
+        TestMpeProcessor fp;
+        fp.setSink(&fsink);
+        mec::TouchFrame f;
+        f.add(mec::TouchFrame::T_ON, 0, 60.0f, 0.0f, 0.0f, 0.5f);
+        f.add(mec::TouchFrame::T_ON, 1, 64.0f, 0.0f, 0.0f, 0.5f);
+        fp.frame(f);
+        fp.flush();
+        assert(fsink.messages_.size() == 8 && !fp.isPending());
+        fsink.messages_.clear();
+
+        f.clear();
+        f.add(mec::TouchFrame::T_CONTINUE, 0, 60.0f, 0.0f, 0.0f, 0.6f);
+        f.add(mec::TouchFrame::T_CONTINUE, 0, 60.0f, 0.0f, 0.0f, 0.9f); // latest value only
+        f.add(mec::TouchFrame::T_CONTINUE, 2, 60.0f, 0.0f, 0.0f, 0.9f); // not on, ignored
+        f.add(mec::TouchFrame::T_OFF, 1, 64.0f, 0.0f, 0.0f, 0.0f);
+        fp.frame(f);
+        fp.flush();
+        assert(fsink.messages_.size() == 3 && !fp.isPending());
+        assert((fsink.messages_[1][0] & 0xF0) == 0x80 && fsink.messages_[1][1] == 64);
+        assert(fsink.messages_[2][0] == 0xD1 && fsink.messages_[2][1] == 114);
+    }
+
+    // no sink, messages are discarded (not buffered)
+    TestMpeProcessor nosink;
+    nosink.touchOn(0, 60.0f, 0.0f, 0.0f, 0.5f);
+    assert(nosink.flush());
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <vector>
+
+#include <processors/mec_midi_scheduler.h>
+#include <mec_log.h>
+
+class StreamSink : public mec::IMidiSink {
+public:
+    bool send(const unsigned char *data, unsigned size) override {
+        bytes_.insert(bytes_.end(), data, data + size);
+        return true;
+    }
+
+    std::vector<unsigned char> bytes_;
+};
+
+static void sendMsg(mec::MidiScheduler &s, unsigned char st, unsigned char d1, unsigned char d2) {
+    unsigned char m[3] = {st, d1, d2};
+    s.send(m, (st & 0xF0) == 0xD0 ? 2 : 3);
+}
+
+static std::vector<unsigned char> bytes(std::initializer_list<unsigned char> l) {
+    return std::vector<unsigned char>(l);
+}
+
+static const mec::MecTime MS = 1000000;
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    // no rate, passed through as they arrive
+    {
+        StreamSink out;
+        mec::MidiScheduler s(&out);
+        sendMsg(s, 0xE1, 0x00, 0x40);
+        sendMsg(s, 0xE1, 0x10, 0x40);
+        sendMsg(s, 0x91, 60, 100);
+        sendMsg(s, 0xB1, 64, 127);
+        sendMsg(s, 0xB1, 64, 0);
+        assert(!s.isPending());
+        assert(out.bytes_ == bytes({0xE1, 0x00, 0x40, 0xE1, 0x10, 0x40, 0x91, 60, 100, 0xB1, 64, 127, 0xB1, 64, 0}));
+        s.service();
+        assert(out.bytes_.size() == 15 && s.stats().coalesced_ == 0);
+    }
+
+    // notes first, continuous values replaced not queued
+    {
+        StreamSink out;
+        mec::MidiScheduler s(&out);
+        s.setRate(1000000, 1024);
+        sendMsg(s, 0xE1, 0x00, 0x40);
+        sendMsg(s, 0xE1, 0x10, 0x40);
+        sendMsg(s, 0xB1, 74, 10);
+        sendMsg(s, 0xE1, 0x20, 0x40);   // latest pitchbend
+        sendMsg(s, 0x92, 60, 100);
+        sendMsg(s, 0x83, 62, 0);
+        assert(out.bytes_.empty() && s.isPending());
+        s.service();
+        assert(out.bytes_ == bytes({0x92, 60, 100, 0x83, 62, 0, 0xE1, 0x20, 0x40, 0xB1, 74, 10}));
+        assert(s.stats().coalesced_ == 2);
+        assert(!s.isPending());
+    }
+
+    // note on takes pending data for its channel with it (mpe initial pitch/timbre)
+    {
+        StreamSink out;
+        mec::MidiScheduler s(&out);
+        s.setRate(1000000, 1024);
+        sendMsg(s, 0xE1, 0x00, 0x41);
+        sendMsg(s, 0xB1, 74, 64);
+        sendMsg(s, 0x91, 60, 100);
+        sendMsg(s, 0xD1, 30, 0);
+        sendMsg(s, 0xB1, 6, 1);         // data entry, kept in order
+        s.service();
+        assert(out.bytes_ == bytes({0xE1, 0x00, 0x41, 0xB1, 74, 64, 0x91, 60, 100, 0xB1, 6, 1, 0xD1, 30}));
+    }
+
+    // bank select and pedals are discrete, every value in order with notes and program changes
+    {
+        StreamSink out;
+        mec::MidiScheduler s(&out);
+        s.setRate(1000000, 1024);
+        sendMsg(s, 0xB0, 0, 1);
+        sendMsg(s, 0xB0, 32, 2);
+        unsigned char pc[2] = {0xC0, 5};
+        s.send(pc, 2);
+        sendMsg(s, 0xB0, 64, 127);
+        sendMsg(s, 0x80, 60, 0);
+        sendMsg(s, 0xB0, 64, 0);
+        s.service();
+        assert(out.bytes_ == bytes({0xB0, 0, 1, 0xB0, 32, 2, 0xC0, 5, 0xB0, 64, 127, 0x80, 60, 0, 0xB0, 64, 0}));
+        assert(s.stats().coalesced_ == 0);
+    }
+
+    // byte rate budget
+    {
+        StreamSink out;
+        mec::MidiScheduler s(&out);
+        s.setRate(1000, 6);
+        mec::MecTime t0 = mec::mecTimeNow();
+        for (unsigned i = 0; i < 10; i++) sendMsg(s, 0x90, (unsigned char) (60 + i), 100);
+        s.service(t0 + MS);
+        assert(out.bytes_.size() == 6);  // burst
+        s.service(t0 + 2 * MS);
+        assert(out.bytes_.size() == 6);  // 1 byte available, not a whole message
+        s.service(t0 + 4 * MS);
+        assert(out.bytes_.size() == 9);
+        s.service(t0 + 1000 * MS);
+        assert(out.bytes_.size() == 15); // limited by burst
+        assert(s.stats().maxPriorityDelay_ >= 999 * MS);
+    }
+
+    // continuous data round robin over channels, then slots within a channel
+    {
+        StreamSink out;
+        mec::MidiScheduler s(&out);
+        s.setRate(1000, 12);
+        mec::MecTime t0 = mec::mecTimeNow();
+        for (unsigned char ch = 1; ch <= 4; ch++) {
+            sendMsg(s, (unsigned char) (0xE0 | ch), 0, 0x40);
+            sendMsg(s, (unsigned char) (0xD0 | ch), 50, 0);
+            sendMsg(s, (unsigned char) (0xB0 | ch), 74, 64);
+        }
+        s.service(t0 + MS);
+        assert(out.bytes_ == bytes({0xE1, 0, 0x40, 0xE2, 0, 0x40, 0xE3, 0, 0x40, 0xE4, 0, 0x40}));
+        out.bytes_.clear();
+
+        // note off goes ahead of the waiting continuous data
+        sendMsg(s, 0x82, 60, 0);
+        s.service(t0 + 13 * MS);
+        assert(out.bytes_ == bytes({0x82, 60, 0, 0xD1, 50, 0xD2, 50, 0xD3, 50, 0xD4, 50}));
+        assert(s.isPending());
+        out.bytes_.clear();
+
+        // newer value while waiting replaces the stale one
+        sendMsg(s, 0xB4, 74, 100);
+        s.service(t0 + 100 * MS);
+        assert(out.bytes_ == bytes({0xB1, 74, 64, 0xB2, 74, 64, 0xB3, 74, 64, 0xB4, 74, 100}));
+        assert(!s.isPending());
+    }
+
+    // priority queue full, oldest sent over budget rather than lost
+    {
+        StreamSink out;
+        mec::MidiScheduler s(&out);
+        s.setRate(10, 3);
+        for (unsigned i = 0; i < mec::MidiScheduler::PRIORITY_CAPACITY + 4; i++) sendMsg(s, 0x80, 60, 0);
+        assert(out.bytes_.size() == 4 * 3);
+        assert(s.stats().overBudget_ == 4);
+    }
+
+    LOG_0("test completed");
+    return 0;
+}
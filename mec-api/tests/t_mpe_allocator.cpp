@@ -0,0 +1,123 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <vector>
+
+#include <processors/mec_mpe_allocator.h>
+#include <processors/mec_mpe_processor.h>
+#include <mec_log.h>
+
+class TestSink : public mec::IMidiSink {
+public:
+    bool send(const unsigned char *data, unsigned size) override {
+        unsigned pos = 0;
+        while (pos < size) {
+            unsigned n = mec::MidiBuffer::messageLength(data + pos, size - pos);
+            assert(n > 0);
+            messages_.push_back(std::vector<unsigned char>(data + pos, data + pos + n));
+            pos += n;
+        }
+        return true;
+    }
+
+    unsigned count(unsigned char status) const {
+        unsigned n = 0;
+        for (auto &m : messages_) if (m[0] == status) n++;
+        return n;
+    }
+
+    std::vector<std::vector<unsigned char>> messages_;
+};
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    using mec::MpeChannelAllocator;
+
+    // zones
+    {
+        MpeChannelAllocator a;
+        assert(a.allocate() == -1); // no zones
+        assert(a.addZone(0, MpeChannelAllocator::LOWER, 7));
+        assert(a.addZone(0, MpeChannelAllocator::UPPER, 7));
+        assert(!a.addZone(0, MpeChannelAllocator::UPPER, 1)); // already one
+        assert(!a.addZone(1, MpeChannelAllocator::LOWER, 16));
+        assert(a.size() == 14);
+        assert(a.zone(1).master() == 15);
+
+        MpeChannelAllocator b;
+        assert(b.addZone(0, MpeChannelAllocator::LOWER, 10));
+        assert(!b.addZone(0, MpeChannelAllocator::UPPER, 5)); // overlaps
+        assert(b.addZone(0, MpeChannelAllocator::UPPER, 4));
+    }
+
+    // zones interleaved, least recently released reused first, then shared
+    {
+        MpeChannelAllocator a;
+        a.addZone(0, MpeChannelAllocator::LOWER, 2);
+        a.addZone(1, MpeChannelAllocator::UPPER, 2);
+        int c0 = a.allocate(), c1 = a.allocate(), c2 = a.allocate(), c3 = a.allocate();
+        assert(a.channel(c0).port_ == 0 && a.channel(c0).ch_ == 1);
+        assert(a.channel(c1).port_ == 1 && a.channel(c1).ch_ == 14);
+        assert(a.channel(c2).port_ == 0 && a.channel(c2).ch_ == 2);
+        assert(a.channel(c3).port_ == 1 && a.channel(c3).ch_ == 13);
+
+        a.release(c2);
+        a.release(c0);
+        assert(a.allocate() == c2);
+        assert(a.allocate() == c0);
+
+        // all in use, shared round robin
+        int s0 = a.allocate(), s1 = a.allocate();
+        assert(s0 != s1 && a.notes(s0) == 2 && a.notes(s1) == 2);
+        a.release(s0);
+        assert(a.notes(s0) == 1);
+        a.release(s0);
+        assert(a.notes(s0) == 0 && a.allocate() == s0);
+    }
+
+    // 30 voices over 2 ports, no channel shared
+    {
+        TestSink port0, port1;
+        mec::MPE_Processor mpe;
+        mpe.channels().clear();
+        mpe.channels().addZone(0, MpeChannelAllocator::LOWER, 15);
+        mpe.channels().addZone(1, MpeChannelAllocator::LOWER, 15);
+        mpe.setSink(&port0, 0);
+        mpe.setSink(&port1, 1);
+        mpe.sendZoneConfig();
+        mpe.flush();
+        assert(port0.messages_.size() == 5 && port0.messages_[2][1] == 6 && port0.messages_[2][2] == 15);
+        port0.messages_.clear();
+        port1.messages_.clear();
+
+        for (int v = 0; v < 30; v++) mpe.touchOn(v, 40.0f + v, 0.0f, 0.0f, 0.5f);
+        for (int v = 0; v < 30; v++) mpe.touchContinue(v, 40.5f + v, 0.0f, 0.0f, 0.6f);
+        mpe.flush();
+        for (unsigned ch = 1; ch <= 15; ch++) {
+            assert(port0.count((unsigned char) (0x90 | ch)) == 1);
+            assert(port1.count((unsigned char) (0x90 | ch)) == 1);
+        }
+        for (int v = 0; v < 30; v++) mpe.touchOff(v, 40.5f + v, 0.0f, 0.0f, 0.0f);
+        mpe.flush();
+        unsigned offs = 0;
+        for (unsigned ch = 1; ch <= 15; ch++) offs += port0.count((unsigned char) (0x80 | ch)) + port1.count((unsigned char) (0x80 | ch));
+        assert(offs == 30);
+
+        // global control goes to each master
+        port0.messages_.clear();
+        port1.messages_.clear();
+        mpe.control(1, 0.5f);
+        mpe.flush();
+        assert(port0.count(0xB0) == 1 && port1.count(0xB0) == 1);
+
+        // ids beyond capacity are ignored
+        mpe.touchOn(mec::MPE_Processor::MAX_VOICES, 60.0f, 0.0f, 0.0f, 0.5f);
+        mpe.touchOn(-1, 60.0f, 0.0f, 0.0f, 0.5f);
+        mpe.flush();
+        assert(port0.messages_.size() == 1 && port1.messages_.size() == 1);
+    }
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include <mec_msg_queue.h>
+#include <mec_log.h>
+
+class CountCallback : public mec::Callback {
+public:
+    CountCallback() : count_(0), lastId_(-1), ordered_(true), time_(0) { ; }
+
+    void eventTime(mec::MecTime t) override { time_ = t; }
+
+    void touchContinue(int touchId, float note, float x, float y, float z) override {
+        if (touchId != lastId_ + 1) ordered_ = false;
+        lastId_ = touchId;
+        count_++;
+    }
+
+    unsigned count_;
+    int lastId_;
+    bool ordered_;
+    mec::MecTime time_;
+};
+
+class FrameCallback : public mec::IFrameCallback {
+public:
+    FrameCallback() : frames_(0), touches_(0), lastSize_(0) { ; }
+
+    void frame(const mec::TouchFrame &f) override {
+        frames_++;
+        touches_ += f.size_;
+        lastSize_ = f.size_;
+        for (unsigned i = 0; i < f.size_; i++) {
+            assert(f.state_[i] == mec::TouchFrame::T_CONTINUE);
+        }
+    }
+
+    unsigned frames_;
+    unsigned touches_;
+    unsigned lastSize_;
+};
+
+static mec::MecMsg touchMsg(int id) {
+    mec::MecMsg msg;
+    msg.type_ = mec::MecMsg::TOUCH_CONTINUE;
+    msg.data_.touch_.touchId_ = id;
+    msg.data_.touch_.note_ = 0.0f;
+    msg.data_.touch_.x_ = msg.data_.touch_.y_ = msg.data_.touch_.z_ = 0.0f;
+    return msg;
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    // capacity is rounded to power of 2
+    mec::MsgQueue queue(30);
+    assert(queue.capacity() == 32);
+    assert(queue.isEmpty());
+
+    for (int i = 0; i < 32; i++) {
+        mec::MecMsg msg = touchMsg(i);
+        assert(queue.addToQueue(msg));
+    }
+    assert(queue.isFull());
+    mec::MecMsg extra = touchMsg(32);
+    assert(!queue.addToQueue(extra));
+    assert(queue.overflows() == 1);
+
+    // batch drain
+    CountCallback cb;
+    assert(queue.drain(cb, 10) == 10);
+    assert(queue.pending() == 22);
+    assert(queue.drain(cb, 100) == 22);
+    assert(queue.isEmpty());
+    assert(cb.count_ == 32 && cb.ordered_);
+
+    // latency stats, overflowed message not counted
+    mec::LatencyStats &stats = queue.latencyStats();
+    for (unsigned s = 0; s < mec::LatencyStats::N_STAGES; s++) {
+        mec::LatencySnapshot snap;
+        stats.stage((mec::LatencyStats::Stage) s).snapshot(snap);
+        assert(snap.count_ == 32);
+        unsigned long long n = 0;
+        for (unsigned b = 0; b < mec::LatencySnapshot::N_BUCKETS; b++) n += snap.buckets_[b];
+        assert(n == snap.count_);
+        assert(snap.percentileUs(0.5) <= snap.percentileUs(0.99));
+    }
+    stats.reset();
+    mec::LatencySnapshot empty;
+    stats.stage(mec::LatencyStats::TOTAL).snapshot(empty);
+    assert(empty.count_ == 0 && empty.percentileUs(0.5) == 0);
+
+    // device arrival time is passed on with the touch
+    mec::MecMsg timed = touchMsg(0);
+    timed.deviceTime_ = 1234;
+    assert(queue.addToQueue(timed));
+    CountCallback tcb0;
+    assert(queue.drain(tcb0, 10) == 1 && tcb0.time_ == 1234);
+
+    // log2 buckets
+    assert(mec::LatencyHistogram::bucket(0) == 0);
+    assert(mec::LatencyHistogram::bucket(1) == 1);
+    assert(mec::LatencyHistogram::bucket(3) == 2);
+    assert(mec::LatencyHistogram::bucket(1000) == 10);
+    assert(mec::LatencyHistogram::bucket(~0ULL) == mec::LatencyHistogram::N_BUCKETS - 1);
+
+    // frames, delivered on FRAME, empty frames skipped, large frames split
+    mec::MsgQueue fqueue(256);
+    FrameCallback fcb;
+    CountCallback fccb;
+    fqueue.setFrameCallback(&fcb);
+    mec::MecMsg frameMsg;
+    frameMsg.type_ = mec::MecMsg::FRAME;
+    for (int i = 0; i < 3; i++) {
+        mec::MecMsg msg = touchMsg(i);
+        fqueue.addToQueue(msg);
+    }
+    fqueue.addToQueue(frameMsg);
+    fqueue.addToQueue(frameMsg);
+    fqueue.drain(fccb, 100);
+    assert(fcb.frames_ == 1 && fcb.touches_ == 3 && fcb.lastSize_ == 3);
+    assert(fccb.count_ == 3); // still delivered per touch
+    for (int i = 0; i < 70; i++) {
+        mec::MecMsg msg = touchMsg(i);
+        fqueue.addToQueue(msg);
+    }
+    fqueue.addToQueue(frameMsg);
+    fqueue.drain(fccb, 1000);
+    assert(fcb.frames_ == 3 && fcb.touches_ == 73 && fcb.lastSize_ == 70 - mec::TouchFrame::MAX_TOUCHES);
+
+    // touches without a FRAME (e.g. t3d without /t3d/frm) are not held over to the next drain
+    for (int i = 0; i < 2; i++) {
+        mec::MecMsg msg = touchMsg(i);
+        fqueue.addToQueue(msg);
+    }
+    fqueue.drain(fccb, 1000);
+    assert(fcb.frames_ == 4 && fcb.touches_ == 75 && fcb.lastSize_ == 2);
+
+    // FRAME markers are not in the latency stats
+    mec::LatencySnapshot snap;
+    fqueue.latencyStats().stage(mec::LatencyStats::QUEUE).snapshot(snap);
+    assert(snap.count_ == 75);
+
+    // producer/consumer on separate threads
+    mec::MsgQueue tqueue;
+    tqueue.setCapacity(64);
+    const int N = 100000;
+    std::thread producer([&tqueue]() {
+        for (int i = 0; i < N; i++) {
+            mec::MecMsg msg = touchMsg(i);
+            while (!tqueue.addToQueue(msg)) std::this_thread::yield();
+        }
+    });
+    CountCallback tcb;
+    while (tcb.count_ < N) {
+        if (tqueue.drain(tcb, 16) == 0) std::this_thread::yield();
+    }
+    producer.join();
+    assert(tcb.ordered_);
+    assert(tqueue.isEmpty());
+
+    // consumer sleeps until woken by producer
+    mec::MsgWakeup wakeup;
+    mec::MsgQueue wqueue;
+    wqueue.setWakeup(&wakeup);
+    assert(!wakeup.wait(0));
+    assert(!wakeup.wait(10));
+    CountCallback wcb;
+    std::thread wproducer([&wqueue]() {
+        for (int i = 0; i < N; i++) {
+            mec::MecMsg msg = touchMsg(i);
+            while (!wqueue.addToQueue(msg)) std::this_thread::yield();
+            if ((i % 1000) == 0) std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+    while (wcb.count_ < N) {
+        // would stall (and time out) if a wakeup was lost
+        assert(wakeup.wait(1000) || !wqueue.isEmpty());
+        wqueue.drain(wcb, 16);
+    }
+    wproducer.join();
+    assert(wcb.ordered_);
+    wqueue.setWakeup(nullptr);
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <mec_log.h>
+#include <processors/mec_osc_processor.h>
+
+#include <osc/OscReceivedElements.h>
+
+struct Msg {
+    std::string address_;
+    std::vector<float> args_;
+};
+
+// decodes each packet, checks it is a single bundle of messages
+class TestSink : public mec::IOscSink {
+public:
+    bool send(const char *data, unsigned size) override {
+        osc::ReceivedPacket p(data, (osc::osc_bundle_element_size_t) size);
+        assert(p.IsBundle());
+        osc::ReceivedBundle b(p);
+        for (auto e = b.ElementsBegin(); e != b.ElementsEnd(); e++) {
+            assert(e->IsMessage());
+            osc::ReceivedMessage m(*e);
+            Msg msg;
+            msg.address_ = m.AddressPattern();
+            for (auto a = m.ArgumentsBegin(); a != m.ArgumentsEnd(); a++) {
+                msg.args_.push_back(a->IsFloat() ? a->AsFloat() : float(a->AsInt32()));
+            }
+            msgs_.push_back(msg);
+        }
+        sizes_.push_back(size);
+        return true;
+    }
+
+    std::vector<Msg> msgs_;
+    std::vector<unsigned> sizes_;
+};
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    // one bundle per flush, payload patched into templates
+    {
+        TestSink sink;
+        mec::OSC_Processor p(&sink);
+        p.touchOn(1, 60.0f, 0.1f, 0.2f, 0.3f);
+        p.touchOn(12, 64.5f, 0.4f, 0.5f, 0.6f);
+        p.touchContinue(1, 60.5f, 0.15f, 0.25f, 0.35f);
+        p.control(3, 0.75f);
+        assert(sink.sizes_.empty() && p.isPending());
+        assert(p.flush(0));
+        assert(!p.isPending() && sink.sizes_.size() == 1 && sink.msgs_.size() == 4);
+
+        assert(sink.msgs_[0].address_ == "/t3d/tch1" && sink.msgs_[0].args_.size() == 4);
+        assert(sink.msgs_[0].args_[0] == 0.1f && sink.msgs_[0].args_[2] == 0.3f && sink.msgs_[0].args_[3] == 60.0f);
+        assert(sink.msgs_[1].address_ == "/t3d/tch12" && sink.msgs_[1].args_[3] == 64.5f);
+        assert(sink.msgs_[2].address_ == "/t3d/tch1" && sink.msgs_[2].args_[0] == 0.15f);
+        assert(sink.msgs_[3].address_ == "/t3d/control" && sink.msgs_[3].args_[0] == 3.0f && sink.msgs_[3].args_[1] == 0.75f);
+
+        // off has zero pressure
+        p.touchOff(12, 64.5f, 0.4f, 0.5f, 0.6f);
+        p.flush(0);
+        assert(sink.msgs_.size() == 5 && sink.msgs_[4].args_[2] == 0.0f);
+
+        // nothing to send, no packet
+        p.flush(0);
+        p.touchOn(100, 60.0f, 0.1f, 0.2f, 0.3f);
+        p.flush(0);
+        assert(sink.sizes_.size() == 2);
+        assert(p.stats().packets_ == 2 && p.stats().messages_ == 5);
+    }
+
+    // split at mtu, frame message leads
+    {
+        TestSink sink;
+        mec::OSC_Processor p(&sink);
+        p.setMtu(256);
+        p.setFrameMessages(true);
+        for (int i = 0; i < 40; i++) p.touchContinue(i, 60.0f, 0.5f, 0.5f, 0.5f);
+        p.flush(5000000);
+        assert(sink.sizes_.size() > 1 && sink.msgs_.size() == 41);
+        for (auto s : sink.sizes_) assert(s <= 256);
+        assert(sink.msgs_[0].address_ == "/t3d/frm" && sink.msgs_[0].args_[0] == 0.0f && sink.msgs_[0].args_[1] == 5.0f);
+        assert(sink.msgs_[40].address_ == "/t3d/tch39");
+    }
+
+    // output rate, continues coalesced, on/off kept
+    {
+        TestSink sink;
+        mec::OSC_Processor p(&sink);
+        p.setOutputRate(100); // 10ms
+        p.touchOn(2, 60.0f, 0.0f, 0.0f, 0.5f);
+        assert(p.flush(1000000000ULL));
+        assert(sink.msgs_.size() == 1);
+
+        for (int i = 1; i <= 5; i++) {
+            p.touchContinue(2, 60.0f, 0.1f * i, 0.0f, 0.5f);
+            p.flush(1000000000ULL + i * 1000000ULL);
+        }
+        assert(sink.sizes_.size() == 1 && p.isPending()); // tick not due yet
+        p.flush(1010000000ULL);
+        assert(sink.sizes_.size() == 2 && sink.msgs_.size() == 2 && sink.msgs_[1].args_[0] == 0.5f);
+        assert(p.stats().coalesced_ == 4);
+
+        // continue then off before tick, only the off
+        p.touchContinue(2, 60.0f, 0.9f, 0.0f, 0.5f);
+        p.touchOff(2, 60.0f, 0.9f, 0.0f, 0.5f);
+        p.flush(1020000000ULL);
+        assert(sink.msgs_.size() == 3 && sink.msgs_[2].args_[2] == 0.0f);
+    }
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include <devices/mec_osct3d.h>
+#include <mec_log.h>
+#include <mec_recorder.h>
+
+#include <osc/OscOutboundPacketStream.h>
+
+class TestCallback : public mec::Callback {
+public:
+    void touchOn(int touchId, float note, float x, float y, float z) override {
+        on_++;
+        lastId_ = touchId;
+        lastNote_ = note;
+    }
+
+    void touchContinue(int touchId, float note, float x, float y, float z) override { continue_++; }
+
+    void touchOff(int touchId, float note, float x, float y, float z) override { off_++; }
+
+    void mec_control(int cmd, void *other) override { shutdown_ += (cmd == ICallback::SHUTDOWN); }
+
+    unsigned on_ = 0, continue_ = 0, off_ = 0, shutdown_ = 0;
+    int lastId_ = -1;
+    float lastNote_ = 0.0f;
+};
+
+// feed a packet in, as replay of a recording would
+static void replay(mec::OscT3D &dev, const char *data, unsigned size) {
+    std::vector<unsigned long long> buf((sizeof(mec::EventRecord) + size + 7) / 8);
+    mec::EventRecord *r = reinterpret_cast<mec::EventRecord *>(buf.data());
+    r->size_ = static_cast<uint32_t>(buf.size() * 8);
+    r->type_ = 0;
+    r->len_ = static_cast<uint16_t>(size);
+    r->time_ = 0;
+    memcpy(r + 1, data, size);
+    dev.replay(*r);
+}
+
+static void replay(mec::OscT3D &dev, osc::OutboundPacketStream &p) {
+    replay(dev, p.Data(), static_cast<unsigned>(p.Size()));
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    TestCallback cb;
+    mec::OscT3D dev(cb);
+    assert(dev.initReplay(nullptr));
+
+    char buf[1024];
+
+    // touch on only once velocity is detected, index parsed from address
+    for (unsigned i = 0; i < 6; i++) {
+        osc::OutboundPacketStream p(buf, sizeof(buf));
+        p << osc::BeginBundleImmediate
+          << osc::BeginMessage("/t3d/frm") << (osc::int32) i << (osc::int32) 0 << osc::EndMessage
+          << osc::BeginMessage("/t3d/tch12") << 0.5f << 0.5f << 0.2f * (i + 1) << 60.0f << osc::EndMessage
+          << osc::EndBundle;
+        replay(dev, p);
+    }
+    dev.process();
+    assert(cb.on_ == 1 && cb.lastId_ == 0 && cb.lastNote_ == 60.0f);
+
+    {
+        osc::OutboundPacketStream p(buf, sizeof(buf));
+        p << osc::BeginMessage("/t3d/tch12") << 0.5f << 0.5f << 0.0f << 61.0f << osc::EndMessage;
+        replay(dev, p);
+    }
+    dev.process();
+    assert(cb.off_ == 1);
+
+    // unknown addresses, bad arguments, counted not thrown
+    const char *unknown[] = {"/t3d/tch", "/t3d/tchx", "/t3d/tch1x", "/t3d/tch1234567890", "/t3d/frmx", "/foo"};
+    for (auto addr : unknown) {
+        osc::OutboundPacketStream p(buf, sizeof(buf));
+        p << osc::BeginMessage(addr) << 0.5f << 0.5f << 0.5f << 60.0f << osc::EndMessage;
+        replay(dev, p);
+    }
+    {
+        osc::OutboundPacketStream p(buf, sizeof(buf));
+        p << osc::BeginBundleImmediate
+          << osc::BeginMessage("/t3d/tch1") << 0.5f << 0.5f << 0.5f << osc::EndMessage
+          << osc::BeginMessage("/t3d/frm") << 1.0f << 2.0f << osc::EndMessage
+          << osc::BeginMessage("/t3d/command") << (osc::int32) 1 << osc::EndMessage
+          << osc::EndBundle;
+        replay(dev, p);
+    }
+    replay(dev, "#bundle", 7);
+
+    {
+        osc::OutboundPacketStream p(buf, sizeof(buf));
+        p << osc::BeginMessage("/t3d/command") << "shutdown" << osc::EndMessage;
+        replay(dev, p);
+    }
+    dev.process();
+    assert(cb.shutdown_ == 1 && cb.on_ == 1 && cb.continue_ == 0);
+
+    mec::OscT3D::Stats s = dev.stats();
+    assert(s.packets_ == 7 + 6 + 3);
+    assert(s.messages_ == 12 + 1 + 6 + 3 + 1);
+    assert(s.unknown_ == 6 && s.badArgs_ == 3 && s.malformed_ == 1);
+
+    dev.deinit();
+    LOG_0("test completed");
+    return 0;
+}
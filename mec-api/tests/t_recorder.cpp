@@ -0,0 +1,108 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <mec_recorder.h>
+#include <mec_log.h>
+
+struct TestRec {
+    int id_;
+    float v_;
+};
+
+int main(int ac, char **av) {
+    LOG_0("test started");
+    const char *file = "t_recorder.mecr";
+
+    // small chunks, so the file has to grow while recording
+    const int N = 10000;
+    {
+        mec::EventRecorder recorder;
+        assert(!recorder.isOpen());
+        assert(!recorder.record(1, TestRec{0, 0.0f}));
+        assert(recorder.open(file, "test", 4096));
+        assert(recorder.isOpen());
+        for (int i = 0; i < N; i++) {
+            if (i % 3) {
+                assert(recorder.record(1, TestRec{i, i * 0.5f}));
+            } else {
+                char bytes[3] = {char(i & 0x7f), 1, 2};
+                assert(recorder.record(2, bytes, (i % 2) ? 3 : 1));
+            }
+        }
+        assert(recorder.count() == N);
+        recorder.close();
+        assert(!recorder.isOpen());
+    }
+
+    mec::EventReader reader;
+    assert(!reader.isOpen());
+    assert(reader.next() == nullptr);
+    assert(reader.open(file));
+    assert(reader.device() == "test");
+
+    for (int pass = 0; pass < 2; pass++) {
+        unsigned long long lastTime = 0;
+        int i = 0;
+        for (const mec::EventRecord *r = reader.next(); r != nullptr; r = reader.next(), i++) {
+            assert(r->time_ >= lastTime);
+            assert((reinterpret_cast<uintptr_t>(r) % 8) == 0);
+            lastTime = r->time_;
+            if (i % 3) {
+                assert(r->type_ == 1);
+                const TestRec *t = r->as<TestRec>();
+                assert(t != nullptr && t->id_ == i && t->v_ == i * 0.5f);
+            } else {
+                assert(r->type_ == 2);
+                assert(r->len_ == ((i % 2) ? 3 : 1));
+                assert(r->as<TestRec>() == nullptr);
+                const char *bytes = static_cast<const char *>(r->data());
+                assert(bytes[0] == char(i & 0x7f));
+            }
+        }
+        assert(i == N);
+        reader.rewind();
+    }
+    reader.close();
+
+    // not a recording
+    FILE *fp = fopen(file, "wb");
+    const char junk[64] = "not a recording";
+    fwrite(junk, 1, sizeof(junk), fp);
+    fclose(fp);
+    assert(!reader.open(file));
+    assert(!reader.open("t_recorder_missing.mecr"));
+
+    // truncated recording, reads up to the corruption
+    {
+        mec::EventRecorder recorder;
+        assert(recorder.open(file, "test"));
+        for (int i = 0; i < 10; i++) recorder.record(1, TestRec{i, 0.0f});
+    }
+    fp = fopen(file, "r+b");
+    fseek(fp, 0, SEEK_END);
+    long sz = ftell(fp);
+    fclose(fp);
+    assert(sz > 0);
+    {
+        std::vector<char> buf(sz);
+        fp = fopen(file, "rb");
+        assert(fread(buf.data(), 1, sz, fp) == (size_t) sz);
+        fclose(fp);
+        fp = fopen(file, "wb");
+        fwrite(buf.data(), 1, sz - 4, fp);
+        fclose(fp);
+    }
+    assert(reader.open(file));
+    int n = 0;
+    while (reader.next()) n++;
+    assert(n == 9);
+    reader.close();
+
+    remove(file);
+    LOG_0("test completed");
+    return 0;
+}
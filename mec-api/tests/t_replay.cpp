@@ -0,0 +1,151 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <devices/mec_replaydevice.h>
+#include <mec_log.h>
+#include <mec_recorder.h>
+
+#include <osc/OscOutboundPacketStream.h>
+
+// touches in the order delivered, with time since replay started
+class TestCallback : public mec::Callback {
+public:
+    enum { ON, CONTINUE, OFF };
+
+    void touchOn(int touchId, float note, float x, float y, float z) override { add(ON, note); }
+
+    void touchContinue(int touchId, float note, float x, float y, float z) override { add(CONTINUE, note); }
+
+    void touchOff(int touchId, float note, float x, float y, float z) override { add(OFF, note); }
+
+    void mec_control(int cmd, void *other) override { shutdown_ += (cmd == ICallback::SHUTDOWN); }
+
+    void add(int type, float note) {
+        type_.push_back(type);
+        note_.push_back(note);
+        time_.push_back(mec::mecTimeNow() - start_);
+    }
+
+    mec::MecTime start_ = 0;
+    std::vector<int> type_;
+    std::vector<float> note_;
+    std::vector<mec::MecTime> time_;
+    unsigned shutdown_ = 0;
+};
+
+class TestFrameCallback : public mec::IFrameCallback {
+public:
+    void frame(const mec::TouchFrame &f) override {
+        frames_++;
+        touches_ += f.size_;
+    }
+
+    unsigned frames_ = 0, touches_ = 0;
+};
+
+// t3d packet, as the device records it
+static void record(mec::EventRecorder &recorder, int frame, float z, float note) {
+    char buf[256];
+    osc::OutboundPacketStream p(buf, sizeof(buf));
+    p << osc::BeginBundleImmediate
+      << osc::BeginMessage("/t3d/frm") << (osc::int32) frame << (osc::int32) 0 << osc::EndMessage
+      << osc::BeginMessage("/t3d/tch1") << 0.5f << 0.5f << z << note << osc::EndMessage
+      << osc::EndBundle;
+    assert(recorder.record(0, p.Data(), static_cast<unsigned>(p.Size())));
+}
+
+static void writePrefs(const char *file, const char *json) {
+    FILE *fp = fopen(file, "w");
+    fputs(json, fp);
+    fclose(fp);
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+    const char *file = "t_replay.mecr";
+    const char *prefsFile = "t_replay.json";
+    const mec::MecTime MS = 1000000;
+
+    // a touch, on once velocity is detected, then a continue and an off, each 30ms apart
+    {
+        mec::EventRecorder recorder;
+        assert(recorder.open(file, "osct3d"));
+        int frame = 0;
+        for (unsigned i = 0; i < 6; i++, frame++) record(recorder, frame, 0.1f * (i + 1), 60.0f);
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        record(recorder, frame++, 0.9f, 61.0f);
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        record(recorder, frame++, 0.0f, 61.0f);
+        assert(recorder.count() == 8);
+    }
+
+    // realtime, through the device queue, in order, and not before the recorded time
+    {
+        writePrefs(prefsFile, "{ \"file\" : \"t_replay.mecr\", \"speed\" : 1.0, \"shutdown\" : true }");
+        mec::Preferences prefs(prefsFile);
+        TestCallback cb;
+        TestFrameCallback fcb;
+        mec::ReplayDevice dev(cb);
+        assert(!dev.setFrameCallback(&fcb)); // no device until init
+        assert(dev.init(prefs.getTree()) && dev.isActive());
+        assert(dev.setFrameCallback(&fcb));
+
+        cb.start_ = mec::mecTimeNow();
+        while (cb.shutdown_ == 0 && mec::mecTimeNow() - cb.start_ < 2000 * MS) {
+            dev.process();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        assert(cb.shutdown_ == 1);
+        assert(cb.type_.size() == 3);
+        assert(cb.type_[0] == TestCallback::ON && cb.note_[0] == 60.0f);
+        assert(cb.type_[1] == TestCallback::CONTINUE && cb.note_[1] == 61.0f);
+        assert(cb.type_[2] == TestCallback::OFF);
+        assert(cb.time_[1] >= 30 * MS && cb.time_[2] >= 60 * MS);
+        assert(cb.time_[2] - cb.time_[1] >= 20 * MS);
+        assert(fcb.frames_ == 3 && fcb.touches_ == 3);
+        dev.deinit();
+        assert(!dev.isActive());
+    }
+
+    // as fast as possible, in batches
+    {
+        writePrefs(prefsFile, "{ \"file\" : \"t_replay.mecr\", \"speed\" : 0, \"batch\" : 4 }");
+        mec::Preferences prefs(prefsFile);
+        TestCallback cb;
+        mec::ReplayDevice dev(cb);
+        assert(dev.init(prefs.getTree()));
+        cb.start_ = mec::mecTimeNow();
+        dev.process(); // first 4 packets, no touch yet
+        assert(cb.type_.empty());
+        dev.process();
+        dev.process();
+        assert(cb.type_.size() == 3 && cb.type_[2] == TestCallback::OFF);
+        assert(cb.time_[2] < 30 * MS && cb.shutdown_ == 0);
+    }
+
+    // not a recording, or a device that cannot be replayed
+    {
+        writePrefs(prefsFile, "{ \"file\" : \"t_replay_missing.mecr\" }");
+        mec::Preferences prefs(prefsFile);
+        TestCallback cb;
+        mec::ReplayDevice dev(cb);
+        assert(!dev.init(prefs.getTree()) && !dev.isActive());
+
+        mec::EventRecorder recorder;
+        assert(recorder.open(file, "push2"));
+        recorder.close();
+        writePrefs(prefsFile, "{ \"file\" : \"t_replay.mecr\" }");
+        mec::Preferences prefs2(prefsFile);
+        assert(!dev.init(prefs2.getTree()));
+    }
+
+    remove(file);
+    remove(prefsFile);
+    LOG_0("test completed");
+    return 0;
+}
@@ -1,7 +1,9 @@
 #include <mec_api.h>
 #include <iostream>
 
+#include <atomic>
 #include <cassert>
+#include <thread>
 #include <mec_scaler.h>
 #include <mec_log.h>
 
@@ -84,6 +86,64 @@ int main (int argc, char** argv) {
     assert(mt.note_ == 19.5f);
 
 
+    // unknown scales
+    assert(mec::Scales::getScale("squirrel").empty());
+    assert(mec::Scales::getScale("squirrel").empty());
+    scaler.setScale("squirrel");
+    assert(scaler.getScale() == mec::Scales::getScale("minor"));
+
+    // precomputed table, against calculated (outside table)
+    mec::Touch tin[40];
+    mec::MusicalTouch tout[40];
+    for (unsigned i = 0; i < 40; i++) {
+        tin[i].id_ = i;
+        tin[i].r_ = float(i % 3);
+        tin[i].c_ = (float(i) * 7.3f) - 20.0f;
+    }
+    scaler.mapBatch(tin, tout, 40);
+    for (unsigned i = 0; i < 40; i++) {
+        assert(tout[i].id_ == (int) i);
+        assert(tout[i].note_ == scaler.note(tin[i].r_, tin[i].c_));
+    }
+    // octave either side of table edge
+    mec::ScaleTable calc(scaler.getScale(), 0.0f, 0.0f, 0.0f);
+    float b0, sl0, b1, sl1;
+    calc.column(mec::ScaleTable::N_COLUMNS - 7, b0, sl0);
+    calc.column(mec::ScaleTable::N_COLUMNS, b1, sl1);
+    assert(b1 == b0 + 12.0f);
+    assert(sl1 == sl0);
+    calc.column(-7, b0, sl0);
+    calc.column(0, b1, sl1);
+    assert(b1 == b0 + 12.0f);
+    assert(sl1 == sl0);
+
+    // key change, while mapping
+    mec::Scaler keyScaler;
+    keyScaler.set(mec::Scales::getScale("major"), 0.0f, 0.0f, 0.0f);
+    std::atomic<bool> running(true);
+    std::thread changer([&]() {
+        for (unsigned i = 0; i < 200; i++) {
+            keyScaler.setTonic(float(i % 2) * 7.0f);
+        }
+        running = false;
+    });
+    t.r_ = 0.0f;
+    t.c_ = 7.0f;
+    while (running) {
+        float n = keyScaler.note(t.r_, t.c_);
+        assert(n == 12.0f || n == 19.0f);
+        keyScaler.quiescent();
+    }
+    changer.join();
+
+    // replaced tables are freed, once the mapping thread has been quiescent
+    keyScaler.quiescent();
+    keyScaler.setTonic(2.0f);
+    assert(keyScaler.retired() == 1);
+    assert(keyScaler.note(t.r_, t.c_) == 14.0f);
+    keyScaler.setTonic(0.0f); // not quiescent since, so kept
+    assert(keyScaler.retired() == 2);
+
     LOG_0("test completed");
     return 0;
 }
\ No newline at end of file
@@ -7,6 +7,12 @@
 #include <mec_prefs.h>
 #include <mec_log.h>
 
+#include <type_traits>
+
+static mec::SurfaceID sid(const char *name) {
+    return mec::SurfaceRegistry::intern(name);
+}
+
 int main (int argc, char** argv) {
     LOG_0("test started");
 
@@ -23,36 +29,103 @@ int main (int argc, char** argv) {
     mec::SurfaceManager mgr;
     assert(mgr.init(sm_prefs));
 
+    // interned ids
+    assert(sid("1") == sid("1"));
+    assert(sid("1") != sid("2"));
+    assert(mec::SurfaceRegistry::name(sid("10")) == "10");
+    assert(mec::SurfaceRegistry::name(sid("10") + 1000).empty());
+    static_assert(std::is_trivially_copyable<mec::Touch>::value, "Touch must be trivially copyable");
+    static_assert(std::is_trivially_copyable<mec::MusicalTouch>::value, "MusicalTouch must be trivially copyable");
+    static_assert(sizeof(mec::MusicalTouch) <= 64, "MusicalTouch should fit in a cache line");
+
     mec::Touch t;
     mec::Touch out;
 
     // simple split
-    std::shared_ptr<mec::Surface> split1 = mgr.getSurface("1");
+    std::shared_ptr<mec::Surface> split1 = mgr.getSurface(sid("1"));
     assert(split1 != nullptr);
-    t.surface_ = "a1";
+    t.surface_ = sid("a1");
     t.x_ = 0.1f;
     out = split1->map(t);
     assert(out.x_ == t.x_);
-    assert(out.surface_ == "10");
+    assert(out.surface_ == sid("10"));
     t.x_ = 0.8f;
     out = split1->map(t);
     assert(out.x_ == 0.3f);
-    assert(out.surface_ == "11");
+    assert(out.surface_ == sid("11"));
 
 
 
     // simple join
-    std::shared_ptr<mec::Surface> join1 = mgr.getSurface("2");
+    std::shared_ptr<mec::Surface> join1 = mgr.getSurface(sid("2"));
     assert(join1 != nullptr);
     t.x_ = 0.1f;
-    t.surface_ = "20";
+    t.surface_ = sid("20");
     out = join1->map(t);
     assert(out.x_ == t.x_);
-    assert(out.surface_ == "2");
-    t.surface_ = "21";
+    assert(out.surface_ == sid("2"));
+    t.surface_ = sid("21");
     out = join1->map(t);
     assert(out.x_ == 1.1f);
-    assert(out.surface_ == "2");
+    assert(out.surface_ == sid("2"));
+
+
+
+    // compiled graph
+    // split then join (defined in reverse order), gives original touch
+    float v[mec::SurfaceNode::N_AXES] = {0.8f, 0.0f, 0.0f, 0.0f, 0.0f};
+    int idx = mgr.route(mgr.index(sid("5")), v);
+    assert(mgr.id(idx) == sid("4"));
+    assert(v[0] == 0.8f);
+    assert(mgr.index(sid("5")) < mgr.index(sid("40")));
+    assert(mgr.index(sid("40")) < mgr.index(sid("4")));
+
+    // same as reference implementation
+    v[0] = 0.8f;
+    idx = mgr.route(mgr.index(sid("1")), v);
+    assert(mgr.id(idx) == sid("11"));
+    assert(v[0] == 0.3f);
+    v[0] = 0.1f;
+    idx = mgr.route(mgr.index(sid("21")), v);
+    assert(mgr.id(idx) == sid("2"));
+    assert(v[0] == 1.1f);
+    assert(mgr.scaler(idx) == nullptr);
+
+    // keyboard split on column (note), upper half transformed back and scaled
+    v[mec::Surface::C_C] = 59.0f;
+    idx = mgr.route(mgr.index(sid("3")), v);
+    assert(mgr.id(idx) == sid("30"));
+    assert(v[mec::Surface::C_C] == 59.0f);
+    v[mec::Surface::C_C] = 62.0f;
+    idx = mgr.route(mgr.index(sid("3")), v);
+    assert(mgr.id(idx) == sid("31"));
+    assert(v[mec::Surface::C_C] == 62.0f);
+    assert(mgr.scaler(idx) == nullptr); // scales not loaded
+
+    // cycles are broken, rather than looping
+    idx = mgr.route(mgr.index(sid("6")), v);
+    assert(idx >= 0);
+
+    // inputs, are added as plain surfaces
+    mec::SurfaceManager mgr2;
+    assert(!mgr2.init(mec::Preferences(nullptr), {sid("soundplane")}));
+    assert(mgr2.size() == 1);
+    v[0] = 0.5f;
+    idx = mgr2.route(mgr2.index(sid("soundplane")), v);
+    assert(mgr2.id(idx) == sid("soundplane"));
+    assert(v[0] == 0.5f);
+
+    // scaler on output surface
+    assert(mec::Scales::init(mec::Preferences(mec_prefs.getSubTree("scales"))));
+    mec::SurfaceManager mgr3;
+    assert(mgr3.init(sm_prefs));
+    v[mec::Surface::C_R] = 0.0f;
+    v[mec::Surface::C_C] = 62.0f;
+    idx = mgr3.route(mgr3.index(sid("3")), v);
+    assert(mgr3.id(idx) == sid("31"));
+    assert(mgr3.scaler(idx) != nullptr);
+    // 62 = 8 octaves + 6 major degrees = 96 + 11
+    assert(mgr3.scaler(idx)->note(v[mec::Surface::C_R], v[mec::Surface::C_C]) == 107.0f);
 
     LOG_0("test completed");
     return 0;
@@ -0,0 +1,102 @@
+#include <cassert>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <ip/IpEndpointName.h>
+#include <mec_log.h>
+#include <mec_udp_receiver.h>
+
+class TestListener : public PacketListener {
+public:
+    void ProcessPacket(const char *data, int size, const IpEndpointName &remote) override {
+        packets_++;
+        bytes_ += size;
+        if (size > 0 && data[0] != 'x') bad_++;
+        port_ = remote.port;
+    }
+
+    unsigned packets_ = 0, bytes_ = 0, bad_ = 0;
+    int port_ = 0;
+};
+
+// receive until count packets, or nothing arrives for a while
+static void receive(mec::UdpReceiver &r, TestListener &l, unsigned count) {
+    while (l.packets_ < count && r.receive(500000) > 0);
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+#ifdef __linux__
+    // batched over loopback
+    {
+        TestListener l;
+        mec::UdpReceiver r(&l, 16);
+        assert(r.open(0) && r.port() > 0);
+
+        mec::UdpBlaster b;
+        assert(b.open("127.0.0.1", r.port()));
+        std::vector<char> pkt(64, 'x');
+        assert(b.send(pkt.data(), pkt.size(), 200) == 200);
+
+        receive(r, l, 200);
+        assert(l.packets_ == 200 && l.bytes_ == 200 * 64 && l.bad_ == 0 && l.port_ > 0);
+        assert(r.stats().packets_ == 200 && r.stats().calls_ < 200);
+
+        // too large, dropped
+        std::vector<char> big(mec::UdpReceiver::MAX_PACKET_SIZE + 100, 'x');
+        assert(b.send(big.data(), big.size(), 1) == 1);
+        assert(b.send(pkt.data(), pkt.size(), 1) == 1);
+        receive(r, l, 201);
+        assert(l.packets_ == 201 && r.stats().truncated_ == 1);
+    }
+#endif
+
+    // fan out, to several destinations
+    {
+        TestListener l1, l2;
+        mec::UdpReceiver r1(&l1), r2(&l2);
+        assert(r1.open(0) && r2.open(0));
+
+        mec::UdpSender s;
+        assert(s.open());
+        int d1 = s.addDestination("127.0.0.1", r1.port());
+        int d2 = s.addDestination("127.0.0.1", r2.port());
+        assert(d1 >= 0 && d2 >= 0 && d1 != d2);
+
+        std::vector<char> pkt(32, 'x');
+        std::vector<mec::UdpSender::Datagram> dgs;
+        for (unsigned i = 0; i < 10; i++) {
+            dgs.push_back({pkt.data(), (unsigned) pkt.size(), (unsigned) d1});
+            dgs.push_back({pkt.data(), (unsigned) pkt.size(), (unsigned) d2});
+        }
+        assert(s.send(dgs.data(), dgs.size()) == 20 && s.stats().datagrams_ == 20);
+
+        // removed, not sent
+        s.removeDestination(d2);
+        assert(s.send(&dgs[1], 1) == 0);
+
+#ifdef __linux__
+        assert(s.stats().calls_ == 1);
+        receive(r1, l1, 10);
+        receive(r2, l2, 10);
+        assert(l1.packets_ == 10 && l2.packets_ == 10);
+#endif
+    }
+
+    // run on a thread, until break
+    {
+        TestListener l;
+        mec::UdpReceiver r(&l);
+        assert(r.open(0));
+        std::thread t([&r]() { r.run(); });
+        r.asynchronousBreak();
+        t.join();
+        r.close();
+        assert(!r.isOpen());
+    }
+
+    LOG_0("test completed");
+    return 0;
+}
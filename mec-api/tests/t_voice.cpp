@@ -29,6 +29,53 @@ int main (int argc, char** argv) {
     voices.startVoice(4);
     assert(voices.oldestActiveVoice()->id_ == 2);
 
+    // id lookup, including ids outside the direct table
+    mec::Voices big(4, 2, 128);
+    mec::Voices::Voice *v1 = big.startVoice(5);
+    mec::Voices::Voice *v2 = big.startVoice(1000);
+    assert(big.voiceId(5) == v1);
+    assert(big.voiceId(1000) == v2);
+    assert(big.voiceId(6) == nullptr);
+    big.stopVoice(v1);
+    big.stopVoice(v1); // already stopped, ignored
+    assert(big.voiceId(5) == nullptr);
+    assert(big.oldestActiveVoice() == v2);
+    big.stopVoice(v2);
+    assert(big.oldestActiveVoice() == nullptr);
+
+    // freed voices are reused last
+    v1 = big.startVoice(1);
+    big.stopVoice(v1);
+    v2 = big.startVoice(2);
+    assert(v2 != v1);
+
+    // stolen ids
+    big.markStolen(7);
+    assert(big.isStolen(7));
+    assert(!big.isStolen(8));
+    big.clearStolen(7);
+    assert(!big.isStolen(7));
+    big.markStolen(1000); // not tracked
+    assert(!big.isStolen(1000));
+
+    // steal policies
+    mec::Voices steal(3, 2);
+    v = steal.startVoice(10);
+    v->note_ = 60.0f;
+    v->z_ = 0.5f;
+    v = steal.startVoice(11);
+    v->note_ = 64.0f;
+    v->z_ = 0.1f;
+    v = steal.startVoice(12);
+    v->note_ = 67.0f;
+    v->z_ = 0.9f;
+    assert(steal.voiceToSteal(66.0f)->id_ == 10);
+    steal.stealPolicy(mec::Voices::stealPolicy("quietest"));
+    assert(steal.voiceToSteal(66.0f)->id_ == 11);
+    steal.stealPolicy(mec::Voices::stealPolicy("nearest"));
+    assert(steal.voiceToSteal(66.0f)->id_ == 12);
+    assert(steal.voiceToSteal(61.0f)->id_ == 10);
+
     LOG_0("test completed");
     return 0;
 }
\ No newline at end of file
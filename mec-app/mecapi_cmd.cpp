@@ -3,7 +3,6 @@
 
 #include <pthread.h>
 
-#include <osc/OscOutboundPacketStream.h>
 #include <ip/UdpSocket.h>
 
 #include "mec_app.h"
@@ -11,9 +10,10 @@
 
 #include <mec_api.h>
 #include <mec_prefs.h>
+#include <processors/mec_midi_encoder.h>
+#include <processors/mec_midi_scheduler.h>
 #include <processors/mec_mpe_processor.h>
-
-#define OUTPUT_BUFFER_SIZE 1024
+#include <processors/mec_osc_processor.h>
 
 //hacks for now
 //#define VELOCITY 1.0f
@@ -95,133 +95,224 @@ private:
 };
 
 
-// this is basically T3D, but doesnt have the framemessages (/t3d/frm)
-class MecOSCCallback : public MecCmdCallback {
+// t3d over udp, see OSC_Processor
+class UdpOscSink : public mec::IOscSink {
+public:
+    UdpOscSink(const IpEndpointName &remote) : socket_(remote) {
+        ;
+    }
+
+    bool send(const char *data, unsigned size) override {
+        socket_.Send(data, size);
+        return true;
+    }
+
+private:
+    UdpTransmitSocket socket_;
+};
+
+// touches from each process are sent as one bundle, optionally with frame messages (/t3d/frm)
+// devices with frames are processed a frame at a time
+class MecOSCProcessor : public mec::OSC_Processor, public mec::IFrameCallback {
 public:
-    MecOSCCallback(mec::Preferences &p)
+    MecOSCProcessor(mec::Preferences &p)
             : prefs_(p),
-              transmitSocket_(IpEndpointName(p.getString("host", "127.0.0.1").c_str(), p.getInt("port", 9001))),
+              sink_(IpEndpointName(p.getString("host", "127.0.0.1").c_str(), p.getInt("port", 9001))),
               valid_(true) {
+        setSink(&sink_);
+        setMtu(static_cast<unsigned>(p.getInt("mtu", DEFAULT_MTU)));
+        setOutputRate(static_cast<unsigned>(p.getInt("output rate", 0)));
+        setFrameMessages(p.getBool("frame messages", false));
         if (valid_) {
-            LOG_0("mecapi_proc enabling for osc");
+            LOG_0("mecapi_proc enabling for osc, output rate : " << p.getInt("output rate", 0));
         }
     }
 
     bool isValid() { return valid_; }
 
-    void touchOn(int touchId, float note, float x, float y, float z) {
-        std::string topic = "/t3d/tch" + std::to_string(touchId);
-        sendMsg(topic, touchId, note, x, y, z);
-    }
-
-    void touchContinue(int touchId, float note, float x, float y, float z) {
-        std::string topic = "/t3d/tch" + std::to_string(touchId);
-        sendMsg(topic, touchId, note, x, y, z);
+    void mec_control(int cmd, void *other) override {
+        if (cmd == mec::ICallback::SHUTDOWN) {
+            LOG_0("mec requesting shutdown");
+            keepRunning = 0;
+            waitCond.notify_all();
+        }
     }
 
-    void touchOff(int touchId, float note, float x, float y, float z) {
-        std::string topic = "/t3d/tch" + std::to_string(touchId);
-        sendMsg(topic, touchId, note, x, y, 0);
+    void frame(const mec::TouchFrame &f) override { OSC_Processor::frame(f); }
 
-    }
+private:
+    mec::Preferences prefs_;
+    UdpOscSink sink_;
+    bool valid_;
+};
 
-    void control(int ctrlId, float v) {
-        osc::OutboundPacketStream op(buffer_, OUTPUT_BUFFER_SIZE);
-        op << osc::BeginBundleImmediate
-           << osc::BeginMessage("/t3d/control")
-           << ctrlId << v
-           << osc::EndMessage
-           << osc::EndBundle;
-        transmitSocket_.Send(op.Data(), op.Size());
+// an output port : processor -> scheduler (byte rate budget) -> encoder -> output
+class MidiPort {
+public:
+    bool create(mec::Preferences &p, const std::string &device) {
+        int virt = p.getInt("virtual", 0);
+        output_.create(device, virt > 0);
+        scheduler_.load(p);
+        scheduler_.setOutput(&encoder_);
+        encoder_.load(p);
+        if (p.getBool("running status", false)) {
+            LOG_0("midi output : running status not supported by rtmidi, ignored");
+        }
+        encoder_.setRunningStatus(false); // rtmidi needs complete messages
+        encoder_.setOutput(&output_);
+        return output_.isOpen();
     }
 
-    void sendMsg(std::string topic, int touchId, float note, float x, float y, float z) {
-        osc::OutboundPacketStream op(buffer_, OUTPUT_BUFFER_SIZE);
-        op << osc::BeginBundleImmediate
-           << osc::BeginMessage(topic.c_str())
-           << x << y << z << note
-           << osc::EndMessage
-           << osc::EndBundle;
-        transmitSocket_.Send(op.Data(), op.Size());
-    }
+    mec::MidiScheduler &scheduler() { return scheduler_; }
+    const mec::MidiEncoder &encoder() const { return encoder_; }
 
 private:
-    mec::Preferences prefs_;
-    UdpTransmitSocket transmitSocket_;
-    char buffer_[OUTPUT_BUFFER_SIZE];
-    bool valid_;
+    MidiOutput output_;
+    mec::MidiEncoder encoder_;
+    mec::MidiScheduler scheduler_;
 };
 
+typedef std::vector<std::unique_ptr<MidiPort>> MidiPorts;
+
 class MecMidiProcessor : public mec::Midi_Processor {
 public:
     MecMidiProcessor(mec::Preferences &p) : prefs_(p) {
         setPitchbendRange(static_cast<float>(p.getDouble("pitchbend range", 48.0f)));
         std::string device = prefs_.getString("device");
-        int virt = prefs_.getInt("virtual", 0);
-        if (output_.create(device, virt > 0)) {
+        ports_.emplace_back(new MidiPort());
+        valid_ = ports_[0]->create(prefs_, device);
+        if (valid_) {
             LOG_1("MecMidiProcessor enabling for midi to " << device);
-        }
-        if (!output_.isOpen()) {
+        } else {
             LOG_0("MecMidiProcessor not open, so invalid for" << device);
         }
+        setSink(&ports_[0]->scheduler()); // queued on flush(), sent by scheduler().service()
     }
 
-    bool isValid() { return output_.isOpen(); }
+    bool isValid() { return valid_; }
 
-    void process(mec::Midi_Processor::MidiMsg &m) {
-        if (output_.isOpen()) {
-            std::vector<unsigned char> msg;
-
-            for (int i = 0; i < m.size; i++) {
-                msg.push_back((unsigned char) m.data[i]);
-            }
-            output_.sendMsg(msg);
-        }
-    }
+    MidiPorts &ports() { return ports_; }
 
 private:
     mec::Preferences prefs_;
-    MidiOutput output_;
+    MidiPorts ports_;
+    bool valid_;
 };
 
 
 
-class MecMpeProcessor : public mec::MPE_Processor {
+// voices are spread over the mpe zones, which can be on several ports ("devices"), to go beyond 15 voices
+// e.g. "devices" : [ "a", "b" ], "zones" : [ { "port" : 0, "zone" : "lower", "channels" : 15 } , ...]
+// without zones, each port has a lower zone of 15 channels
+// a port which does not open has no sink and no zones, so its voices go to the other ports
+// devices with frames are processed a frame at a time
+class MecMpeProcessor : public mec::MPE_Processor, public mec::IFrameCallback {
 public:
-    MecMpeProcessor(mec::Preferences &p) : prefs_(p) {
+    MecMpeProcessor(mec::Preferences &p) : prefs_(p), valid_(false) {
         // p.getInt("voices", 15);
         setPitchbendRange(static_cast<float>(p.getDouble("pitchbend range", 48.0f)));
-        std::string device = prefs_.getString("device");
-        int virt = prefs_.getInt("virtual", 0);
-        if (output_.create(device, virt > 0)) {
-            LOG_1("MecMpeProcessor enabling for midi to " << device);
-            LOG_1("TODO (MecMpeProcessor) :");
-            LOG_1("- MPE init, including PB range");
-        }
-        if (!output_.isOpen()) {
-            LOG_0("MecMpeProcessor not open, so invalid for" << device);
-        }
-    }
+        setOutputRate(static_cast<unsigned>(p.getInt("output rate", 0)));
 
-    bool isValid() { return output_.isOpen(); }
+        std::vector<std::string> devices;
+        if (prefs_.exists("devices")) {
+            mec::Preferences::Array array(prefs_.getArray("devices"));
+            unsigned size = static_cast<unsigned>(array.getSize());
+            for (unsigned i = 0; i < size && i < MAX_PORTS; i++) devices.push_back(array.getString(i));
+        } else {
+            devices.push_back(prefs_.getString("device"));
+        }
 
-    void process(mec::MPE_Processor::MidiMsg &m) {
-        if (output_.isOpen()) {
-            std::vector<unsigned char> msg;
+        // port index is the position in devices, so zones refer to the configured port
+        std::vector<bool> open(devices.size(), false);
+        for (unsigned i = 0; i < devices.size(); i++) {
+            ports_.emplace_back(new MidiPort());
+            open[i] = ports_[i]->create(prefs_, devices[i]);
+            if (open[i]) {
+                LOG_1("MecMpeProcessor enabling for midi to " << devices[i] << " port " << i);
+                setSink(&ports_[i]->scheduler(), i); // queued on flush(), sent by scheduler().service()
+            } else {
+                LOG_0("MecMpeProcessor not open, so invalid for" << devices[i]);
+            }
+        }
 
-            for (int i = 0; i < m.size; i++) {
-                msg.push_back((unsigned char) m.data[i]);
+        channels().clear();
+        if (prefs_.exists("zones")) {
+            mec::Preferences::Array array(prefs_.getArray("zones"));
+            unsigned size = static_cast<unsigned>(array.getSize());
+            for (unsigned i = 0; i < size; i++) {
+                mec::Preferences zone(array.getObject(i));
+                unsigned port = static_cast<unsigned>(zone.getInt("port", 0));
+                mec::MpeChannelAllocator::ZoneType type = zone.getString("zone", "lower") == "upper"
+                                                          ? mec::MpeChannelAllocator::UPPER
+                                                          : mec::MpeChannelAllocator::LOWER;
+                unsigned members = static_cast<unsigned>(zone.getInt("channels", 15));
+                if (port >= ports_.size() || !open[port]) {
+                    LOG_0("MecMpeProcessor zone " << i << ", port " << port << " not open, ignored");
+                } else if (!channels().addZone(port, type, members)) {
+                    LOG_0("MecMpeProcessor invalid zone " << i << ", ignored");
+                }
+            }
+        } else {
+            for (unsigned i = 0; i < ports_.size(); i++) {
+                if (!open[i]) continue;
+                channels().addZone(i, mec::MpeChannelAllocator::LOWER, mec::MpeChannelAllocator::MAX_MEMBERS);
             }
-            output_.sendMsg(msg);
         }
+        valid_ = channels().zoneCount() > 0;
+        LOG_1("MecMpeProcessor " << channels().zoneCount() << " zones, " << channels().size() << " channels");
+        LOG_1("TODO (MecMpeProcessor) :");
+        LOG_1("- MPE init, PB range");
+        sendZoneConfig();
     }
 
+    bool isValid() { return valid_; }
+
+    MidiPorts &ports() { return ports_; }
+
+    void frame(const mec::TouchFrame &f) override { MPE_Processor::frame(f); }
+
 private:
     mec::Preferences prefs_;
-    MidiOutput output_;
+    MidiPorts ports_;
+    bool valid_;
 };
 
 
+static void logLatencyStats(mec::MecApi &api) {
+    std::vector<mec::DeviceStats> stats = api.stats();
+    for (auto &ds : stats) {
+        for (unsigned s = 0; s < mec::LatencyStats::N_STAGES; s++) {
+            const mec::LatencySnapshot &h = ds.stages_[s];
+            if (h.count_ == 0) continue;
+            LOG_0("latency " << ds.device_ << " " << mec::LatencyStats::stageName((mec::LatencyStats::Stage) s)
+                             << " n: " << h.count_
+                             << " mean: " << h.meanUs() << "us"
+                             << " p50: <" << h.percentileUs(0.5) << "us"
+                             << " p99: <" << h.percentileUs(0.99) << "us"
+                             << " max: " << h.maxUs_ << "us");
+        }
+    }
+}
+
+static void logEncoderStats(const mec::MidiEncoder &encoder) {
+    const mec::MidiEncoder::Stats &s = encoder.stats();
+    LOG_0("midi output " << s.messagesIn_ << " messages, " << s.messagesDropped_ << " suppressed, "
+                         << s.bytesOut_ << " bytes sent, " << s.bytesSaved() << " bytes saved");
+}
+
+static void logOscStats(const mec::OSC_Processor &osc) {
+    const mec::OSC_Processor::Stats &s = osc.stats();
+    LOG_0("osc output " << s.messages_ << " messages, " << s.packets_ << " packets, " << s.bytes_ << " bytes, "
+                        << s.coalesced_ << " coalesced, " << s.sendErrors_ << " send errors");
+}
+
+static void logSchedulerStats(const mec::MidiScheduler &scheduler) {
+    const mec::MidiScheduler::Stats &s = scheduler.stats();
+    LOG_0("midi scheduler " << s.messagesIn_ << " messages, " << s.coalesced_ << " replaced, "
+                            << s.overBudget_ << " over budget, max note delay: "
+                            << (s.maxPriorityDelay_ / 1000) << "us");
+}
+
 void *mecapi_proc(void *arg) {
     static int exitCode = 0;
 
@@ -241,12 +332,29 @@ void *mecapi_proc(void *arg) {
     std::unique_ptr<mec::MecApi> mecApi;
     mecApi.reset(new mec::MecApi(arg));
 
+    // midi is buffered by the processors, and flushed once per process
+    // then sent by the scheduler, as the output byte rate allows
+    std::vector<mec::Midi_Processor *> midiOutputs;
+    std::vector<mec::MPE_Processor *> mpeOutputs; // ticked for output rate
+    std::vector<mec::MidiScheduler *> midiSchedulers;
+    std::vector<const mec::MidiEncoder *> midiEncoders;
+    std::vector<mec::OSC_Processor *> oscOutputs; // bundle per process, or per output rate tick
+    auto addPorts = [&](MidiPorts &ports) {
+        for (auto &port : ports) {
+            midiSchedulers.push_back(&port->scheduler());
+            midiEncoders.push_back(&port->encoder());
+        }
+    };
+
     if (outprefs.exists("midi")) {
         mec::Preferences cbprefs(outprefs.getSubTree("midi"));
         if(cbprefs.getBool("mpe",true)) {
             MecMpeProcessor *pCb = new MecMpeProcessor(cbprefs);
             if (pCb->isValid()) {
-                mecApi->subscribe(pCb);
+                mecApi->subscribe(static_cast<mec::ICallback *>(pCb), static_cast<mec::IFrameCallback *>(pCb));
+                midiOutputs.push_back(pCb);
+                mpeOutputs.push_back(pCb);
+                addPorts(pCb->ports());
             } else {
                 delete pCb;
             }
@@ -254,6 +362,8 @@ void *mecapi_proc(void *arg) {
             MecMidiProcessor *pCb = new MecMidiProcessor(cbprefs);
             if (pCb->isValid()) {
                 mecApi->subscribe(pCb);
+                midiOutputs.push_back(pCb);
+                addPorts(pCb->ports());
             } else {
                 delete pCb;
             }
@@ -261,9 +371,10 @@ void *mecapi_proc(void *arg) {
     }
     if (outprefs.exists("osc")) {
         mec::Preferences cbprefs(outprefs.getSubTree("osc"));
-        MecOSCCallback *pCb = new MecOSCCallback(cbprefs);
+        MecOSCProcessor *pCb = new MecOSCProcessor(cbprefs);
         if (pCb->isValid()) {
-            mecApi->subscribe(pCb);
+            mecApi->subscribe(static_cast<mec::ICallback *>(pCb), static_cast<mec::IFrameCallback *>(pCb));
+            oscOutputs.push_back(pCb);
         } else {
             delete pCb;
         }
@@ -280,16 +391,42 @@ void *mecapi_proc(void *arg) {
 
     mecApi->init();
 
-    {
-        std::unique_lock<std::mutex> lock(waitMtx);
-        while (keepRunning) {
-            mecApi->process();
-            waitCond.wait_for(lock, std::chrono::milliseconds(5));
+    // process as soon as devices have data, timeout is only so we notice keepRunning
+    // or, when midi is waiting for budget or an output rate tick, so it is sent
+    static const unsigned MAX_WAIT_MS = 100;
+    static const unsigned SCHEDULER_WAIT_MS = 1;
+    while (keepRunning) {
+        mecApi->process();
+        unsigned waitMs = MAX_WAIT_MS;
+        mec::MecTime now = mec::mecTimeNow();
+        for (auto mpe : mpeOutputs) {
+            mpe->tick(now);
+            if (mpe->isPending()) {
+                unsigned ms = static_cast<unsigned>((mpe->nextTick() - now) / 1000000) + 1;
+                if (ms < waitMs) waitMs = ms;
+            }
+        }
+        for (auto midi : midiOutputs) midi->flush();
+        for (auto osc : oscOutputs) {
+            osc->flush(now);
+            if (osc->isPending()) {
+                unsigned ms = static_cast<unsigned>((osc->nextTick() - now) / 1000000) + 1;
+                if (ms < waitMs) waitMs = ms;
+            }
+        }
+        for (auto scheduler : midiSchedulers) {
+            scheduler->service();
+            if (scheduler->isPending()) waitMs = SCHEDULER_WAIT_MS;
         }
+        mecApi->waitForEvents(waitMs);
     }
 
     // delete the api, so that it can clean up
     LOG_0("mecapi_proc stopping");
+    logLatencyStats(*mecApi);
+    for (auto scheduler : midiSchedulers) logSchedulerStats(*scheduler);
+    for (auto encoder : midiEncoders) logEncoderStats(*encoder);
+    for (auto osc : oscOutputs) logOscStats(*osc);
     mecApi.reset();
     sleep(1);
     LOG_0("mecapi_proc stopped");
@@ -56,6 +56,27 @@ bool MidiOutput::create(const std::string &portname, bool virt) {
     return false;
 }
 
+bool MidiOutput::send(const unsigned char *data, unsigned size) {
+    if (!isOpen()) return false;
+
+    try {
+        unsigned pos = 0;
+        while (pos < size) {
+            unsigned n = mec::MidiBuffer::messageLength(data + pos, size - pos);
+            if (n == 0) {
+                LOG_0("Midi output invalid message, at " << pos);
+                return false;
+            }
+            output_->sendMessage(data + pos, n);
+            pos += n;
+        }
+    } catch (RtMidiError &error) {
+        LOG_0("Midi output write error:" << error.what());
+        return false;
+    }
+    return true;
+}
+
 bool MidiOutput::sendMsg(std::vector<unsigned char> &msg) {
     if (!isOpen()) return false;
 
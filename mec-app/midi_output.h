@@ -4,8 +4,10 @@
 #include <memory>
 #include <RtMidi.h>
 
+#include <processors/mec_midi_buffer.h>
 
-class MidiOutput {
+
+class MidiOutput : public mec::IMidiSink {
 public:
     MidiOutput();
     virtual ~MidiOutput();
@@ -15,6 +17,9 @@ public:
     bool isOpen() { return (output_ && (virtualOpen_ || output_->isPortOpen())); }
 
     bool sendMsg(std::vector<unsigned char> &msg);
+
+    // IMidiSink, rtmidi takes a message at a time, but this avoids building a vector for each
+    bool send(const unsigned char *data, unsigned size) override;
 private:
     std::unique_ptr<RtMidiOut> output_;
     bool virtualOpen_;
@@ -2,145 +2,67 @@
 #include <Midi.h>
 
 #include <mec_api.h>
+#include <processors/mec_midi_encoder.h>
+#include <processors/mec_midi_scheduler.h>
 #include <processors/mec_mpe_processor.h>
 
 Midi 			gMidi;
 mec::MecApi* 		gMecApi=NULL;
-mec::Callback* 	gMecCallback=NULL;
+mec::ICallback* 	gMecCallback=NULL;
 const char* 	gMidiPort0 = "hw:1,0,0";
 
 
 AuxiliaryTask gMecProcessTask;
 
-/*
-
-struct MidiVoiceData {
-	unsigned startNote_;
-	unsigned note_;		 //0
-	unsigned pitchbend_; //1
-	unsigned timbre_;    //2
-	unsigned pressure_;  //3
-	bool active_;
-	int changeMask_;
-};
-MidiVoiceData gMidiVoices[16];
-
-class BelaMidiMecCallback : public mec::Callback {
+// continuous data is sent at a fixed output rate (was decimated in render), only values that changed
+// din midi (31.25kbit/s) is the bottleneck, so output goes thru a scheduler limited to the din byte rate
+// (notes first, latest continuous values) then an encoder using running status,
+// and is written once per process, rather than per message
+class BelaMidiSink : public mec::IMidiSink {
 public:
-	BelaMidiMecCallback() :	pitchbendRange_(48.0) {
-		;
-	}
-	
-    virtual void touchOn(int touchId, float note, float x, float y, float z) {
-    	// rt_printf("touchOn %i , %f, %f %f %f", touchId,note,x,y,z);
-    	int ch = touchId + 1;
-
-	    MidiVoiceData& voice = gMidiVoices[ch];
-    
-    	voice.startNote_ = note;
-    	
-	    float semis = note - float(voice.startNote_); 
-	    unsigned pb = bipolar14bit(semis / pitchbendRange_);
-		unsigned pressure = unipolar7bit(z); // note on, we use as velocity
-		unsigned timbre = bipolar7bit(y);
-		
-		gMidi.writePitchBend(ch, pb);
-    	gMidi.writeNoteOn(ch ,note, pressure);
-    	gMidi.writeControlChange(ch,74,timbre);
-    	gMidi.writeChannelPressure(ch,0);
-
-    	voice.note_ = note;
-    	voice.pitchbend_ = pb;
-    	voice.timbre_ = timbre;
-    	voice.pressure_ = 0; // we used it for velocity
-    	voice.changeMask_ = 0;
-    	voice.active_ = true;
+    bool send(const unsigned char *data, unsigned size) override {
+        return gMidi.writeOutput((midi_byte_t *) data, size) >= 0;
     }
-
-    virtual void touchContinue(int touchId, float note, float x, float y, float z) {
-    	// only send out one set of updates per render call
-    	int ch = touchId + 1;
-	    MidiVoiceData& voice = gMidiVoices[ch];
-
-	    float semis = note - float(voice.startNote_); 
-	    unsigned pb = bipolar14bit(semis / pitchbendRange_);
-    	unsigned timbre = bipolar7bit(y);
-    	unsigned pressure = unipolar7bit(z);
-
-    	voice.changeMask_ = 		voice.changeMask_ 
-    								|   ((pb != voice.pitchbend_) << 1) 
-    								|   ((timbre != voice.timbre_) << 2) 
-    								|   ((pressure != voice.pressure_) << 3);
-		// voice.startNote_ = 0;
-    	voice.note_ = note;
-    	voice.pitchbend_ = pb;
-    	voice.timbre_ = timbre;
-    	voice.pressure_ = pressure;
-    }
-
-    virtual void touchOff(int touchId, float note, float x, float y, float z) {
-    	// rt_printf("touchOff %i , %f, %f %f %f", touchId,note,x,y,z);
-    	int ch = touchId + 1;
-	    MidiVoiceData& voice = gMidiVoices[ch];
-
-  	    float semis = note - float(voice.startNote_); 
-	    unsigned pb = bipolar14bit(semis / pitchbendRange_);
-
-		// unsigned pressure = unipolar7bit(z); 
-		unsigned timbre = bipolar7bit(y);
-
-		gMidi.writePitchBend(ch, pb);
-    	gMidi.writeControlChange(ch,74,timbre);
-    	gMidi.writeChannelPressure(ch,0);
-    	gMidi.writeNoteOff(ch,voice.startNote_,0);
-
-		voice.startNote_ = 0;
-    	voice.note_ = 0;
-    	voice.pitchbend_ = 0;
-    	voice.timbre_ = 0;
-    	voice.pressure_ = 0;
-    	voice.changeMask_ = 0;
-    	voice.active_ = true;
-    }
-    
-    virtual void control(int ctrlId, float v)  {
-    	gMidi.writeControlChange(0,ctrlId,v*127);
-    }
-    
-    int bipolar14bit(float v) {return ((v * 0x2000) + 0x2000);}
-    int bipolar7bit(float v) {return ((v / 2) + 0.5)  * 127; }
-    int unipolar7bit(float v) {return v * 127;}
-    
-private:
-    float pitchbendRange_;
 };
-*/
 
-// this replaces the above, and can all be removed after testing
 class MecMpeProcessor : public mec::MPE_Processor {
 public:
     MecMpeProcessor() {
          // p.getInt("voices", 15);
         setPitchbendRange(48.0);
+        setOutputRate(550);
+        encoder_.setRunningStatus(true); // uart, so byte stream
+        encoder_.setOutput(&output_);
+        scheduler_.setRate(3125, 32); // 31250 baud, 10 bits per byte
+        scheduler_.setOutput(&encoder_);
+        setSink(&scheduler_);
     }   
 
-    bool isValid() { return output_.isOpen();}
-
-    void  process(mec::MidiProcessor::MidiMsg& m) {
-        if(output_.isOpen()) {
-            midi_byte_t msg[4];
-            msg_[0] = m.data[0];
-            msg_[1] = m.data[1];
-            msg_[2] = m.data[2];
-            msg_[3] = m.data[3];
-            gMidi.writeOutput(msg,m.size);
-        }
-    }
+    const mec::MidiEncoder &encoder() const { return encoder_; }
+    mec::MidiScheduler &scheduler() { return scheduler_; }
+
+private:
+    BelaMidiSink output_;
+    mec::MidiEncoder encoder_;
+    mec::MidiScheduler scheduler_;
 };
 
+MecMpeProcessor* gMecProcessor=NULL;
+
+// runs for lifetime of program, processing as soon as devices have data
+// rather than being scheduled on every render
+const unsigned mecMaxWaitMs = 100;
+const unsigned mecSchedulerWaitMs = 1;
 void mecProcess(void* pvMec) {
 	MecApi *pMecApi = (MecApi*) pvMec;
-	pMecApi->process();
+	while(!gShouldStop) {
+		pMecApi->process();
+		gMecProcessor->tick();
+		gMecProcessor->flush();
+		gMecProcessor->scheduler().service();
+		bool pending = gMecProcessor->isPending() || gMecProcessor->scheduler().isPending();
+		pMecApi->waitForEvents(pending ? mecSchedulerWaitMs : mecMaxWaitMs);
+	}
 }
 
 
@@ -149,7 +71,8 @@ bool setup(BelaContext *context, void *userData)
 	gMidi.writeTo(gMidiPort0);
 
 	gMecApi=new mec::MecApi();
-	gMecCallback=new MecMpeProcessor();
+	gMecProcessor=new MecMpeProcessor();
+	gMecCallback=gMecProcessor;
 	gMecApi->init();
 	gMecApi->subscribe(gMecCallback);
 	
@@ -157,47 +80,30 @@ bool setup(BelaContext *context, void *userData)
 
 	if((gMecProcessTask = Bela_createAuxiliaryTask(&mecProcess, BELA_AUDIO_PRIORITY - 1, "mecProcess", gMecApi)) == 0)
 		return false;
+	Bela_scheduleAuxiliaryTask(gMecProcessTask);
 
 	return true;
 }
 
 // render is called 2750 per second (44000/16)
-const int decimation = 5;  // = 550/seconds
-long renderFrame = 0;
+// midi is output from mecProcess, so nothing to do but silence
 void render(BelaContext *context, void *userData)
 {
-	Bela_scheduleAuxiliaryTask(gMecProcessTask);
-	
-	renderFrame++;
 	// silence audio buffer
 	for(unsigned int n = 0; n < context->audioFrames; n++) {
 		for(unsigned int channel = 0; channel < context->audioOutChannels; channel++) {
 			audioWrite(context, n, channel, 0.0f);
 		}
 	}
-
-	if(decimation <= 1 || ((renderFrame % decimation) ==0) ) {	
-		for(int ch=0;ch<16;ch++) {
-		    MidiVoiceData& voice = gMidiVoices[ch];
-		    if(voice.active_) {
-				if(voice.changeMask_ & (1 << 1)) {
-					gMidi.writePitchBend(ch, voice.pitchbend_);
-				}
-				if(voice.changeMask_ & (1 << 2)) {
-			    	gMidi.writeControlChange(ch,74,voice.timbre_);
-				}
-				if(voice.changeMask_ & (1 << 3)) {
-			    	gMidi.writeChannelPressure(ch,voice.pressure_);
-				}
-		    }
-			voice.changeMask_ = 0;
-		}
-	}
 }
 
 void cleanup(BelaContext *context, void *userData)
 {
 	gMecApi->unsubscribe(gMecCallback);
+	const mec::MidiEncoder::Stats& stats = gMecProcessor->encoder().stats();
+	printf("midi output %llu bytes sent, %lld bytes saved\n", stats.bytesOut_, stats.bytesSaved());
+	const mec::MidiScheduler::Stats& sched = gMecProcessor->scheduler().stats();
+	printf("midi scheduler %llu replaced, max note delay %lluus\n", sched.coalesced_, sched.maxPriorityDelay_ / 1000);
 	delete gMecCallback;
 	delete gMecApi;
 }
\ No newline at end of file
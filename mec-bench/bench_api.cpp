@@ -0,0 +1,439 @@
+#include "mec_bench.h"
+
+#include <cJSON.h>
+
+#include <cstdlib>
+
+#include <mec_api.h>
+#include <mec_msg_queue.h>
+#include <mec_prefs.h>
+#include <mec_recorder.h>
+#include <mec_scaler.h>
+#include <mec_surface.h>
+#include <mec_voice.h>
+#include <devices/mec_midi_decoder.h>
+#include <processors/mec_midi_encoder.h>
+#include <processors/mec_midi_parser.h>
+#include <processors/mec_mpe_processor.h>
+
+namespace mec {
+
+// surfaces, as a typical eigenharp setup : split into lower and (scaled) upper, plus a join of two devices
+static const char *BENCH_CONFIG = R"({
+    "scales" : {
+        "major"     : [0.0, 2.0, 4.0, 5.0, 7.0, 9.0, 11.0, 12.0],
+        "chromatic" : [0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0, 10.0, 11.0, 12.0]
+    },
+    "surfaces" : {
+        "keys" : {
+            "type" : "split",
+            "axis" : "c",
+            "split point" : 12.0,
+            "surfaces" : ["lower", "upper"]
+        },
+        "upper" : {
+            "transform" : { "c offset" : -12.0 },
+            "scaler" : { "tonic" : 0, "scale" : "major", "row offset" : 5 }
+        },
+        "joined" : {
+            "type" : "join",
+            "axis" : "c",
+            "surface size" : 24.0,
+            "surfaces" : ["left", "right"]
+        }
+    }
+})";
+
+static const unsigned N_TOUCHES = 4096;
+
+static std::vector<Touch> randomTouches(SurfaceID surface) {
+    BenchRandom rnd;
+    std::vector<Touch> touches(N_TOUCHES);
+    for (unsigned i = 0; i < N_TOUCHES; i++) {
+        touches[i] = Touch(i % 16, surface, rnd.unit(), rnd.unit(), rnd.unit(),
+                           float(rnd.below(4)), rnd.unit() * 24.0f);
+    }
+    return touches;
+}
+
+static inline unsigned long long checksum(float v) {
+    return static_cast<unsigned long long>(v * 1000.0f);
+}
+
+
+////////////////////////////// MsgQueue ////////////////////////////////////////
+
+static void addMsgQueue(BenchSuite &suite) {
+    static const unsigned BLOCK = 256, ROUNDS = 64;
+    struct CountCallback : public Callback {
+        void touchContinue(int touchId, float, float, float, float) override { sum_ += touchId; }
+
+        unsigned long long sum_ = 0;
+    };
+    auto queue = std::make_shared<MsgQueue>(BLOCK);
+    auto cb = std::make_shared<CountCallback>();
+    suite.add("msgqueue.add_drain", BLOCK * ROUNDS, [queue, cb]() {
+        MecMsg msg;
+        msg.type_ = MecMsg::TOUCH_CONTINUE;
+        for (unsigned r = 0; r < ROUNDS; r++) {
+            for (unsigned i = 0; i < BLOCK; i++) {
+                msg.data_.touch_.touchId_ = i;
+                msg.data_.touch_.note_ = 60.0f;
+                msg.data_.touch_.x_ = msg.data_.touch_.y_ = msg.data_.touch_.z_ = 0.5f;
+                queue->addToQueue(msg);
+            }
+            queue->drain(*cb, BLOCK);
+        }
+        return cb->sum_;
+    });
+}
+
+
+////////////////////////////// Voices ////////////////////////////////////////
+
+static void addVoices(BenchSuite &suite) {
+    // mostly continues on held keys, with some key on/offs (see tests/bench_voice.cpp)
+    static const unsigned N_KEYS = 132, N_EVENTS = 65536;
+    struct KeyEvent {
+        unsigned key_;
+        bool on_;
+    };
+    auto events = std::make_shared<std::vector<KeyEvent>>(N_EVENTS);
+    BenchRandom rnd;
+    for (KeyEvent &e : *events) {
+        unsigned r = rnd.next();
+        e.key_ = r % N_KEYS;
+        e.on_ = ((r >> 20) & 7) != 0;
+    }
+    auto voices = std::make_shared<Voices>(15);
+    suite.add("voices.start_stop_lookup", N_EVENTS, [events, voices]() {
+        unsigned long long sum = 0;
+        for (const KeyEvent &e : *events) {
+            Voices::Voice *voice = voices->voiceId(e.key_);
+            if (e.on_) {
+                if (!voice) {
+                    voice = voices->startVoice(e.key_);
+                    if (!voice) {
+                        voices->stopVoice(voices->voiceToSteal(0.0f));
+                        voice = voices->startVoice(e.key_);
+                    }
+                }
+                sum += voice->i_;
+            } else if (voice) {
+                voices->stopVoice(voice);
+            }
+        }
+        return sum;
+    });
+}
+
+
+////////////////////////////// Scaler ////////////////////////////////////////
+
+static void addScaler(BenchSuite &suite) {
+    auto scaler = std::make_shared<Scaler>();
+    scaler->set(Scales::getScale("major"), 0.0f, 5.0f, 0.0f);
+    auto touches = std::make_shared<std::vector<Touch>>(randomTouches(SurfaceRegistry::intern("bench")));
+    auto out = std::make_shared<std::vector<MusicalTouch>>(N_TOUCHES);
+
+    suite.add("scaler.map", N_TOUCHES, [scaler, touches]() {
+        unsigned long long sum = 0;
+        for (const Touch &t : *touches) sum += checksum(scaler->map(t).note_);
+        return sum;
+    });
+
+    suite.add("scaler.map_batch", N_TOUCHES, [scaler, touches, out]() {
+        scaler->mapBatch(touches->data(), out->data(), N_TOUCHES);
+        unsigned long long sum = 0;
+        for (const MusicalTouch &t : *out) sum += checksum(t.note_);
+        return sum;
+    });
+}
+
+
+////////////////////////////// Surfaces ////////////////////////////////////////
+
+static void addSurfaces(BenchSuite &suite, const Preferences &config) {
+    SurfaceID keys = SurfaceRegistry::intern("keys");
+    SurfaceID left = SurfaceRegistry::intern("left");
+    auto mgr = std::make_shared<SurfaceManager>();
+    mgr->init(Preferences(config.getSubTree("surfaces")), std::vector<SurfaceID>({keys, left}));
+
+    auto split = mgr->getSurface(keys);
+    auto splitTouches = std::make_shared<std::vector<Touch>>(randomTouches(keys));
+    suite.add("surface.split_map", N_TOUCHES, [split, splitTouches]() {
+        unsigned long long sum = 0;
+        for (const Touch &t : *splitTouches) sum += split->map(t).surface_;
+        return sum;
+    });
+
+    auto join = mgr->getSurface(SurfaceRegistry::intern("joined"));
+    auto joinTouches = std::make_shared<std::vector<Touch>>(randomTouches(left));
+    suite.add("surface.join_map", N_TOUCHES, [join, joinTouches]() {
+        unsigned long long sum = 0;
+        for (const Touch &t : *joinTouches) sum += checksum(join->map(t).c_);
+        return sum;
+    });
+
+    // compiled graph, as used by MecApi
+    int idx = mgr->index(keys);
+    suite.add("surface.route", N_TOUCHES, [mgr, idx, splitTouches]() {
+        unsigned long long sum = 0;
+        for (const Touch &t : *splitTouches) {
+            float v[SurfaceNode::N_AXES] = {t.x_, t.y_, t.z_, t.r_, t.c_};
+            int out = mgr->route(idx, v);
+            const Scaler *scaler = mgr->scaler(out);
+            sum += out + (scaler ? checksum(scaler->note(v[Surface::C_R], v[Surface::C_C])) : 0);
+        }
+        return sum;
+    });
+}
+
+
+////////////////////////////// MPE ////////////////////////////////////////
+
+class BenchMpeProcessor : public MPE_Processor {
+public:
+    void process(MidiMsg &msg) override {
+        for (unsigned i = 0; i < msg.size; i++) sum_ += (unsigned char) msg.data[i];
+    }
+
+    unsigned long long sum_ = 0;
+};
+
+// previous mec-app output, a vector per message (minus the rtmidi call)
+class BenchVectorMpeProcessor : public MPE_Processor {
+public:
+    void process(MidiMsg &m) override {
+        std::vector<unsigned char> msg;
+        for (unsigned i = 0; i < m.size; i++) msg.push_back((unsigned char) m.data[i]);
+        send(msg);
+    }
+
+    void send(const std::vector<unsigned char> &msg) {
+        for (unsigned char b : msg) sum_ += b;
+    }
+
+    unsigned long long sum_ = 0;
+};
+
+// buffered output, flushed to sink once per frame (as mec-app does per MecApi::process)
+class BenchMidiSink : public IMidiSink {
+public:
+    bool send(const unsigned char *data, unsigned size) override {
+        for (unsigned i = 0; i < size; i++) sum_ += data[i];
+        return true;
+    }
+
+    unsigned long long sum_ = 0;
+};
+
+static void addMpe(BenchSuite &suite) {
+    // 8 concurrent touches, each : on, continues, off
+    static const unsigned N_VOICES = 8, N_CONTINUE = 62, N_ROUNDS = 8;
+    static const unsigned N_EVENTS = N_VOICES * (N_CONTINUE + 2) * N_ROUNDS;
+
+    auto mpe = std::make_shared<BenchMpeProcessor>();
+    suite.add("mpe.touch_to_midi", N_EVENTS, [mpe]() {
+        for (unsigned r = 0; r < N_ROUNDS; r++) {
+            for (unsigned v = 0; v < N_VOICES; v++) mpe->touchOn(v, 48.0f + v * 4, 0.0f, 0.0f, 0.5f);
+            for (unsigned i = 0; i < N_CONTINUE; i++) {
+                float d = float(i) / N_CONTINUE;
+                for (unsigned v = 0; v < N_VOICES; v++) {
+                    mpe->touchContinue(v, 48.0f + v * 4 + d, d - 0.5f, d, 1.0f - d);
+                }
+            }
+            for (unsigned v = 0; v < N_VOICES; v++) mpe->touchOff(v, 48.0f + v * 4 + 1.0f, 0.5f, 1.0f, 0.0f);
+        }
+        return mpe->sum_;
+    });
+
+    auto fmpe = std::make_shared<BenchMpeProcessor>();
+    suite.add("mpe.frame_to_midi", N_EVENTS, [fmpe]() {
+        TouchFrame f;
+        for (unsigned r = 0; r < N_ROUNDS; r++) {
+            f.clear();
+            for (unsigned v = 0; v < N_VOICES; v++) f.add(TouchFrame::T_ON, v, 48.0f + v * 4, 0.0f, 0.0f, 0.5f);
+            fmpe->frame(f);
+            for (unsigned i = 0; i < N_CONTINUE; i++) {
+                float d = float(i) / N_CONTINUE;
+                f.clear();
+                for (unsigned v = 0; v < N_VOICES; v++) {
+                    f.add(TouchFrame::T_CONTINUE, v, 48.0f + v * 4 + d, d - 0.5f, d, 1.0f - d);
+                }
+                fmpe->frame(f);
+            }
+            f.clear();
+            for (unsigned v = 0; v < N_VOICES; v++) f.add(TouchFrame::T_OFF, v, 48.0f + v * 4 + 1.0f, 0.5f, 1.0f, 0.0f);
+            fmpe->frame(f);
+        }
+        return fmpe->sum_;
+    });
+
+    auto vmpe = std::make_shared<BenchVectorMpeProcessor>();
+    suite.add("mpe.touch_to_midi_vector", N_EVENTS, [vmpe]() {
+        for (unsigned r = 0; r < N_ROUNDS; r++) {
+            for (unsigned v = 0; v < N_VOICES; v++) vmpe->touchOn(v, 48.0f + v * 4, 0.0f, 0.0f, 0.5f);
+            for (unsigned i = 0; i < N_CONTINUE; i++) {
+                float d = float(i) / N_CONTINUE;
+                for (unsigned v = 0; v < N_VOICES; v++) {
+                    vmpe->touchContinue(v, 48.0f + v * 4 + d, d - 0.5f, d, 1.0f - d);
+                }
+            }
+            for (unsigned v = 0; v < N_VOICES; v++) vmpe->touchOff(v, 48.0f + v * 4 + 1.0f, 0.5f, 1.0f, 0.0f);
+        }
+        return vmpe->sum_;
+    });
+
+    auto sink = std::make_shared<BenchMidiSink>();
+    auto bmpe = std::make_shared<MPE_Processor>();
+    bmpe->setSink(sink.get());
+    suite.add("mpe.touch_to_midi_buffered", N_EVENTS, [bmpe, sink]() {
+        for (unsigned r = 0; r < N_ROUNDS; r++) {
+            for (unsigned v = 0; v < N_VOICES; v++) bmpe->touchOn(v, 48.0f + v * 4, 0.0f, 0.0f, 0.5f);
+            bmpe->flush();
+            for (unsigned i = 0; i < N_CONTINUE; i++) {
+                float d = float(i) / N_CONTINUE;
+                for (unsigned v = 0; v < N_VOICES; v++) {
+                    bmpe->touchContinue(v, 48.0f + v * 4 + d, d - 0.5f, d, 1.0f - d);
+                }
+                bmpe->flush();
+            }
+            for (unsigned v = 0; v < N_VOICES; v++) bmpe->touchOff(v, 48.0f + v * 4 + 1.0f, 0.5f, 1.0f, 0.0f);
+            bmpe->flush();
+        }
+        return sink->sum_;
+    });
+}
+
+
+////////////////////////////// MIDI input ////////////////////////////////////////
+
+// captures midi output as a byte stream, as a midi input would receive it
+class BenchStreamSink : public IMidiSink {
+public:
+    bool send(const unsigned char *data, unsigned size) override {
+        bytes_.insert(bytes_.end(), data, data + size);
+        return true;
+    }
+
+    std::vector<unsigned char> bytes_;
+};
+
+class BenchMidiHandler : public MidiParser::Handler {
+public:
+    void message(unsigned char status, unsigned char d1, unsigned char d2) override { sum_ += status + d1 + d2; }
+
+    void realtime(unsigned char b) override { sum_ += b; }
+
+    void sysex(const unsigned char *, unsigned size, bool) override { sum_ += size; }
+
+    unsigned long long sum_ = 0;
+};
+
+// an mpe controller playing : 10 voices, on, 62 continues, off
+static std::shared_ptr<std::vector<unsigned char>> mpeStream(bool runningStatus) {
+    BenchStreamSink out;
+    MidiEncoder enc(&out);
+    enc.setRunningStatus(runningStatus);
+    enc.setSuppressRedundant(false);
+    MPE_Processor mpe;
+    mpe.setSink(&enc);
+    static const unsigned N_VOICES = 10, N_CONTINUE = 62, N_ROUNDS = 4;
+    for (unsigned r = 0; r < N_ROUNDS; r++) {
+        for (unsigned v = 0; v < N_VOICES; v++) mpe.touchOn(v, 48.0f + v * 3, 0.0f, 0.0f, 0.5f);
+        for (unsigned i = 0; i < N_CONTINUE; i++) {
+            float d = float(i) / N_CONTINUE;
+            for (unsigned v = 0; v < N_VOICES; v++) mpe.touchContinue(v, 48.0f + v * 3 + d, d - 0.5f, d, 1.0f - d);
+            mpe.flush();
+        }
+        for (unsigned v = 0; v < N_VOICES; v++) mpe.touchOff(v, 48.0f + v * 3 + 1.0f, 0.5f, 1.0f, 0.0f);
+        mpe.flush();
+    }
+    return std::make_shared<std::vector<unsigned char>>(out.bytes_);
+}
+
+// midi input recorded by a MidiDevice ("record" in mec.json)
+static std::shared_ptr<std::vector<unsigned char>> recordedStream(const char *file) {
+    auto bytes = std::make_shared<std::vector<unsigned char>>();
+    EventReader reader;
+    if (!reader.open(file) || reader.device() != "midi") return bytes;
+    const EventRecord *r;
+    while ((r = reader.next()) != nullptr) {
+        if (r->type_ != 0) continue;
+        const unsigned char *data = static_cast<const unsigned char *>(r->data());
+        bytes->insert(bytes->end(), data, data + r->len_);
+    }
+    return bytes;
+}
+
+static unsigned countMessages(const std::vector<unsigned char> &bytes) {
+    class Counter : public MidiParser::Handler {
+    public:
+        void message(unsigned char, unsigned char, unsigned char) override { n_++; }
+        unsigned n_ = 0;
+    } counter;
+    MidiParser p;
+    p.parse(bytes.data(), bytes.size(), counter);
+    return counter.n_;
+}
+
+// fed in chunks, as read from a port
+static const unsigned MIDI_CHUNK = 64;
+
+static void addMidiParse(BenchSuite &suite, const std::string &name, std::shared_ptr<std::vector<unsigned char>> bytes) {
+    if (bytes->empty()) return;
+    unsigned n = countMessages(*bytes);
+
+    auto handler = std::make_shared<BenchMidiHandler>();
+    auto parser = std::make_shared<MidiParser>();
+    suite.add("midi.parse" + name, n, [bytes, handler, parser]() {
+        for (unsigned pos = 0; pos < bytes->size(); pos += MIDI_CHUNK) {
+            unsigned sz = bytes->size() - pos < MIDI_CHUNK ? bytes->size() - pos : MIDI_CHUNK;
+            parser->parse(bytes->data() + pos, sz, *handler);
+        }
+        return handler->sum_;
+    });
+
+    // decoded into a device queue, which is drained after each chunk
+    auto queue = std::make_shared<MsgQueue>(1024);
+    auto decoder = std::make_shared<MidiDecoder>(*queue);
+    auto dparser = std::make_shared<MidiParser>();
+    suite.add("midi.parse_decode" + name, n, [bytes, queue, decoder, dparser]() {
+        unsigned long long sum = 0;
+        MecMsg msg;
+        decoder->setTime(1);
+        for (unsigned pos = 0; pos < bytes->size(); pos += MIDI_CHUNK) {
+            unsigned sz = bytes->size() - pos < MIDI_CHUNK ? bytes->size() - pos : MIDI_CHUNK;
+            dparser->parse(bytes->data() + pos, sz, *decoder);
+            while (queue->nextMsg(msg)) sum += msg.type_ + (unsigned) (msg.data_.touch_.note_ * 16.0f);
+        }
+        return sum;
+    });
+}
+
+static void addMidiInput(BenchSuite &suite) {
+    addMidiParse(suite, "", mpeStream(false));
+    addMidiParse(suite, "_running_status", mpeStream(true));
+    const char *file = getenv("MEC_BENCH_MIDI");
+    if (file != nullptr) addMidiParse(suite, "_recorded", recordedStream(file));
+}
+
+
+void addApiBenchmarks(BenchSuite &suite) {
+    cJSON *json = cJSON_Parse(BENCH_CONFIG);
+    Preferences config(json);
+    Scales::init(Preferences(config.getSubTree("scales")));
+
+    addMsgQueue(suite);
+    addVoices(suite);
+    addScaler(suite);
+    addSurfaces(suite, config);
+    addMpe(suite);
+    addMidiInput(suite);
+
+    // surfaces/scalers have copied what they need
+    cJSON_Delete(json);
+}
+
+}
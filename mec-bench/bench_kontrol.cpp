@@ -0,0 +1,67 @@
+#include "mec_bench.h"
+
+#include <KontrolModel.h>
+
+namespace mec {
+
+// counts changes, as a minimal listener (e.g. a broadcaster) would see them
+class BenchKontrolCallback : public Kontrol::KontrolCallback {
+public:
+    void rack(Kontrol::ChangeSource, const Kontrol::Rack &) override { ; }
+
+    void module(Kontrol::ChangeSource, const Kontrol::Rack &, const Kontrol::Module &) override { ; }
+
+    void page(Kontrol::ChangeSource, const Kontrol::Rack &, const Kontrol::Module &,
+              const Kontrol::Page &) override { ; }
+
+    void param(Kontrol::ChangeSource, const Kontrol::Rack &, const Kontrol::Module &,
+               const Kontrol::Parameter &) override { ; }
+
+    void changed(Kontrol::ChangeSource, const Kontrol::Rack &, const Kontrol::Module &,
+                 const Kontrol::Parameter &p) override {
+        sum_ += static_cast<unsigned long long>(p.current().floatValue());
+    }
+
+    void resource(Kontrol::ChangeSource, const Kontrol::Rack &,
+                  const std::string &, const std::string &) override { ; }
+
+    unsigned long long sum_ = 0;
+};
+
+void addKontrolBenchmarks(BenchSuite &suite) {
+    static const unsigned N_CHANGES = 4096;
+
+    auto model = Kontrol::KontrolModel::model();
+    auto cb = std::make_shared<BenchKontrolCallback>();
+    model->addCallback("mec-bench", cb);
+
+    std::string host = "127.0.0.1";
+    unsigned port = 9001;
+    Kontrol::EntityId rackId = Kontrol::Rack::createId(host, port);
+    Kontrol::EntityId moduleId = "module1";
+    model->createRack(Kontrol::CS_LOCAL, rackId, host, port);
+    model->createModule(Kontrol::CS_LOCAL, rackId, moduleId, "Poly Synth", "polysynth");
+
+    // as kontrol-module.json
+    std::vector<std::vector<Kontrol::ParamValue>> params = {
+            {"pitch", "o_transpose", "transpose", -24.0f, 24.0f, 0.0f},
+            {"pct",   "o_level",     "level",     0.0f,   100.0f, 100.0f},
+            {"int",   "r_type",      "type",      0.0f,   5.0f,   3.0f},
+            {"pct",   "r_mix",       "mix",       0.0f,   100.0f, 50.0f}
+    };
+    auto paramIds = std::make_shared<std::vector<Kontrol::EntityId>>();
+    for (auto &args : params) {
+        model->createParam(Kontrol::CS_LOCAL, rackId, moduleId, args);
+        paramIds->push_back(args[1].stringValue());
+    }
+
+    suite.add("kontrol.change_param", N_CHANGES, [model, cb, rackId, moduleId, paramIds]() {
+        for (unsigned i = 0; i < N_CHANGES; i++) {
+            const Kontrol::EntityId &paramId = (*paramIds)[i % paramIds->size()];
+            model->changeParam(Kontrol::CS_LOCAL, rackId, moduleId, paramId, Kontrol::ParamValue(float(i % 5)));
+        }
+        return cb->sum_;
+    });
+}
+
+}
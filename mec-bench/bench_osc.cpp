@@ -0,0 +1,136 @@
+#include "mec_bench.h"
+
+#include <string>
+
+#include <osc/OscOutboundPacketStream.h>
+#include <ip/PacketListener.h>
+
+#include <mec_udp_receiver.h>
+#include <processors/mec_osc_processor.h>
+
+namespace mec {
+
+static const unsigned OUTPUT_BUFFER_SIZE = 1024;
+static const unsigned N_PACKETS = 4096;
+
+// a bundle per touch, as mec-app sent before OSC_Processor, minus the socket
+static void addT3dTouch(BenchSuite &suite) {
+    auto buffer = std::make_shared<std::vector<char>>(OUTPUT_BUFFER_SIZE);
+    suite.add("osc.encode_t3d_tch", N_PACKETS, [buffer]() {
+        unsigned long long sum = 0;
+        for (unsigned i = 0; i < N_PACKETS; i++) {
+            int touchId = i % 16;
+            float d = float(i) / N_PACKETS;
+            std::string topic = "/t3d/tch" + std::to_string(touchId);
+            osc::OutboundPacketStream op(buffer->data(), OUTPUT_BUFFER_SIZE);
+            op << osc::BeginBundleImmediate
+               << osc::BeginMessage(topic.c_str())
+               << d << 1.0f - d << 0.5f << 60.0f + d
+               << osc::EndMessage
+               << osc::EndBundle;
+            sum += op.Size();
+        }
+        return sum;
+    });
+}
+
+// as MecOSCProcessor (mec-app), 16 touches per process, bundled, minus the socket
+class CountingOscSink : public IOscSink {
+public:
+    bool send(const char *data, unsigned size) override {
+        bytes_ += size + data[size - 1];
+        return true;
+    }
+
+    unsigned long long bytes_ = 0;
+};
+
+static void addT3dBundle(BenchSuite &suite) {
+    auto sink = std::make_shared<CountingOscSink>();
+    auto processor = std::make_shared<OSC_Processor>(sink.get());
+    suite.add("osc.encode_t3d_bundle", N_PACKETS, [sink, processor]() {
+        for (unsigned i = 0; i < N_PACKETS; i++) {
+            int touchId = i % 16;
+            float d = float(i) / N_PACKETS;
+            processor->touchContinue(touchId, 60.0f + d, d, 1.0f - d, 0.5f);
+            if (touchId == 15) processor->flush(0);
+        }
+        return sink->bytes_;
+    });
+}
+
+// as OSCBroadcaster::changed (float parameter), minus the socket
+static void addKontrolChanged(BenchSuite &suite) {
+    auto buffer = std::make_shared<std::vector<char>>(OUTPUT_BUFFER_SIZE);
+    auto rackId = std::make_shared<std::string>("127.0.0.1:9001");
+    auto moduleId = std::make_shared<std::string>("module1");
+    auto paramIds = std::make_shared<std::vector<std::string>>(
+            std::vector<std::string>({"o_transpose", "o_level", "r_type", "r_mix"}));
+    suite.add("osc.encode_kontrol_changed", N_PACKETS, [buffer, rackId, moduleId, paramIds]() {
+        unsigned long long sum = 0;
+        for (unsigned i = 0; i < N_PACKETS; i++) {
+            const std::string &paramId = (*paramIds)[i % paramIds->size()];
+            osc::OutboundPacketStream ops(buffer->data(), OUTPUT_BUFFER_SIZE);
+            ops << osc::BeginBundleImmediate
+                << osc::BeginMessage("/Kontrol/changed")
+                << rackId->c_str()
+                << moduleId->c_str()
+                << paramId.c_str()
+                << float(i % 100)
+                << osc::EndMessage
+                << osc::EndBundle;
+            sum += ops.Size();
+        }
+        return sum;
+    });
+}
+
+// t3d sized packets, blasted over loopback then received, per packet cost of send + receive
+// batch 1 is one system call per packet (as oscpack), so the difference is what batching saves
+static const unsigned N_UDP_PACKETS = 256; // well within default socket buffer
+
+class CountingListener : public PacketListener {
+public:
+    void ProcessPacket(const char *data, int size, const IpEndpointName &) override {
+        bytes_ += size + data[0];
+    }
+
+    unsigned long long bytes_ = 0;
+};
+
+static void addUdpLoopback(BenchSuite &suite, const std::string &name, unsigned batch) {
+    auto listener = std::make_shared<CountingListener>();
+    auto receiver = std::make_shared<UdpReceiver>(listener.get(), batch);
+    auto blaster = std::make_shared<UdpBlaster>();
+    if (!receiver->open(0) || !blaster->open("127.0.0.1", receiver->port())) return;
+
+    auto packet = std::make_shared<std::vector<char>>(OUTPUT_BUFFER_SIZE);
+    osc::OutboundPacketStream op(packet->data(), OUTPUT_BUFFER_SIZE);
+    op << osc::BeginBundleImmediate
+       << osc::BeginMessage("/t3d/tch1") << 0.5f << 0.5f << 0.5f << 60.0f << osc::EndMessage
+       << osc::EndBundle;
+    packet->resize(op.Size());
+
+    suite.add(name, N_UDP_PACKETS, [listener, receiver, blaster, packet]() {
+        unsigned sent = blaster->send(packet->data(), packet->size(), N_UDP_PACKETS);
+        unsigned received = 0;
+        while (received < sent) {
+            unsigned n = receiver->receive(100000);
+            if (n == 0) break; // lost, shows in checksum
+            received += n;
+        }
+        return listener->bytes_;
+    });
+}
+
+void addOscBenchmarks(BenchSuite &suite) {
+    addT3dTouch(suite);
+    addT3dBundle(suite);
+    addKontrolChanged(suite);
+#ifdef __linux__
+    addUdpLoopback(suite, "osc.udp_loopback_recv", 1);
+    addUdpLoopback(suite, "osc.udp_loopback_recvmmsg", UdpReceiver::DEFAULT_BATCH);
+#endif
+}
+
+}
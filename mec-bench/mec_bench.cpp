@@ -0,0 +1,202 @@
+#include "mec_bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+#include <mec_prefs.h>
+
+// usage : mec-bench [-f filter] [-r repeats] [-j results.json] [-b baseline.json] [-t threshold%] [-l]
+//   -f  only run benchmarks whose name contains filter
+//   -r  timed runs per benchmark (default 5), after 1 untimed warmup run
+//   -j  write results as json ('-' for stdout)
+//   -b  compare with previous results (from -j), fail if any benchmark is slower by more than threshold
+//       (compares min ns/op)
+//   -t  regression threshold, in percent (default 10)
+//   -l  list benchmarks
+// exit code : 0 ok, 1 regression against baseline, 2 usage/file error
+// MEC_BENCH_MIDI=file (a midi device recording, see "record") adds midi input benchmarks on that stream
+
+#ifndef MEC_VERSION
+#define MEC_VERSION "unknown"
+#endif
+#ifndef MEC_BENCH_BUILD
+#define MEC_BENCH_BUILD "unknown"
+#endif
+#ifndef MEC_BENCH_PROCESSOR
+#define MEC_BENCH_PROCESSOR "unknown"
+#endif
+
+namespace {
+
+struct Result {
+    std::string name_;
+    unsigned long long ops_;
+    unsigned repeats_;
+    double min_, median_, mean_, max_; // ns per op
+    unsigned long long checksum_;
+};
+
+volatile unsigned long long sink_; // results of timed runs, so they are not optimised away
+
+Result run(const mec::Benchmark &b, unsigned repeats) {
+    Result res;
+    res.name_ = b.name_;
+    res.ops_ = b.ops_;
+    res.repeats_ = repeats;
+    // warmup, also touches all data
+    // its checksum is reported, as later runs may accumulate state (so depend on repeats)
+    res.checksum_ = b.run_();
+
+    std::vector<double> t(repeats);
+    for (unsigned i = 0; i < repeats; i++) {
+        auto start = std::chrono::steady_clock::now();
+        sink_ += b.run_();
+        auto end = std::chrono::steady_clock::now();
+        t[i] = std::chrono::duration<double, std::nano>(end - start).count() / b.ops_;
+    }
+    std::sort(t.begin(), t.end());
+    res.min_ = t.front();
+    res.max_ = t.back();
+    res.median_ = (repeats % 2) ? t[repeats / 2] : (t[repeats / 2 - 1] + t[repeats / 2]) / 2.0;
+    res.mean_ = 0.0;
+    for (double v : t) res.mean_ += v;
+    res.mean_ /= repeats;
+    return res;
+}
+
+void writeJson(std::ostream &os, const std::vector<Result> &results) {
+    os << std::fixed << std::setprecision(3);
+    os << "{\n";
+    os << "    \"version\" : \"" << MEC_VERSION << "\",\n";
+    os << "    \"build\" : \"" << MEC_BENCH_BUILD << "\",\n";
+    os << "    \"processor\" : \"" << MEC_BENCH_PROCESSOR << "\",\n";
+    os << "    \"benchmarks\" : [";
+    for (unsigned i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        os << (i ? ",\n" : "\n");
+        os << "        {\n";
+        os << "            \"name\" : \"" << r.name_ << "\",\n";
+        os << "            \"ops\" : " << r.ops_ << ",\n";
+        os << "            \"repeats\" : " << r.repeats_ << ",\n";
+        os << "            \"ns per op\" : { "
+           << "\"min\" : " << r.min_ << ", "
+           << "\"median\" : " << r.median_ << ", "
+           << "\"mean\" : " << r.mean_ << ", "
+           << "\"max\" : " << r.max_ << " },\n";
+        os << "            \"ops per sec\" : " << (r.median_ > 0.0 ? 1e9 / r.median_ : 0.0) << ",\n";
+        os << "            \"checksum\" : \"" << r.checksum_ << "\"\n";
+        os << "        }";
+    }
+    os << "\n    ]\n}\n";
+}
+
+// min ns/op by name, min is least affected by other load on the machine, so is used for comparison
+bool readBaseline(const std::string &file, std::map<std::string, double> &baseline) {
+    mec::Preferences prefs(file);
+    if (!prefs.valid()) return false;
+    mec::Preferences::Array benchmarks(prefs.getArray("benchmarks"));
+    if (!benchmarks.valid()) return false;
+    for (int i = 0; i < benchmarks.getSize(); i++) {
+        mec::Preferences b(benchmarks.getObject(i));
+        mec::Preferences ns(b.getSubTree("ns per op"));
+        if (b.valid() && ns.valid()) baseline[b.getString("name")] = ns.getDouble("min");
+    }
+    return true;
+}
+
+void usage() {
+    std::cerr << "usage: mec-bench [-f filter] [-r repeats] [-j results.json] [-b baseline.json] [-t threshold%] [-l]"
+              << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+    std::string filter, jsonFile, baselineFile;
+    unsigned repeats = 5;
+    double threshold = 10.0;
+    bool list = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-l") list = true;
+        else if (arg == "-f" && hasValue) filter = argv[++i];
+        else if (arg == "-r" && hasValue) repeats = std::max(1, atoi(argv[++i]));
+        else if (arg == "-j" && hasValue) jsonFile = argv[++i];
+        else if (arg == "-b" && hasValue) baselineFile = argv[++i];
+        else if (arg == "-t" && hasValue) threshold = atof(argv[++i]);
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baselineFile.empty() && !readBaseline(baselineFile, baseline)) {
+        std::cerr << "unable to read baseline : " << baselineFile << std::endl;
+        return 2;
+    }
+
+    mec::BenchSuite suite;
+    mec::addApiBenchmarks(suite);
+    mec::addOscBenchmarks(suite);
+    mec::addKontrolBenchmarks(suite);
+
+    // table to stderr if json is going to stdout
+    std::ostream &out = jsonFile == "-" ? std::cerr : std::cout;
+    if (list) {
+        for (const mec::Benchmark &b : suite.benchmarks()) out << b.name_ << std::endl;
+        return 0;
+    }
+
+    std::vector<Result> results;
+    unsigned regressions = 0;
+    out << std::left << std::setw(32) << "benchmark"
+        << std::right << std::setw(12) << "ns/op" << std::setw(12) << "min" << std::setw(12) << "max"
+        << std::setw(16) << "ops/sec" << std::setw(12) << "baseline" << std::endl;
+    for (const mec::Benchmark &b : suite.benchmarks()) {
+        if (!filter.empty() && b.name_.find(filter) == std::string::npos) continue;
+        Result r = run(b, repeats);
+        results.push_back(r);
+
+        out << std::left << std::setw(32) << r.name_ << std::right << std::fixed << std::setprecision(2)
+            << std::setw(12) << r.median_ << std::setw(12) << r.min_ << std::setw(12) << r.max_
+            << std::setw(16) << std::setprecision(0) << (r.median_ > 0.0 ? 1e9 / r.median_ : 0.0);
+        auto it = baseline.find(r.name_);
+        if (it != baseline.end() && it->second > 0.0) {
+            double change = ((r.min_ / it->second) - 1.0) * 100.0;
+            out << std::setw(11) << std::showpos << std::setprecision(1) << change << "%" << std::noshowpos;
+            if (change > threshold) {
+                out << " REGRESSION";
+                regressions++;
+            }
+        }
+        out << std::endl;
+    }
+
+    if (!jsonFile.empty()) {
+        if (jsonFile == "-") {
+            writeJson(std::cout, results);
+        } else {
+            std::ofstream os(jsonFile);
+            if (!os) {
+                std::cerr << "unable to write : " << jsonFile << std::endl;
+                return 2;
+            }
+            writeJson(os, results);
+        }
+    }
+
+    if (regressions > 0) {
+        out << regressions << " benchmark(s) slower than baseline by more than " << threshold << "%" << std::endl;
+        return 1;
+    }
+    return 0;
+}
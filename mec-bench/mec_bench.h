@@ -0,0 +1,62 @@
+#ifndef MEC_BENCH_H
+#define MEC_BENCH_H
+
+//
+// mec-bench : microbenchmarks of the hot paths (device -> surfaces -> midi/osc, and kontrol)
+//
+// each benchmark performs a fixed number of operations per run on fixed (seeded) data,
+// so results are repeatable and comparable between builds/machines.
+// run returns a checksum, which is reported, so the work cannot be optimised away
+// (and so a change in behaviour, as well as performance, is visible)
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mec {
+
+struct Benchmark {
+    std::string name_;
+    unsigned long long ops_; // operations per run
+    std::function<unsigned long long()> run_;
+};
+
+class BenchSuite {
+public:
+    void add(const std::string &name, unsigned long long ops, std::function<unsigned long long()> run) {
+        benchmarks_.push_back(Benchmark{name, ops, run});
+    }
+
+    const std::vector<Benchmark> &benchmarks() const { return benchmarks_; }
+
+private:
+    std::vector<Benchmark> benchmarks_;
+};
+
+// deterministic pseudo random sequence, identical on all platforms (unlike std:: distributions)
+class BenchRandom {
+public:
+    BenchRandom(unsigned long long seed = 12345) : state_(seed) { ; }
+
+    unsigned next() {
+        state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<unsigned>(state_ >> 33);
+    }
+
+    unsigned below(unsigned n) { return next() % n; }
+
+    float unit() { return float(next() & 0xFFFFFF) / float(0x1000000); } // 0 to 1
+
+private:
+    unsigned long long state_;
+};
+
+// benchmark groups, see bench_*.cpp
+void addApiBenchmarks(BenchSuite &);
+void addOscBenchmarks(BenchSuite &);
+void addKontrolBenchmarks(BenchSuite &);
+
+}
+
+#endif //MEC_BENCH_H
@@ -11,7 +11,8 @@ bool operator==(const ChangeSource &a, const ChangeSource &b) {
     if (a.type_ == b.type_) {
         // we only use id_ for remote sources
         return a.type_ != ChangeSource::SrcType::REMOTE
-               || a.id_ == b.id_;
+               || a.id_ == b.id_
+               || (a.id_ != nullptr && b.id_ != nullptr && *a.id_ == *b.id_);
     }
     return false;
 }
@@ -21,7 +22,8 @@ bool operator!=(const ChangeSource &a, const ChangeSource &b) {
 }
 
 
-ChangeSource::ChangeSource(SrcType t, const SrcId& id) : type_(t), id_(id) {
+ChangeSource::ChangeSource(SrcType t, const SrcId& id)
+    : type_(t), id_(t == SrcType::REMOTE ? std::make_shared<const SrcId>(id) : nullptr) {
     ;
 }
 
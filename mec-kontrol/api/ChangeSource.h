@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 
 namespace Kontrol {
@@ -23,7 +24,7 @@ public:
 
 private:
     SrcType type_;
-    SrcId   id_;
+    std::shared_ptr<const SrcId> id_; // shared, so copying a remote source does not allocate
 };
 
 bool operator==(const ChangeSource& a,const ChangeSource& b);
@@ -63,11 +63,9 @@ std::shared_ptr<Rack> KontrolModel::getLocalRack() const {
 }
 
 std::shared_ptr<Rack> KontrolModel::getRack(const EntityId &rackId) const {
-    try {
-        return racks_.at(rackId);
-    } catch (const std::out_of_range &) {
-        return nullptr;
-    }
+    auto i = racks_.find(rackId);
+    if (i == racks_.end()) return nullptr;
+    return i->second;
 }
 
 std::shared_ptr<Module> KontrolModel::getModule(const std::shared_ptr<Rack> &rack, const EntityId &moduleId) const {
@@ -245,7 +243,7 @@ std::shared_ptr<Parameter> KontrolModel::changeParam(
     auto param = getParam(module, paramId);
     if (param == nullptr) return nullptr;
 
-    if (module->changeParam(paramId, v, src == CS_PRESET)) {
+    if (param->change(v, src == CS_PRESET)) {
         publishChanged(src, *rack, *module, *param);
     }
     return param;
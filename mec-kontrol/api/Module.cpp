@@ -71,7 +71,9 @@ std::shared_ptr<Page> Module::getPage(const EntityId &pageId) {
 }
 
 std::shared_ptr<Parameter> Module::getParam(const EntityId &paramId) {
-    return parameters_[paramId];
+    auto i = parameters_.find(paramId);
+    if (i == parameters_.end()) return nullptr;
+    return i->second;
 }
 
 std::vector<std::shared_ptr<Page>> Module::getPages() {
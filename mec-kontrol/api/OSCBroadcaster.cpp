@@ -3,6 +3,8 @@
 #include <osc/OscOutboundPacketStream.h>
 #include <mec_log.h>
 
+#include <algorithm>
+
 namespace Kontrol {
 
 
@@ -11,11 +13,14 @@ namespace Kontrol {
 #define POLL_TIMEOUT_MS 1000
 
 OSCBroadcaster::OSCBroadcaster(Kontrol::ChangeSource src, unsigned keepAlive, bool master) :
+        coalesce_(0),
+        coalesced_(0),
+        keepAliveTime_(keepAlive),
         master_(master),
-        port_(0),
-        changeSource_(src),
-        keepAliveTime_(keepAlive) {
-    PaUtil_InitializeRingBuffer(&messageQueue_, sizeof(OscMsg), OscMsg::MAX_N_OSC_MSGS, msgData_);
+        running_(false),
+        wake_(false),
+        writerWaiting_(false),
+        changeSource_(src) {
 }
 
 OSCBroadcaster::~OSCBroadcaster() {
@@ -31,74 +36,294 @@ void *osc_broadcaster_write_thread_func(void *pBroadcaster) {
 
 bool OSCBroadcaster::connect(const std::string &host, unsigned port) {
     stop();
-    try {
-        host_ = host;
-        port_ = port;
-        socket_ = std::shared_ptr<UdpTransmitSocket>(new UdpTransmitSocket(IpEndpointName(host.c_str(), port_)));
-    } catch (const std::runtime_error &e) {
-        port_ = 0;
-        socket_.reset();
-        return false;
+    return addClient(changeSource_, host, port, keepAliveTime_);
+}
+
+bool OSCBroadcaster::addClient(Kontrol::ChangeSource src, const std::string &host, unsigned port, unsigned keepAlive) {
+    std::lock_guard<std::mutex> guard(clients_lock_);
+    for (const auto &client : clients_) {
+        if (client.host_ == host && client.port_ == port) return false;
     }
-    running_ = true;
-    writer_thread_ = std::thread(osc_broadcaster_write_thread_func, this);
+    if (!running_) {
+        if (!socket_.open()) return false;
+        running_ = true;
+        writer_thread_ = std::thread(osc_broadcaster_write_thread_func, this);
+    }
+    int dest = socket_.addDestination(host, port);
+    if (dest < 0) return false;
+    clients_.emplace_back(src, host, port, keepAlive, dest);
     return true;
 }
 
+unsigned OSCBroadcaster::removeInactive() {
+    // no change is part way to the queue, so records for a removed client are all before end()
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    std::lock_guard<std::mutex> guard(clients_lock_);
+    auto now = std::chrono::steady_clock::now();
+    unsigned removed = 0;
+    for (auto it = clients_.begin(); it != clients_.end();) {
+        if (it->isActive(now)) {
+            it++;
+            continue;
+        }
+        LOG_0("OSCBroadcaster remove inactive client " << it->host_ << " : " << it->port_);
+        {
+            std::lock_guard<std::mutex> coalesceGuard(coalesce_lock_);
+            for (auto &change : pending_) change.clients_ &= ~(1u << it->dest_);
+        }
+        if (running_) retired_.push_back({it->dest_, messageQueue_.end()});
+        else socket_.removeDestination(it->dest_);
+        it = clients_.erase(it);
+        removed++;
+    }
+    return removed;
+}
+
 void OSCBroadcaster::stop() {
-    running_ = false;
-    if (socket_) {
+    if (running_) {
+        {
+            // so the writer cannot be between checking running_ and waiting
+            std::lock_guard<std::mutex> guard(write_lock_);
+            running_ = false;
+        }
+        write_cond_.notify_one();
         writer_thread_.join();
-        PaUtil_FlushRingBuffer(&messageQueue_);
+        messageQueue_.flush();
+        if (messageQueue_.dropped() > 0) LOG_0("OSCBroadcaster dropped " << messageQueue_.dropped() << " messages");
+    }
+    {
+        std::lock_guard<std::mutex> guard(coalesce_lock_);
+        pending_.clear();
+        pendingIndex_.clear();
     }
-    port_ = 0;
-    socket_.reset();
+    std::lock_guard<std::mutex> guard(clients_lock_);
+    clients_.clear();
+    retired_.clear();
+    socket_.close();
 }
 
 
 void OSCBroadcaster::writePoll() {
-    std::unique_lock<std::mutex> lock(write_lock_);
+    static const unsigned BATCH = 16;
+    mec::UdpSender::Datagram datagrams[BATCH * MAX_CLIENTS];
+
     while (running_) {
-        while (PaUtil_GetRingBufferReadAvailable(&messageQueue_)) {
-            OscMsg msg;
-            PaUtil_ReadRingBuffer(&messageQueue_, &msg, 1);
-            socket_->Send(msg.buffer_, msg.size_);
+        // anything queued after this is seen, or it wakes us
+        wake_.exchange(false, std::memory_order_acquire);
+        for (;;) {
+            // every message to each of its clients, sent together, from the queue in place
+            unsigned pos = messageQueue_.begin(), size, n = 0, count = 0;
+            const char *record;
+            for (; n < BATCH && (record = messageQueue_.peek(pos, size)) != nullptr; n++) {
+                Clients clients;
+                memcpy(&clients, record, sizeof(clients));
+                for (unsigned dest = 0; dest < MAX_CLIENTS; dest++) {
+                    if ((clients & (1u << dest)) == 0) continue;
+                    mec::UdpSender::Datagram &d = datagrams[count++];
+                    d.data_ = record + sizeof(clients);
+                    d.size_ = size - sizeof(clients);
+                    d.dest_ = dest;
+                }
+            }
+            if (n == 0) break;
+            {
+                std::lock_guard<std::mutex> guard(clients_lock_);
+                socket_.send(datagrams, count);
+            }
+            messageQueue_.release(pos);
+        }
+        freeRetired();
+
+        auto wakeup = std::chrono::steady_clock::now() + std::chrono::milliseconds(POLL_TIMEOUT_MS);
+        if (coalesce_.count() > 0) {
+            bool flush = false;
+            {
+                std::lock_guard<std::mutex> guard(coalesce_lock_);
+                if (!pending_.empty()) {
+                    if (std::chrono::steady_clock::now() >= flushAt_) flush = true;
+                    else if (flushAt_ < wakeup) wakeup = flushAt_;
+                }
+            }
+            if (flush) {
+                flushChanges();
+                continue;
+            }
         }
-        write_cond_.wait_for(lock, std::chrono::milliseconds(POLL_TIMEOUT_MS));
+
+        std::unique_lock<std::mutex> lock(write_lock_);
+        writerWaiting_.store(true, std::memory_order_relaxed);
+        // pairs with the fence in wakeWriter, so either we see wake_, or the producer sees writerWaiting_
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        write_cond_.wait_until(lock, wakeup, [this] {
+            return !running_ || wake_.load(std::memory_order_relaxed);
+        });
+        writerWaiting_.store(false, std::memory_order_relaxed);
     }
 }
 
-bool OSCBroadcaster::isActive() {
-    if (!socket_) return false;
+void OSCBroadcaster::wakeWriter() {
+    wake_.store(true, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writerWaiting_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> guard(write_lock_);
+        write_cond_.notify_one();
+    }
+}
+
+void OSCBroadcaster::freeRetired() {
+    std::lock_guard<std::mutex> guard(clients_lock_);
+    unsigned done = messageQueue_.begin();
+    for (auto it = retired_.begin(); it != retired_.end();) {
+        if (int(done - it->queuePos_) < 0) {
+            it++;
+            continue;
+        }
+        socket_.removeDestination(it->dest_);
+        it = retired_.erase(it);
+    }
+}
+
+bool OSCBroadcaster::isDiscrete(const Parameter &p) {
+    return p.type() == PT_Int || p.type() == PT_Boolean || p.current().type() != ParamValue::T_Float;
+}
+
+void OSCBroadcaster::coalesceChange(const Rack &rack, const Module &module, const Parameter &p, Clients clients) {
+    ParamKey key = {&rack, &module, &p};
+    float value = p.current().floatValue();
+    {
+        std::lock_guard<std::mutex> guard(coalesce_lock_);
+        auto it = pendingIndex_.find(key);
+        if (it != pendingIndex_.end()) {
+            PendingChange &change = pending_[it->second];
+            // could be a new parameter, at the address of one that was deleted
+            if (change.paramId_ == p.id() && change.moduleId_ == module.id() && change.rackId_ == rack.id()) {
+                change.value_ = value;
+                change.clients_ = clients;
+                coalesced_++;
+                return;
+            }
+        }
+        pendingIndex_[key] = pending_.size();
+        pending_.push_back({rack.id(), module.id(), p.id(), value, clients});
+        if (pending_.size() > 1) return;
+        flushAt_ = std::chrono::steady_clock::now() + coalesce_;
+    }
+    // first change, writer must wake for the flush
+    wakeWriter();
+}
+
+void OSCBroadcaster::flushChanges() {
+    {
+        std::lock_guard<std::mutex> guard(coalesce_lock_);
+        flushing_.swap(pending_);
+        pending_.clear();
+        pendingIndex_.clear();
+    }
+
+    // a bundle only has changes for the same clients, usually all are
+    std::stable_sort(flushing_.begin(), flushing_.end(),
+                     [](const PendingChange &a, const PendingChange &b) { return a.clients_ < b.clients_; });
+
+    // address, type tags (,sssf) and value, plus element size
+    static const unsigned CHANGED_SIZE = 20 + 8 + 4 + 4;
+    static const unsigned MAX_BUNDLE_SIZE = OUTPUT_BUFFER_SIZE - 8; // margin for oscpack type tag space
+
+    for (size_t i = 0; i < flushing_.size();) {
+        Clients clients = flushing_[i].clients_;
+        osc::OutboundPacketStream ops(flushBuffer_, OUTPUT_BUFFER_SIZE);
+        ops << osc::BeginBundleImmediate;
+        for (unsigned n = 0; i < flushing_.size() && flushing_[i].clients_ == clients; i++, n++) {
+            const PendingChange &c = flushing_[i];
+            size_t size = CHANGED_SIZE
+                          + ((c.rackId_.size() + 4) & ~3) + ((c.moduleId_.size() + 4) & ~3)
+                          + ((c.paramId_.size() + 4) & ~3);
+            if (n > 0 && ops.Size() + size > MAX_BUNDLE_SIZE) break;
+            ops << osc::BeginMessage("/Kontrol/changed")
+                << c.rackId_.c_str()
+                << c.moduleId_.c_str()
+                << c.paramId_.c_str()
+                << c.value_
+                << osc::EndMessage;
+        }
+        ops << osc::EndBundle;
+
+        mec::UdpSender::Datagram datagrams[MAX_CLIENTS];
+        unsigned count = 0;
+        for (unsigned dest = 0; dest < MAX_CLIENTS; dest++) {
+            if ((clients & (1u << dest)) == 0) continue;
+            mec::UdpSender::Datagram &d = datagrams[count++];
+            d.data_ = ops.Data();
+            d.size_ = static_cast<unsigned>(ops.Size());
+            d.dest_ = dest;
+        }
+        std::lock_guard<std::mutex> guard(clients_lock_);
+        socket_.send(datagrams, count);
+    }
+    flushing_.clear();
+}
+
+bool OSCBroadcaster::Client::isActive(std::chrono::steady_clock::time_point now) const {
     if (keepAliveTime_ == 0) return true;
 
-    static std::chrono::seconds timeOut(keepAliveTime_ * 2); // twice normal ping time
-    auto now = std::chrono::steady_clock::now();
+    std::chrono::seconds timeOut(keepAliveTime_ * 2); // twice normal ping time
     auto dur = std::chrono::duration_cast<std::chrono::seconds>(now - lastPing_);
-//    if(!(dur <= timeOut)) {
-//        std::cerr << "not active : " << dur.count() << std::endl;
-//    }
     return dur <= timeOut;
 }
 
+bool OSCBroadcaster::isActive() {
+    std::lock_guard<std::mutex> guard(clients_lock_);
+    auto now = std::chrono::steady_clock::now();
+    for (const auto &client : clients_) {
+        if (client.isActive(now)) return true;
+    }
+    return false;
+}
+
+bool OSCBroadcaster::isThisHost(const std::string &host, unsigned port) {
+    std::lock_guard<std::mutex> guard(clients_lock_);
+    for (const auto &client : clients_) {
+        if (client.host_ == host && client.port_ == port) return true;
+    }
+    return false;
+}
+
+std::string OSCBroadcaster::host() {
+    std::lock_guard<std::mutex> guard(clients_lock_);
+    return clients_.empty() ? std::string() : clients_[0].host_;
+}
+
+unsigned OSCBroadcaster::port() {
+    std::lock_guard<std::mutex> guard(clients_lock_);
+    return clients_.empty() ? 0 : clients_[0].port_;
+}
+
 
-void OSCBroadcaster::send(const char *data, unsigned size) {
-    OscMsg msg;
-//    {
-//        static unsigned maxsize = 0;
-//        if(size>maxsize) {
-//            maxsize = size;
-//            LOG_0("OSCBroadcaster MAXSIZE " << maxsize);
-//        }
-//    }
-    msg.size_ = (size > OscMsg::MAX_OSC_MESSAGE_SIZE ? OscMsg::MAX_OSC_MESSAGE_SIZE : size);
-    memcpy(msg.buffer_, data, (size_t) msg.size_);
-    PaUtil_WriteRingBuffer(&messageQueue_, (void *) &msg, 1);
-    write_cond_.notify_one();
+void OSCBroadcaster::send(const char *data, unsigned size, Clients clients) {
+    unsigned recordSize = sizeof(clients) + size;
+    char *record = messageQueue_.reserve(recordSize);
+    if (record == nullptr) {
+        // writer is behind, callers may be time critical (e.g. midi learn), so drop rather than wait
+        messageQueue_.drop();
+        wakeWriter();
+        return;
+    }
+    memcpy(record, &clients, sizeof(clients));
+    memcpy(record + sizeof(clients), data, size);
+    messageQueue_.commit();
+    wakeWriter();
 }
 
 void OSCBroadcaster::sendPing(unsigned port) {
-    if (!socket_) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = 0;
+    {
+        std::lock_guard<std::mutex> guard(clients_lock_);
+        auto now = std::chrono::steady_clock::now();
+        for (const auto &client : clients_) {
+            if (client.isActive(now)) clients |= 1u << client.dest_;
+        }
+    }
+    if (!clients) return;
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
@@ -109,49 +334,74 @@ void OSCBroadcaster::sendPing(unsigned port) {
         << osc::EndMessage
         << osc::EndBundle;
 
-    send(ops.Data(), ops.Size());
+    send(ops.Data(), ops.Size(), clients);
 }
 
-bool OSCBroadcaster::broadcastChange(ChangeSource src) {
-    return src != changeSource_;
+OSCBroadcaster::Clients OSCBroadcaster::broadcastChange(ChangeSource src) {
+    std::lock_guard<std::mutex> guard(clients_lock_);
+    auto now = std::chrono::steady_clock::now();
+    Clients clients = 0;
+    for (const auto &client : clients_) {
+        if (client.changeSource_ != src && client.isActive(now)) clients |= 1u << client.dest_;
+    }
+    return clients;
 }
 
 
 void OSCBroadcaster::ping(ChangeSource src, const std::string &host, unsigned port, unsigned keepAlive) {
-    if ((port_ == port) && (host_ == host)) {
-        changeSource_ = src;
-
-        keepAliveTime_ = keepAlive;
-        bool wasActive = isActive();
-        lastPing_ = std::chrono::steady_clock::now();
-        if (!master_) {
-            if (!wasActive) {
-                KontrolModel::model()->publishMetaData();
+    // held until the meta data is queued, so dest cannot be removed meanwhile
+    std::unique_lock<std::mutex> producer(producer_lock_);
+    bool wasActive = false;
+    int dest = -1;
+    {
+        std::lock_guard<std::mutex> guard(clients_lock_);
+        for (auto &client : clients_) {
+            if ((client.port_ == port) && (client.host_ == host)) {
+                client.changeSource_ = src;
+
+                client.keepAliveTime_ = keepAlive;
+                auto now = std::chrono::steady_clock::now();
+                wasActive = client.isActive(now);
+                client.lastPing_ = now;
+                dest = client.dest_;
+                break;
             }
-        } else {
-            if (keepAliveTime_ == 0 || !wasActive) {
-
-                EntityId rackId = Rack::createId(host_, port_);
-                for (auto r:KontrolModel::model()->getRacks()) {
-                    if (rackId != r->id()) {
-                        std::cerr << " publishing meta data to " << rackId << " for " << r->id() << std::endl;
-                        rack(CS_LOCAL, *r);
-                        for (auto m : r->getModules()) {
-                            module(CS_LOCAL, *r, *m);
-                            for (auto p :  m->getParams()) {
-                                param(CS_LOCAL, *r, *m, *p);
-                            }
-                            for (auto p : m->getPages()) {
-                                if (p != nullptr) {
-                                    page(CS_LOCAL, *r, *m, *p);
-                                }
-                            }
-                            for (auto p :  m->getParams()) {
-                                changed(CS_LOCAL, *r, *m, *p);
-                            }
-                        }
+        }
+    }
+    if (dest < 0) return;
+
+    if (!master_) {
+        producer.unlock(); // model calls back into us
+        if (!wasActive) {
+            KontrolModel::model()->publishMetaData();
+        }
+    } else {
+        if (keepAlive == 0 || !wasActive) {
+            // only to this client, the others already have it
+            publishMetaData(Rack::createId(host, port), 1u << dest);
+        }
+    }
+}
+
+// meta data is sent in order, and changes are not coalesced, so they follow the params they are for
+void OSCBroadcaster::publishMetaData(const EntityId &rackId, Clients clients) {
+    for (auto r:KontrolModel::model()->getRacks()) {
+        if (rackId != r->id()) {
+            std::cerr << " publishing meta data to " << rackId << " for " << r->id() << std::endl;
+            sendRack(*r, clients);
+            for (auto m : r->getModules()) {
+                sendModule(*r, *m, clients);
+                for (auto p :  m->getParams()) {
+                    sendParam(*r, *m, *p, clients);
+                }
+                for (auto p : m->getPages()) {
+                    if (p != nullptr) {
+                        sendPage(*r, *m, *p, clients);
                     }
                 }
+                for (auto p :  m->getParams()) {
+                    sendChanged(*r, *m, *p, clients);
+                }
             }
         }
     }
@@ -159,8 +409,9 @@ void OSCBroadcaster::ping(ChangeSource src, const std::string &host, unsigned po
 
 void OSCBroadcaster::assignMidiCC(ChangeSource src, const Rack &rack, const Module &module, const Parameter &p,
                                   unsigned midiCC) {
-    if (!broadcastChange(src)) return;
-    if (!isActive()) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = broadcastChange(src);
+    if (!clients) return;
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
@@ -177,8 +428,9 @@ void OSCBroadcaster::assignMidiCC(ChangeSource src, const Rack &rack, const Modu
 
 void OSCBroadcaster::unassignMidiCC(ChangeSource src, const Rack &rack, const Module &module, const Parameter &p,
                                     unsigned midiCC) {
-    if (!broadcastChange(src)) return;
-    if (!isActive()) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = broadcastChange(src);
+    if (!clients) return;
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
@@ -195,8 +447,9 @@ void OSCBroadcaster::unassignMidiCC(ChangeSource src, const Rack &rack, const Mo
 
 
 void OSCBroadcaster::updatePreset(ChangeSource src, const Rack &rack, std::string preset) {
-    if (!broadcastChange(src)) return;
-    if (!isActive()) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = broadcastChange(src);
+    if (!clients) return;
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
@@ -208,12 +461,13 @@ void OSCBroadcaster::updatePreset(ChangeSource src, const Rack &rack, std::strin
     ops << osc::EndMessage
         << osc::EndBundle;
 
-    send(ops.Data(), ops.Size());
+    send(ops.Data(), ops.Size(), clients);
 }
 
 void OSCBroadcaster::applyPreset(ChangeSource src, const Rack &rack, std::string preset) {
-    if (!broadcastChange(src)) return;
-    if (!isActive()) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = broadcastChange(src);
+    if (!clients) return;
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
     ops << osc::BeginBundleImmediate
@@ -224,12 +478,13 @@ void OSCBroadcaster::applyPreset(ChangeSource src, const Rack &rack, std::string
     ops << osc::EndMessage
         << osc::EndBundle;
 
-    send(ops.Data(), ops.Size());
+    send(ops.Data(), ops.Size(), clients);
 }
 
 void OSCBroadcaster::saveSettings(ChangeSource src, const Rack &rack) {
-    if (!broadcastChange(src)) return;
-    if (!isActive()) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = broadcastChange(src);
+    if (!clients) return;
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
     ops << osc::BeginBundleImmediate
@@ -239,14 +494,15 @@ void OSCBroadcaster::saveSettings(ChangeSource src, const Rack &rack) {
     ops << osc::EndMessage
         << osc::EndBundle;
 
-    send(ops.Data(), ops.Size());
+    send(ops.Data(), ops.Size(), clients);
 }
 
 
 void OSCBroadcaster::loadModule(ChangeSource src, const Rack &rack, const EntityId &moduleId,
                                 const std::string &modType) {
-    if (!broadcastChange(src)) return;
-    if (!isActive()) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = broadcastChange(src);
+    if (!clients) return;
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
     ops << osc::BeginBundleImmediate
@@ -258,14 +514,18 @@ void OSCBroadcaster::loadModule(ChangeSource src, const Rack &rack, const Entity
     ops << osc::EndMessage
         << osc::EndBundle;
 
-    send(ops.Data(), ops.Size());
+    send(ops.Data(), ops.Size(), clients);
 }
 
 
 void OSCBroadcaster::rack(ChangeSource src, const Rack &p) {
-    if (!broadcastChange(src)) return;
-    if (!isActive()) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = broadcastChange(src);
+    if (!clients) return;
+    sendRack(p, clients);
+}
 
+void OSCBroadcaster::sendRack(const Rack &p, Clients clients) {
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
     ops << osc::BeginBundleImmediate
@@ -277,14 +537,18 @@ void OSCBroadcaster::rack(ChangeSource src, const Rack &p) {
     ops << osc::EndMessage
         << osc::EndBundle;
 
-    send(ops.Data(), ops.Size());
+    send(ops.Data(), ops.Size(), clients);
 }
 
 
 void OSCBroadcaster::module(ChangeSource src, const Rack &rack, const Module &m) {
-    if (!broadcastChange(src)) return;
-    if (!isActive()) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = broadcastChange(src);
+    if (!clients) return;
+    sendModule(rack, m, clients);
+}
 
+void OSCBroadcaster::sendModule(const Rack &rack, const Module &m, Clients clients) {
 //    LOG_0("OSCBroadcaster::module " << m.id());
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
@@ -299,14 +563,18 @@ void OSCBroadcaster::module(ChangeSource src, const Rack &rack, const Module &m)
     ops << osc::EndMessage
         << osc::EndBundle;
 
-    send(ops.Data(), ops.Size());
+    send(ops.Data(), ops.Size(), clients);
 }
 
 
 void OSCBroadcaster::page(ChangeSource src, const Rack &rack, const Module &module, const Page &p) {
-    if (!broadcastChange(src)) return;
-    if (!isActive()) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = broadcastChange(src);
+    if (!clients) return;
+    sendPage(rack, module, p, clients);
+}
 
+void OSCBroadcaster::sendPage(const Rack &rack, const Module &module, const Page &p, Clients clients) {
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
     ops << osc::BeginBundleImmediate
@@ -323,13 +591,17 @@ void OSCBroadcaster::page(ChangeSource src, const Rack &rack, const Module &modu
     ops << osc::EndMessage
         << osc::EndBundle;
 
-    send(ops.Data(), ops.Size());
+    send(ops.Data(), ops.Size(), clients);
 }
 
 void OSCBroadcaster::param(ChangeSource src, const Rack &rack, const Module &module, const Parameter &p) {
-    if (!broadcastChange(src)) return;
-    if (!isActive()) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = broadcastChange(src);
+    if (!clients) return;
+    sendParam(rack, module, p, clients);
+}
 
+void OSCBroadcaster::sendParam(const Rack &rack, const Module &module, const Parameter &p, Clients clients) {
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
     ops << osc::BeginBundleImmediate
@@ -354,13 +626,22 @@ void OSCBroadcaster::param(ChangeSource src, const Rack &rack, const Module &mod
     ops << osc::EndMessage
         << osc::EndBundle;
 
-    send(ops.Data(), ops.Size());
+    send(ops.Data(), ops.Size(), clients);
 }
 
 void OSCBroadcaster::changed(ChangeSource src, const Rack &rack, const Module &module, const Parameter &p) {
-    if (!broadcastChange(src)) return;
-    if (!isActive()) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = broadcastChange(src);
+    if (!clients) return;
+
+    if (coalesce_.count() > 0 && !isDiscrete(p)) {
+        coalesceChange(rack, module, p, clients);
+        return;
+    }
+    sendChanged(rack, module, p, clients);
+}
 
+void OSCBroadcaster::sendChanged(const Rack &rack, const Module &module, const Parameter &p, Clients clients) {
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
     ops << osc::BeginBundleImmediate
@@ -382,12 +663,13 @@ void OSCBroadcaster::changed(ChangeSource src, const Rack &rack, const Module &m
     ops << osc::EndMessage
         << osc::EndBundle;
 
-    send(ops.Data(), ops.Size());
+    send(ops.Data(), ops.Size(), clients);
 }
 
 void OSCBroadcaster::resource(ChangeSource src, const Rack &rack, const std::string &type, const std::string &res) {
-    if (!broadcastChange(src)) return;
-    if (!isActive()) return;
+    std::lock_guard<std::mutex> producer(producer_lock_);
+    Clients clients = broadcastChange(src);
+    if (!clients) return;
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
@@ -401,7 +683,7 @@ void OSCBroadcaster::resource(ChangeSource src, const Rack &rack, const std::str
     ops << osc::EndMessage
         << osc::EndBundle;
 
-    send(ops.Data(), ops.Size());
+    send(ops.Data(), ops.Size(), clients);
 }
 
 
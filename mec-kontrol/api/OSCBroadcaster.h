@@ -3,27 +3,47 @@
 #include "KontrolModel.h"
 #include "ChangeSource.h"
 
+#include <atomic>
 #include <memory>
-#include <ip/UdpSocket.h>
-#include <pa_ringbuffer.h>
+#include <mec_byte_ring.h>
+#include <mec_udp_receiver.h>
 #include <chrono>
+#include <cstdint>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <unordered_map>
+#include <vector>
 
 namespace Kontrol {
 
-
+// sends model changes to one or more clients (e.g. each organelle/push connected to mec)
+// each message is encoded once, queued once, then sent to every client that should see it
+// by a single writer thread, in as few system calls as possible (see mec::UdpSender)
+// a client does not get changes that came from it (its change source), or anything once its keep alive has expired
+// callbacks may come from several threads (osc receiver, midi, ui...), they are serialised by producer_lock_
+// as encoding uses buffer_, and messageQueue_ has a single producer
 class OSCBroadcaster : public KontrolCallback {
 public:
     static const unsigned int OUTPUT_BUFFER_SIZE = 1024;
+    static const unsigned MAX_CLIENTS = mec::UdpSender::MAX_DESTINATIONS;
 
     OSCBroadcaster(Kontrol::ChangeSource src, unsigned keepAlive, bool master);
     ~OSCBroadcaster();
+    // single client, with change source and keep alive given when constructed
     bool connect(const std::string &host, unsigned port);
+    // further clients, false if already a client, or no room
+    bool addClient(Kontrol::ChangeSource src, const std::string &host, unsigned port, unsigned keepAlive);
+    unsigned removeInactive(); // returns number removed
     void stop() override;
 
-    void sendPing(unsigned port);
+    // changes to a parameter are held for up to ms, then only the latest value is sent, several to a bundle
+    // discrete parameters (int, boolean) are always sent immediately. 0 = off (default), set before connecting
+    void setCoalesce(unsigned ms) { coalesce_ = std::chrono::milliseconds(ms); }
+    unsigned long long coalesced() const { return coalesced_; } // changes replaced by a later value
+    unsigned long dropped() const { return messageQueue_.dropped(); } // writer too far behind
+
+    void sendPing(unsigned port); // to active clients
 
     // KontrolCallback
     void rack(ChangeSource, const Rack &) override;
@@ -42,40 +62,108 @@ public:
     void saveSettings(ChangeSource, const Rack &) override;
     void loadModule(ChangeSource, const Rack &, const EntityId &, const std::string &) override;
 
-    bool isThisHost(const std::string &host, unsigned port) { return host == host_ && port == port_; }
+    bool isThisHost(const std::string &host, unsigned port);
 
-    bool isActive();
+    bool isActive(); // any client
     void writePoll();
 
-    std::string host() { return host_; }
-
-    unsigned port() { return port_; }
+    // first client
+    std::string host();
+    unsigned port();
 
 
 protected:
-    void send(const char *data, unsigned size);
-    bool broadcastChange(ChangeSource src);
+    typedef uint32_t Clients; // bit per client (its destination in socket_)
+
+    void send(const char *data, unsigned size, Clients clients);
+    Clients broadcastChange(ChangeSource src); // active clients, which are not the source
 
 private:
-    struct OscMsg {
-        static const int MAX_N_OSC_MSGS = 128;
-        static const int MAX_OSC_MESSAGE_SIZE = 256;
-        int size_;
-        char buffer_[MAX_OSC_MESSAGE_SIZE];
+    struct Client {
+        Client(ChangeSource src, const std::string &host, unsigned port, unsigned keepAlive, int dest) :
+                changeSource_(src), host_(host), port_(port), keepAliveTime_(keepAlive), dest_(dest) { ; }
+
+        bool isActive(std::chrono::steady_clock::time_point now) const;
+
+        ChangeSource changeSource_;
+        std::string host_;
+        unsigned port_;
+        unsigned keepAliveTime_;
+        std::chrono::steady_clock::time_point lastPing_;
+        int dest_;
+    };
+
+    // destination of a removed client, only freed once records queued for it are sent
+    // (else a new client could get the destination, and the old client's messages)
+    struct Retired {
+        int dest_;
+        unsigned queuePos_; // messageQueue_ write position, when removed
+    };
+
+    // pending parameter changes, latest value by rack/module/parameter (see setCoalesce)
+    struct ParamKey {
+        const Rack *rack_;
+        const Module *module_;
+        const Parameter *param_;
+
+        bool operator==(const ParamKey &k) const {
+            return rack_ == k.rack_ && module_ == k.module_ && param_ == k.param_;
+        }
+    };
+
+    struct ParamKeyHash {
+        size_t operator()(const ParamKey &k) const {
+            return std::hash<const void *>()(k.param_) ^ (std::hash<const void *>()(k.module_) << 1);
+        }
+    };
+
+    struct PendingChange {
+        std::string rackId_;
+        std::string moduleId_;
+        std::string paramId_;
+        float value_;
+        Clients clients_;
     };
 
-    std::string host_;
-    unsigned int port_;
-    std::shared_ptr<UdpTransmitSocket> socket_;
+    // meta data and changes, to the given clients
+    void sendRack(const Rack &, Clients clients);
+    void sendModule(const Rack &rack, const Module &, Clients clients);
+    void sendPage(const Rack &rack, const Module &module, const Page &p, Clients clients);
+    void sendParam(const Rack &rack, const Module &module, const Parameter &p, Clients clients);
+    void sendChanged(const Rack &rack, const Module &module, const Parameter &p, Clients clients);
+    void publishMetaData(const EntityId &rackId, Clients clients); // all racks, except rackId
+
+    static bool isDiscrete(const Parameter &p);
+    void coalesceChange(const Rack &rack, const Module &module, const Parameter &p, Clients clients);
+    void flushChanges(); // writer thread
+    void freeRetired(); // writer thread
+    void wakeWriter();
+
+    std::chrono::milliseconds coalesce_;
+    std::mutex coalesce_lock_;
+    std::vector<PendingChange> pending_;
+    std::unordered_map<ParamKey, size_t, ParamKeyHash> pendingIndex_;
+    std::chrono::steady_clock::time_point flushAt_;
+    std::vector<PendingChange> flushing_;
+    char flushBuffer_[OUTPUT_BUFFER_SIZE];
+    unsigned long long coalesced_;
+
+    std::mutex producer_lock_; // lock order : producer_lock_, clients_lock_, coalesce_lock_
+    std::vector<Client> clients_;
+    std::vector<Retired> retired_;
+    std::mutex clients_lock_;
+
+    mec::UdpSender socket_;
     char buffer_[OUTPUT_BUFFER_SIZE];
-    std::chrono::steady_clock::time_point lastPing_;
     unsigned keepAliveTime_;
 
-    PaUtilRingBuffer messageQueue_;
-    char msgData_[sizeof(OscMsg) * OscMsg::MAX_N_OSC_MSGS];
+    mec::ByteRing messageQueue_; // records are Clients, then the osc packet
     bool master_;
 
-    bool running_;
+    std::atomic<bool> running_;
+    // writer wakes on wake_, producers only lock/notify when it is waiting (as ByteRing::waitForSpace)
+    std::atomic<bool> wake_;
+    std::atomic<bool> writerWaiting_;
     std::mutex write_lock_;
     std::condition_variable write_cond_;
     std::thread writer_thread_;
@@ -5,166 +5,345 @@
 
 #include <mec_log.h>
 
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
 
 namespace Kontrol {
 
+// when the queue is full, how long the receive thread will block waiting for poll(), before dropping a packet
+// meanwhile, packets are buffered by the socket
+static const unsigned BACKPRESSURE_MS = 50;
+
 class KontrolPacketListener : public PacketListener {
 public:
-    KontrolPacketListener(PaUtilRingBuffer *queue) : queue_(queue) {
+    KontrolPacketListener(mec::ByteRing *queue) : queue_(queue) {
     }
 
     virtual void ProcessPacket(const char *data, int size,
                                const IpEndpointName &remoteEndpoint) {
-        OSCReceiver::OscMsg msg;
-        msg.origin_ = remoteEndpoint;
-
-//        {
-//            static unsigned maxsize = 0;
-//            if(size>maxsize) {
-//                maxsize = size;
-//                LOG_0("KontrolPacketListener MAXSIZE " << maxsize);
-//            }
-//        }
-
-        msg.size_ = (size > OSCReceiver::OscMsg::MAX_OSC_MESSAGE_SIZE ? OSCReceiver::OscMsg::MAX_OSC_MESSAGE_SIZE
-                                                                      : size);
-        memcpy(msg.buffer_, data, (size_t) msg.size_);
-        PaUtil_WriteRingBuffer(queue_, (void *) &msg, 1);
+        unsigned recordSize = sizeof(remoteEndpoint) + size;
+        char *record = queue_->reserve(recordSize);
+        if (record == nullptr) {
+            if (queue_->waitForSpace(recordSize, std::chrono::milliseconds(BACKPRESSURE_MS))) {
+                record = queue_->reserve(recordSize);
+            }
+            if (record == nullptr) {
+                queue_->drop();
+                return;
+            }
+        }
+        memcpy(record, &remoteEndpoint, sizeof(remoteEndpoint));
+        memcpy(record + sizeof(remoteEndpoint), data, (size_t) size);
+        queue_->commit();
     }
 
 private:
-    PaUtilRingBuffer *queue_;
+    mec::ByteRing *queue_;
+};
+
+
+// the /Kontrol addresses, indexed by a perfect hash, so dispatch is one hash and one compare
+enum KontrolAddress {
+    KA_CHANGED,
+    KA_PARAM,
+    KA_PAGE,
+    KA_MODULE,
+    KA_RACK,
+    KA_PING,
+    KA_RESOURCE,
+    KA_ASSIGN_MIDI_CC,
+    KA_UNASSIGN_MIDI_CC,
+    KA_UPDATE_PRESET,
+    KA_APPLY_PRESET,
+    KA_SAVE_SETTINGS,
+    KA_LOAD_MODULE,
+    KA_MAX
+};
+
+static const char *const KONTROL_ADDRESSES[KA_MAX] = {
+        "/Kontrol/changed",
+        "/Kontrol/param",
+        "/Kontrol/page",
+        "/Kontrol/module",
+        "/Kontrol/rack",
+        "/Kontrol/ping",
+        "/Kontrol/resource",
+        "/Kontrol/assignMidiCC",
+        "/Kontrol/unassignMidiCC",
+        "/Kontrol/updatePreset",
+        "/Kontrol/applyPreset",
+        "/Kontrol/saveSettings",
+        "/Kontrol/loadModule"
+};
+
+class AddressTable {
+public:
+    AddressTable() : seed_(0x9E3779B1) {
+        // find a multiplier which places every address in its own slot
+        for (;; seed_ += 2) {
+            for (unsigned i = 0; i < TABLE_SIZE; i++) table_[i] = -1;
+            unsigned n = 0;
+            for (; n < KA_MAX; n++) {
+                unsigned slot = slotFor(KONTROL_ADDRESSES[n]);
+                if (table_[slot] != -1) break;
+                table_[slot] = n;
+            }
+            if (n == KA_MAX) break;
+        }
+    }
+
+    // KA_MAX if not a Kontrol address
+    KontrolAddress lookup(const char *address) const {
+        int n = table_[slotFor(address)];
+        if (n < 0 || std::strcmp(address, KONTROL_ADDRESSES[n]) != 0) return KA_MAX;
+        return static_cast<KontrolAddress>(n);
+    }
+
+private:
+    static const unsigned TABLE_BITS = 5;
+    static const unsigned TABLE_SIZE = 1 << TABLE_BITS;
+    static const unsigned PREFIX_LEN = 9; // "/Kontrol/"
+
+    // length, first two characters after the prefix, and the last, are unique over the address set
+    unsigned slotFor(const char *address) const {
+        size_t len = std::strlen(address);
+        if (len <= PREFIX_LEN + 1) return 0;
+        uint32_t key = uint32_t(len)
+                       | (uint32_t((unsigned char) address[PREFIX_LEN]) << 8)
+                       | (uint32_t((unsigned char) address[PREFIX_LEN + 1]) << 16)
+                       | (uint32_t((unsigned char) address[len - 1]) << 24);
+        return (key * seed_) >> (32 - TABLE_BITS);
+    }
+
+    uint32_t seed_;
+    int table_[TABLE_SIZE];
+};
+
+
+// interned entity ids, so an id which has been seen before is decoded without allocating
+// ids are only added when new, references remain valid until trim()
+class IdCache {
+public:
+    static const unsigned MAX_IDS = 4096;
+
+    IdCache() { rehash(64); }
+
+    const EntityId &intern(const char *id) {
+        uint32_t h = hash(id);
+        for (unsigned i = h & mask_;; i = (i + 1) & mask_) {
+            Slot &slot = slots_[i];
+            if (slot.id_ == nullptr) break;
+            if (slot.hash_ == h && *slot.id_ == id) return *slot.id_;
+        }
+
+        ids_.emplace_back(id);
+        if (ids_.size() * 2 > slots_.size()) {
+            rehash(static_cast<unsigned>(slots_.size() * 2));
+        } else {
+            insert(h, &ids_.back());
+        }
+        return ids_.back();
+    }
+
+    // between messages, bounds memory if a sender floods us with unique ids
+    void trim() {
+        if (ids_.size() > MAX_IDS) {
+            ids_.clear();
+            rehash(64);
+        }
+    }
+
+private:
+    struct Slot {
+        uint32_t hash_;
+        const EntityId *id_;
+    };
+
+    static uint32_t hash(const char *s) {
+        uint32_t h = 2166136261u; // FNV-1a
+        for (; *s; s++) h = (h ^ (unsigned char) *s) * 16777619u;
+        return h;
+    }
+
+    void insert(uint32_t h, const EntityId *id) {
+        unsigned i = h & mask_;
+        while (slots_[i].id_ != nullptr) i = (i + 1) & mask_;
+        slots_[i].hash_ = h;
+        slots_[i].id_ = id;
+    }
+
+    void rehash(unsigned size) {
+        slots_.assign(size, Slot{0, nullptr});
+        mask_ = size - 1;
+        for (const auto &id : ids_) insert(hash(id.c_str()), &id);
+    }
+
+    std::deque<EntityId> ids_; // stable addresses
+    std::vector<Slot> slots_;
+    unsigned mask_;
 };
 
 
 class KontrolOSCListener : public osc::OscPacketListener {
 public:
-    KontrolOSCListener(OSCReceiver &recv) : receiver_(recv) { ; }
+    KontrolOSCListener(OSCReceiver &recv) : receiver_(recv), lastKey_(0), lastSource_(nullptr) { ; }
 
 
     virtual void ProcessMessage(const osc::ReceivedMessage &m,
                                 const IpEndpointName &remoteEndpoint) {
         try {
-            char host[IpEndpointName::ADDRESS_STRING_LENGTH];
-            remoteEndpoint.AddressAsString(host);
-            ChangeSource changedSrc = ChangeSource::createRemoteSource(host, remoteEndpoint.port);
+            ids_.trim();
+            const Source &source = sourceFor(remoteEndpoint);
+            const ChangeSource &changedSrc = source.changeSource_;
             // std::err << "received osc message: " << m.AddressPattern() << std::endl;
-            if (std::strcmp(m.AddressPattern(), "/Kontrol/changed") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *moduleId = (arg++)->AsString();
-                const char *paramId = (arg++)->AsString();
-                if (arg != m.ArgumentsEnd()) {
-                    if (arg->IsString()) {
-                        receiver_.changeParam(changedSrc, rackId, moduleId, paramId,
-                                              ParamValue(std::string(arg->AsString())));
-
-                    } else if (arg->IsFloat()) {
-//                        std::cerr << "changed " << paramId << " : " << arg->AsFloat() << std::endl;
-                        receiver_.changeParam(changedSrc, rackId, moduleId, paramId, ParamValue(arg->AsFloat()));
+            switch (addresses_.lookup(m.AddressPattern())) {
+                case KA_CHANGED: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const EntityId &rackId = ids_.intern((arg++)->AsString());
+                    const EntityId &moduleId = ids_.intern((arg++)->AsString());
+                    const EntityId &paramId = ids_.intern((arg++)->AsString());
+                    if (arg != m.ArgumentsEnd()) {
+                        if (arg->IsString()) {
+                            receiver_.changeParam(changedSrc, rackId, moduleId, paramId,
+                                                  ParamValue(std::string(arg->AsString())));
+
+                        } else if (arg->IsFloat()) {
+//                            std::cerr << "changed " << paramId << " : " << arg->AsFloat() << std::endl;
+                            receiver_.changeParam(changedSrc, rackId, moduleId, paramId, ParamValue(arg->AsFloat()));
+                        }
                     }
+                    break;
                 }
-
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/param") == 0) {
-                std::vector<ParamValue> params;
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *moduleId = (arg++)->AsString();
-                while (arg != m.ArgumentsEnd()) {
-                    if (arg->IsString()) {
-                        params.push_back(ParamValue(std::string(arg->AsString())));
-
-                    } else if (arg->IsFloat()) {
-                        params.push_back(ParamValue(arg->AsFloat()));
+                case KA_PARAM: {
+                    params_.clear();
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const EntityId &rackId = ids_.intern((arg++)->AsString());
+                    const EntityId &moduleId = ids_.intern((arg++)->AsString());
+                    while (arg != m.ArgumentsEnd()) {
+                        if (arg->IsString()) {
+                            params_.push_back(ParamValue(std::string(arg->AsString())));
+
+                        } else if (arg->IsFloat()) {
+                            params_.push_back(ParamValue(arg->AsFloat()));
+                        }
+                        arg++;
                     }
-                    arg++;
-                }
-
-                receiver_.createParam(changedSrc, rackId, moduleId, params);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/page") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                // std::cerr << "received page p1"<< std::endl;
-                const char *rackId = (arg++)->AsString();
-                const char *moduleId = (arg++)->AsString();
-                const char *pageId = (arg++)->AsString();
-
-                const char *displayName = (arg++)->AsString();
 
-                std::vector<EntityId> paramIds;
-                while (arg != m.ArgumentsEnd()) {
-                    paramIds.push_back((arg++)->AsString());
+                    receiver_.createParam(changedSrc, rackId, moduleId, params_);
+                    break;
                 }
+                case KA_PAGE: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    // std::cerr << "received page p1"<< std::endl;
+                    const EntityId &rackId = ids_.intern((arg++)->AsString());
+                    const EntityId &moduleId = ids_.intern((arg++)->AsString());
+                    const char *pageId = (arg++)->AsString();
+
+                    const char *displayName = (arg++)->AsString();
+
+                    std::vector<EntityId> paramIds;
+                    while (arg != m.ArgumentsEnd()) {
+                        paramIds.push_back((arg++)->AsString());
+                    }
 
-                // std::cout << "received page " << id << std::endl;
-                receiver_.createPage(changedSrc, rackId, moduleId, pageId, displayName, paramIds);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/module") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *moduleId = (arg++)->AsString();
-                const char *displayName = (arg++)->AsString();
-                const char *type = (arg++)->AsString();
-
-//                 std::cout << "received module " << moduleId << std::endl;
-                receiver_.createModule(changedSrc, rackId, moduleId, displayName, type);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/rack") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *host = (arg++)->AsString();
-                unsigned port = (unsigned) (arg++)->AsInt32();
-
-                // std::cout << "received rack " << rackId << std::endl;
-                receiver_.createRack(changedSrc, rackId, host, port);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/ping") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                unsigned port = (unsigned) (arg++)->AsInt32();
-                unsigned keepAlive = 0;
-                if (arg != m.ArgumentsEnd()) {
-                    keepAlive = (unsigned) (arg++)->AsInt32();
+                    // std::cout << "received page " << id << std::endl;
+                    receiver_.createPage(changedSrc, rackId, moduleId, pageId, displayName, paramIds);
+                    break;
+                }
+                case KA_MODULE: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const EntityId &rackId = ids_.intern((arg++)->AsString());
+                    const EntityId &moduleId = ids_.intern((arg++)->AsString());
+                    const char *displayName = (arg++)->AsString();
+                    const char *type = (arg++)->AsString();
+
+//                     std::cout << "received module " << moduleId << std::endl;
+                    receiver_.createModule(changedSrc, rackId, moduleId, displayName, type);
+                    break;
+                }
+                case KA_RACK: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const EntityId &rackId = ids_.intern((arg++)->AsString());
+                    const char *host = (arg++)->AsString();
+                    unsigned port = (unsigned) (arg++)->AsInt32();
+
+                    // std::cout << "received rack " << rackId << std::endl;
+                    receiver_.createRack(changedSrc, rackId, host, port);
+                    break;
+                }
+                case KA_PING: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    unsigned port = (unsigned) (arg++)->AsInt32();
+                    unsigned keepAlive = 0;
+                    if (arg != m.ArgumentsEnd()) {
+                        keepAlive = (unsigned) (arg++)->AsInt32();
+                    }
+                    receiver_.ping(changedSrc, source.host_, port, keepAlive);
+                    break;
+                }
+                case KA_RESOURCE: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+//                     std::cout << "received resource p1"<< std::endl;
+                    const EntityId &rackId = ids_.intern((arg++)->AsString());
+                    const char *resType = (arg++)->AsString();
+                    const char *resValue = (arg++)->AsString();
+
+//                     std::cout << "received resource " << rackId <<  " : " << resType << " : " << resValue << std::endl;
+                    receiver_.createResource(changedSrc, rackId, resType, resValue);
+                    break;
+                }
+                case KA_ASSIGN_MIDI_CC: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const EntityId &rackId = ids_.intern((arg++)->AsString());
+                    const EntityId &moduleId = ids_.intern((arg++)->AsString());
+                    const EntityId &paramId = ids_.intern((arg++)->AsString());
+                    unsigned midiCC = (unsigned) (arg++)->AsInt32();
+                    receiver_.assignMidiCC(changedSrc, rackId, moduleId, paramId, midiCC);
+                    break;
+                }
+                case KA_UNASSIGN_MIDI_CC: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const EntityId &rackId = ids_.intern((arg++)->AsString());
+                    const EntityId &moduleId = ids_.intern((arg++)->AsString());
+                    const EntityId &paramId = ids_.intern((arg++)->AsString());
+                    unsigned midiCC = (unsigned) (arg++)->AsInt32();
+                    receiver_.unassignMidiCC(changedSrc, rackId, moduleId, paramId, midiCC);
+                    break;
+                }
+                case KA_UPDATE_PRESET: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const EntityId &rackId = ids_.intern((arg++)->AsString());
+                    const char *preset = (arg++)->AsString();
+                    receiver_.updatePreset(changedSrc, rackId, preset);
+                    break;
                 }
-                receiver_.ping(changedSrc, std::string(host), port, keepAlive);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/resource") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-//                 std::cout << "received resource p1"<< std::endl;
-                const char *rackId = (arg++)->AsString();
-                const char *resType = (arg++)->AsString();
-                const char *resValue = (arg++)->AsString();
-
-//                 std::cout << "received resource " << rackId <<  " : " << resType << " : " << resValue << std::endl;
-                receiver_.createResource(changedSrc, rackId, resType, resValue);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/assignMidiCC") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *moduleId = (arg++)->AsString();
-                const char *paramId = (arg++)->AsString();
-                unsigned midiCC = (unsigned) (arg++)->AsInt32();
-                receiver_.assignMidiCC(changedSrc, rackId, moduleId, paramId, midiCC);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/unassignMidiCC") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *moduleId = (arg++)->AsString();
-                const char *paramId = (arg++)->AsString();
-                unsigned midiCC = (unsigned) (arg++)->AsInt32();
-                receiver_.unassignMidiCC(changedSrc, rackId, moduleId, paramId, midiCC);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/updatePreset") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *preset = (arg++)->AsString();
-                receiver_.updatePreset(changedSrc, rackId, preset);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/applyPreset") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *preset = (arg++)->AsString();
-                receiver_.applyPreset(changedSrc, rackId, preset);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/saveSettings") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                receiver_.saveSettings(changedSrc, rackId);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/loadModule") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *modId = (arg++)->AsString();
-                const char *modType = (arg++)->AsString();
-                receiver_.loadModule(changedSrc, rackId, modId, modType);
+                case KA_APPLY_PRESET: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const EntityId &rackId = ids_.intern((arg++)->AsString());
+                    const char *preset = (arg++)->AsString();
+                    receiver_.applyPreset(changedSrc, rackId, preset);
+                    break;
+                }
+                case KA_SAVE_SETTINGS: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const EntityId &rackId = ids_.intern((arg++)->AsString());
+                    receiver_.saveSettings(changedSrc, rackId);
+                    break;
+                }
+                case KA_LOAD_MODULE: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const EntityId &rackId = ids_.intern((arg++)->AsString());
+                    const EntityId &modId = ids_.intern((arg++)->AsString());
+                    const char *modType = (arg++)->AsString();
+                    receiver_.loadModule(changedSrc, rackId, modId, modType);
+                    break;
+                }
+                default:
+                    break;
             }
         } catch (osc::Exception &e) {
             // std::err << "error while parsing message: "
@@ -173,12 +352,44 @@ public:
     }
 
 private:
+    static const unsigned MAX_SOURCES = 256;
+
+    // change source for a remote endpoint, created on first message
+    struct Source {
+        Source(const std::string &host, int port)
+                : host_(host), changeSource_(ChangeSource::createRemoteSource(host, port)) { ; }
+
+        std::string host_;
+        ChangeSource changeSource_;
+    };
+
+    const Source &sourceFor(const IpEndpointName &endpoint) {
+        uint64_t key = (uint64_t(endpoint.address) << 16) | (uint64_t(endpoint.port) & 0xffff);
+        if (lastSource_ != nullptr && key == lastKey_) return *lastSource_;
+
+        auto i = sources_.find(key);
+        if (i == sources_.end()) {
+            if (sources_.size() >= MAX_SOURCES) sources_.clear();
+            char host[IpEndpointName::ADDRESS_STRING_LENGTH];
+            endpoint.AddressAsString(host);
+            i = sources_.emplace(key, Source(host, endpoint.port)).first;
+        }
+        lastKey_ = key;
+        lastSource_ = &i->second;
+        return *lastSource_;
+    }
+
     OSCReceiver &receiver_;
+    AddressTable addresses_;
+    IdCache ids_;
+    std::vector<ParamValue> params_; // reused, so capacity is kept
+    std::unordered_map<uint64_t, Source> sources_; // key = address:port
+    uint64_t lastKey_;
+    const Source *lastSource_;
 };
 
 OSCReceiver::OSCReceiver(const std::shared_ptr<KontrolModel> &param)
         : model_(param), port_(0) {
-    PaUtil_InitializeRingBuffer(&messageQueue_, sizeof(OscMsg), OscMsg::MAX_N_OSC_MSGS, msgData_);
     packetListener_ = std::make_shared<KontrolPacketListener>(&messageQueue_);
     oscListener_ = std::make_shared<KontrolOSCListener>(*this);
 }
@@ -189,40 +400,41 @@ OSCReceiver::~OSCReceiver() {
 
 void *osc_receiver_read_thread_func(void *pReceiver) {
     OSCReceiver *pThis = static_cast<OSCReceiver *>(pReceiver);
-    pThis->socket()->Run();
+    pThis->socket()->run();
     return nullptr;
 }
 
-bool OSCReceiver::listen(unsigned port) {
+bool OSCReceiver::listen(unsigned port, unsigned batch, unsigned busyPollUs) {
     stop();
     port_ = port;
-    try {
-        socket_ = std::make_shared<UdpListeningReceiveSocket>(
-                IpEndpointName(IpEndpointName::ANY_ADDRESS, port_),
-                packetListener_.get());
-
-        receive_thread_ = std::thread(osc_receiver_read_thread_func, this);
-    } catch (const std::runtime_error &e) {
+    socket_ = std::make_shared<mec::UdpReceiver>(packetListener_.get(), batch);
+    if (!socket_->open(port_, busyPollUs)) {
+        socket_.reset();
+        port_ = 0;
         return false;
     }
+    receive_thread_ = std::thread(osc_receiver_read_thread_func, this);
     return true;
 }
 
 void OSCReceiver::stop() {
     if (socket_) {
-        socket_->AsynchronousBreak();
+        socket_->asynchronousBreak();
         receive_thread_.join();
-        PaUtil_FlushRingBuffer(&messageQueue_);
+        messageQueue_.flush();
+        if (messageQueue_.dropped() > 0) LOG_0("OSCReceiver dropped " << messageQueue_.dropped() << " packets");
     }
     port_ = 0;
     socket_.reset();
 }
 
 void OSCReceiver::poll() {
-    while (PaUtil_GetRingBufferReadAvailable(&messageQueue_)) {
-        OscMsg msg;
-        PaUtil_ReadRingBuffer(&messageQueue_, &msg, 1);
-        oscListener_->ProcessPacket(msg.buffer_, msg.size_, msg.origin_);
+    unsigned pos = messageQueue_.begin(), size;
+    while (const char *record = messageQueue_.peek(pos, size)) {
+        IpEndpointName origin;
+        memcpy(&origin, record, sizeof(origin));
+        oscListener_->ProcessPacket(record + sizeof(origin), static_cast<int>(size - sizeof(origin)), origin);
+        messageQueue_.release(pos);
     }
 }
 
@@ -4,8 +4,9 @@
 #include <thread>
 #include <memory>
 
-#include <ip/UdpSocket.h>
-#include <pa_ringbuffer.h>
+#include <ip/IpEndpointName.h>
+#include <mec_byte_ring.h>
+#include <mec_udp_receiver.h>
 
 namespace Kontrol {
 
@@ -19,7 +20,10 @@ class OSCReceiver {
 public:
     OSCReceiver(const std::shared_ptr<KontrolModel> &param);
     ~OSCReceiver();
-    bool listen(unsigned port = 9000);
+    // batch, busyPollUs : see mec::UdpReceiver
+    bool listen(unsigned port = 9000,
+                unsigned batch = mec::UdpReceiver::DEFAULT_BATCH,
+                unsigned busyPollUs = 0);
     void poll();
 
     void stop();
@@ -94,27 +98,20 @@ public:
 
     unsigned int port() { return port_; }
 
-    std::shared_ptr<UdpListeningReceiveSocket> socket() { return socket_; }
+    std::shared_ptr<mec::UdpReceiver> socket() { return socket_; }
+
+    unsigned long dropped() const { return messageQueue_.dropped(); } // poll() too far behind
 
 private:
     friend class KontrolPacketListener;
 
-    struct OscMsg {
-        static const int MAX_N_OSC_MSGS = 128;
-        static const int MAX_OSC_MESSAGE_SIZE = 256;
-        IpEndpointName origin_;
-        int size_;
-        char buffer_[MAX_OSC_MESSAGE_SIZE];
-    };
-
     std::shared_ptr<KontrolModel> model_;
     unsigned int port_;
     std::thread receive_thread_;
-    std::shared_ptr<UdpListeningReceiveSocket> socket_;
+    std::shared_ptr<mec::UdpReceiver> socket_;
     std::shared_ptr<PacketListener> packetListener_;
     std::shared_ptr<KontrolOSCListener> oscListener_;
-    PaUtilRingBuffer messageQueue_;
-    char msgData_[sizeof(OscMsg) * OscMsg::MAX_N_OSC_MSGS];
+    mec::ByteRing messageQueue_; // records are the origin (IpEndpointName), then the osc packet
 };
 
 } //namespace
\ No newline at end of file
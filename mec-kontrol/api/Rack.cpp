@@ -38,7 +38,9 @@ std::vector<std::shared_ptr<Module>> Rack::getModules() {
 }
 
 std::shared_ptr<Module> Rack::getModule(const EntityId &moduleId) {
-    return modules_[moduleId];
+    auto i = modules_.find(moduleId);
+    if (i == modules_.end()) return nullptr;
+    return i->second;
 }
 
 
@@ -147,7 +147,8 @@ void mec_tick(t_mec *self)
         return;
     }
 
-    if (self->pApi) self->pApi->process();
+    // cannot block on scheduler thread, so just check if there is anything to do
+    if (self->pApi && self->pApi->waitForEvents(0)) self->pApi->process();
 
     struct TouchMsg* pMsg;
     do
@@ -0,0 +1,184 @@
+#ifndef MEC_BYTE_RING_H
+#define MEC_BYTE_RING_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace mec {
+
+// single producer / single consumer lock free queue of variable length records (e.g. osc packets)
+// a record is a 4 byte length, then the data, padded to 4 bytes, so a small record uses little of the ring
+// records are contiguous, if one does not fit before the end of the ring, the rest of the ring is padding
+// and the record starts at the beginning, so both sides can use records in place (see reserve, peek)
+// capacity is rounded up to a power of 2, read/write positions are free running byte counts
+// when full, the producer can wait for space (backpressure), otherwise the record is dropped and counted
+// a waiting producer blocks, and is woken by the consumer's release, the consumer only locks if one is waiting
+class ByteRing {
+public:
+    static const unsigned DEFAULT_CAPACITY = 65536;
+
+    ByteRing(unsigned capacity = DEFAULT_CAPACITY) : reserved_(0), dropped_(0) {
+        writePtr_.store(0);
+        readPtr_.store(0);
+        waiting_.store(false);
+        setCapacity(capacity);
+    }
+
+    // not thread safe, call before producer/consumer are started
+    void setCapacity(unsigned capacity) {
+        unsigned sz = 64;
+        while (sz < capacity) sz <<= 1;
+        buffer_.assign(sz / 4, 0);
+        mask_ = sz - 1;
+        writePtr_.store(0);
+        readPtr_.store(0);
+    }
+
+    unsigned capacity() const { return mask_ + 1; }
+
+    // largest record, so it will always fit once the ring is empty
+    unsigned maxSize() const { return capacity() / 2 - HEADER_SIZE; }
+
+    // producer, space for size bytes, to be filled in place then commit()
+    // nullptr if no space (not counted as dropped, see drop())
+    char *reserve(unsigned size) {
+        if (size > maxSize()) return nullptr;
+        unsigned need = recordSize(size);
+        unsigned wp = writePtr_.load(std::memory_order_relaxed);
+        unsigned space = capacity() - (wp - readPtr_.load(std::memory_order_acquire));
+        unsigned pos = wp & mask_;
+        unsigned tail = capacity() - pos;
+        if (tail < need) {
+            // not enough before the end, pad and start at the beginning
+            if (space < tail + need) return nullptr;
+            header(pos) = PADDING;
+            wp += tail;
+            pos = 0;
+        } else if (space < need) {
+            return nullptr;
+        }
+        header(pos) = size;
+        reserved_ = wp + need;
+        return data() + pos + HEADER_SIZE;
+    }
+
+    // producer, make the reserved record available to the consumer
+    void commit() {
+        writePtr_.store(reserved_, std::memory_order_release);
+    }
+
+    // producer, copy in a record, false if no space
+    bool write(const void *data, unsigned size) {
+        char *p = reserve(size);
+        if (p == nullptr) return false;
+        memcpy(p, data, size);
+        commit();
+        return true;
+    }
+
+    // producer, wait up to timeout for space for size bytes, e.g. after reserve/write fail
+    // the consumer should be woken first, it is not signalled
+    bool waitForSpace(unsigned size, std::chrono::microseconds timeout) {
+        if (size > maxSize()) return false;
+        unsigned need = recordSize(size) * 2; // worst case, with padding
+        if (need > capacity()) need = capacity();
+        std::unique_lock<std::mutex> lock(spaceLock_);
+        waiting_.store(true, std::memory_order_relaxed);
+        // pairs with the fence in release, so either we see the space, or the consumer sees waiting_
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool space = spaceCond_.wait_for(lock, timeout, [&] { return available() >= need; });
+        waiting_.store(false, std::memory_order_relaxed);
+        return space;
+    }
+
+    // producer, a record was not written
+    void drop() { dropped_.fetch_add(1, std::memory_order_relaxed); }
+
+    // producer, position after the last committed record, the consumer is past it once begin() reaches it
+    unsigned end() const { return writePtr_.load(std::memory_order_relaxed); }
+
+    // consumer, in place access to records, e.g.
+    //   unsigned pos = ring.begin(), size;
+    //   while (const char* data = ring.peek(pos, size)) { ... }
+    //   ring.release(pos);
+    // records remain valid until released, so several can be used at once
+    unsigned begin() const { return readPtr_.load(std::memory_order_relaxed); }
+
+    // next record at pos, advancing pos past it, nullptr if none
+    const char *peek(unsigned &pos, unsigned &size) const {
+        unsigned wp = writePtr_.load(std::memory_order_acquire);
+        if (pos == wp) return nullptr;
+        unsigned offset = pos & mask_;
+        if (header(offset) == PADDING) {
+            pos += capacity() - offset;
+            offset = 0;
+        }
+        size = header(offset);
+        pos += recordSize(size);
+        return data() + offset + HEADER_SIZE;
+    }
+
+    // consumer, records before pos are no longer used
+    void release(unsigned pos) {
+        readPtr_.store(pos, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(spaceLock_);
+            spaceCond_.notify_one();
+        }
+    }
+
+    // consumer, discard everything queued
+    void flush() {
+        release(writePtr_.load(std::memory_order_acquire));
+    }
+
+    unsigned pending() const {
+        return writePtr_.load(std::memory_order_acquire) - readPtr_.load(std::memory_order_acquire);
+    }
+
+    unsigned available() const { return capacity() - pending(); }
+
+    bool isEmpty() const { return pending() == 0; }
+
+    unsigned long dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static const unsigned HEADER_SIZE = 4;
+    static const uint32_t PADDING = 0xFFFFFFFF;
+
+    static unsigned recordSize(unsigned size) { return HEADER_SIZE + ((size + 3) & ~3u); }
+
+    char *data() { return reinterpret_cast<char *>(buffer_.data()); }
+
+    const char *data() const { return reinterpret_cast<const char *>(buffer_.data()); }
+
+    uint32_t &header(unsigned offset) { return buffer_[offset / 4]; }
+
+    uint32_t header(unsigned offset) const { return buffer_[offset / 4]; }
+
+    // producer owned
+    std::atomic<unsigned> writePtr_;
+    unsigned reserved_;
+    std::atomic<unsigned long> dropped_;
+    char pad1_[64];
+    // consumer owned
+    std::atomic<unsigned> readPtr_;
+    char pad2_[64];
+    // producer waiting for space, see waitForSpace
+    std::atomic<bool> waiting_;
+    std::mutex spaceLock_;
+    std::condition_variable spaceCond_;
+    // shared, read only once running
+    unsigned mask_;
+    std::vector<uint32_t> buffer_; // as words, so headers are aligned
+};
+
+}
+
+#endif //MEC_BYTE_RING_H
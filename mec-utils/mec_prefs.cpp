@@ -254,7 +254,7 @@ void *Preferences::Array::getArray(unsigned i) const {
 void *Preferences::Array::getObject(unsigned i) const {
     if (!jsonData_) return nullptr;
     cJSON *node = cJSON_GetArrayItem((cJSON *) jsonData_, i);
-    if (node != nullptr && node->type == cJSON_Array) {
+    if (node != nullptr && node->type == cJSON_Object) {
         return node;
     }
     return nullptr;
@@ -0,0 +1,587 @@
+#include "mec_udp_receiver.h"
+
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <ip/IpEndpointName.h>
+
+#ifdef __linux__
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#else
+
+#include <ip/UdpSocket.h>
+
+#endif
+
+#include "mec_log.h"
+
+namespace mec {
+
+#ifdef __linux__
+
+// in busy poll mode, we block in recvmmsg (which busy polls), so wake this often to check for a break
+static const unsigned BUSY_POLL_BREAK_MS = 10;
+
+class UdpReceiver_impl {
+public:
+    UdpReceiver_impl(PacketListener *listener, unsigned batch) :
+            listener_(listener),
+            batch_(batch > 0 ? batch : 1),
+            fd_(-1),
+            breakFd_(-1),
+            busyPoll_(false),
+            port_(0),
+            break_(false) {
+        memset(&stats_, 0, sizeof(stats_));
+    }
+
+    ~UdpReceiver_impl() {
+        close();
+    }
+
+    bool open(unsigned port, unsigned busyPollUs) {
+        close();
+        fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd_ < 0) {
+            LOG_0("UdpReceiver: unable to create socket");
+            return false;
+        }
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (::bind(fd_, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+            LOG_0("UdpReceiver: unable to bind udp socket, port " << port);
+            close();
+            return false;
+        }
+        socklen_t len = sizeof(addr);
+        if (::getsockname(fd_, (struct sockaddr *) &addr, &len) == 0) port_ = ntohs(addr.sin_port);
+
+        busyPoll_ = false;
+        if (busyPollUs > 0) {
+#ifdef SO_BUSY_POLL
+            int us = static_cast<int>(busyPollUs);
+            struct timeval tv;
+            tv.tv_sec = 0;
+            tv.tv_usec = BUSY_POLL_BREAK_MS * 1000;
+            if (::setsockopt(fd_, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)) == 0
+                && ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0) {
+                busyPoll_ = true;
+                LOG_1("UdpReceiver: busy poll " << busyPollUs << "us, port " << port_);
+            } else {
+                // raising above net.core.busy_read needs CAP_NET_ADMIN
+                LOG_0("UdpReceiver: unable to set busy poll, port " << port_);
+            }
+#else
+            LOG_0("UdpReceiver: busy poll not supported");
+#endif
+        }
+
+        breakFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (breakFd_ < 0) {
+            LOG_0("UdpReceiver: unable to create eventfd");
+            close();
+            return false;
+        }
+
+        slab_.resize(batch_ * UdpReceiver::MAX_PACKET_SIZE);
+        msgs_.resize(batch_);
+        iovs_.resize(batch_);
+        addrs_.resize(batch_);
+        for (unsigned i = 0; i < batch_; i++) {
+            iovs_[i].iov_base = &slab_[i * UdpReceiver::MAX_PACKET_SIZE];
+            iovs_[i].iov_len = UdpReceiver::MAX_PACKET_SIZE;
+        }
+        break_ = false;
+        return true;
+    }
+
+    void close() {
+        if (fd_ >= 0) ::close(fd_);
+        if (breakFd_ >= 0) ::close(breakFd_);
+        fd_ = -1;
+        breakFd_ = -1;
+    }
+
+    void asynchronousBreak() {
+        break_ = true;
+        if (breakFd_ >= 0) {
+            uint64_t v = 1;
+            ssize_t r = ::write(breakFd_, &v, sizeof(v));
+            (void) r;
+        }
+    }
+
+    unsigned receive(int timeoutUs) {
+        if (fd_ < 0) return 0;
+        if (busyPoll_) {
+            // blocking read busy polls, but only wakes every BUSY_POLL_BREAK_MS, so spin for short timeouts
+            bool spin = timeoutUs >= 0 && timeoutUs < (int) BUSY_POLL_BREAK_MS * 1000;
+            return read(spin ? MSG_DONTWAIT : MSG_WAITFORONE);
+        }
+
+        struct pollfd pfd[2];
+        pfd[0].fd = fd_;
+        pfd[0].events = POLLIN;
+        pfd[0].revents = 0;
+        pfd[1].fd = breakFd_;
+        pfd[1].events = POLLIN;
+        pfd[1].revents = 0;
+        struct timespec ts;
+        ts.tv_sec = timeoutUs / 1000000;
+        ts.tv_nsec = (timeoutUs % 1000000) * 1000;
+        if (::ppoll(pfd, 2, timeoutUs < 0 ? nullptr : &ts, nullptr) <= 0) return 0;
+        if (pfd[1].revents & POLLIN) {
+            uint64_t v;
+            ssize_t r = ::read(breakFd_, &v, sizeof(v));
+            (void) r;
+        }
+        if (!(pfd[0].revents & POLLIN)) return 0;
+        return read(MSG_DONTWAIT);
+    }
+
+    // a batch at a time, until the socket is empty (a short batch)
+    unsigned read(int flags) {
+        unsigned total = 0;
+        for (;;) {
+            for (unsigned i = 0; i < batch_; i++) {
+                struct msghdr &hdr = msgs_[i].msg_hdr;
+                memset(&hdr, 0, sizeof(hdr));
+                hdr.msg_name = &addrs_[i];
+                hdr.msg_namelen = sizeof(addrs_[i]);
+                hdr.msg_iov = &iovs_[i];
+                hdr.msg_iovlen = 1;
+                msgs_[i].msg_len = 0;
+            }
+            int n = ::recvmmsg(fd_, msgs_.data(), batch_, flags, nullptr);
+            stats_.calls_++;
+            if (n <= 0) break;
+
+            for (int i = 0; i < n; i++) {
+                if (msgs_[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                    stats_.truncated_++;
+                    continue;
+                }
+                const struct sockaddr_in &from = addrs_[i];
+                IpEndpointName remote(ntohl(from.sin_addr.s_addr), ntohs(from.sin_port));
+                listener_->ProcessPacket(static_cast<const char *>(iovs_[i].iov_base),
+                                         static_cast<int>(msgs_[i].msg_len), remote);
+            }
+            stats_.packets_ += n;
+            total += n;
+            if ((unsigned) n < batch_) break;
+            flags = MSG_DONTWAIT;
+        }
+        return total;
+    }
+
+    void run() {
+        while (!break_) {
+            receive(-1);
+        }
+    }
+
+    PacketListener *listener_;
+    unsigned batch_;
+    int fd_;
+    int breakFd_;
+    bool busyPoll_;
+    unsigned port_;
+    std::atomic<bool> break_;
+    UdpReceiver::Stats stats_;
+
+    std::vector<char> slab_;
+    std::vector<struct mmsghdr> msgs_;
+    std::vector<struct iovec> iovs_;
+    std::vector<struct sockaddr_in> addrs_;
+};
+
+
+static bool resolve(const std::string &host, unsigned port, struct sockaddr_in &addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == 1) return true;
+
+    struct addrinfo hints, *res = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (::getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || res == nullptr) return false;
+    addr.sin_addr = ((struct sockaddr_in *) res->ai_addr)->sin_addr;
+    ::freeaddrinfo(res);
+    return true;
+}
+
+
+class UdpBlaster_impl {
+public:
+    UdpBlaster_impl() : fd_(-1) { ; }
+
+    ~UdpBlaster_impl() { close(); }
+
+    bool open(const std::string &host, unsigned port) {
+        close();
+        if (!resolve(host, port, addr_)) {
+            LOG_0("UdpBlaster: unable to resolve " << host);
+            return false;
+        }
+        fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+        return fd_ >= 0;
+    }
+
+    void close() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    unsigned send(const char *data, unsigned size, unsigned count) {
+        if (fd_ < 0) return 0;
+        static const unsigned BATCH = 64;
+        struct iovec iov;
+        iov.iov_base = const_cast<char *>(data);
+        iov.iov_len = size;
+        struct mmsghdr msgs[BATCH];
+        memset(msgs, 0, sizeof(msgs));
+        for (unsigned i = 0; i < BATCH; i++) {
+            msgs[i].msg_hdr.msg_name = &addr_;
+            msgs[i].msg_hdr.msg_namelen = sizeof(addr_);
+            msgs[i].msg_hdr.msg_iov = &iov;
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        unsigned sent = 0;
+        while (sent < count) {
+            unsigned n = count - sent < BATCH ? count - sent : BATCH;
+            int r = ::sendmmsg(fd_, msgs, n, 0);
+            if (r <= 0) break;
+            sent += r;
+        }
+        return sent;
+    }
+
+    int fd_;
+    struct sockaddr_in addr_;
+};
+
+class UdpSender_impl {
+public:
+    UdpSender_impl() : fd_(-1) {
+        memset(&stats_, 0, sizeof(stats_));
+        for (unsigned i = 0; i < UdpSender::MAX_DESTINATIONS; i++) used_[i] = false;
+    }
+
+    ~UdpSender_impl() { close(); }
+
+    bool open() {
+        close();
+        fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+        return fd_ >= 0;
+    }
+
+    void close() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+        for (unsigned i = 0; i < UdpSender::MAX_DESTINATIONS; i++) used_[i] = false;
+    }
+
+    int addDestination(const std::string &host, unsigned port) {
+        for (unsigned i = 0; i < UdpSender::MAX_DESTINATIONS; i++) {
+            if (used_[i]) continue;
+            if (!resolve(host, port, dests_[i])) {
+                LOG_0("UdpSender: unable to resolve " << host);
+                return -1;
+            }
+            used_[i] = true;
+            return i;
+        }
+        return -1;
+    }
+
+    void removeDestination(int dest) {
+        if (dest >= 0 && dest < (int) UdpSender::MAX_DESTINATIONS) used_[dest] = false;
+    }
+
+    unsigned send(const UdpSender::Datagram *datagrams, unsigned n) {
+        if (fd_ < 0) return 0;
+        static const unsigned BATCH = 64;
+        struct iovec iov[BATCH];
+        struct mmsghdr msgs[BATCH];
+        unsigned sent = 0;
+        for (unsigned i = 0; i < n;) {
+            unsigned count = 0;
+            for (; i < n && count < BATCH; i++) {
+                const UdpSender::Datagram &d = datagrams[i];
+                if (d.dest_ >= UdpSender::MAX_DESTINATIONS || !used_[d.dest_]) continue;
+                iov[count].iov_base = const_cast<char *>(d.data_);
+                iov[count].iov_len = d.size_;
+                memset(&msgs[count], 0, sizeof(msgs[count]));
+                msgs[count].msg_hdr.msg_name = &dests_[d.dest_];
+                msgs[count].msg_hdr.msg_namelen = sizeof(dests_[d.dest_]);
+                msgs[count].msg_hdr.msg_iov = &iov[count];
+                msgs[count].msg_hdr.msg_iovlen = 1;
+                count++;
+            }
+            for (unsigned done = 0; done < count;) {
+                int r = ::sendmmsg(fd_, msgs + done, count - done, 0);
+                stats_.calls_++;
+                if (r <= 0) {
+                    // failed on the first, skip it, so one bad destination does not stop the others
+                    stats_.errors_++;
+                    done++;
+                    continue;
+                }
+                done += r;
+                sent += r;
+            }
+        }
+        stats_.datagrams_ += sent;
+        return sent;
+    }
+
+    int fd_;
+    bool used_[UdpSender::MAX_DESTINATIONS];
+    struct sockaddr_in dests_[UdpSender::MAX_DESTINATIONS];
+    UdpSender::Stats stats_;
+};
+
+#else
+
+class UdpReceiver_impl {
+public:
+    UdpReceiver_impl(PacketListener *listener, unsigned) : listener_(listener), port_(0) {
+        memset(&stats_, 0, sizeof(stats_));
+    }
+
+    bool open(unsigned port, unsigned busyPollUs) {
+        if (busyPollUs > 0) LOG_0("UdpReceiver: busy poll not supported");
+        try {
+            socket_.reset(new UdpListeningReceiveSocket(IpEndpointName(IpEndpointName::ANY_ADDRESS, port), listener_));
+        } catch (const std::runtime_error &e) {
+            LOG_0("UdpReceiver: unable to bind udp socket, port " << port);
+            return false;
+        }
+        port_ = port;
+        return true;
+    }
+
+    void close() { socket_.reset(); }
+
+    void asynchronousBreak() { if (socket_) socket_->AsynchronousBreak(); }
+
+    unsigned receive(int) { return 0; }
+
+    void run() { if (socket_) socket_->Run(); }
+
+    PacketListener *listener_;
+    unsigned port_;
+    UdpReceiver::Stats stats_;
+    std::unique_ptr<UdpListeningReceiveSocket> socket_;
+};
+
+
+class UdpBlaster_impl {
+public:
+    bool open(const std::string &host, unsigned port) {
+        try {
+            socket_.reset(new UdpTransmitSocket(IpEndpointName(host.c_str(), port)));
+        } catch (const std::runtime_error &e) {
+            return false;
+        }
+        return true;
+    }
+
+    void close() { socket_.reset(); }
+
+    unsigned send(const char *data, unsigned size, unsigned count) {
+        if (!socket_) return 0;
+        for (unsigned i = 0; i < count; i++) socket_->Send(data, size);
+        return count;
+    }
+
+    std::unique_ptr<UdpTransmitSocket> socket_;
+};
+
+class UdpSender_impl {
+public:
+    UdpSender_impl() {
+        memset(&stats_, 0, sizeof(stats_));
+    }
+
+    bool open() {
+        try {
+            socket_.reset(new UdpSocket());
+        } catch (const std::runtime_error &e) {
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        socket_.reset();
+        dests_.clear();
+    }
+
+    int addDestination(const std::string &host, unsigned port) {
+        for (unsigned i = 0; i < UdpSender::MAX_DESTINATIONS; i++) {
+            if (i < dests_.size() && dests_[i].port != 0) continue;
+            if (i >= dests_.size()) dests_.resize(i + 1);
+            try {
+                dests_[i] = IpEndpointName(host.c_str(), port);
+            } catch (const std::runtime_error &e) {
+                return -1;
+            }
+            return i;
+        }
+        return -1;
+    }
+
+    void removeDestination(int dest) {
+        if (dest >= 0 && dest < (int) dests_.size()) dests_[dest] = IpEndpointName();
+    }
+
+    unsigned send(const UdpSender::Datagram *datagrams, unsigned n) {
+        if (!socket_) return 0;
+        unsigned sent = 0;
+        for (unsigned i = 0; i < n; i++) {
+            const UdpSender::Datagram &d = datagrams[i];
+            if (d.dest_ >= dests_.size() || dests_[d.dest_].port == 0) continue;
+            socket_->SendTo(dests_[d.dest_], d.data_, d.size_);
+            stats_.calls_++;
+            sent++;
+        }
+        stats_.datagrams_ += sent;
+        return sent;
+    }
+
+    std::unique_ptr<UdpSocket> socket_;
+    std::vector<IpEndpointName> dests_; // port 0, unused
+    UdpSender::Stats stats_;
+};
+
+#endif
+
+
+////////////////////////////// UdpReceiver ////////////////////////////////////////
+
+UdpReceiver::UdpReceiver(PacketListener *listener, unsigned batch) :
+        impl_(new UdpReceiver_impl(listener, batch)) {
+}
+
+UdpReceiver::~UdpReceiver() {
+    close();
+}
+
+bool UdpReceiver::open(unsigned port, unsigned busyPollUs) {
+    return impl_->open(port, busyPollUs);
+}
+
+void UdpReceiver::close() {
+    impl_->close();
+}
+
+bool UdpReceiver::isOpen() const {
+#ifdef __linux__
+    return impl_->fd_ >= 0;
+#else
+    return impl_->socket_ != nullptr;
+#endif
+}
+
+unsigned UdpReceiver::port() const {
+    return impl_->port_;
+}
+
+void UdpReceiver::run() {
+    impl_->run();
+}
+
+void UdpReceiver::asynchronousBreak() {
+    impl_->asynchronousBreak();
+}
+
+unsigned UdpReceiver::receive(int timeoutUs) {
+    return impl_->receive(timeoutUs);
+}
+
+bool UdpReceiver::timedReceive() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+const UdpReceiver::Stats &UdpReceiver::stats() const {
+    return impl_->stats_;
+}
+
+
+////////////////////////////// UdpBlaster ////////////////////////////////////////
+
+UdpBlaster::UdpBlaster() : impl_(new UdpBlaster_impl()) {
+}
+
+UdpBlaster::~UdpBlaster() {
+    close();
+}
+
+bool UdpBlaster::open(const std::string &host, unsigned port) {
+    return impl_->open(host, port);
+}
+
+void UdpBlaster::close() {
+    impl_->close();
+}
+
+unsigned UdpBlaster::send(const char *data, unsigned size, unsigned count) {
+    return impl_->send(data, size, count);
+}
+
+
+////////////////////////////// UdpSender ////////////////////////////////////////
+
+UdpSender::UdpSender() : impl_(new UdpSender_impl()) {
+}
+
+UdpSender::~UdpSender() {
+    close();
+}
+
+bool UdpSender::open() {
+    return impl_->open();
+}
+
+void UdpSender::close() {
+    impl_->close();
+}
+
+int UdpSender::addDestination(const std::string &host, unsigned port) {
+    return impl_->addDestination(host, port);
+}
+
+void UdpSender::removeDestination(int dest) {
+    impl_->removeDestination(dest);
+}
+
+unsigned UdpSender::send(const Datagram *datagrams, unsigned n) {
+    return impl_->send(datagrams, n);
+}
+
+const UdpSender::Stats &UdpSender::stats() const {
+    return impl_->stats_;
+}
+
+}
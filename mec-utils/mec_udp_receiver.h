@@ -0,0 +1,110 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <ip/PacketListener.h>
+
+namespace mec {
+
+// udp receive socket for the osc devices (OscT3D, Kontrol::OSCReceiver)
+// a drop in for oscpack's UdpListeningReceiveSocket, packets go to the same PacketListener
+//
+// linux : recvmmsg, up to "batch" datagrams per system call, into a slab allocated when opened
+//         packets are passed to the listener in place, from the slab
+//         optionally busy polls (SO_BUSY_POLL, in us), for lowest latency at the expense of a core
+// other platforms : UdpListeningReceiveSocket (run() only, see timedReceive())
+class UdpReceiver_impl;
+
+class UdpReceiver {
+public:
+    static const unsigned DEFAULT_BATCH = 32;
+    static const unsigned MAX_PACKET_SIZE = 4096; // larger packets are dropped (and counted)
+
+    struct Stats {
+        unsigned long long packets_;
+        unsigned long long calls_;     // receive system calls
+        unsigned long long truncated_; // dropped, larger than MAX_PACKET_SIZE
+    };
+
+    UdpReceiver(PacketListener *listener, unsigned batch = DEFAULT_BATCH);
+    ~UdpReceiver();
+
+    bool open(unsigned port, unsigned busyPollUs = 0); // port 0, any free port (see port())
+    void close(); // not while running
+    bool isOpen() const;
+    unsigned port() const;
+
+    void run(); // receive until asynchronousBreak()
+    void asynchronousBreak(); // any thread
+
+    // wait up to timeoutUs (-1 forever) for packets, then receive all that are available
+    // returns packets received, returns early on asynchronousBreak()
+    // only if timedReceive(), otherwise returns 0 immediately (use run())
+    unsigned receive(int timeoutUs);
+    static bool timedReceive();
+
+    const Stats &stats() const;
+
+private:
+    std::unique_ptr<UdpReceiver_impl> impl_;
+};
+
+
+// sends the same packet repeatedly, as fast as possible (sendmmsg on linux)
+// used to load a receiver over loopback, for tests and mec-bench
+class UdpBlaster_impl;
+
+class UdpBlaster {
+public:
+    UdpBlaster();
+    ~UdpBlaster();
+
+    bool open(const std::string &host, unsigned port);
+    void close();
+    unsigned send(const char *data, unsigned size, unsigned count); // returns packets sent
+
+private:
+    std::unique_ptr<UdpBlaster_impl> impl_;
+};
+
+
+// one unbound socket, sending to many destinations, in as few system calls as possible (sendmmsg on linux)
+// used by Kontrol::OSCBroadcaster, to send each message to all its clients
+// not thread safe, destinations must not be changed while sending
+class UdpSender_impl;
+
+class UdpSender {
+public:
+    static const unsigned MAX_DESTINATIONS = 32;
+
+    struct Datagram {
+        const char *data_;
+        unsigned size_;
+        unsigned dest_; // from addDestination
+    };
+
+    struct Stats {
+        unsigned long long datagrams_;
+        unsigned long long calls_;  // send system calls
+        unsigned long long errors_; // datagrams that failed to send
+    };
+
+    UdpSender();
+    ~UdpSender();
+
+    bool open();
+    void close(); // also removes all destinations
+
+    int addDestination(const std::string &host, unsigned port); // returns dest, -1 if full or unresolved
+    void removeDestination(int dest); // dest may then be reused
+
+    unsigned send(const Datagram *datagrams, unsigned n); // returns datagrams sent
+
+    const Stats &stats() const;
+
+private:
+    std::unique_ptr<UdpSender_impl> impl_;
+};
+
+}